@@ -179,6 +179,37 @@ namespace {
 		}
 	}
 
+	/**
+	 * Create operand from xpdf object.
+	 *
+	 * Simple objects (almost all operands) are allocated by the operator
+	 * allocator, complex objects are created on the heap.
+	 *
+	 * @param o Xpdf object.
+	 * @param alloc Allocator.
+	 */
+	boost::shared_ptr<IProperty>
+	createOperand (const ::Object& o, const OperatorAllocator& alloc)
+	{
+		switch (o.getType ())
+		{
+			case objBool:
+				return boost::allocate_shared<CBool> (alloc, o);
+			case objInt:
+				return boost::allocate_shared<CInt> (alloc, o);
+			case objReal:
+				return boost::allocate_shared<CReal> (alloc, o);
+			case objString:
+				return boost::allocate_shared<CString> (alloc, o);
+			case objName:
+				return boost::allocate_shared<CName> (alloc, o);
+			case objNull:
+				return boost::allocate_shared<CNull> (alloc);
+			default:
+				return boost::shared_ptr<IProperty> (createObjFromXpdfObj (o));
+		}
+	}
+
 	/**
 	 * Create simple operator and its operands.
 	 *
@@ -187,7 +218,8 @@ namespace {
 	bool
 	createOperandsFromStream (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, 
 					PdfOperator::Operands& operands,
-					boost::shared_ptr< ::Object>& o)
+					boost::shared_ptr< ::Object>& o,
+					const OperatorAllocator& alloc)
 	{
 		// Get first object
 		streamreader.getXpdfObject (*o);
@@ -204,8 +236,7 @@ namespace {
 			}else 
 			{// We have an OPERAND
 				
-				boost::shared_ptr<IProperty> pIp (createObjFromXpdfObj (*o));
-				operands.push_back (pIp);
+				operands.push_back (createOperand (*o, alloc));
 			}
 
 			o->free ();
@@ -222,14 +253,16 @@ namespace {
 	 *
 	 * @param streamreader CStreams parser from which we get an xpdf object.
 	 * @param operands Operands of operator. They are shared through subcalls.
+	 * @param alloc Allocator for operators and operands.
 	 */
 	boost::shared_ptr<PdfOperator>
 	createOperatorFromStream (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, 
-					PdfOperator::Operands& operands)
+					PdfOperator::Operands& operands,
+					const OperatorAllocator& alloc)
 	{
 		// Get operands
 		boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-		if (!createOperandsFromStream (streamreader, operands, o))
+		if (!createOperandsFromStream (streamreader, operands, o, alloc))
 			return boost::shared_ptr<PdfOperator> ();
 		
 		//
@@ -252,7 +285,7 @@ namespace {
 
 		// factory function for all other operators
 		std::string name = o->getCmd();
-		return createOperator(name, operands);
+		return createOperator(name, operands, alloc);
 	}
 	
 	/**
@@ -266,14 +299,17 @@ namespace {
 	 *
 	 * @param streamreader CStreams parser from which we get an xpdf object.
 	 * @param operands Operands of operator. They are shared through subcalls.
+	 * @param alloc Allocator for operators and operands.
 	 *
 	 * @return New pdf operator.
 	 */
 	boost::shared_ptr<PdfOperator>
-	parseOp (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, PdfOperator::Operands& operands)
+	parseOp (CStreamsXpdfReader<CContentStream::CStreams>& streamreader, 
+			 PdfOperator::Operands& operands, 
+			 const OperatorAllocator& alloc)
 	{
 		// Create operator with its operands
-		boost::shared_ptr<PdfOperator> result = createOperatorFromStream (streamreader, operands);
+		boost::shared_ptr<PdfOperator> result = createOperatorFromStream (streamreader, operands, alloc);
 	
 		if (result && isCompositeOp (result) && !isInlineImageOp (result))
 		{
@@ -288,7 +324,7 @@ namespace {
 			//
 			// Use recursion to get all operators
 			//
-			while (newop=parseOp (streamreader, operands))
+			while (newop=parseOp (streamreader, operands, alloc))
 			{
 				result->push_back (newop, previousLast);
 
@@ -316,27 +352,26 @@ namespace {
 	}
 
 	/**
-	 * Parse the stream for the first time into pdf operators. 
+	 * Parse streams into pdf operators. 
 	 *
-	 * Problem with content stream is, that it can be splitted in many streams
-	 * and the split points are really insane. And moreover some pdf creators 
-	 * produce even more insane split points. So we try to parse a valid stream
-	 * (all composite objects are ended with their ending tags) and look if we
-	 * are at the end of one of the streams. If positive, we claim this content
-	 * stream to be a valid one.
+	 * Streams which form the content stream are found by scan, so all of
+	 * them are parsed.
+	 *
+	 * All operators and their operands are allocated by given allocator
+	 * (from the arena of the content stream).
 	 * 
 	 * @param operators Operator stack.
 	 * @param streams 	Streams to be parsed.
 	 * @param cs 		Content stream in which operators belong
 	 * @param observer 	Operand observer.
-	 * @param parsedstreams Streams that have been really parsed.
+	 * @param alloc 	Allocator for operators and operands.
 	 */
 	void
 	parse (CContentStream::Operators& operators, 
 						CContentStream::CStreams& streams, 
 						CContentStream& cs,
 						boost::shared_ptr<IPropertyObserver> observer,
-						CContentStream::CStreams* parsedstreams = NULL)
+						const OperatorAllocator& alloc)
 	{
 		// Clear operators
 		operators.clear ();
@@ -366,50 +401,10 @@ namespace {
 		//
 		try 
 		{
-			bool our_change = false;
-			while (newop=parseOp (streamreader, operands))
+			while (newop=parseOp (streamreader, operands, alloc))
 			{
-				//
-				// Is it our change
-				//
-				if (isPdfOp (*newop,ContentsChangeTag::CHANGE_TAG_NAME))
-				{	
-					PdfOperator::Operands ops;
-					newop->getParameters (ops);
-					if (!ops.empty())
-					{
-						try {
-							if (ContentsChangeTag::CHANGE_TAG_ID == getNameFromIProperty(ops.front()))
-								our_change = true;
-						}catch (ElementBadTypeException&)
-							{}
-					}
-				}
-
 				topoperator->push_back (newop, previousLast);
 				previousLast = getLastOperator (newop);
-
-				if (parsedstreams)
-				{ // FIRST PARSE
-					//
-					// We have found complete and correct content stream.
-					//  BUT this can be tricky -- e.g. 
-					//  Tf ...
-					//  <<END>>
-					//  Tj 
-					// if we want to do something with all operators (xml
-					// output) we have a problem
-					//
-					if (streamreader.eofOfActualStream())
-					{
-						if (our_change)
-							break;
-						boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-						streamreader.lookXpdfObject (*o);
-						if (o->isName (ContentsChangeTag::CHANGE_TAG_ID))
-							break;
-					}
-				}
 			}
 
 		}catch (CObjectException&)
@@ -430,24 +425,7 @@ namespace {
 		// Delete topoperator
 		topoperator.reset();
 
-		if (parsedstreams)  // Save which streams were parsed and close
-			streamreader.close (*parsedstreams);
-		else
-			streamreader.close ();
-
-
-		if (parsedstreams)
-		{ // FIRST PARSE
-	
-			// Check if they match the input streams and delete them
-			CContentStream::CStreams::iterator itparsed = parsedstreams->begin (); 
-			for (; itparsed != parsedstreams->end(); ++itparsed)
-			{			
-				assert (*(streams.begin()) == *itparsed);
-				//streams.erase (streams.begin());
-				streams.pop_front();
-			}
-		}
+		streamreader.close ();
 
 			assert (operands.empty());
 			assert (observer);
@@ -456,6 +434,179 @@ namespace {
 			opsSetPdfRefCs (operators.front(), pdf, rf, cs, observer);
 	}
 
+	/**
+	 * Get kind of the first level block started by an operator.
+	 *
+	 * @param name Operator name.
+	 * @param composite Is the operator a composite.
+	 */
+	CContentStream::Block::Kind
+	blockKind (const std::string& name, bool composite)
+	{
+		if (!composite)
+			return CContentStream::Block::Simple;
+		if ("q" == name)
+			return CContentStream::Block::GraphicState;
+		if ("BT" == name)
+			return CContentStream::Block::Text;
+		return CContentStream::Block::Composite;
+	}
+
+	/**
+	 * Add a first level operator to the index of blocks.
+	 *
+	 * Consecutive simple operators share one block.
+	 */
+	void
+	addBlock (CContentStream::Blocks& blocks, CContentStream::Block::Kind kind)
+	{
+		if (CContentStream::Block::Simple == kind && !blocks.empty() 
+				&& CContentStream::Block::Simple == blocks.back().kind)
+			++blocks.back().count;
+		else
+			blocks.push_back (CContentStream::Block (kind));
+	}
+
+	/**
+	 * Build the index of blocks from first level operators.
+	 */
+	void
+	indexOperators (const CContentStream::Operators& operators, CContentStream::Blocks& blocks)
+	{
+		blocks.clear ();
+		for (CContentStream::Operators::const_iterator it = operators.begin(); it != operators.end(); ++it)
+		{
+			std::string name;
+			(*it)->getOperatorName (name);
+			addBlock (blocks, blockKind (name, isCompositeOp (*it)));
+		}
+	}
+
+	/**
+	 * Find out which streams form the first content stream without creating
+	 * pdf operators.
+	 *
+	 * Problem with content stream is, that it can be splitted in many streams
+	 * and the split points are really insane. And moreover some pdf creators 
+	 * produce even more insane split points. So we read a valid stream
+	 * (all composite objects are ended with their ending tags) and look if we
+	 * are at the end of one of the streams. If positive, we claim this content
+	 * stream to be a valid one.
+	 *
+	 * Only xpdf objects are read and nesting of composite operators is
+	 * tracked by their end tags. First level blocks are indexed on the way
+	 * (see CContentStream::Block), so the content stream can answer simple
+	 * questions before its operators are parsed from the scanned streams.
+	 *
+	 * @param streams 	Streams to be scanned, scanned streams are removed.
+	 * @param scannedstreams Output container of scanned streams.
+	 * @param blocks 	Output index of first level blocks.
+	 */
+	void
+	scan (CContentStream::CStreams& streams, 
+		  CContentStream::CStreams& scannedstreams,
+		  CContentStream::Blocks& blocks)
+	{
+		blocks.clear ();
+
+		// Check if streams are in a valid pdf
+		for (CContentStream::CStreams::const_iterator it = streams.begin(); it != streams.end(); ++it)
+		{
+			assert (hasValidPdf (*it) && hasValidRef (*it));
+			if (!hasValidPdf (*it) || !hasValidRef (*it))
+				throw CObjInvalidObject ();
+		}
+
+		assert (!streams.empty());
+		CStreamsXpdfReader<CContentStream::CStreams> streamreader (streams);
+		streamreader.open ();
+
+		boost::shared_ptr< ::Object> o(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+		// End tags of opened composites
+		std::vector<std::string> endtags;
+		// Kind of the opened first level composite
+		CContentStream::Block::Kind kind = CContentStream::Block::Simple;
+		bool our_change = false;
+		bool our_tag = false;
+		bool first_operand = true;
+
+		try
+		{
+			streamreader.getXpdfObject (*o);
+			while (!streamreader.eof ())
+			{
+				if (!o->isCmd ())
+				{ // OPERAND -- only the first one can be our change tag id
+					if (first_operand)
+						our_tag = o->isName (ContentsChangeTag::CHANGE_TAG_ID);
+					first_operand = false;
+					o->free ();
+					streamreader.getXpdfObject (*o);
+					continue;
+				}
+
+				// OPERATOR
+				std::string name = o->getCmd ();
+				bool firstlevel = endtags.empty ();
+				if (0 == strncmp (name.c_str(), "BI", 2))
+				{ // inline image data have to be skipped
+					boost::scoped_ptr<CInlineImage> img (getInlineImage (streamreader));
+					if (firstlevel)
+						addBlock (blocks, CContentStream::Block::Composite);
+
+				}else if (!endtags.empty() && name == endtags.back())
+				{
+					endtags.pop_back ();
+					// first level composite is indexed when it is complete
+					if (endtags.empty ())
+						addBlock (blocks, kind);
+
+				}else
+				{
+					if (our_tag && firstlevel && name == ContentsChangeTag::CHANGE_TAG_NAME)
+						our_change = true;
+					const StateUpdater::CheckTypes* chcktp = StateUpdater::findOp (name.c_str());
+					if (chcktp && !isSimpleOp (*chcktp))
+					{
+						endtags.push_back (chcktp->endTag);
+						if (firstlevel)
+							kind = blockKind (name, true);
+					}else if (firstlevel)
+						addBlock (blocks, CContentStream::Block::Simple);
+				}
+				our_tag = false;
+				first_operand = true;
+
+				// We are at the end of a complete first level operator
+				if (endtags.empty() && streamreader.eofOfActualStream())
+				{
+					if (our_change)
+						break;
+					o->free ();
+					streamreader.lookXpdfObject (*o);
+					if (o->isName (ContentsChangeTag::CHANGE_TAG_ID))
+						break;
+				}
+
+				o->free ();
+				streamreader.getXpdfObject (*o);
+			}
+
+		}catch (CObjectException&)
+		{
+			kernelPrintDbg (debug::DBG_ERR, "Invalid content stream...");
+		}
+
+		// Save which streams were scanned and remove them from input
+		streamreader.close (scannedstreams);
+		CContentStream::CStreams::iterator itscanned = scannedstreams.begin (); 
+		for (; itscanned != scannedstreams.end(); ++itscanned)
+		{			
+			assert (*(streams.begin()) == *itscanned);
+			streams.pop_front();
+		}
+	}
+
 
 	//==========================================================
 	// Gfx state updater functors
@@ -481,6 +632,125 @@ namespace {
 		}
 	};
 
+	/**
+	 * Stop predicate for bounding box update.
+	 *
+	 * Stores entry states of all first level operators it walks through and
+	 * complete state checkpoints of every interval-th of them. After the last
+	 * changed operator it compares the new entry state with the stored one
+	 * and stops as soon as they match. Works as a never stopping predicate
+	 * if no last changed operator is given.
+	 */
+	template<typename States, typename Checkpoints>
+	struct BBoxSync
+	{
+		typedef typename States::mapped_type State;
+		
+		CContentStream::Operators::const_iterator cur, end;
+		size_t since;
+		size_t interval;
+		const PdfOperator* curLast;
+		const PdfOperator* lastChanged;
+		bool passed;
+		States* states;
+		Checkpoints* checkpoints;
+
+		/**
+		 * @param start First level operator where the update starts.
+		 * @param ops First level operators.
+		 * @param changed Last changed operator or NULL.
+		 * @param sts Entry states.
+		 * @param chcks State checkpoints.
+		 * @param intrvl Minimal distance of checkpoints.
+		 */
+		BBoxSync (CContentStream::Operators::const_iterator start, const CContentStream::Operators& ops, 
+				  const PdfOperator* changed, States* sts, Checkpoints* chcks, size_t intrvl) 
+			: cur (start), end (ops.end()), since (0), interval (intrvl), curLast (NULL), 
+			  lastChanged (changed), passed (false), states (sts), checkpoints (chcks)
+		{
+			if (cur != end)
+				curLast = getLastOperator (*cur).get();
+		}
+
+		static State getState (const GfxState& state)
+		{
+			State st;
+			st.curX = state.getCurX ();
+			st.curY = state.getCurY ();
+			st.lineX = state.getLineX ();
+			st.lineY = state.getLineY ();
+			st.path = state.isCurPt ();
+			return st;
+		}
+
+		static bool equal (const State& a, const State& b)
+		{
+			return !a.path && !b.path
+				&& a.curX == b.curX && a.curY == b.curY 
+				&& a.lineX == b.lineX && a.lineY == b.lineY;
+		}
+
+		bool operator() (const boost::shared_ptr<PdfOperator>& op, const GfxState& state)
+		{
+			if (op.get() == lastChanged)
+				passed = true;
+			if (op.get() != curLast)
+				return false;
+
+			// we are at the boundary of first level operators
+			if (++cur == end)
+				return true;
+			curLast = getLastOperator (*cur).get();
+			
+			// only states without saved ones and path can be restarted, so
+			// the checkpoint is stored at the first such boundary after the
+			// interval
+			GfxState& gfxstate = const_cast<GfxState&> (state);
+			if (++since >= interval && !gfxstate.hasSaves() && !gfxstate.isPath())
+			{
+				(*checkpoints)[(*cur).get()] = boost::shared_ptr<GfxState> (state.copy (false));
+				since = 0;
+			}else
+				checkpoints->erase ((*cur).get());
+
+			State st = getState (state);
+			typename States::iterator it = states->find ((*cur).get());
+			if (passed && it != states->end() && equal (it->second, st))
+				return true;
+			(*states)[(*cur).get()] = st;
+			return false;
+		}
+	};
+
+
+	/**
+	 * Is the operator neutral to the graphical state.
+	 *
+	 * Complete q/Q composite restores the graphical state so it can not change
+	 * bounding boxes of operators behind it.
+	 */
+	bool
+	isStateNeutral (boost::shared_ptr<PdfOperator> op)
+	{
+		if (!isCompositeOp (op) || !isPdfOp (op, "q"))
+			return false;
+		return isPdfOp (getLastOperator (op), "Q");
+	}
+
+	/**
+	 * Get lock for parsing content streams of the document the streams
+	 * belong to (see CPdf::getContentMutex).
+	 *
+	 * @param streams Non empty streams with valid pdf.
+	 */
+	threads::Mutex&
+	contentMutex (const CContentStream::CStreams& streams)
+	{
+		assert (!streams.empty());
+		boost::shared_ptr<CPdf> pdf = streams.front()->getPdf().lock();
+		assert (pdf);
+		return pdf->getContentMutex();
+	}
 	
 //==========================================================
 } // namespace
@@ -569,13 +839,18 @@ throw ()
 // Constructors
 //
 CContentStream::CContentStream (boost::shared_ptr<GfxState> state, 
-		boost::shared_ptr<GfxResources> res) : gfxstate (state), gfxres (res) {
+		boost::shared_ptr<GfxResources> res) 
+	: parsed (true), gfxstate (state), gfxres (res), spansValid (false), dirtyState (true),
+	  transactionDepth (0), transactionPending (false), transactionDirty (false),
+	  transactionAborted (false) {
 }
 
 CContentStream::CContentStream (CStreams& strs, 
 								boost::shared_ptr<GfxState> state, 
 								boost::shared_ptr<GfxResources> res) 
-	: gfxstate (state), gfxres (res)
+	: parsed (true), gfxstate (state), gfxres (res), spansValid (false), dirtyState (true),
+	  transactionDepth (0), transactionPending (false), transactionDirty (false),
+	  transactionAborted (false)
 {
 	kernelPrintDbg (DBG_DBG, "");
 	setStreams(strs);
@@ -586,6 +861,7 @@ void CContentStream::setStreams (CStreams& strs) {
 	// cleanup
 	if (cstreamobserver)
 		unregisterCStreamObservers();
+	invalidateSpans ();
 
 	// If streams are empty return
 	if (strs.empty())
@@ -608,17 +884,87 @@ void CContentStream::setStreams (CStreams& strs) {
 	// Create operand observer
 	operandobserver = boost::shared_ptr<OperandObserver> (new OperandObserver (this));
 	
-	// Parse it, move parsed streams from strs to cstreams
-	parse (operators, strs, *this, operandobserver, &cstreams);
-	
-	// Save bounding boxes
-	if (!operators.empty()) 
-		StateUpdater::updatePdfOperators (PdfOperator::getIterator (operators.front()), gfxres, *gfxstate, BBoxUpdater());
+	// Find out our streams and move them from strs to cstreams, operators
+	// are parsed when needed
+	operators.clear ();
+	arena.renew ();
+	cstreams.clear ();
+	{
+		threads::ScopedLock lock (contentMutex (strs));
+		scan (strs, cstreams, blocks);
+	}
+	parsed = false;
 
 	// Register observer on all cstream
 	registerCStreamObservers ();
 }
 
+//
+//
+//
+void
+CContentStream::init () const
+{
+	// Shared read-only document can be used by more threads, so parsing and
+	// checking whether we have already parsed has to be done under the lock
+	if (cstreams.empty())
+		return;
+	threads::ScopedLock lock (contentMutex (cstreams));
+	if (parsed)
+		return;
+
+	CContentStream* cs = const_cast<CContentStream*> (this);
+	cs->parsed = true;
+	try {
+		cs->arena.renew ();
+		parse (cs->operators, cs->cstreams, *cs, operandobserver, OperatorAllocator (cs->arena.get ()));
+	}catch (...)
+	{
+		cs->operators.clear ();
+		cs->parsed = false;
+		throw;
+	}
+	// Index is built from operators from now on
+	Blocks ().swap (cs->blocks);
+	
+	// Save bounding boxes
+	cs->dirtyState = true;
+	cs->updateChangedBBoxes (true);
+}
+
+
+//
+//
+//
+bool
+CContentStream::empty () const
+{
+	if (!cstreams.empty())
+	{
+		threads::ScopedLock lock (contentMutex (cstreams));
+		if (!parsed)
+			return blocks.empty ();
+	}
+	return operators.empty ();
+}
+
+//
+//
+//
+void
+CContentStream::getBlocks (Blocks& container) const
+{
+	if (!cstreams.empty())
+	{
+		threads::ScopedLock lock (contentMutex (cstreams));
+		if (!parsed)
+		{
+			container = blocks;
+			return;
+		}
+	}
+	indexOperators (operators, container);
+}
 
 //
 // Helper methods
@@ -639,17 +985,34 @@ CContentStream::reparse (bool bboxOnly, boost::shared_ptr<GfxState> state, boost
 	assert (gfxres);
 	assert (gfxstate);
 	
+	// Not parsed yet, everything will be done with the first access, only
+	// the index of blocks has to follow changed cstreams
+	if (!parsed)
+	{
+		invalidateSpans ();
+		if (!bboxOnly && !cstreams.empty())
+		{
+			threads::ScopedLock lock (contentMutex (cstreams));
+			CStreams strs (cstreams), scanned;
+			scan (strs, scanned, blocks);
+		}
+		return;
+	}
+
 	// Reparse it if needed
 	if (!bboxOnly)
 	{
-		// Clear operators	
+		// Our serialization is not in the cstreams anymore
+		invalidateSpans ();
+		// Clear operators, their memory is reused if nobody else holds them
 		operators.clear ();
-		parse (operators, cstreams, *this, operandobserver);
+		arena.renew ();
+		parse (operators, cstreams, *this, operandobserver, OperatorAllocator (arena.get ()));
 	}
 	
-	// Save bounding boxes
-	if (!operators.empty()) 
-		StateUpdater::updatePdfOperators (PdfOperator::getIterator (operators.front()), gfxres, *gfxstate, BBoxUpdater());
+	// Save bounding boxes (graphical state or resources could have changed)
+	dirtyState = true;
+	updateChangedBBoxes (true);
 }
 
 //
@@ -659,6 +1022,7 @@ void
 CContentStream::replaceText (const std::wstring& what, const std::wstring& with)
 {
 	bool dirty = false;
+	init ();
 		if (operators.empty())
 			return;
 
@@ -685,7 +1049,7 @@ CContentStream::replaceText (const std::wstring& what, const std::wstring& with)
 
 	operandobserver->unlock();
 	if (dirty)
-		_objectChanged();
+		saveChange ();
 }
 
 
@@ -696,6 +1060,8 @@ void
 CContentStream::_objectChanged ()
 {
 	assert (!cstreams.empty());
+	// Operators are serialized so they have to be there
+	init ();
 	// Do not notify anything if we are not in a valid pdf
 	if (!hasValidPdf (cstreams.front()))
 		return;
@@ -717,22 +1083,34 @@ CContentStream::_objectChanged ()
 	unregisterCStreamObservers ();
 
 	try {
-		// Save it
-		string tmp;
-		getStringRepresentation (tmp);
+		// Save it -- only dirty operators are serialized if we know where 
+		// the clean ones are
+		bool splice = spansValid;
+		CStream::Buffer buf;
+		serialize (buf);
 		assert (!cstreams.empty());
 		CStreams::iterator it = cstreams.begin();
 		assert (it != cstreams.end());
-		// Put it to the first cstream
-		(*it)->setBuffer (tmp);
-		++it;
-		// Erase all others
-		for (;it != cstreams.end();++it)
-			(*it)->setBuffer (string(""));
+		if (splice)
+		{
+			// Filters were dropped when we wrote the first cstream the 
+			// last time and all other cstreams are already empty
+			(*it)->setRawBuffer (buf);
+		}else
+		{
+			// Put it to the first cstream
+			(*it)->setBuffer (buf);
+			++it;
+			// Erase all others
+			for (;it != cstreams.end();++it)
+				(*it)->setBuffer (string(""));
+		}
+		spansValid = true;
 
 	}catch (PdfException&)
 	{
 		kernelPrintDbg (debug::DBG_WARN, "Restoring old value...");
+		invalidateSpans ();
 		// Register observers again
 		registerCStreamObservers ();
 		throw;
@@ -744,7 +1122,7 @@ CContentStream::_objectChanged ()
 	registerCStreamObservers ();
 	
 	// Update bboxes
-	reparse (true);
+	updateChangedBBoxes ();
 
 	// Notify observers
 	boost::shared_ptr<CContentStream> current (this, EmptyDeallocator<CContentStream> ());
@@ -752,6 +1130,263 @@ CContentStream::_objectChanged ()
 }
 
 
+//
+//
+//
+void
+CContentStream::dispatchChange ()
+{
+	if (inTransaction ())
+	{
+		transactionPending = true;
+		return;
+	}
+	_objectChanged ();
+}
+
+//
+//
+//
+void
+CContentStream::beginTransaction ()
+{
+	if (0 == transactionDepth++)
+	{
+		transactionPending = false;
+		transactionDirty = false;
+		transactionAborted = false;
+	}
+}
+
+//
+//
+//
+void
+CContentStream::commitTransaction ()
+{
+	assert (inTransaction ());
+	if (!inTransaction ())
+		throw CObjInvalidOperation ();
+
+	if (0 < --transactionDepth)
+		return;
+
+	if (transactionAborted)
+	{
+		++transactionDepth;
+		abortTransaction ();
+		return;
+	}
+
+	if (transactionPending)
+	{
+		transactionPending = false;
+		transactionDirty = false;
+		_objectChanged ();
+	}
+}
+
+//
+//
+//
+void
+CContentStream::abortTransaction ()
+{
+	assert (inTransaction ());
+	if (!inTransaction ())
+		throw CObjInvalidOperation ();
+
+	if (0 < --transactionDepth)
+	{
+		transactionAborted = true;
+		return;
+	}
+
+	bool dirty = transactionDirty;
+	transactionPending = false;
+	transactionDirty = false;
+	transactionAborted = false;
+	// Cstreams were not touched in the transaction
+	if (dirty && !cstreams.empty())
+		reparse ();
+}
+
+//
+//
+//
+void
+CContentStream::serialize (CStream::Buffer& buf)
+{
+	assert (!cstreams.empty());
+	const CStream::Buffer& old = cstreams.front()->getBuffer();
+	SerializedSpans newspans;
+
+	for (Operators::const_iterator it = operators.begin(); it != operators.end(); ++it)
+	{
+		const PdfOperator* op = (*it).get();
+		SerializedSpan span;
+		span.offset = buf.size();
+
+		SerializedSpans::const_iterator oldspan = spans.end();
+		if (spansValid && dirtyOps.end() == dirtyOps.find (op))
+			oldspan = spans.find (op);
+
+		if (oldspan != spans.end() && oldspan->second.offset + oldspan->second.length <= old.size())
+		{ // clean operator -- copy what we have already written
+			CStream::Buffer::const_iterator from = old.begin() + oldspan->second.offset;
+			buf.insert (buf.end(), from, from + oldspan->second.length);
+		}else
+		{ // dirty or unknown operator
+			std::string tmp;
+			(*it)->getStringRepresentation (tmp);
+			buf.insert (buf.end(), tmp.begin(), tmp.end());
+			buf.push_back (' ');
+		}
+
+		span.length = buf.size() - span.offset;
+		newspans.insert (std::make_pair (op, span));
+	}
+
+	spans.swap (newspans);
+}
+
+//
+//
+//
+void
+CContentStream::updateChangedBBoxes (bool all)
+{
+	assert (gfxres);
+	assert (gfxstate);
+	if (operators.empty())
+	{
+		dirtyOps.clear ();
+		entryStates.clear ();
+		checkpoints.clear ();
+		dirtyState = false;
+		return;
+	}
+
+	// Find the first and the last changed first level operator and the
+	// closest checkpoint in front of the first one. Checkpoint of the first
+	// changed operator itself can't be used, because it can follow a
+	// removed operator
+	boost::shared_ptr<PdfOperator> firstChanged, lastChanged;
+	Operators::const_iterator start = operators.begin();
+	for (Operators::const_iterator it = operators.begin(); it != operators.end(); ++it)
+	{
+		if (dirtyOps.end() != dirtyOps.find ((*it).get()))
+		{
+			if (!firstChanged)
+				firstChanged = *it;
+			lastChanged = *it;
+		}else if (!firstChanged && checkpoints.end() != checkpoints.find ((*it).get()))
+			start = it;
+	}
+
+	typedef BBoxSync<EntryStates, StateCheckpoints> Sync;
+	if (all || (dirtyState && !firstChanged))
+	{ // we have to update everything
+		entryStates.clear ();
+		checkpoints.clear ();
+		StateUpdater::updatePdfOperators (PdfOperator::getIterator (operators.front()), gfxres, *gfxstate, 
+				BBoxUpdater(), Sync (operators.begin(), operators, NULL, &entryStates, &checkpoints, BBOX_CHECKPOINT_INTERVAL));
+	}else if (firstChanged)
+	{ // operators in front of the checkpoint are not affected, operators
+	  // behind the last changed one are affected only until the state gets
+	  // synchronized (or all of them if the state could have changed)
+		GfxState& state = (operators.begin() == start) ? *gfxstate : *checkpoints[(*start).get()];
+		const PdfOperator* last = (dirtyState) ? NULL : getLastOperator (lastChanged).get();
+		StateUpdater::updatePdfOperators (PdfOperator::getIterator (*start), gfxres, state, 
+				BBoxUpdater(), Sync (start, operators, last, &entryStates, &checkpoints, BBOX_CHECKPOINT_INTERVAL));
+	}
+
+	dirtyOps.clear ();
+	dirtyState = false;
+}
+
+//
+//
+//
+boost::shared_ptr<PdfOperator>
+CContentStream::getFirstLevelOperator (boost::shared_ptr<PdfOperator> oper) const
+{
+	for (Operators::const_iterator it = operators.begin(); it != operators.end(); ++it)
+	{
+		if (*it == oper)
+			return *it;
+		if (!isCompositeOp (*it))
+			continue;
+
+		// Look into the composite subtree
+		boost::shared_ptr<PdfOperator> last = getLastOperator (*it);
+		OperatorIterator opit = PdfOperator::getIterator (*it);
+		while (!opit.isEnd())
+		{
+			if (opit.getCurrent() == oper)
+				return *it;
+			if (opit.getCurrent() == last)
+				break;
+			opit.next ();
+		}
+	}
+	return boost::shared_ptr<PdfOperator> ();
+}
+
+//
+//
+//
+void
+CContentStream::markChanged (boost::shared_ptr<PdfOperator> oper)
+{
+	if (!oper)
+	{
+		invalidateSpans ();
+		return;
+	}
+	if (inTransaction ())
+		transactionDirty = true;
+	dirtyOps.insert (oper.get());
+	if (!isStateNeutral (oper))
+		dirtyState = true;
+}
+
+//
+//
+//
+void
+CContentStream::markRemoved (boost::shared_ptr<PdfOperator> oper)
+{
+	if (inTransaction ())
+		transactionDirty = true;
+	spans.erase (oper.get());
+	dirtyOps.erase (oper.get());
+	entryStates.erase (oper.get());
+	checkpoints.erase (oper.get());
+	if (!isStateNeutral (oper))
+		dirtyState = true;
+
+	// Entry state of the following operator can change
+	Operators::const_iterator it = std::find (operators.begin(), operators.end(), oper);
+	if (it != operators.end() && ++it != operators.end())
+		dirtyOps.insert ((*it).get());
+}
+
+//
+//
+//
+void
+CContentStream::invalidateSpans ()
+{
+	if (inTransaction ())
+		transactionDirty = true;
+	spansValid = false;
+	spans.clear ();
+	dirtyOps.clear ();
+	dirtyState = true;
+}
+
+
 //
 // If an operator is in CContentStream::operators it is
 // 	* not in a composite
@@ -765,6 +1400,7 @@ void
 CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 {
 	kernelPrintDbg (debug::DBG_DBG, "");
+	init ();
 	assert (!operators.empty());
 	assert (!cstreams.empty());
 
@@ -787,8 +1423,10 @@ CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 		assert (composite);
 		// Remove it from composite
 		if (composite)
+		{
+			markChanged (getFirstLevelOperator (composite));
 			composite->remove (toDel);
-		else
+		}else
 		{
 			//assert ("Want to delete a not existing operator.");
 			throw CObjInvalidObject ();
@@ -797,6 +1435,7 @@ CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 	}else
 	{
 		// Remove it from operators
+		markRemoved (toDel);
 		operators.erase (operIt);
 	}
 
@@ -832,7 +1471,7 @@ CContentStream::deleteOperator (OperatorIterator it, bool indicateChange)
 	{
 		try {
 			// notify observers and dispatch the change
-			_objectChanged ();
+			dispatchChange ();
 
 		}catch (PdfException&)
 		{
@@ -850,6 +1489,7 @@ void
 CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperator> newOper, bool indicateChange)
 {
 	kernelPrintDbg (debug::DBG_DBG, "");
+	init ();
 	assert (!cstreams.empty());
 
 	// Check whether we can make the change
@@ -860,6 +1500,7 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 	{
 		assert (!it.valid());
 		operators.push_back (newOper);
+		markChanged (newOper);
 		return;
 	}
 	assert (!it.isEnd());
@@ -886,8 +1527,10 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 		assert (composite);
 		// Insert it into composite
 		if (composite)
+		{
+			markChanged (getFirstLevelOperator (composite));
 			composite->insert_after (it.getCurrent(), newOper);
-		else
+		}else
 		{
 			//assert ("Want to insert after not existing operator.");
 			throw CObjInvalidObject ();
@@ -898,6 +1541,7 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 		// Insert it into operators
 		++operIt;
 		operators.insert (operIt, newOper);
+		markChanged (newOper);
 	}
 
 	//
@@ -924,7 +1568,7 @@ CContentStream::insertOperator (OperatorIterator it, boost::shared_ptr<PdfOperat
 	{
 		try {
 			// notify observers and dispatch the change
-			_objectChanged ();
+			dispatchChange ();
 
 		}catch (PdfException&)
 		{
@@ -941,6 +1585,7 @@ void
 CContentStream::frontInsertOperator (boost::shared_ptr<PdfOperator> newoper, 
 		bool indicateChange)
 {
+	init ();
 		assert (!cstreams.empty());
 		// Set correct IndiRef, CPdf and cs to inserted operator
 		assert (hasValidRef (cstreams.front()));
@@ -954,6 +1599,7 @@ CContentStream::frontInsertOperator (boost::shared_ptr<PdfOperator> newoper,
 	// set accordingly	
 	opsSetPdfRefCs (newoper, pdf, rf, *this, operandobserver);
 
+	markChanged (newoper);
 	if (operators.empty ())
 	{ // Insert into empty contentstream
 		operators.push_back (newoper);
@@ -973,7 +1619,7 @@ CContentStream::frontInsertOperator (boost::shared_ptr<PdfOperator> newoper,
 	{
 		try {
 			// notify observers and dispatch the change
-			_objectChanged ();
+			dispatchChange ();
 
 		}catch (PdfException&)
 		{
@@ -992,6 +1638,7 @@ CContentStream::replaceOperator (OperatorIterator it,
 		bool indicateChange)
 {
 	kernelPrintDbg (debug::DBG_DBG, "");
+	init ();
 	assert (!operators.empty());
 	assert (!cstreams.empty());
 
@@ -1023,6 +1670,7 @@ CContentStream::replaceOperator (OperatorIterator it,
 		// Replace it from composite
 		if (composite)
 		{
+			markChanged (getFirstLevelOperator (composite));
 			composite->insert_after (toReplace, newOper);
 			composite->remove (toReplace);
 		
@@ -1035,7 +1683,9 @@ CContentStream::replaceOperator (OperatorIterator it,
 	}else
 	{
 		// Replace it from operators
+		markRemoved (toReplace);
 		std::replace (operators.begin(), operators.end(), *operIt, newOper);
+		markChanged (newOper);
 	}
 
 	
@@ -1075,7 +1725,7 @@ CContentStream::replaceOperator (OperatorIterator it,
 	{
 		try {
 			// notify observers and dispatch the change
-			_objectChanged ();
+			dispatchChange ();
 
 		}catch (PdfException&)
 		{
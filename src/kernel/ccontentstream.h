@@ -31,6 +31,8 @@
 
 #include "kernel/pdfoperatorsbase.h"
 #include "kernel/pdfoperatorsiter.h"
+#include "kernel/cstream.h"
+#include "utils/arena.h"
 
 //==========================================================
 namespace pdfobjects {
@@ -69,6 +71,14 @@ typedef observer::ObserverHandler<CContentStream> CContentStreamObserverSubject;
  * Operators form a tree-like structure consisting of Simple and Composite objects. 
  * 
  * Only first level operators are stored.
+ *
+ * Operators are parsed lazily. When the content stream is created, the
+ * streams are only scanned to find out which of them form this content
+ * stream and an index of first level blocks (q/Q, BT/ET and other composites
+ * and runs of simple operators) is built. Operators are parsed when they are
+ * accessed for the first time, so e.g. adding a new content stream to a page
+ * does not parse existing ones and questions answered by the index (see
+ * getBlocks, empty) do not parse anything.
  * 
  * The pdf feature that a content stream can consist of several streams means we
  * can not derive from CStream object. Due to this limitation we do not have 
@@ -96,6 +106,24 @@ public:
 	typedef std::list<boost::shared_ptr<CStream> > CStreams;
 	typedef PdfOperator::Iterator OperatorIterator;
 	typedef observer::BasicChangeContext<CContentStream> BasicObserverContext;
+
+	/**
+	 * First level block of operators.
+	 *
+	 * Graphical state (q/Q), text (BT/ET) and other composite operators form
+	 * a block each, consecutive simple operators are merged into one block.
+	 */
+	struct Block
+	{
+		/** Kind of a block. */
+		enum Kind {Simple, GraphicState, Text, Composite};
+
+		Kind kind;		/**< Kind of the block. */
+		size_t count;	/**< Number of first level operators in the block. */
+
+		Block (Kind k) : kind (k), count (1) {}
+	};
+	typedef std::vector<Block> Blocks;
 	
 private:
 
@@ -104,6 +132,27 @@ private:
 
 	/** Parsed first level content stream operators. */
 	Operators operators;
+	/** 
+	 * Arena of parsed operators and their operands.
+	 *
+	 * It is reused (or replaced if some operators are still held by
+	 * somebody) when operators are parsed again or streams are replaced.
+	 */
+	ArenaOwner arena;
+	/** 
+	 * Are operators parsed from cstreams. 
+	 *
+	 * Cstreams are parsed lazily when operators are accessed for the first
+	 * time.
+	 */
+	bool parsed;
+	/** 
+	 * Index of first level blocks found by the scan of cstreams.
+	 *
+	 * Valid only until operators are parsed, the index is built from
+	 * operators afterwards.
+	 */
+	Blocks blocks;
 
 	/** Graphical state. */
 	boost::shared_ptr<GfxState> gfxstate;
@@ -114,6 +163,89 @@ private:
 	/** Smart pointer to this object. */
 	boost::weak_ptr<CContentStream> smart_this;
 
+	//
+	// Dirty range tracking
+	//
+private:
+	/**
+	 * Position of a first level operator serialization in the buffer of the
+	 * first cstream.
+	 */
+	struct SerializedSpan
+	{
+		size_t offset;	/**< Offset of the first byte. */
+		size_t length;	/**< Length including the trailing separator. */
+	};
+	typedef std::map<const PdfOperator*, SerializedSpan> SerializedSpans;
+	typedef std::set<const PdfOperator*> DirtyOperators;
+
+	/**
+	 * Spans of all clean first level operators.
+	 *
+	 * Valid only if spansValid is true which means that the first cstream
+	 * holds exactly what we have written there the last time (and all other
+	 * cstreams are empty).
+	 */
+	SerializedSpans spans;
+	/** Are spans valid. */
+	bool spansValid;
+
+	/** First level operators which were changed since the last save. */
+	DirtyOperators dirtyOps;
+
+	/**
+	 * True if a change could alter the graphical state of operators which
+	 * follow the changed ones. Bounding boxes of all operators have to be
+	 * recalculated in such a case.
+	 */
+	bool dirtyState;
+
+	/**
+	 * Graphical state attributes which are not restored by the Q operator at
+	 * the beginning of a first level operator.
+	 *
+	 * If they are the same as before a change which has not altered the
+	 * graphical state otherwise, bounding boxes of the operator and all
+	 * following operators remain the same.
+	 */
+	struct EntryState
+	{
+		double curX, curY, lineX, lineY;
+		bool path;
+	};
+	typedef std::map<const PdfOperator*, EntryState> EntryStates;
+
+	/** Entry states of first level operators (but the very first one). */
+	EntryStates entryStates;
+
+	/**
+	 * Complete graphical states at the beginning of some first level
+	 * operators.
+	 *
+	 * Bounding box update starts from the closest checkpoint in front of
+	 * the first changed operator instead of the first operator. A state is
+	 * stored at the first restartable boundary (no saved states, no path)
+	 * after BBOX_CHECKPOINT_INTERVAL first level operators.
+	 */
+	typedef std::map<const PdfOperator*, boost::shared_ptr<GfxState> > StateCheckpoints;
+	StateCheckpoints checkpoints;
+
+	/** Minimal distance of first level operators with stored state checkpoints. */
+	static const size_t BBOX_CHECKPOINT_INTERVAL = 32;
+
+	//
+	// Edit transactions
+	//
+private:
+	/** Number of open (nested) transactions. */
+	size_t transactionDepth;
+	/** Has a change been postponed until the end of the transaction. */
+	bool transactionPending;
+	/** Has an operator been changed in the transaction. */
+	bool transactionDirty;
+	/** Has a nested transaction been aborted. */
+	bool transactionAborted;
+
 	//
 	// Observer observing underlying cstreams and operands
 	//
@@ -219,7 +351,8 @@ public:
 			boost::shared_ptr<GfxResources> res);
 
 	/** Sets streams.
-	 * Cleans up the previous state and forces new parsing.
+	 * Cleans up the previous state. Streams which form the content stream
+	 * are moved from strs but operators are parsed only when needed.
 	 */
 	void setStreams(CStreams &strs);
 
@@ -253,6 +386,7 @@ public:
 	void getStringRepresentation (std::string& str) const
 	{
 		kernelPrintDbg (debug::DBG_DBG, "");
+		init ();
 
 		if (operators.empty ())
 			return;
@@ -280,6 +414,7 @@ public:
 	void getStringRepresentation (std::string& str) const
 	{
 		utilsPrintDbg (debug::DBG_DBG, "");
+		init ();
 
 		if (operators.empty ())
 			return;
@@ -310,6 +445,7 @@ public:
 	void getOperatorsAtPosition (OpContainer& opContainer, const PdfOpPosComparator& cmp) const
 	{
 		utilsPrintDbg (debug::DBG_DBG, "");
+		init ();
 		if (operators.empty())
 			return;
 			
@@ -356,6 +492,7 @@ public:
 	template<typename T>
 	void getPdfOperators (T& container) const
 	{ 
+		init ();
 		container.clear ();
 		std::copy (operators.begin(), operators.end(), std::back_inserter (container));
 	}
@@ -446,6 +583,88 @@ public:
 						  bool indicateChange = true)
 		{ replaceOperator (PdfOperator::getIterator<OperatorIterator> (oper), newOper, indicateChange); }
 
+	//
+	// Edit transactions
+	//
+public:
+	/**
+	 * Begin an edit transaction.
+	 *
+	 * Changes made inside of a transaction are not written to cstreams and
+	 * observers are not notified until the outermost transaction is
+	 * committed. Then the content stream is written, bounding boxes are
+	 * updated and observers are notified only once. Bounding boxes of
+	 * operators are not valid inside a transaction.
+	 *
+	 * Transactions can be nested, nested transactions are part of the
+	 * outermost one.
+	 */
+	void beginTransaction ();
+
+	/**
+	 * Commit an edit transaction.
+	 *
+	 * If this is the outermost transaction all postponed changes are saved.
+	 * If a nested transaction has been aborted the whole transaction is rolled
+	 * back instead.
+	 */
+	void commitTransaction ();
+
+	/**
+	 * Abort an edit transaction.
+	 *
+	 * If this is the outermost transaction the content stream is reparsed
+	 * from its (unchanged) cstreams, so all operators obtained inside of the
+	 * transaction are invalid after that. Aborting a nested transaction
+	 * aborts the outermost one when it ends.
+	 */
+	void abortTransaction ();
+
+	/** Is a transaction open. */
+	bool inTransaction () const
+		{ return 0 < transactionDepth; }
+
+	/**
+	 * Edit transaction guard.
+	 *
+	 * Begins a transaction in the constructor and aborts it in the destructor
+	 * unless it was committed.
+	 *
+	 * \code
+	 *	CContentStream::Transaction t (cs);
+	 *	cs->insertOperator (...);
+	 *	cs->deleteOperator (...);
+	 *	t.commit ();
+	 * \endcode
+	 */
+	class Transaction : public noncopyable
+	{
+		boost::shared_ptr<CContentStream> _cs;
+		bool _finished;
+	public:
+		/** Begin a transaction on specified content stream. */
+		Transaction (boost::shared_ptr<CContentStream> cs) : _cs (cs), _finished (false)
+			{ assert (_cs); _cs->beginTransaction (); }
+		/** Commit the transaction. */
+		void commit ()
+			{ assert (!_finished); _finished = true; _cs->commitTransaction (); }
+		/** Abort the transaction. */
+		void abort ()
+			{ assert (!_finished); _finished = true; _cs->abortTransaction (); }
+		/** Abort the transaction if it was not finished. */
+		~Transaction ()
+		{
+			if (_finished)
+				return;
+			try {
+				_cs->abortTransaction ();
+			}catch (...)
+			{
+				kernelPrintDbg (debug::DBG_ERR, "Transaction rollback failed.");
+			}
+		}
+	};
+
 	//
 	// Helper methods
 	//
@@ -453,9 +672,31 @@ public:
 	/**
 	 * Is the content stream empty.
 	 * 
+	 * Does not parse operators, the index of blocks is used if they have not
+	 * been parsed yet.
+	 *
 	 * @return True if the contentstream is empty, false otherwise.
 	 */
-	bool empty () const {return operators.empty ();}
+	bool empty () const;
+
+	/**
+	 * Are operators parsed from cstreams.
+	 *
+	 * @return True if operators have been already parsed, false if they will
+	 * be parsed with the first access.
+	 */
+	bool isParsed () const {return parsed;}
+
+	/**
+	 * Get index of first level blocks.
+	 *
+	 * Operators are not parsed, the index found by the scan of cstreams is
+	 * returned if they have not been parsed yet. Otherwise it is built from
+	 * first level operators.
+	 *
+	 * @param container Output container.
+	 */
+	void getBlocks (Blocks& container) const;
 
 	/**
 	 * Reparse pdf operators and set their bounding boxes.
@@ -491,8 +732,8 @@ public:
 	 *
 	 * Does not reparse anything. 
 	 */
-	void saveChange () 
-		{ _objectChanged(); }
+	void saveChange ()
+		{ invalidateSpans(); dispatchChange(); }
 
 	/**
 	 * Get smart pointer to this content stream.
@@ -523,12 +764,77 @@ public:
 
 
 private:
+	/**
+	 * Parse operators from cstreams if they have not been parsed yet.
+	 *
+	 * Bounding boxes are calculated too.
+	 */
+	void init () const;
 	/**
 	 * Save changes and indicate that the object has changed by calling all
 	 * observers.
 	 */
 	void _objectChanged ();
 
+	/**
+	 * Save changes now or at the end of the transaction if one is open.
+	 */
+	void dispatchChange ();
+
+	/**
+	 * Serialize first level operators into the buffer.
+	 *
+	 * Operators which are not dirty are copied from the current buffer of the
+	 * first cstream if spans are valid. New spans are stored.
+	 *
+	 * @param buf Output buffer.
+	 */
+	void serialize (CStream::Buffer& buf);
+
+	/**
+	 * Update bounding boxes after a change.
+	 *
+	 * Update starts at the closest state checkpoint in front of the first
+	 * changed operator. If no change could alter the graphical state of
+	 * following operators, it stops as soon as the state behind the last
+	 * changed operator is the same as before. Otherwise all following
+	 * bounding boxes are recalculated. Everything is recalculated if
+	 * changed operators are not known.
+	 *
+	 * @param all Recalculate everything (e.g. operators have been parsed
+	 * again or the graphical state has changed).
+	 */
+	void updateChangedBBoxes (bool all = false);
+
+	/**
+	 * Get first level operator which contains specified operator.
+	 *
+	 * @param oper Operator.
+	 *
+	 * @return First level operator (can be oper itself) or NULL if not found.
+	 */
+	boost::shared_ptr<PdfOperator> getFirstLevelOperator (boost::shared_ptr<PdfOperator> oper) const;
+
+	/**
+	 * Mark first level operator as changed.
+	 *
+	 * @param oper First level operator.
+	 */
+	void markChanged (boost::shared_ptr<PdfOperator> oper);
+
+	/**
+	 * Mark first level operator as removed.
+	 *
+	 * @param oper First level operator.
+	 */
+	void markRemoved (boost::shared_ptr<PdfOperator> oper);
+
+	/**
+	 * Forget all spans and force the full rewrite and bounding box update
+	 * with the next save.
+	 */
+	void invalidateSpans ();
+
 	//
 	// Observers
 	//
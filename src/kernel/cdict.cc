@@ -83,9 +83,11 @@ CDict::containsProperty (const string& name) const
 {
 	//kernelPrintDbg (debug::DBG_DBG, "getAllPropertyNames()");
 
+	// Name is not interned, keys are compared by hash first
+	size_t hash = NameTable::hash (name);
 	for ( Value::const_iterator it = value.begin(); it != value.end(); ++it)
 	{
-		if ((*it).first == name)
+		if ((*it).first.equals (name, hash))
 			return true;
 	}
 
@@ -247,7 +249,7 @@ CDict::addProperty (const string& propertyName, const IProperty& newIp)
 		newIpClone->setPdf (this->getPdf());
 	
 		// Store it
-		value.push_back (make_pair (propertyName,newIpClone));
+		value.push_back (make_pair (Name (propertyName),newIpClone));
 		
 	}else
 		throw CObjInvalidObject ();
@@ -384,7 +386,7 @@ CDict::_makeXpdfObject () const
 	{
 		boost::shared_ptr<IProperty> prop = it->second;
 		Object * propObj = prop->_makeXpdfObject();
-		dictObj->dictAdd(copyString((it->first).c_str()), propObj);
+		dictObj->dictAdd(copyString((it->first).str().c_str()), propObj);
 		gfree(propObj);
 	}
 	assert(static_cast<unsigned int>(dictObj->dictGetLength()) == getPropertyCount());
@@ -69,7 +69,7 @@ class CDict : noncopyable, public IProperty
 	friend class CStream;
 	
 public:
-	typedef std::list<std::pair<std::string, boost::shared_ptr<IProperty> > > Value; 
+	typedef std::list<std::pair<Name, boost::shared_ptr<IProperty> > > Value; 
 	typedef const std::string& WriteType; 
 	typedef const std::string& PropertyId;
 	typedef observer::ComplexChangeContext<IProperty, PropertyId> CDictComplexObserverContext;
@@ -429,23 +429,28 @@ public:
  * </ul>
  * This functor relies on the first one.
  *
+ * Keys are interned names, the searched name is compared with them by its
+ * hash first and it is not interned, so the lookup doesn't take the name
+ * table lock.
+ *
  * REMARK: More effective algorithms could be used but this approach is 
  * more generic.
  */
 class DictIdxComparator : noncopyable
 {
 private:
-	const std::string str;
+	const std::string& name;
+	size_t hash;
 	boost::shared_ptr<IProperty> ip;
 
 public:
-	DictIdxComparator (const std::string& s) : str(s) {}
+	DictIdxComparator (const std::string& s) : name (s), hash (NameTable::hash (s)) {}
 		
 	boost::shared_ptr<IProperty> getIProperty () {return ip;}
 		
 	bool operator() (const CDict::Value::value_type& item)
 	{	
-		if (item.first == str)
+		if (item.first.equals (name, hash))
 		{
 			ip = item.second;
 			return true;
@@ -555,6 +560,23 @@ unsigned char* convertStreamToDecodedData (const Object& obj, size_t& size);
  */
 typedef unsigned char* (*stream_data_extractor)(const Object& obj, size_t& size);
 
+/** Prepares pdf representation of stream object without its data.
+ * @param streamObject Xpdf object representing stream.
+ * @param ref Reference for this indirect object (NULL for direct object).
+ * @param dataLength Number of stream data bytes.
+ * @param prefix Everything what precedes stream data (indirect header,
+ * 	dictionary and stream keyword).
+ * @param suffix Everything what follows stream data (endstream keyword and
+ * 	indirect footer).
+ *
+ * Updates Length entry of the stream dictionary to dataLength if it differs.
+ * prefix, data and suffix together form the same representation as
+ * streamToCharBuffer produces, so the data can be written without copying
+ * them to one buffer.
+ */
+void streamFraming (const Object & streamObject, Ref* ref, size_t dataLength,
+		std::string & prefix, std::string & suffix);
+
 /** Makes a valid pdf indirect object representation of stream object.
  * @param streamObject Xpdf object representing stream.
  * @param ref Reference for this indirect object.
@@ -30,6 +30,8 @@
 //
 #include "kernel/pdfspecification.h"
 #include "kernel/cobject.h"
+#include "kernel/nametable.h"
+#include "utils/atomic.h"
 #include "kernel/cpdf.h"
 #include "kernel/cxref.h"
 #include "kernel/factories.h"
@@ -107,9 +109,17 @@ parseStreamToContainer (T& container, const ::Object& obj)
 	rawstr->reset ();
 
 	// Save chars
-	int c;
-	while (container.size() < len && EOF != (c = rawstr->getChar())) 
-		container.push_back (static_cast<typename T::value_type> (c));
+	container.resize (len);
+	size_t read = 0;
+	while (read < len)
+	{
+		int chunk = static_cast<int> (std::min (len - read, static_cast<size_t> (INT_MAX)));
+		int n = rawstr->getBlock (reinterpret_cast<char*> (&container[read]), chunk);
+		if (n <= 0)
+			break;
+		read += n;
+	}
+	container.resize (read);
 	
 	utilsPrintDbg (debug::DBG_DBG, "Container length: " << container.size());
 	
@@ -207,5 +217,213 @@ createIndirectObjectStringFromString  ( const IndiRef& rf, const std::string& va
 // =====================================================================================
 } /* namespace utils */
 // =====================================================================================
+
+// =====================================================================================
+//  NameTable
+// =====================================================================================
+
+namespace {
+
+	/** Key of the table index (name string without its terminator). */
+	struct NameKey
+	{
+		const char* str;
+		size_t len;
+		NameKey (const char* s, size_t l) : str (s), len (l) {}
+	};
+
+	/** Compares keys of the table index. */
+	struct NameKeyLess
+	{
+		bool operator() (const NameKey& a, const NameKey& b) const
+		{
+			int cmp = memcmp (a.str, b.str, std::min (a.len, b.len));
+			return (0 != cmp) ? (0 > cmp) : (a.len < b.len);
+		}
+	};
+
+	/**
+	 * Storage of the interned names.
+	 *
+	 * Entries are allocated separately, so the index can point to their
+	 * names and atoms stay valid until they are purged.
+	 */
+	struct NameStorage
+	{
+		typedef std::map<NameKey, NameTable::Entry*, NameKeyLess> Index;
+
+		/** Minimal number of insertions between two purges. */
+		static const size_t MIN_PURGE_INTERVAL = 1024;
+
+		Index index;
+		/** Number of insertions since the last purge. */
+		size_t inserted;
+		/** Table is shared by all documents (and threads). */
+		threads::Mutex mutex;
+		/** Entry of the empty name. */
+		NameTable::Entry* empty;
+
+		NameStorage () : inserted (0)
+		{
+			// empty name is always referenced by the storage, so default
+			// names can share it without the lock
+			empty = insert ("", 0);
+			empty->refs = 1;
+		}
+
+		/** Deletes all unused entries (entries still referenced by
+		 * objects destroyed later are left to them). */
+		~NameStorage ()
+		{
+			purge ();
+		}
+
+		/** Creates unreferenced entry for the name. */
+		NameTable::Entry*
+		insert (const char* name, size_t len)
+		{
+			NameTable::Entry* entry = new NameTable::Entry;
+			entry->name.assign (name, len);
+			entry->hash = NameTable::hash (entry->name);
+			entry->refs = 0;
+			index.insert (std::make_pair (NameKey (entry->name.data (), len), entry));
+			++inserted;
+			return entry;
+		}
+
+		/** Deletes all entries which are not referenced. Entry can't be
+		 * referenced again without the lock, because nobody else holds
+		 * its atom. */
+		void
+		purge ()
+		{
+			for (Index::iterator it = index.begin (); it != index.end ();)
+			{
+				NameTable::Entry* entry = it->second;
+				if (0 < threads::atomicRead (entry->refs))
+				{
+					++it;
+					continue;
+				}
+				index.erase (it++);
+				delete entry;
+			}
+			inserted = 0;
+		}
+	};
+
+	/** Get the storage (created on the first use). */
+	NameStorage&
+	nameStorage ()
+	{
+		static NameStorage storage;
+		return storage;
+	}
+
+} // namespace
+
+//
+//
+//
+NameTable::Atom
+NameTable::intern (const std::string& name)
+{
+	return intern (name.data (), name.length ());
+}
+
+//
+//
+//
+NameTable::Atom
+NameTable::intern (const char* name)
+{
+	return intern (name, strlen (name));
+}
+
+//
+//
+//
+NameTable::Atom
+NameTable::intern (const char* name, size_t len)
+{
+	NameStorage& storage = nameStorage ();
+	threads::ScopedLock lock (storage.mutex);
+	NameStorage::Index::const_iterator it = storage.index.find (NameKey (name, len));
+	Entry* entry;
+	if (it != storage.index.end ())
+		entry = it->second;
+	else
+	{
+		// purge only after as many insertions as half of the table, so
+		// that unused names are not searched for on each insertion
+		size_t interval = storage.index.size () / 2;
+		if (interval < NameStorage::MIN_PURGE_INTERVAL)
+			interval = NameStorage::MIN_PURGE_INTERVAL;
+		if (storage.inserted >= interval)
+			storage.purge ();
+		entry = storage.insert (name, len);
+	}
+	threads::atomicIncrement (entry->refs);
+	return entry;
+}
+
+//
+//
+//
+NameTable::Atom
+NameTable::empty ()
+{
+	Entry* entry = nameStorage ().empty;
+	threads::atomicIncrement (entry->refs);
+	return entry;
+}
+
+//
+//
+//
+void
+NameTable::acquire (Atom atom)
+{
+	threads::atomicIncrement (atom->refs);
+}
+
+//
+//
+//
+void
+NameTable::release (Atom atom)
+{
+	long refs = threads::atomicDecrement (atom->refs);
+	assert (0 <= refs);
+	(void) refs;
+}
+
+//
+//
+//
+size_t
+NameTable::hash (const std::string& name)
+{
+	// FNV-1a
+	size_t h = 2166136261U;
+	for (std::string::const_iterator it = name.begin (); it != name.end (); ++it)
+	{
+		h ^= static_cast<unsigned char> (*it);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+//
+//
+//
+size_t
+NameTable::size ()
+{
+	NameStorage& storage = nameStorage ();
+	threads::ScopedLock lock (storage.mutex);
+	return storage.index.size ();
+}
+
 } /* namespace pdfobjects */
 // =====================================================================================
@@ -96,6 +96,12 @@ simpleValueFromString (const std::string& str, std::string& val)
 	val = str;
 }
 
+void
+simpleValueFromString (const std::string& str, Name& val)
+{
+	val = str;
+}
+
 void
 simpleValueFromString (const std::string& str, IndiRef& val)
 {
@@ -500,7 +500,7 @@ namespace {
 			for (int i = 0; i < len; ++i)
 			{
 				// Get Object at i-th position
-				string key (dict.dictGetKey (i));
+				Name key (dict.dictGetKey (i));
 				obj->free ();
 				dict.dictGetValNF (i,obj.get());
 
@@ -732,8 +732,40 @@ template void simpleValueFromXpdfObj<pInt, int&> (const Object&,  int& val);
 template void simpleValueFromXpdfObj<pReal, double&> (const Object&, double& val);
 template void simpleValueFromXpdfObj<pString, string&> (const Object&, string& val);
 template void simpleValueFromXpdfObj<pName, string&> (const Object&, string& val);
+template void simpleValueFromXpdfObj<pName, Name&> (const Object&, Name& val);
 template void simpleValueFromXpdfObj<pRef, IndiRef&> (const Object&, IndiRef& val);
 
+//
+//
+//
+template <PropertyType Tp>
+typename PropertyTraitSimple<Tp>::storage
+simpleStorageFromXpdfObj (const Object& obj)
+{
+	typedef typename PropertyTraitSimple<Tp>::storage Storage;
+	Storage val = Storage ();
+	simpleValueFromXpdfObj<Tp, Storage&> (obj, val);
+	return val;
+}
+
+//
+// Special case for pName, interned only once
+//
+template <>
+Name
+simpleStorageFromXpdfObj<pName> (const Object& obj)
+{
+	if (objName != obj.getType())
+		throw ElementBadTypeException ("Xpdf object is not name.");
+	return Name (obj.getName ());
+}
+template NullType simpleStorageFromXpdfObj<pNull> (const Object& obj);
+template bool simpleStorageFromXpdfObj<pBool> (const Object& obj);
+template int simpleStorageFromXpdfObj<pInt> (const Object& obj);
+template double simpleStorageFromXpdfObj<pReal> (const Object& obj);
+template string simpleStorageFromXpdfObj<pString> (const Object& obj);
+template IndiRef simpleStorageFromXpdfObj<pRef> (const Object& obj);
+
 
 
 //
@@ -893,7 +925,9 @@ xpdfStreamObjFromBuffer (const CStream::Buffer& buffer, const CDict& dict)
 
 unsigned char* bufferFromStream(Stream& str, size_t dictLength, size_t& size)
 {
-	size_t streamLength = dictLength;
+	// Length value may be missing or wrong, so we start with some reasonable
+	// size anyway
+	size_t streamLength = std::max(dictLength, (size_t)1024);
 	unsigned char* buffer = (unsigned char*)malloc(sizeof(unsigned char)*streamLength);
 	if(!buffer)
 	{
@@ -901,9 +935,8 @@ unsigned char* bufferFromStream(Stream& str, size_t dictLength, size_t& size)
 		return NULL;
 	}
 	str.reset();
-	int ch;
 	size_t i = 0;
-	while((ch=str.getChar())!=EOF)
+	for(;;)
 	{
 		if(i == streamLength)
 		{
@@ -917,11 +950,15 @@ unsigned char* bufferFromStream(Stream& str, size_t dictLength, size_t& size)
 			}
 			buffer = buf;
 		}
-		// NOTE that we are reducing int -> char here, so multi-bytes
-		// returned from a stream will be stripped to 1B
-		if((unsigned char)ch != ch)
-			utilsPrintDbg(debug::DBG_DBG, "Too wide character("<<(int)ch<<") in the stream at pos="<<i);
-		buffer[i++]=(unsigned char)ch;
+		// reads as much as fits into the buffer - getBlock returns less only
+		// at the end of the stream
+		size_t want = std::min(streamLength - i, (size_t)INT_MAX);
+		int read = str.getBlock((char *)buffer + i, (int)want);
+		if(read <= 0)
+			break;
+		i += read;
+		if((size_t)read < want)
+			break;
 	}
 
 	// restore stream object to the begining
@@ -962,6 +999,48 @@ unsigned char* convertStreamToDecodedData(const Object& obj, size_t& size)
 	return buffer;
 }
 
+void streamFraming (const Object & streamObject, Ref* ref, size_t dataLength,
+		std::string & prefix, std::string & suffix)
+{
+	// indirect header is filled only if ref is given
+	// same way footer
+	std::string header="";
+	std::string footer="";
+	if(ref)
+	{
+		ostringstream indirectHeader;
+		indirectHeader << *ref << " " << Specification::INDIRECT_HEADER << "\n";
+		header += indirectHeader.str();
+		footer = Specification::INDIRECT_FOOTER;
+	}
+
+	// Update dict stream with the new Length value (if necessary)
+	// TODO indirect value would be much better, but we don't have
+	// access to the XrefWriter here
+	boost::shared_ptr< ::Object> lenghtObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+ 	streamObject.streamGetDict()->lookup("Length", lenghtObj.get());
+	if (!lenghtObj->isInt() || (size_t)lenghtObj->getInt() != dataLength)
+	{
+		lenghtObj->free();
+		lenghtObj->initInt((int)dataLength);
+		Object* oldLen = streamObject.getStream()->getBaseStream()->dictUpdate("Length", lenghtObj.get());
+		if(oldLen)
+			freeXpdfObject(oldLen);
+	}
+
+	// FIXME dirty workaround because we don't have dedicated function
+	// for Dict -> String conversion
+	// initDict increases streamDict's reference thus we need to
+	// decrease it back by free
+	boost::shared_ptr< ::Object> streamDictObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	streamDictObj->initDict((Dict *)streamObject.streamGetDict());
+	std::string dict;
+	xpdfObjToString(*streamDictObj, dict);
+
+	prefix = header + dict + Specification::CSTREAM_HEADER;
+	suffix = Specification::CSTREAM_FOOTER + footer;
+}
+
 size_t streamToCharBuffer (const Object & streamObject, Ref* ref, CharBuffer & outputBuf, 
 		stream_data_extractor extractor)
 {
@@ -1000,47 +1079,11 @@ size_t streamToCharBuffer (const Object & streamObject, Ref* ref, CharBuffer & o
 	if(!realBufferLen)
 		utilsPrintDbg(debug::DBG_WARN, "Stream " << *ref << " with zero bytes in encountered");
 	
-	// indirect header is filled only if asIndirect flag is set
-	// same way footer
-	std::string header="";
-	std::string footer="";
-	if(ref)
-	{
-		ostringstream indirectHeader;
-		indirectHeader << *ref << " " << Specification::INDIRECT_HEADER << "\n";
-		header += indirectHeader.str();
-		footer = Specification::INDIRECT_FOOTER;
-	}
-
-	// Update dict stream with the new Length value (if necessary)
-	// TODO indirect value would be much better, but we don't have
-	// access to the XrefWriter here
-	if (lenghtObj->getInt() != realBufferLen)
-	{
-		lenghtObj->initInt(realBufferLen);
-		// don't need to give copyString(Length) because we are sure, that
-		// this entry already exists
- 		Object* oldLen = streamObject.getStream()->getBaseStream()->dictUpdate("Length", lenghtObj.get());
-		if(oldLen)
-			freeXpdfObject(oldLen);
-	}
-
-	// FIXME dirty workaround because we don't have dedicated function
-	// for Dict -> String conversion
-	// initDict increases streamDict's reference thus we need to
-	// decrease it back by free
-	boost::shared_ptr< ::Object> streamDictObj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-	streamDictObj->initDict((Dict *)streamObject.streamGetDict());
-	std::string dict;
-	xpdfObjToString(*streamDictObj, dict);
+	std::string prefix, suffix;
+	streamFraming(streamObject, ref, realBufferLen, prefix, suffix);
 
 	// gets total length and allocates CharBuffer for output
-	size_t len = header.length() + 
-		dict.length() + 
-		Specification::CSTREAM_HEADER.length() +
-		realBufferLen + 
-		Specification::CSTREAM_FOOTER.length() + 
-		footer.length(); 
+	size_t len = prefix.length() + realBufferLen + suffix.length(); 
 	char* buf = char_buffer_new (len);
 	outputBuf = CharBuffer (buf, char_buffer_delete()); 
 
@@ -1051,19 +1094,13 @@ size_t streamToCharBuffer (const Object & streamObject, Ref* ref, CharBuffer & o
 	size_t copied=0;
 
 	// copy all parts 
-	memcpy(buf, header.c_str(), header.length());
-	copied+=header.length();
-	memcpy(buf+copied, dict.c_str(), dict.length());
-	copied+=dict.length();
-	memcpy(buf+copied, Specification::CSTREAM_HEADER.c_str(), Specification::CSTREAM_HEADER.length());
-	copied+=Specification::CSTREAM_HEADER.length();
+	memcpy(buf, prefix.data(), prefix.length());
+	copied+=prefix.length();
 	memcpy(buf+copied, dataBuff, realBufferLen);
 	free(dataBuff);
 	copied+=realBufferLen;
-	memcpy(buf + copied, Specification::CSTREAM_FOOTER.c_str(), Specification::CSTREAM_FOOTER.length());
-	copied+=Specification::CSTREAM_FOOTER.length();
-	memcpy(buf + copied, footer.c_str(), footer.length());
-	copied+=footer.length();
+	memcpy(buf + copied, suffix.data(), suffix.length());
+	copied+=suffix.length();
 	
 	// just to be sure
 	assert(copied==len);
@@ -28,6 +28,7 @@
 // all basic includes
 #include "kernel/static.h"
 #include "kernel/iproperty.h"
+#include "kernel/nametable.h"
 #include <algorithm>
 
 
@@ -46,6 +47,10 @@ namespace pdfobjects {
  * If someone tries to use unsupported type (e.g pCmd, etc.), she 
  * should get compile error because PropertyTraitSimple<> has no body.
  * <br>
+ * Storage is the type used to hold the value inside of the object. It
+ * differs from the value type only for names, which are interned (see
+ * NameTable).
+ * <br>
  * REMARK: BE CAREFUL when manipulating these ones. Small change could 
  * resulting in an error could be very difficult to find.
  *
@@ -55,30 +60,37 @@ template<PropertyType T> struct PropertyTraitSimple;
 template<> struct PropertyTraitSimple<pNull>
 {	public: typedef NullType value;
 	public: typedef NullType writeType; 
+	public: typedef NullType storage;
 };
 template<> struct PropertyTraitSimple<pBool>
 {	public: typedef bool value;
 	public: typedef bool writeType; 
+	public: typedef bool storage;
 };
 template<> struct PropertyTraitSimple<pInt>
 {	public: typedef int value;
 	public: typedef int writeType; 
+	public: typedef int storage;
 };
 template<> struct PropertyTraitSimple<pReal>
 {	public: typedef double value;
 	public: typedef double writeType; 
+	public: typedef double storage;
 };
 template<> struct PropertyTraitSimple<pString> 
 {	public: typedef std::string value;
 	public: typedef const std::string& writeType; 
+	public: typedef std::string storage;
 };
 template<> struct PropertyTraitSimple<pName>
 {	public: typedef std::string value;
 	public: typedef const std::string& writeType; 
+	public: typedef Name storage;
 };
 template<> struct PropertyTraitSimple<pRef> 
 {	public: typedef IndiRef value;
 	public: typedef const IndiRef& writeType; 
+	public: typedef IndiRef storage;
 };
 
 
@@ -106,6 +118,7 @@ class CObjectSimple : noncopyable, public IProperty
 public:
 	typedef typename PropertyTraitSimple<Tp>::writeType WriteType;
 	typedef typename PropertyTraitSimple<Tp>::value Value;
+	typedef typename PropertyTraitSimple<Tp>::storage Storage;
 	typedef observer::BasicChangeContext<IProperty> BasicObserverContext;
 
 	/** 
@@ -116,7 +129,7 @@ public:
 	static const PropertyType type = Tp;
 private:
 	/** Simple value. */
-	Value value;
+	Storage value;
 	
 	//
 	// Constructors
@@ -450,6 +463,19 @@ IProperty* createObjFromXpdfObj (const ::Object& obj);
  */
 template <PropertyType Tp,typename T> void simpleValueFromXpdfObj (const ::Object& obj, T val);
 
+/**
+ * Create storage of a simple value from xpdf object.
+ *
+ * Names are interned directly from the xpdf name, so no empty name is
+ * created just to be replaced. Other storages are filled by
+ * simpleValueFromXpdfObj.
+ * 
+ * @param obj Xpdf object which holds the value.
+ * @return Storage holding the value.
+ */
+template <PropertyType Tp> typename PropertyTraitSimple<Tp>::storage simpleStorageFromXpdfObj (const ::Object& obj);
+template <> Name simpleStorageFromXpdfObj<pName> (const ::Object& obj);
+
 /**
  * Create xpdf Object which represents value.
  * 
@@ -480,6 +506,7 @@ void simpleValueFromString (const std::string& str, bool& val);
 void simpleValueFromString (const std::string& str, int& val);
 void simpleValueFromString (const std::string& str, double& val);
 void simpleValueFromString (const std::string& str, std::string& val);
+void simpleValueFromString (const std::string& str, Name& val);
 void simpleValueFromString (const std::string& str, IndiRef& val);
 
 
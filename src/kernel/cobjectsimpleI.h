@@ -42,12 +42,9 @@ namespace pdfobjects {
 // Protected constructor, called when we have parsed an object
 //
 template<PropertyType Tp>
-CObjectSimple<Tp>::CObjectSimple (boost::weak_ptr<CPdf> p, const Object& o, const IndiRef& rf) : IProperty (p,rf), value(Value())
+CObjectSimple<Tp>::CObjectSimple (boost::weak_ptr<CPdf> p, const Object& o, const IndiRef& rf) : IProperty (p,rf), value(utils::simpleStorageFromXpdfObj<Tp> (o))
 {
 	//kernelPrintDbg (debug::DBG_DBG,"CObjectSimple <" << debug::getStringType<Tp>() << ">(p,o,rf) constructor.");
-	
-	// Set object's value
-	utils::simpleValueFromXpdfObj<Tp,Value&> (o,value);
 }
 
 
@@ -55,12 +52,9 @@ CObjectSimple<Tp>::CObjectSimple (boost::weak_ptr<CPdf> p, const Object& o, cons
 // Protected constructor, called when we have parsed an object
 //
 template<PropertyType Tp>
-CObjectSimple<Tp>::CObjectSimple (const Object& o) : value(Value())
+CObjectSimple<Tp>::CObjectSimple (const Object& o) : value(utils::simpleStorageFromXpdfObj<Tp> (o))
 {
 	//kernelPrintDbg (debug::DBG_DBG,"CObjectSimple <" << debug::getStringType<Tp>() << ">(o) constructor.");
-	
-	// Set object's value
-	utils::simpleValueFromXpdfObj<Tp,Value&> (o,value);
 }
 
 
@@ -260,7 +254,10 @@ CObjectSimple<Tp>::doClone () const
 
 	// Make new complex object
 	// NOTE: We do not want to preserve any IProperty variable
-	return new CObjectSimple<Tp> (value);
+	CObjectSimple<Tp>* clone_ = new CObjectSimple<Tp> ();
+	// Copy stored value directly (does not intern names again)
+	clone_->value = value;
+	return clone_;
 }
 
 
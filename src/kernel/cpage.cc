@@ -271,6 +271,43 @@ CPage::invalidate ()
 }
 
 
+//
+//
+//
+CPage::Transaction::Transaction (boost::shared_ptr<CPage> page)
+{
+	assert (page);
+	std::vector<boost::shared_ptr<CContentStream> > ccs;
+	page->getContentStreams (ccs);
+	for (std::vector<boost::shared_ptr<CContentStream> >::iterator it = ccs.begin(); it != ccs.end(); ++it)
+		_transactions.push_back (boost::shared_ptr<CContentStream::Transaction> (new CContentStream::Transaction (*it)));
+}
+
+//
+//
+//
+void
+CPage::Transaction::commit ()
+{
+	// Not committed content streams are aborted if a commit fails
+	Transactions transactions;
+	transactions.swap (_transactions);
+	for (Transactions::iterator it = transactions.begin(); it != transactions.end(); ++it)
+		(*it)->commit ();
+}
+
+//
+//
+//
+void
+CPage::Transaction::abort ()
+{
+	Transactions transactions;
+	transactions.swap (_transactions);
+	for (Transactions::iterator it = transactions.begin(); it != transactions.end(); ++it)
+		(*it)->abort ();
+}
+
 //
 //
 //
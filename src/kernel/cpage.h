@@ -302,6 +302,34 @@ public:
 	void getContentStreams (Container& container)
 		{ _contents->getContentStreams (container); }
 
+	/** Are content streams created (see CPageContents::isParsed). */
+	bool isContentParsed () const
+		{ return _contents->isParsed (); }
+
+	/**
+	 * Edit transaction guard on all content streams of the page.
+	 *
+	 * Operator changes made while the guard is alive are written to the
+	 * content streams at commit (one write, one bounding box update and one
+	 * notification per content stream). The changes are rolled back if the
+	 * guard is destroyed without commit. Content streams added to the page
+	 * inside of the transaction are not part of it.
+	 *
+	 * @see CContentStream::Transaction
+	 */
+	class Transaction : public noncopyable
+	{
+		typedef std::vector<boost::shared_ptr<CContentStream::Transaction> > Transactions;
+		Transactions _transactions;
+	public:
+		/** Begin a transaction on all content streams of specified page. */
+		Transaction (boost::shared_ptr<CPage> page);
+		/** Commit the transaction. */
+		void commit ();
+		/** Abort the transaction. */
+		void abort ();
+	};
+
 
 	/** Get pdf operators at position specified by rectangle. @see getObjectsAtPosition() */
 	template<typename OpContainer>
@@ -212,6 +212,22 @@ namespace {
 	}
 
 
+	/**
+	 * Find content stream which starts with given cstream.
+	 */
+	template<typename In>
+	typename In::iterator findByCStream (In& in, boost::shared_ptr<CStream> stream)
+	{
+		for (typename In::iterator it = in.begin(); it != in.end(); ++it)
+		{
+			CContentStream::CStreams tmp;
+			(*it)->getCStreams (tmp);
+			if (!tmp.empty() && tmp.front() == stream)
+				return it;
+		}
+		return in.end();
+	}
+
 	/**
 	 * Get all cstreams from a container of content streams.
 	 */
@@ -293,12 +309,18 @@ CPageContents::addToFront (boost::shared_ptr<CContentStream> &cc, const Containe
 	streams.push_back (stream);
 	cc->setStreams(streams);
 
-	// copy it to front
-	CCs _tmp;
-	_tmp.push_back (cc);
-	init();
-	std::copy (_ccs.begin(), _ccs.end(), std::back_inserter(_tmp));
-	_ccs = _tmp;
+	// copy it to front, existing content streams are not created just
+	// because of it (parse picks it up when they are needed)
+	if (_ccs.empty())
+	{
+		_added.push_back (cc);
+	}else
+	{
+		CCs _tmp;
+		_tmp.push_back (cc);
+		std::copy (_ccs.begin(), _ccs.end(), std::back_inserter(_tmp));
+		_ccs = _tmp;
+	}
 
 	// Indicate change
 	change ();
@@ -336,8 +358,12 @@ CPageContents::addToBack (boost::shared_ptr<CContentStream> &cc, const Container
 	CContentStream::CStreams streams;
 	streams.push_back (stream);
 	cc->setStreams(streams);
-	init();
-	_ccs.push_back (cc);
+	// existing content streams are not created just because of it (parse
+	// picks it up when they are needed)
+	if (_ccs.empty())
+		_added.push_back (cc);
+	else
+		_ccs.push_back (cc);
 
 	// Indicate change
 	change ();
@@ -506,6 +532,9 @@ CPageContents::addText (const std::string& what,
 	// ET
 	// Q
 	//
+	// Text position is set by the text matrix used on the page
+	find_likely_tm ();
+
 	std::string fontName (font_id);
 	if (fontName.empty())
 		fontName = "PDFEDIT_F1";
@@ -824,6 +853,8 @@ CPageContents::reparse ( )
 	// can someone call reparse sooner than parse?
 	for (CCs::iterator it = _ccs.begin(); it != _ccs.end(); ++it)
 		(*it)->reparse (true, state, res);
+	for (CCs::iterator it = _added.begin(); it != _added.end(); ++it)
+		(*it)->reparse (true, state, res);
 
 	change ();
 }
@@ -849,7 +880,10 @@ CPageContents::parse ()
 	// and finally instantiate CContentStream
 	//
 		if (!_dict->containsProperty (Specification::Page::CONTENTS))
+		{
+			_added.clear ();
 			return true;
+		}
 	boost::shared_ptr<IProperty> contents = getReferencedObject (_dict->getProperty (Specification::Page::CONTENTS));
 		assert (contents);
 	
@@ -883,12 +917,60 @@ CPageContents::parse ()
 	// True if Contents is not [ ]
 	while (!streams.empty())
 	{
-		boost::shared_ptr<CContentStream> cc = createContentStream(*_page, &streams);
-		_ccs.push_back (cc);
+		// content stream added before takes its stream as it is
+		CCs::iterator added = findByCStream (_added, streams.front());
+		if (added != _added.end())
+		{
+			_ccs.push_back (*added);
+			streams.pop_front ();
+			continue;
+		}
+
+		// streams in front of the next added one can't reach it
+		CContentStream::CStreams segment;
+		while (!streams.empty() && _added.end() == findByCStream (_added, streams.front()))
+		{
+			segment.push_back (streams.front());
+			streams.pop_front ();
+		}
+		while (!segment.empty())
+		{
+			boost::shared_ptr<CContentStream> cc = createContentStream(*_page, &segment);
+			_ccs.push_back (cc);
+		}
 	}
+	_added.clear ();
+
+	// Indicate change
+	change ();
+
+	// Everything went ok
+	return true;
+}
+
+
+
+//
+//
+//
+void
+CPageContents::init ()
+{
+		if (!hasValidPdf(_dict))
+			throw CObjInvalidObject ();
+	threads::ScopedLock lock (_dict->getPdf().lock()->getContentMutex());
+	if (_ccs.empty())
+		parse ();
+}
 
-	// uff, go through the first content operators and find out usefull information
-	// - for now the text orientation
+//
+//
+//
+void
+CPageContents::find_likely_tm ()
+{
+	// uff, go through the content operators and find out the text
+	// orientation, operators are parsed here if not yet
 	// - pdfoperators will be reimplemented anyway
 	for (CCs::const_iterator it = _ccs.begin(); 
 			it != _ccs.end(); 
@@ -913,18 +995,8 @@ CPageContents::parse ()
 			opit.next();
 		}
 	}
-
-
-
-	// Indicate change
-	change ();
-
-	// Everything went ok
-	return true;
 }
 
-
-
 void
 CPageContents::reg_observer (boost::shared_ptr<IProperty> ip) const
 {
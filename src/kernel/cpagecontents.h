@@ -120,6 +120,7 @@ private:
 	// Variables
 private:
 	CCs _ccs;		// content streams
+	CCs _added;		// content streams added before _ccs were created
 	CPage* _page;	// pages
 	boost::shared_ptr<CDict> _dict;	// pages
 	boost::shared_ptr<ContentsWatchDog> _wd;
@@ -321,6 +322,16 @@ public:
 	 */
 	boost::shared_ptr<CContentStream> getContentStream (size_t pos); 
 
+	/**
+	 * Are content streams created from the Contents entry.
+	 *
+	 * Content streams added to the front or back of a page do not create
+	 * (and scan) existing ones, they are created with the first access.
+	 *
+	 * @return True if content streams have been already created.
+	 */
+	bool isParsed () const {return !_ccs.empty();}
+
 	/** 
 	 * Fills container with contents streams. 
 	 */
@@ -390,8 +401,12 @@ private:
 
 	/**
 	 * Parse content stream. 
-	 * Content stream is an optional property. When found it is parsed,
-	 * nothing is done otherwise.
+	 * Content stream is an optional property. When found it is split into
+	 * content streams (operators of each are parsed only when they are
+	 * accessed), nothing is done otherwise. Content streams added before
+	 * are used for their streams and streams between them are split 
+	 * separately, so the result is the same as if existing content streams
+	 * were created before adding.
 	 *
 	 * @return True if content stream was found and was parsed, false otherwise.
 	 */
@@ -404,12 +419,16 @@ private:
 
 	/** 
 	 * Init ccs only when necessary. 
+	 * Holds read lock of the document, so the page of a read-only
+	 * document can be used by more threads.
 	 */
-	inline void init ()
-	{
-		if (_ccs.empty())
-			parse ();		
-	}
+	void init ();
+
+	/**
+	 * Find the text matrix used on the page. This parses operators of all
+	 * content streams.
+	 */
+	void find_likely_tm ();
 
 	/** 
 	 * Indicate changed page. 
@@ -31,6 +31,7 @@
 #include "kernel/cpage.h"
 #include "kernel/cpdf.h"
 #include "kernel/cpageattributes.h"
+#include "kernel/rendercontext.h"
 
 // =====================================================================================
 namespace pdfobjects {
@@ -39,6 +40,27 @@ namespace pdfobjects {
 using namespace boost;
 using namespace utils;
 
+//
+//
+//
+CPageDisplay::CPageDisplay (CPage* page) : 
+		_page(page), 
+		_wd (new PageWatchDog (this)),
+		_xpdfPageStamp (0)
+{
+	REGISTER_PTR_OBSERVER (_page, _wd);
+}
+
+//
+//
+//
+CPageDisplay::~CPageDisplay () 
+{ 
+	UNREGISTER_PTR_OBSERVER (_page, _wd);
+	discardXpdfPage ();
+	_page = NULL; 
+}
+
 //
 //
 //
@@ -95,44 +117,60 @@ CPageDisplay::displayPage (::OutputDev& out,
 	if (!(pagedict))
 		throw XpdfInvalidObject ();
 
+	// xpdf reads the page content directly from the document stream
+	threads::ScopedLock lock (pdf->getCXref()->getReadMutex());
+	RenderContext& context = pdf->getRenderContext ();
+
 	//
-	// Create xpdf object representing CPage
+	// Get xpdf page representing CPage
+	// Page of this page dictionary is kept until the document changes
 	//
-	boost::shared_ptr<Object> xpdfPage (pagedict->_makeXpdfObject(), xpdf::object_deleter());
-		// Check page dictionary
-		assert (objDict == xpdfPage->getType());
-		if (objDict != xpdfPage->getType ())
-			throw XpdfInvalidObject ();
-	
-	// Get page dictionary
-	const Dict* xpdfPageDict = xpdfPage->getDict ();
-		assert (NULL != xpdfPageDict);
+	bool cached = (pagedict == _page->getDictionary());
+	if (cached && _xpdfPage && _xpdfPageStamp != pdf->getCXref()->getChangeStamp())
+		discardXpdfPage ();
+	boost::shared_ptr<Object> xpdfPageDict = (cached) ? _xpdfPageDict : boost::shared_ptr<Object> ();
+	boost::shared_ptr<Page> page = (cached) ? _xpdfPage : boost::shared_ptr<Page> ();
+	if (!page)
+	{
+		xpdfPageDict = boost::shared_ptr<Object> (pagedict->_makeXpdfObject(), xpdf::object_deleter());
+			// Check page dictionary
+			assert (objDict == xpdfPageDict->getType());
+			if (objDict != xpdfPageDict->getType ())
+				throw XpdfInvalidObject ();
+		
+		// Get page dictionary
+		const Dict* dict = xpdfPageDict->getDict ();
+			assert (NULL != dict);
+
+		//
+		// Create default page attributes and make page
+		// ATTRIBUTES are deleted in Page destructor
+		// 
+		page = boost::shared_ptr<Page> (new Page (xref, 0, dict, new PageAttrs (NULL, dict)));
+		if (cached)
+		{
+			_xpdfPageDict = xpdfPageDict;
+			_xpdfPage = page;
+			_xpdfPageStamp = pdf->getCXref()->getChangeStamp();
+		}
+	}
 
-	
 	//
 	// We need to handle special case
+	// (fonts loaded for this document are kept)
 	//
 	SplashOutputDev* sout = dynamic_cast<SplashOutputDev*> (&out);
 	if (sout)
-		sout->startDoc (xref);
+		context.startDoc (*sout);
 
-	//
-	// Create default page attributes and make page
-	// ATTRIBUTES are deleted in Page destructor
-	// 
-	Page page (xref, 0, xpdfPageDict, new PageAttrs (NULL, xpdfPageDict));
-	
-	// Create catalog
-	boost::scoped_ptr<Catalog> xpdfCatalog (new Catalog (xref));
-	
 	//
 	// Page object display (..., useMediaBox, crop, links, catalog)
 	//
 	// TODO ROTATION !! int rotation = _params.rotate - pagedict->getRotation ();
-	page.displaySlice (&out, _params.hDpi, _params.vDpi,
+	page->displaySlice (&out, _params.hDpi, _params.vDpi,
 			0, _params.useMediaBox, _params.crop,
 			x, y, w, h, 
-			false, xpdfCatalog.get());
+			false, context.getCatalog ());
 
 }
 
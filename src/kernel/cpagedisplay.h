@@ -49,19 +49,65 @@ class CDict;
  */
 class CPageDisplay : public ICPageModule
 {
+	//==========================================================
+	// Page observer
+	//==========================================================
+private:
+
+	/** 
+	 * Observer which discards cached xpdf page when the page changes.
+	 */
+	class PageWatchDog: public observer::IObserver<CPage>
+	{
+	private:
+		CPageDisplay* _display;
+	public:
+		PageWatchDog (CPageDisplay* display) : _display(display) { assert(_display); }
+		virtual ~PageWatchDog() throw() {}
+		// IObserver Interface
+		virtual void notify (boost::shared_ptr<CPage>, boost::shared_ptr<const observer::IChangeContext<CPage> >) const throw()
+			{ _display->discardXpdfPage (); }
+		virtual priority_t getPriority() const throw() 
+			{ return 0;	}
+	
+	};	// class PageWatchDog
+
+	//==========================================================
+
 	// Variables
 private:
 	/** Pdf dictionary representing a page. */
 	CPage* _page;
 	/** Actual display parameters. */
 	DisplayParams _params;
+	/** Page observer. */
+	boost::shared_ptr<PageWatchDog> _wd;
+
+	/** 
+	 * Xpdf page dictionary used by _xpdfPage. 
+	 * Cached together with _xpdfPage between displayPage calls.
+	 */
+	boost::shared_ptr<Object> _xpdfPageDict;
+	/** Xpdf page created from this page dictionary (NULL if not cached). */
+	boost::shared_ptr<Page> _xpdfPage;
+	/** Document change stamp for which _xpdfPage is valid (see CXref::getChangeStamp). */
+	size_t _xpdfPageStamp;
 
 
 	// Ctor & Dtor
 public:
-	CPageDisplay (CPage* page) : _page(page) {}
-	~CPageDisplay () 
-		{ _page = NULL; }
+	CPageDisplay (CPage* page);
+	~CPageDisplay ();
+
+private:
+	/** 
+	 * Discards cached xpdf page. 
+	 */
+	void discardXpdfPage ()
+	{ 
+		_xpdfPage.reset ();
+		_xpdfPageDict.reset ();
+	}
 
 
 	//
@@ -134,6 +180,10 @@ public:
 	 * @param out Output device.
 	 * @param dict If not null, page is created from dict otherwise
 	 * this page dictionary is used. But still some information is gathered from this page dictionary.
+	 *
+	 * Xpdf page created from this page dictionary and the document catalog
+	 * (see RenderContext) are reused by following calls until the document
+	 * changes.
 	 */
 	void displayPage (::OutputDev& out, 
 					  boost::shared_ptr<CDict> pagedict, 
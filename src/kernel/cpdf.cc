@@ -33,6 +33,7 @@
 #include "kernel/cpageattributes.h"
 #include "kernel/pdfedit-core-dev.h"
 #include "kernel/streamwriter.h"
+#include "kernel/rendercontext.h"
 
 using namespace boost;
 using namespace std;
@@ -46,6 +47,11 @@ namespace pdfobjects
 // initializes global list of alive pdf instances
 CPdf::CPdfListContainer CPdf::allPdfs = CPdf::CPdfListContainer();
 
+namespace {
+	/** Lock for CPdf::allPdfs. */
+	threads::Mutex allPdfsMutex;
+}
+
 namespace utils 
 {
 
@@ -1102,17 +1108,8 @@ using namespace utils;
 		}
 	}
 
-	// invalidates pageCount
-	pdf->pageCount=0;
-	
-	// removes and invalidates whole pageList
-	kernelPrintDbg(DBG_DBG, "Invalidating pageList with "<<pdf->pageList.size()<<" elements");
-	for(PageList::iterator i=pdf->pageList.begin(); i!=pdf->pageList.end(); ++i)
-	{
-		boost::shared_ptr<CPage> page=i->second;
-		page->invalidate();
-	}
-	pdf->pageList.clear();
+	// removes and invalidates whole pageList and pageIndex
+	pdf->discardPages();
 
 	// clears nodeCountCache
 	kernelPrintDbg(DBG_DBG, "Discarding nodeCountCache with "<<pdf->nodeCountCache.size()<<" entries");
@@ -1275,11 +1272,23 @@ using namespace observer;
 		boost::shared_ptr<IProperty> interNodeProp=pdf->getIndirectProperty(interNodeRef);
 		if(isDict(interNodeProp))
 		{
+			// cached counts of all old and new children may be out of date
+			// because they were not observed
+			ChildrenStorage::iterator i;
+			for(i=oldValues.begin(); i!=oldValues.end(); ++i)
+				if(isRef(*i))
+				{
+					IndiRef childRef=utils::getValueFromSimple<CRef>(*i);
+					utils::discardKidsCountCache(childRef, pdf->_this.lock(), pdf->nodeCountCache, true);
+				}
+			for(i=newValues.begin(); i!=newValues.end(); ++i)
+				if(isRef(*i))
+				{
+					IndiRef childRef=utils::getValueFromSimple<CRef>(*i);
+					utils::discardKidsCountCache(childRef, pdf->_this.lock(), pdf->nodeCountCache, true);
+				}
 			boost::shared_ptr<CDict> interNode=IProperty::getSmartCObjectPtr<CDict>(interNodeProp);
-			// if consolidatePageTree hasn't kept page count numbers, total number
-			// of pages must be invalidated
-			if(!pdf->consolidatePageTree(interNode, true))
-				pdf->pageCount=0;
+			pdf->consolidatePageTree(interNode, true);
 		}
 	}catch(...)
 	{
@@ -1464,15 +1473,26 @@ using namespace utils;
 		return;
 	}
 
+	// leaf count cache for removed subtree is not valid anymore and the
+	// newly added one may have been changed while it wasn't in the tree
+	if(isRef(oldValue))
+	{
+		IndiRef oldRef=getValueFromSimple<CRef>(oldValue);
+		kernelPrintDbg(DBG_DBG, "discarding leaf count cache for "<<oldRef<<" subtree");
+		discardKidsCountCache(oldRef, pdf->_this.lock(), pdf->nodeCountCache, true);
+	}
+	if(isRef(newValue))
+	{
+		IndiRef newRef=getValueFromSimple<CRef>(newValue);
+		discardKidsCountCache(newRef, pdf->_this.lock(), pdf->nodeCountCache, true);
+	}
+
 	// starts consolidation from parent intermediate node
 	boost::shared_ptr<CDict> parentDict_ptr=IProperty::getSmartCObjectPtr<CDict>(parentProp_ptr);
 	try
 	{
-		// if consolidatePageTree hasn't kept page count numbers, total number
-		// of pages must be invalidated
 		kernelPrintDbg(DBG_DBG, "consolidating page tree.");
-		if(!pdf->consolidatePageTree(parentDict_ptr, true))
-			pdf->pageCount=0;
+		pdf->consolidatePageTree(parentDict_ptr, true);
 	}catch(CObjectException & e)
 	{
 		kernelPrintDbg(DBG_ERR, "consolidatePageTree failed with cause="<<e.what());
@@ -1488,15 +1508,6 @@ using namespace utils;
 		kernelPrintDbg(DBG_ERR, "consolidatePageList failed with cause="<<e.what());
 	}
 
-	// kidsCount cache couldn't have beem discarded until now because it is used
-	// in consolidatePageList
-	if(isRef(oldValue))
-	{
-		IndiRef oldRef=getValueFromSimple<CRef>(oldValue);
-		kernelPrintDbg(DBG_DBG, "discarding leaf count cache for "<<oldRef<<" subtree");
-		discardKidsCountCache(oldRef, pdf->_this.lock(), pdf->nodeCountCache, true);
-	}
-
 	// if newValue is reference, registers observers to newValue dereferenced 
 	// dictionary node sub tree
 	if(isRef(newValue))
@@ -1576,37 +1587,29 @@ void CPdf::initRevisionSpecific()
 	unregisterPageObservers();
 
 	// cleans up and invalidates all returned pages
-	if(pageList.size())
-	{
-		kernelPrintDbg(debug::DBG_DBG, "Cleaning up pages list with "<<pageList.size()<<" elements");
-		PageList::iterator i;
-		for(i=pageList.begin(); i!=pageList.end(); ++i)
-		{
-			kernelPrintDbg(debug::DBG_DBG, "invalidating page at pos="<<i->first);
-			i->second->invalidate();
-		}
-		pageList.clear();
-	}
+	discardPages();
 
 	// cleans up indirect mapping
-	if(indMap.size())
+	if(!indUsage.empty())
 	{
 		// checks for held values (smart pointer is not unique, so somebody
 		// has to keep shared_ptr to same value)
-		for(IndirectMapping::iterator i=indMap.begin(); i!=indMap.end(); ++i)
+		for(size_t shard=0; shard<INDIRECT_SHARDS; ++shard)
 		{
-			IndiRef ref=i->first;
-			boost::shared_ptr<IProperty> value=i->second;
-			if(!value.unique())
-				kernelPrintDbg(debug::DBG_WARN, "Somebody still holds property with with "<<ref);
+			IndirectMapping & mapping=indShards[shard].mapping;
+			for(IndirectMapping::Iterator i=mapping.begin(); i!=mapping.end(); ++i)
+			{
+				IndiRef ref(i->first);
+				ref.num=static_cast<IndiRef::ObjNum>(ref.num*INDIRECT_SHARDS+shard);
+				boost::shared_ptr<IProperty> value=i->second.property;
+				if(!value.unique())
+					kernelPrintDbg(debug::DBG_WARN, "Somebody still holds property with with "<<ref);
+			}
 		}
-		kernelPrintDbg(debug::DBG_DBG, "Cleaning up indirect mapping with "<<indMap.size()<<" elements");
-		indMap.clear();
+		kernelPrintDbg(debug::DBG_DBG, "Cleaning up indirect mapping with "<<indUsage.size()<<" elements");
+		clearIndirectMapping();
 	}
 
-	// invalidates pageCount
-	pageCount=0;
-
 	if((docCatalog.get()) && (!docCatalog.unique()))
 		kernelPrintDbg(debug::DBG_WARN, "Document catalog dictionary is held by somebody.");
 	
@@ -1658,7 +1661,7 @@ void CPdf::initRevisionSpecific()
 		registerPageTreeObservers(pageTreeRoot);
 }
 
-CPdf::CPdf(StreamWriter * stream, OpenMode openMode)
+CPdf::CPdf(StreamWriter * stream, OpenMode openMode, XRefLoading loading, XRefIndex * index)
 	:pageTreeRootObserver(new PageTreeRootObserver(this)),
 	 pageTreeNodeObserver(new PageTreeNodeObserver(this)),
 	 pageTreeKidsObserver(new PageTreeKidsObserver(this)),
@@ -1666,10 +1669,20 @@ CPdf::CPdf(StreamWriter * stream, OpenMode openMode)
 	 change(false), 
 	 modeController(NULL)
 {
+	indStats.hits = indStats.misses = indStats.evictions = indStats.size = 0;
+	indStats.shrinks = 0;
+	indHits = 0;
+	indStats.budget = DEFAULT_INDIRECT_CACHE_BUDGET;
+	indShrinkSize = indStats.budget;
+	pageIndexValid = false;
+	pageTreeEdit.active = false;
+	pageTreeFanout = 0;
+
 	// gets xref writer - if error occures, exception is thrown 
 	// Note that we can't do anything that could use cobjects here
 	// because of weak_ptr & shared_ptr are not initialized yet
-	xref=new XRefWriter(stream, this);
+	xref=new XRefWriter(stream, this, loading, index);
+	renderContext.reset(new RenderContext(getCXref()));
 	mode=openMode;
 
 	// sets mode accoring openMode
@@ -1688,7 +1701,7 @@ CPdf::CPdf(StreamWriter * stream, OpenMode openMode)
  */
 void deleteResolveRefStorage(ResolvedRefStorage * storage)
 {
-	for(ResolvedRefStorage::iterator storIter=storage->begin();
+	for(ResolvedRefStorage::Iterator storIter=storage->begin();
 			storIter != storage->end(); ++storIter)
 	{
 		ResolvedRefEntry * entry = storIter->second;
@@ -1746,11 +1759,14 @@ void CPdf::setPdfId()
 	assert(getCPdfFromId(id) == this);
 	kernelPrintDbg(DBG_DBG, "pdf "<< this 
 			<< " is associated with id=" << id);
+	threads::ScopedLock lock(allPdfsMutex);
 	CPdf::allPdfs.push_back(id);
 }
 
 void CPdf::releasePdfId()
 {
+	threads::ScopedLock lock(allPdfsMutex);
+
 	// removes current id from the list of all life pdfs
 	CPdfListContainer::iterator iter = 
 		std::find(CPdf::allPdfs.begin(), CPdf::allPdfs.end(), id);
@@ -1773,12 +1789,7 @@ void CPdf::invalidate()
 	// indirect mapping is cleaned up automaticaly
 	
 	// discards all returned pages
-	for(PageList::iterator i=pageList.begin(); i!=pageList.end(); ++i)
-	{
-		kernelPrintDbg(DBG_DBG, "Invalidating page at pos="<<i->first);
-		i->second->invalidate();
-	}
-	pageList.clear();
+	discardPages();
 
 	// idealy we should unregister page tree observers but as the _this
 	// is no longer valid in this context (last reference to 
@@ -1792,7 +1803,7 @@ void CPdf::invalidate()
 	pageTreeKidsObserver->setActive(false);
 
 	// clears all referenced indirect properties
-	indMap.clear();
+	clearIndirectMapping();
 
 	// clean up resolved reference mapping for different pdf objects
 	for(ResolvedRefMapping::iterator i=resolvedRefMapping.begin(); 
@@ -1815,6 +1826,9 @@ CPdf::~CPdf()
 {
 	kernelPrintDbg(DBG_DBG, "");
 
+	// render context refers to xref
+	renderContext.reset();
+
 	// deallocates XRefWriter
 	delete xref;
 
@@ -1822,6 +1836,176 @@ CPdf::~CPdf()
 }
 
 //
+namespace {
+
+/** Estimates memory used by given property.
+ * @param ip Property.
+ *
+ * @return Estimated size in bytes (including all children).
+ */
+size_t estimatePropertySize(const boost::shared_ptr<IProperty> & ip)
+{
+using namespace utils;
+
+	size_t size = 0;
+	ChildrenStorage children;
+	switch(ip->getType())
+	{
+		case pString:
+			return sizeof(CString) + getValueFromSimple<CString>(ip).size();
+		case pName:
+			return sizeof(CName) + getValueFromSimple<CName>(ip).size();
+		case pArray:
+			size = sizeof(CArray);
+			IProperty::getSmartCObjectPtr<CArray>(ip)->_getAllChildObjects(children);
+			break;
+		case pDict:
+			size = sizeof(CDict);
+			IProperty::getSmartCObjectPtr<CDict>(ip)->_getAllChildObjects(children);
+			break;
+		case pStream:
+		{
+			boost::shared_ptr<CStream> stream = IProperty::getSmartCObjectPtr<CStream>(ip);
+			size = sizeof(CStream) + stream->getBuffer().size();
+			stream->_getAllChildObjects(children);
+			break;
+		}
+		default:
+			return sizeof(CReal);
+	}
+
+	// children with their keys
+	for(ChildrenStorage::iterator i=children.begin(); i!=children.end(); ++i)
+		size += sizeof(std::pair<std::string, boost::shared_ptr<IProperty> >) 
+			+ estimatePropertySize(*i);
+	return size;
+}
+
+/** Checks whether given property is used only by its indirect mapping.
+ * @param ip Property.
+ * @param refs Number of references to ip which are expected.
+ *
+ * @return true if neither ip nor any of its children is held by somebody 
+ * else or observed.
+ */
+bool isMappedOnly(const boost::shared_ptr<IProperty> & ip, long refs)
+{
+	if(ip.use_count() > refs || ip->hasObservers())
+		return false;
+
+	ChildrenStorage children;
+	switch(ip->getType())
+	{
+		case pArray:
+			IProperty::getSmartCObjectPtr<CArray>(ip)->_getAllChildObjects(children);
+			break;
+		case pDict:
+			IProperty::getSmartCObjectPtr<CDict>(ip)->_getAllChildObjects(children);
+			break;
+		case pStream:
+			IProperty::getSmartCObjectPtr<CStream>(ip)->_getAllChildObjects(children);
+			break;
+		default:
+			return true;
+	}
+
+	// each child is held by its parent and by children container
+	for(ChildrenStorage::iterator i=children.begin(); i!=children.end(); ++i)
+		if(!isMappedOnly(*i, 2))
+			return false;
+	return true;
+}
+
+} // namespace
+
+CPdf::IndirectShard & CPdf::getIndirectShard(const IndiRef & ref, IndiRef & key)const
+{
+	key.num=static_cast<IndiRef::ObjNum>(ref.num/INDIRECT_SHARDS);
+	key.gen=ref.gen;
+	return indShards[ref.num%INDIRECT_SHARDS];
+}
+
+bool CPdf::isIndirectMapped(const IndiRef & ref)const
+{
+	IndiRef key;
+	IndirectShard & shard=getIndirectShard(ref, key);
+	threads::ScopedLock lock(shard.mutex);
+	return shard.mapping.contains(key);
+}
+
+void CPdf::removeIndirectMapping(const IndiRef & ref)const
+{
+	threads::ScopedLock lock(indMutex);
+	IndiRef key;
+	IndirectShard & shard=getIndirectShard(ref, key);
+	threads::ScopedLock shardLock(shard.mutex);
+	IndirectEntry entry = shard.mapping.remove(key);
+	if(!entry.property)
+		return;
+	indUsage.erase(entry.usage);
+	indStats.size-=entry.size;
+}
+
+void CPdf::clearIndirectMapping()const
+{
+	threads::ScopedLock lock(indMutex);
+	for(size_t shard=0; shard<INDIRECT_SHARDS; ++shard)
+	{
+		threads::ScopedLock shardLock(indShards[shard].mutex);
+		indShards[shard].mapping.clear();
+	}
+	indUsage.clear();
+	indStats.size=0;
+	indShrinkSize=indStats.budget;
+}
+
+void CPdf::shrinkIndirectMapping()const
+{
+	threads::ScopedLock lock(indMutex);
+
+	// each property is checked at most twice - used ones lose their mark
+	// for the first time and properties which are held by somebody are
+	// considered to be used
+	size_t candidates = 2*indUsage.size();
+	while(indStats.size > indStats.budget && candidates--)
+	{
+		IndiRef ref = indUsage.back();
+		IndiRef key;
+		IndirectShard & shard=getIndirectShard(ref, key);
+		threads::ScopedLock shardLock(shard.mutex);
+		IndirectEntry entry = shard.mapping.get(key);
+		assert(entry.property);
+
+		if(entry.used)
+		{
+			entry.used=false;
+			shard.mapping.put(key, entry);
+			indUsage.splice(indUsage.begin(), indUsage, entry.usage);
+			continue;
+		}
+		// held by the mapping and by entry
+		if(!isMappedOnly(entry.property, 2))
+		{
+			indUsage.splice(indUsage.begin(), indUsage, entry.usage);
+			continue;
+		}
+		entry.property.reset();
+		shard.mapping.remove(key);
+		indUsage.erase(entry.usage);
+		indStats.size-=entry.size;
+		++indStats.evictions;
+		kernelPrintDbg(DBG_DBG, "Mapping discarded for "<<ref);
+	}
+	++indStats.shrinks;
+
+	// held properties don't fit into the budget - backs off until the 
+	// mapping grows by a half, so the number of checked properties is 
+	// amortized to a constant per created one
+	indShrinkSize = indStats.budget;
+	if(indStats.size > indStats.budget)
+		indShrinkSize = indStats.size + std::max(indStats.size, indStats.budget)/2;
+}
+
 // 
 // this method can't be const because createObjFromXpdfObj requires 
 // CPdf * not const CPdf * given by this
@@ -1831,20 +2015,36 @@ boost::shared_ptr<IProperty> CPdf::getIndirectProperty(const IndiRef &ref)const
 
 	check_need_credentials(xref);
 
-	// find the key, if it exists
-	IndirectMapping::iterator i = indMap.find(ref);
-	if(i!=indMap.end())
+	// find the key, if it exists - only the shard is locked
+	IndiRef key;
+	IndirectShard & shard=getIndirectShard(ref, key);
 	{
-		// mapping exists, so returns value
-		return i->second;
+		threads::ScopedLock shardLock(shard.mutex);
+		IndirectEntry mapped = shard.mapping.get(key);
+		if(mapped.property)
+		{
+			// mapping exists, so marks it as used (once until the next 
+			// shrinking) and returns value
+			if(!mapped.used)
+			{
+				mapped.used=true;
+				shard.mapping.put(key, mapped);
+			}
+			threads::atomicIncrement(indHits);
+			return mapped.property;
+		}
 	}
 
 	kernelPrintDbg(DBG_DBG, "No mapping for "<<ref);
 
 	// mapping doesn't exist yet, so tries to create one
-	// fetches object according reference
-	boost::shared_ptr< ::Object> obj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
+	// fetches object according reference - xref holds its own lock and
+	// the fetched object is a copy, so the property is created without any
+	// lock. Streams from older revisions are not copied, though, and they
+	// read from the document stream which shares its position with all
+	// other readers, so they are created under the read lock
 	assert(xref);
+	boost::shared_ptr< ::Object> obj(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
 	xref->fetch(ref.num, ref.gen, obj.get());
 	
 	boost::shared_ptr<IProperty> prop_ptr;
@@ -1855,10 +2055,38 @@ boost::shared_ptr<IProperty> CPdf::getIndirectProperty(const IndiRef &ref)const
 	// the mapping
 	if(obj->getType()!=objNull)
 	{
-		IProperty * prop=utils::createObjFromXpdfObj(_this.lock(), *obj, ref);
+		IProperty * prop;
+		if(obj->isStream())
+		{
+			threads::ScopedLock lock(xref->getReadMutex());
+			prop=utils::createObjFromXpdfObj(_this.lock(), *obj, ref);
+		}else
+			prop=utils::createObjFromXpdfObj(_this.lock(), *obj, ref);
 		prop_ptr=boost::shared_ptr<IProperty>(prop);
-		indMap.insert(IndirectMapping::value_type(ref, prop_ptr));
+		threads::ScopedLock lock(indMutex);
+		{
+			threads::ScopedLock shardLock(shard.mutex);
+			IndirectEntry mapped = shard.mapping.get(key);
+			if(mapped.property)
+			{
+				// somebody else has created mapping in the mean time - all
+				// threads have to get the same instance, so ours is dropped
+				threads::atomicIncrement(indHits);
+				return mapped.property;
+			}
+			++indStats.misses;
+			indUsage.push_front(ref);
+			IndirectEntry entry;
+			entry.property=prop_ptr;
+			entry.size=estimatePropertySize(prop_ptr);
+			entry.usage=indUsage.begin();
+			entry.used=false;
+			shard.mapping.put(key, entry);
+			indStats.size+=entry.size;
+		}
 		kernelPrintDbg(DBG_DBG, "Mapping created for "<<ref);
+		if(indStats.size > indShrinkSize)
+			shrinkIndirectMapping();
 	}else
 	{
 		kernelPrintDbg(DBG_DBG, ref<<" not available or points to objNull");
@@ -1964,14 +2192,13 @@ using namespace debug;
 	// object is indirect and if mapping is not in container yet
 	if(isRefValid(&oldRef))
 	{
-		ResolvedRefStorage::iterator i = container.find(oldRef);
-		if(i == container.end())
+		*entry = container.get(oldRef);
+		if(!*entry)
 		{
 			*entry = new ResolvedRefEntry(indiRef, STATE_NEW);
-			container.insert(ResolvedRefStorage::value_type(oldRef, *entry));
+			container.put(oldRef, *entry);
 			kernelPrintDbg(DBG_DBG, "Created mapping from "<<oldRef<<" to "<<indiRef);
-		}else
-			*entry = i->second;
+		}
 	}else
 		*entry = NULL;
 
@@ -2003,14 +2230,12 @@ using namespace utils;
 		{
 			// checks if this reference has already been considered to prevent
 			// endless loops for cyclic structures
-			ResolvedRefStorage::iterator i;
 			ResolvedRefEntry * refEntry = NULL;
 			IndiRef ipRef=getValueFromSimple<CRef>(ip);
-			if((i=container.find(ipRef))!=container.end())
+			if((refEntry=container.get(ipRef)))
 			{
 				// this reference has already been processed, so reuses
 				// reference which already has been created/reserved
-				refEntry = i->second;
 				kernelPrintDbg(DBG_DBG, ipRef<<" already mapped to "<<refEntry->first);
 			}else 
 			{
@@ -2151,13 +2376,11 @@ using namespace boost;
 
 	// If given ip is indirect and there already is mapping in resolvedStorage,
 	// this property or reference to it has already been processed
-	ResolvedRefStorage::iterator resIter;
 	ResolvedRefEntry * refEntry = NULL;
 	IndiRef indiRef;
 	if(hasValidRef(ip)&&
-	  (resIter=resolvedStorage->find(ip->getIndiRef()))!=resolvedStorage->end())
+	  (refEntry=resolvedStorage->get(ip->getIndiRef())))
 	{
-		refEntry = resIter->second;
 		kernelPrintDbg(DBG_DBG, "Property with "<<ip->getIndiRef()
 				<<" already in mapping. Mapped to "
 				<<refEntry->second);
@@ -2235,7 +2458,7 @@ void CPdf::changeIndirectProperty(const boost::shared_ptr<IProperty> &prop)
 	// there must be mapping fro prop's indiref, but it doesn't have to be same
 	// instance.
 	IndiRef indiRef=prop->getIndiRef();
-	if(indMap.find(indiRef)==indMap.end())
+	if(!isIndirectMapped(indiRef))
 	{
 		kernelPrintDbg(DBG_ERR, "Indirect mapping doesn't exist. prop seams to be fake.");
 		throw CObjInvalidObject();
@@ -2259,7 +2482,7 @@ void CPdf::changeIndirectProperty(const boost::shared_ptr<IProperty> &prop)
 	}
 	else
 	{
-		indMap.erase(indiRef);
+		removeIndirectMapping(indiRef);
 		kernelPrintDbg(DBG_INFO, "Indirect mapping removed for "<<indiRef);
 	}
 
@@ -2294,7 +2517,7 @@ public:
 	}
 };
 
-boost::shared_ptr<CPdf> CPdf::getInstance(const char * filename, OpenMode mode)
+boost::shared_ptr<CPdf> CPdf::getInstance(const char * filename, OpenMode mode, WriterType writer, XRefMode xrefMode)
 {
 using namespace std;
 
@@ -2324,18 +2547,37 @@ using namespace std;
 		throw PdfOpenException("Unable to open file.");
 	}
 	kernelPrintDbg(debug::DBG_DBG,"File \"" << filename << "\" open successfully in mode=" << openMode);
+
+	// index is needed only during construction
+	boost::scoped_ptr<XRefIndex> index;
+	if(xrefMode == IndexedXRef)
+		index.reset(XRefIndex::getInstance(file, XRefIndex::getIndexFileName(filename)));
+	XRefLoading loading = (xrefMode == FullXRef)?xrefLoadAll:xrefLoadLazy;
 	
 	// creates FileStream writer to enable changes to the File stream
 	Object obj;
 	obj.initNull();
-	StreamWriter * stream=new FileStreamWriter(file, 0, gFalse, 0, &obj);
+	StreamWriter * stream=NULL;
+#ifdef HAVE_SYS_MMAN_H
+	if(writer == MappedWriter)
+		stream=MappedFileStreamWriter::getInstance(file, &obj);
+#endif
+	if(!stream)
+	{
+		if(writer == MappedWriter)
+			kernelPrintDbg(debug::DBG_WARN,"Unable to map file. Using direct writer.");
+		if(writer == BufferedWriter)
+			stream=new BufferedFileStreamWriter(file, 0, gFalse, 0, &obj);
+		else
+			stream=new FileStreamWriter(file, 0, gFalse, 0, &obj);
+	}
 	kernelPrintDbg(debug::DBG_DBG,"File stream created");
 
 	// stream is ready, creates CPdf instance
 	boost::shared_ptr<CPdf> instance;
 	try
 	{
-		instance = boost::shared_ptr<CPdf>(new CPdf(stream, mode), PdfFileDeleter(file));
+		instance = boost::shared_ptr<CPdf>(new CPdf(stream, mode, loading, index.get()), PdfFileDeleter(file));
 		instance->_this = instance;
 
 		// initializes revision specific data for the newest revision
@@ -2371,6 +2613,104 @@ using namespace std;
 // pos must be without sideeffects
 #define POSITION_IN_RANGE(pos) (((pos) >= 1) && (pos)<=getPageCount())
 
+namespace {
+
+/** Type for set of page tree nodes on the current path. */
+typedef std::set<IndiRef, utils::IndComparator> PageTreePath;
+
+/** Collects all page dictionary references from given intermediate node.
+ * @param interNode Intermediate node dictionary.
+ * @param refs Container where to append references (in the document order).
+ * @param path Intermediate nodes from the root to interNode.
+ *
+ * Only referencies from Kids arrays are considered (same as getKidsCount
+ * does). Intermediate nodes which are already on the path (cyclic page tree)
+ * are skipped.
+ */
+void collectPageRefs(const boost::shared_ptr<CDict> & interNode, std::vector<IndiRef> & refs, PageTreePath & path)
+{
+using namespace utils;
+
+	ChildrenStorage children;
+	getKidsFromInterNode(interNode, children);
+	for(ChildrenStorage::const_iterator i=children.begin(); i!=children.end(); ++i)
+	{
+		boost::shared_ptr<IProperty> child=*i;
+		if(!isRef(child))
+			continue;
+		IndiRef childRef=getValueFromSimple<CRef>(child);
+		switch(getNodeType(child))
+		{
+			case LeafNode:
+				refs.push_back(childRef);
+				break;
+			case InterNode:
+			case RootNode:
+				if(!path.insert(childRef).second)
+				{
+					kernelPrintDbg(DBG_WARN, "Cyclic page tree. Node "<<childRef<<" skipped.");
+					break;
+				}
+				collectPageRefs(getCObjectFromRef<CDict>(child), refs, path);
+				path.erase(childRef);
+				break;
+			default:
+				kernelPrintDbg(DBG_DBG, "Kids element "<<childRef<<" is not leaf or intermediate node.");
+		}
+	}
+}
+
+} // annonymous namespace
+
+void CPdf::discardPages()const
+{
+	kernelPrintDbg(DBG_DBG, "Invalidating pageList with "<<pageList.size()<<" elements");
+	for(PageList::iterator i=pageList.begin(); i!=pageList.end(); ++i)
+		if(*i)
+			(*i)->invalidate();
+	pageList.clear();
+	pageIndex.clear();
+	pageIndexValid=false;
+}
+
+void CPdf::buildPageIndex()const
+{
+using namespace utils;
+
+	kernelPrintDbg(DBG_DBG, "");
+
+	std::vector<IndiRef> refs;
+	boost::shared_ptr<CDict> rootDict=getPageTreeRoot(_this.lock());
+	if(rootDict.get())
+	{
+		PageTreePath path;
+		path.insert(rootDict->getIndiRef());
+		collectPageRefs(rootDict, refs, path);
+	}
+	pageIndex.build(refs);
+	pageIndexValid=true;
+
+	// moves all returned pages to their current positions
+	PageList oldList(refs.size());
+	oldList.swap(pageList);
+	for(PageList::iterator i=oldList.begin(); i!=oldList.end(); ++i)
+	{
+		boost::shared_ptr<CPage> page=*i;
+		if(!page)
+			continue;
+		size_t index;
+		if(pageIndex.getPosition(page->getDictionary()->getIndiRef(), index) && !pageList[index])
+		{
+			pageList[index]=page;
+			continue;
+		}
+		// page is not in the tree anymore or it is ambiguous
+		kernelPrintDbg(DBG_DBG, "Page with original position="<<(i-oldList.begin()+1)<<" is not available. Invalidating.");
+		page->invalidate();
+	}
+	kernelPrintDbg(DBG_DBG, "pageIndex built with "<<pageIndex.size()<<" pages");
+}
+
 boost::shared_ptr<CPage> CPdf::getPage(size_t pos)const
 {
 using namespace utils;
@@ -2379,6 +2719,7 @@ using namespace utils;
 
 	check_need_credentials(xref);
 
+	threads::ScopedLock lock(pageMutex);
 	if(!POSITION_IN_RANGE(pos))
 	{
 		kernelPrintDbg(DBG_WARN, "Page out of range pos="<<pos);
@@ -2386,26 +2727,23 @@ using namespace utils;
 	}
 
 	// checks if page is available in pageList
-	PageList::const_iterator i;
-	if((i=pageList.find(pos))!=pageList.end())
+	boost::shared_ptr<CPage> & page_ptr=pageList[pos-1];
+	if(page_ptr)
 	{
 		kernelPrintDbg(DBG_DBG, "Page at pos="<<pos<<" found in pageList");
-		return i->second;
+		return page_ptr;
 	}
 
-	// page is not available in pageList, searching has to be done
-	// find throws an exception if any problem found, otherwise pageDict_ptr
-	// contians Page dictionary at specified position.
-	boost::shared_ptr<CDict> rootPages_ptr=getPageTreeRoot(_this.lock());
-	if(!rootPages_ptr.get())
+	// page is not available in pageList, page dictionary reference is in the
+	// pageIndex
+	boost::shared_ptr<IProperty> pageProp=getIndirectProperty(pageIndex.at(pos-1));
+	if(!isDict(pageProp))
 		throw PageNotFoundException(pos);
-	boost::shared_ptr<CDict> pageDict_ptr=findPageDict(_this.lock(), rootPages_ptr, 1, pos, &nodeCountCache);
+	boost::shared_ptr<CDict> pageDict_ptr=IProperty::getSmartCObjectPtr<CDict>(pageProp);
 
 	// creates CPage instance from page dictionary and stores it to the pageList
-	CPage * page=CPageFactory::getInstance(pageDict_ptr);
-	boost::shared_ptr<CPage> page_ptr(page);
-	pageList.insert(PageList::value_type(pos, page_ptr));
-	kernelPrintDbg(DBG_DBG, "New page added to the pageList size="<<pageList.size());
+	page_ptr=boost::shared_ptr<CPage>(CPageFactory::getInstance(pageDict_ptr));
+	kernelPrintDbg(DBG_DBG, "New page added to the pageList at pos="<<pos);
 
 	return page_ptr;
 }
@@ -2418,19 +2756,10 @@ using namespace utils;
 	
 	check_need_credentials(xref);
 
-	// try to use cached value - if zero, we have to get it from Page tree root
-	if(pageCount)
-	{
-		kernelPrintDbg(DBG_DBG, "cached page count="<<pageCount);
-		return pageCount;
-	}
-	
-	boost::shared_ptr<CDict> rootDict=getPageTreeRoot(_this.lock());
-	if(!rootDict.get())
-		return 0;
-	pageCount=getKidsCount(rootDict, &nodeCountCache);
-	kernelPrintDbg(DBG_DBG, "page count="<<pageCount);
-	return pageCount;
+	threads::ScopedLock lock(pageMutex);
+	ensurePageIndex();
+	kernelPrintDbg(DBG_DBG, "page count="<<pageIndex.size());
+	return (unsigned int)pageIndex.size();
 }
 
 bool CPdf::hasNextPage(const boost::shared_ptr<CPage> &page) const
@@ -2486,16 +2815,36 @@ size_t CPdf::getPagePosition(const boost::shared_ptr<CPage> &page)const
 		
 	check_need_credentials(xref);
 
-	// search in returned page list
-	PageList::iterator i;
-	for(i=pageList.begin(); i!=pageList.end(); ++i)
+	if(!page)
+		throw PageNotFoundException();
+
+	threads::ScopedLock lock(pageMutex);
+	ensurePageIndex();
+
+	// page dictionary which is in the tree just once has exact position
+	// This is ok even if they manage same page dictionary
+	size_t index;
+	boost::shared_ptr<CDict> pageDict=page->getDictionary();
+	if(pageDict && pageIndex.getPosition(pageDict->getIndiRef(), index))
+	{
+		if(pageList[index] == page)
+		{
+			kernelPrintDbg(DBG_DBG, "Page found at pos="<<index+1);
+			return index+1;
+		}
+		// page not found, it hasn't been returned by this pdf
+		throw PageNotFoundException();
+	}
+
+	// ambiguous page dictionary - compares page instances in returned 
+	// page list
+	for(PageList::const_iterator i=pageList.begin(); i!=pageList.end(); ++i)
 	{
-		// compares page instances
-		// This is ok even if they manage same page dictionary
-		if(i->second == page)
+		if(*i == page)
 		{
-			kernelPrintDbg(DBG_DBG, "Page found at pos="<<i->first);
-			return i->first;
+			size_t pos=i-pageList.begin()+1;
+			kernelPrintDbg(DBG_DBG, "Page found at pos="<<pos);
+			return pos;
 		}
 	}
 
@@ -2510,219 +2859,44 @@ using namespace utils;
 
 	kernelPrintDbg(DBG_DBG, "");
 
-	// correction for all pages affected by this subtree change
-	int difference=0;
-
-	// position of first page which should be considered during consolidation 
-	// because of value change
-	size_t minPos=0;
-
-	// handles original value - one before change
-	// pNull means no previous value available (new sub tree has been added)
-	kernelPrintDbg(DBG_DBG, "oldValue type="<<oldValue->getType());
-	if(!isNull(oldValue))
+	// change announced by insertPage or removePage is applied directly
+	PageTreeEdit edit=pageTreeEdit;
+	pageTreeEdit.active=false;
+	if(edit.active && pageIndexValid)
 	{
-		// oldValue is reference
-		
-		PageTreeNodeType oldNodeType=getNodeType(oldValue);
-
-		switch(oldNodeType)
+		const boost::shared_ptr<IProperty> & value=(edit.insert)?newValue:oldValue;
+		const boost::shared_ptr<IProperty> & other=(edit.insert)?oldValue:newValue;
+		size_t index=edit.pos-1;
+		if(isRef(value) && !isRef(other) && getValueFromSimple<CRef>(value)==edit.ref)
 		{
-			// simple page is compared with all from pageList and if found, 
-			// removes it from list and invalidates it.
-			// Difference is set to - 1, because one page is removed 
-			case LeafNode:
+			if(edit.insert && index<=pageIndex.size())
 			{
-				kernelPrintDbg(DBG_DBG, "oldValue was simple page dictionary");
-				difference = -1;
-				boost::shared_ptr<CDict> oldDict_ptr=getCObjectFromRef<CDict>(oldValue);
-
-				for(PageList::iterator i=pageList.begin(); i!=pageList.end(); ++i)
-				{
-					// checks page's dictionary with old one
-					boost::shared_ptr<CPage> page=i->second;
-					if(page->getDictionary() == oldDict_ptr)
-					{
-						i->second->invalidate();
-						size_t pos=i->first;
-						minPos=pos;
-						pageList.erase(i);
-						kernelPrintDbg(DBG_DBG, "CPage(pos="
-								<<pos
-								<<") associated with oldValue page dictionary removed. pageList.size="
-								<<pageList.size());
-						break;
-					}
-				}
-				break;
+				pageIndex.insert(index, edit.ref);
+				pageList.insert(pageList.begin()+index, boost::shared_ptr<CPage>());
+				kernelPrintDbg(DBG_DBG, "Page inserted to the pageIndex at pos="<<edit.pos);
+				return;
 			}
-			case InterNode:
-			case RootNode:
+			if(!edit.insert && index<pageIndex.size() && pageIndex.at(index)==edit.ref)
 			{
-				// all CPages from this sub tree are removed and invalidated
-				// difference is set to -getKidsCount value (total page lost)
-				kernelPrintDbg(DBG_DBG, "oldValue was intermediate node dictionary.");
-				difference = -getKidsCount(oldValue, &nodeCountCache);
-
-				// gets reference of oldValue - which is the root of removed
-				// subtree
-				IndiRef ref=getValueFromSimple<CRef>(oldValue);
-				
-				bool found=false;
-				for(PageList::iterator i=pageList.begin(); i!=pageList.end();)
-				{
-					boost::shared_ptr<CPage> page=i->second;
-					// checks page's dictionary whether it is in oldDict_ptr sub
-					// tree and if so removes it from pageList
-					if(isNodeDescendant(_this.lock(), ref, page->getDictionary()))
-					{
-						// sets flag, that at least one descendants is found
-						found=true;
-						
-						// updates minPos with page position (if greater)
-						size_t pos=i->first;
-						if(pos > minPos)
-							minPos=pos;
-						
-						page->invalidate();
-						pageList.erase(i++);
-						kernelPrintDbg(DBG_DBG, "CPage(pos="
-								<<pos
-								<<") associated with oldValue page dictionary removed. pageList.size="
-								<<pageList.size());
-						continue;
-					}
-					// if this element is not in subtree and found is true,
-					// this is first node which is in different node and so
-					// none of following pages can be descendant (PageList
-					// is sorted) 
-					if(found)
-						break;
-					// note: we can't do this in for iteration section 
-					// because of erase above which invalidas iterator
-					++i;
-				}
-				break;
+				if(pageList[index])
+					pageList[index]->invalidate();
+				pageIndex.remove(index);
+				pageList.erase(pageList.begin()+index);
+				kernelPrintDbg(DBG_DBG, "Page removed from the pageIndex at pos="<<edit.pos);
+				return;
 			}
-			default:
-				kernelPrintDbg(DBG_DBG, "oldValue is not leaf or intermediate node.");
-		}
-	}
-
-	// oldValue subtree (if any) is consolidated now
-	kernelPrintDbg(DBG_DBG, "All page dictionaries from oldValue subtree removed. count="<<-difference);
-
-	// number of added pages by newValue tree
-	int pagesCount=0;
-	
-	// handles new value - one after change
-	// if pNull - no new value is available (subtree has been removed)
-	kernelPrintDbg(DBG_DBG, "newValue type="<<newValue->getType());
-	if(!isNull(newValue))
-	{
-		// newValue is reference
-		PageTreeNodeType newValueType=getNodeType(newValue);
-
-		// gets count of pages in newValue node (if intermediate all pages
-		// under this node)
-		switch(newValueType)
-		{
-			case LeafNode:
-				pagesCount=1;
-				break;
-			case InterNode:
-			case RootNode:
-				pagesCount=getKidsCount(newValue, &nodeCountCache);
-				break;
-			default:
-				kernelPrintDbg(DBG_DBG, "newValue is not leaf or intermediate node.");
-		}
-			
-		// try to get position of newValue node.  No pages from this subtree can
-		// be in the pageList, so we can set minPos to its position.
-		// If getNodePosition throws, then this node is ambiguous and so we have
-		// no information
-		try
-		{
-			minPos = getNodePosition(_this.lock(), newValue, &nodeCountCache);
-		}catch(std::exception &e)
-		{
-			// position can't be determined
-			// no special handling is needed, minPos keeps its value
-			kernelPrintDbg(DBG_WARN, "Couldn't get newValue position. reason="<<e.what());
 		}
-
-		kernelPrintDbg(DBG_DBG, "newValue sub tree has "<<pagesCount<<" page dictionaries");
+		kernelPrintDbg(DBG_WARN, "Page tree change doesn't match announced change.");
 	}
 
-	// corrects difference with added pages
-	difference += pagesCount;
-
-	// no difference means no speacial handling for other pages
-	// we have replaced old sub tree with new subtree with same number of pages
-	if(difference==0)
-		return;
-
-	kernelPrintDbg(DBG_INFO, "pageList consolidation from minPos="<<minPos<<" with difference="<<difference);
-	 
-	// all pages with position greater than minPos, has to be consolidated
-	PageList::iterator i;
-	PageList readdContainer;
-	for(i=pageList.begin(); i!=pageList.end();)
+	// all returned pages have to be placed again. If there are none, index
+	// is built when it is needed
+	pageIndexValid=false;
+	if(!pageList.empty())
 	{
-		size_t pos=i->first;
-		boost::shared_ptr<CPage> page=i->second;
-
-		if(pos>=minPos)
-		{
-			// collects all removed
-			readdContainer.insert(PageList::value_type(pos, page));	
-			pageList.erase(i++);
-		}else
-			++i;
+		kernelPrintDbg(DBG_INFO, "pageList consolidation after page tree change");
+		buildPageIndex();
 	}
-	
-	// checks minPos==0 and if so, we have to handle situation special way,
-	// because don't have any information about previous position of oldValue
-	// subtree. In such case it has to get current position for all pages in
-	// pageList
-	if(!minPos)
-	{
-		kernelPrintDbg(DBG_DBG,"Reassingning all pages posititions.");
-		for(i=readdContainer.begin(); i!=readdContainer.end(); ++i)
-		{
-			// uses getNodePosition for each page's dictionary to find out
-			// current position. If getNodePosition throws an exception, it
-			// means that it can't be determined. Such page is invalidated.
-			try
-			{
-				size_t pos=getNodePosition(_this.lock(), i->second->getDictionary(), &nodeCountCache);
-				kernelPrintDbg(DBG_DBG, "Original position="<<i->first<<" new="<<pos);
-				pageList.insert(PageList::value_type(pos, i->second));	
-			}catch(AmbiguousPageTreeException & e)
-			{
-				kernelPrintDbg(DBG_WARN, "page with original position="<<i->first<<" is ambiguous. Invalidating.");
-				// page position is ambiguous and so it has to be invalidate
-				i->second->invalidate();
-			}catch(std::exception & e)
-			{
-				kernelPrintDbg(DBG_CRIT, "Unexpected error. cause="<<e.what()<<" Possibly BUG");
-				assert(!"Possibly bug.");
-			}
-		}
-		return;
-	}
-	
-	kernelPrintDbg(DBG_DBG, "Moving pages position with difference="<<difference<<" from page pos="<<minPos);
-	// Information about page numbers which should be consolidated is available
-	// so just adds difference for each in readdContainer
-	// readds all removed with changed position (according difference)
-	for(i=readdContainer.begin(); i!=readdContainer.end(); ++i)
-	{
-		kernelPrintDbg(DBG_DBG, "Original position="<<i->first<<" new="<<i->first+difference);
-		pageList.insert(PageList::value_type(i->first+difference, i->second));	
-	}
-	kernelPrintDbg(DBG_DBG, "pageList consolidation done.");
 }
 
 
@@ -2750,8 +2924,11 @@ using namespace utils;
 	// gets current count of kids and compares it to Count property
 	// if values are different, sets new value and sets countChanged to true and
 	// also node's parent should be consolidated
-	// Doesn't use cache to be sure that value is really collected
-	size_t count=getKidsCount(interNode, NULL);
+	// Cached value of this node is recalculated from its kids. Their cached 
+	// values are correct because change was just in this node (or in
+	// already consolidated kid which has recalculated its value).
+	discardKidsCountCache(interNodeRef, _this.lock(), nodeCountCache, false);
+	size_t count=getKidsCount(interNode, &nodeCountCache);
 	bool countChanged=false;
 	if(interNode->containsProperty("Count"))
 	{
@@ -2792,12 +2969,6 @@ using namespace utils;
 		countChanged=true;
 	}
 
-	// if page count has changed, discards cache for this node but keeps values
-	// in subtree (they contain correct values because change was just in this
-	// intermediate node)
-	if(countChanged)
-		discardKidsCountCache(interNodeRef, _this.lock(), nodeCountCache, false);
-	
 	kernelPrintDbg(DBG_DBG, "consolidating Kids array members");
 
 	// collects all kids from internode for consolidation
@@ -2944,15 +3115,19 @@ using namespace utils;
 		// Root of page dictionary doesn't exist
 		throw NoPageRootException();
 	}
+	// pageIndex can be updated directly only if we know where the new page
+	// goes - page at storePostion is not ambiguous
+	bool knownPosition=true;
 	if(count)
 	{
 		// stores new page at position of existing page
 		
-		// searches for page at storePosition and gets its reference
-		// page dictionary has to be an indirect object, so getIndiRef returns
-		// dictionary reference
-		boost::shared_ptr<CDict> currentPage_ptr=findPageDict(_this.lock(), interNode_ptr, 1, storePostion, &nodeCountCache);
-		currRef=boost::shared_ptr<CRef>(CRefFactory::getInstance(currentPage_ptr->getIndiRef()));
+		// gets reference of the page at storePosition from the pageIndex 
+		// (valid after getPageCount)
+		IndiRef currentPageRef=pageIndex.at(storePostion-1);
+		knownPosition=(pageIndex.occurrences(currentPageRef)==1);
+		boost::shared_ptr<CDict> currentPage_ptr=IProperty::getSmartCObjectPtr<CDict>(getIndirectProperty(currentPageRef));
+		currRef=boost::shared_ptr<CRef>(CRefFactory::getInstance(currentPageRef));
 		
 		// gets parent of found dictionary which maintains 
 		interNode_ptr=currentPage_ptr->getProperty<CDict>("Parent");
@@ -3036,16 +3211,38 @@ using namespace utils;
 	// adds newly created page dictionary to the kids array at kidsIndex
 	// position. This triggers pageTreeWatchDog for consolidation and observer
 	// is registered also on newly added reference
+	size_t newPos=storePostion+append;
 	CRef pageCRef(pageRef);
-	kids_ptr->addProperty(kidsIndex, pageCRef);
+	pageTreeEdit.active=knownPosition;
+	pageTreeEdit.pos=newPos;
+	pageTreeEdit.ref=pageRef;
+	pageTreeEdit.insert=true;
+	try
+	{
+		kids_ptr->addProperty(kidsIndex, pageCRef);
+	}catch(...)
+	{
+		pageTreeEdit.active=false;
+		throw;
+	}
+	pageTreeEdit.active=false;
 	
 	// page dictionary is stored in the tree, consolidation is also done at this
 	// moment
 	// CPage can be created and inserted to the pageList
 	boost::shared_ptr<CDict> newPageDict_ptr=IProperty::getSmartCObjectPtr<CDict>(getIndirectProperty(pageRef));
 	boost::shared_ptr<CPage> newPage_ptr(CPageFactory::getInstance(newPageDict_ptr));
-	pageList.insert(PageList::value_type(storePostion+append, newPage_ptr));
-	kernelPrintDbg(DBG_DBG, "New page added to the pageList size="<<pageList.size());
+	ensurePageIndex();
+	size_t index=newPos-1;
+	if((index<pageIndex.size() && pageIndex.at(index)==pageRef) || pageIndex.getPosition(pageRef, index))
+	{
+		if(!pageList[index])
+		{
+			pageList[index]=newPage_ptr;
+			kernelPrintDbg(DBG_DBG, "New page added to the pageList at pos="<<index+1);
+		}
+	}else
+		kernelPrintDbg(DBG_WARN, "New page position can't be determined.");
 	return newPage_ptr;
 }
 
@@ -3067,12 +3264,11 @@ using namespace utils;
 	if(!POSITION_IN_RANGE(pos))
 		throw PageNotFoundException(pos);
 
-	// Searches for page dictionary at given pos and gets its reference.
-	// getPageTreeRoot doesn't fail, because we are in page range and so it has
-	// to exist
-	boost::shared_ptr<CDict> rootDict=getPageTreeRoot(_this.lock());
-	boost::shared_ptr<CDict> currentPage_ptr=findPageDict(_this.lock(), rootDict, 1, pos, &nodeCountCache);
-	boost::shared_ptr<CRef> currRef(CRefFactory::getInstance(currentPage_ptr->getIndiRef()));
+	// Gets page dictionary at given pos from the pageIndex (valid after
+	// getPageCount called by POSITION_IN_RANGE)
+	IndiRef currentPageRef=pageIndex.at(pos-1);
+	boost::shared_ptr<CDict> currentPage_ptr=IProperty::getSmartCObjectPtr<CDict>(getIndirectProperty(currentPageRef));
+	boost::shared_ptr<CRef> currRef(CRefFactory::getInstance(currentPageRef));
 	
 	// Gets parent field from found page dictionary and gets its Kids array
 	boost::shared_ptr<CDict> interNode_ptr=currentPage_ptr->getProperty<CDict>("Parent");
@@ -3098,13 +3294,292 @@ using namespace utils;
 		throw AmbiguousPageTreeException();
 	}
 	
-	// removing triggers pageTreeWatchDog consolidation
+	// removing triggers pageTreeWatchDog consolidation. pageIndex can be
+	// updated directly if the page is not ambiguous
 	size_t kidsIndex=positions[0];
-	kids_ptr->delProperty(kidsIndex);
+	pageTreeEdit.active=(pageIndex.occurrences(currentPageRef)==1);
+	pageTreeEdit.pos=pos;
+	pageTreeEdit.ref=currentPageRef;
+	pageTreeEdit.insert=false;
+	try
+	{
+		kids_ptr->delProperty(kidsIndex);
+	}catch(...)
+	{
+		pageTreeEdit.active=false;
+		throw;
+	}
+	pageTreeEdit.active=false;
 	
 	// page dictionary is removed from the tree, consolidation is done also for
 	// pageList at this moment
 }
+
+namespace {
+
+/** Inheritable page attributes which have to be kept by rebalancePageTree.
+ */
+const std::string * const inheritableAttributes[]={
+	&Specification::Page::RESOURCES,
+	&Specification::Page::MEDIABOX,
+	&Specification::Page::CROPBOX,
+	&Specification::Page::ROTATE
+};
+
+/** Type for inheritable attributes values (attribute name to value mapping).
+ */
+typedef std::map<std::string, boost::shared_ptr<IProperty> > InheritedValues;
+
+/** Page collected for page tree rebalancing.
+ */
+struct RebalancedPage
+{
+	/** Page dictionary reference. */
+	IndiRef ref;
+	/** Attributes inherited from intermediate nodes (NULL if none). */
+	boost::shared_ptr<InheritedValues> inherited;
+};
+
+/** Intermediate node created by page tree rebalancing.
+ */
+struct RebalancedNode
+{
+	/** Reserved reference of the node. */
+	IndiRef ref;
+	/** Reference of the parent node. */
+	IndiRef parent;
+	/** Kids referencies. */
+	std::vector<IndiRef> kids;
+	/** Number of pages under node. */
+	size_t count;
+};
+
+/** Collects all pages from given intermediate node for rebalancing.
+ * @param interNode Intermediate node dictionary.
+ * @param inherited Attributes inherited from intermediate nodes (not the
+ * root) above interNode and from interNode itself.
+ * @param pages Container where to append pages (in the document order).
+ * @param visited References of all already visited nodes.
+ * @param maxKids Maximal number of kids.
+ * @param unbalanced Set to true if some node has more than maxKids kids.
+ *
+ * @return false if some node is referenced more times (page tree is
+ * ambiguous), true otherwise.
+ */
+bool collectRebalancedPages(const boost::shared_ptr<CDict> & interNode, const boost::shared_ptr<InheritedValues> & inherited, 
+		std::vector<RebalancedPage> & pages, PageTreePath & visited, size_t maxKids, bool & unbalanced)
+{
+using namespace utils;
+
+	ChildrenStorage children;
+	getKidsFromInterNode(interNode, children);
+	if(children.size()>maxKids)
+		unbalanced=true;
+	for(ChildrenStorage::const_iterator i=children.begin(); i!=children.end(); ++i)
+	{
+		boost::shared_ptr<IProperty> child=*i;
+		if(!isRef(child))
+			continue;
+		IndiRef childRef=getValueFromSimple<CRef>(child);
+		PageTreeNodeType nodeType=getNodeType(child);
+		if(nodeType!=LeafNode && nodeType!=InterNode && nodeType!=RootNode)
+		{
+			kernelPrintDbg(DBG_DBG, "Kids element "<<childRef<<" is not leaf or intermediate node.");
+			continue;
+		}
+		if(!visited.insert(childRef).second)
+		{
+			kernelPrintDbg(DBG_WARN, "Node "<<childRef<<" is referenced more times.");
+			return false;
+		}
+		if(nodeType==LeafNode)
+		{
+			RebalancedPage page={childRef, inherited};
+			pages.push_back(page);
+			continue;
+		}
+
+		// kids of this node inherit also its own attributes
+		boost::shared_ptr<CDict> childDict=getCObjectFromRef<CDict>(child);
+		boost::shared_ptr<InheritedValues> childInherited=inherited;
+		for(size_t j=0; j<sizeof(inheritableAttributes)/sizeof(*inheritableAttributes); ++j)
+		{
+			const std::string & name=*inheritableAttributes[j];
+			if(!childDict->containsProperty(name))
+				continue;
+			if(childInherited==inherited)
+				childInherited.reset((inherited)?new InheritedValues(*inherited):new InheritedValues());
+			(*childInherited)[name]=childDict->getProperty(name);
+		}
+		if(!collectRebalancedPages(childDict, childInherited, pages, visited, maxKids, unbalanced))
+			return false;
+	}
+	return true;
+}
+
+} // annonymous namespace
+
+bool CPdf::rebalancePageTree(size_t maxKids)
+{
+using namespace utils;
+
+	kernelPrintDbg(DBG_DBG, "maxKids="<<maxKids);
+
+	check_need_credentials(xref);
+
+	if(getMode()==ReadOnly)
+	{
+		kernelPrintDbg(DBG_ERR, "Document is in read-only mode now");
+		throw ReadOnlyDocumentException("Document is in read-only mode.");
+	}
+	if(maxKids<2)
+		throw OutOfRange();
+
+	threads::ScopedLock lock(pageMutex);
+	boost::shared_ptr<CDict> rootDict=getPageTreeRoot(_this.lock());
+	if(!rootDict.get())
+		return false;
+	IndiRef rootRef=rootDict->getIndiRef();
+
+	// collects all pages with attributes which they inherit from 
+	// intermediate nodes which will be replaced
+	std::vector<RebalancedPage> pages;
+	PageTreePath visited;
+	visited.insert(rootRef);
+	bool unbalanced=false;
+	if(!collectRebalancedPages(rootDict, boost::shared_ptr<InheritedValues>(), pages, visited, maxKids, unbalanced))
+	{
+		kernelPrintDbg(DBG_WARN, "Page tree is ambiguous. It can't be rebalanced.");
+		return false;
+	}
+	if(!unbalanced)
+	{
+		kernelPrintDbg(DBG_DBG, "No intermediate node has more than "<<maxKids<<" kids.");
+		return false;
+	}
+	kernelPrintDbg(DBG_INFO, "Rebalancing page tree with "<<pages.size()<<" pages.");
+
+	// builds new intermediate nodes level by level from the bottom. Each
+	// level is distributed evenly to the smallest number of nodes with at
+	// most maxKids kids. The last level is stored to the root.
+	std::vector<RebalancedNode> nodes;
+	std::vector<IndiRef> pageParents(pages.size(), rootRef);
+	std::vector<IndiRef> levelRefs;
+	std::vector<size_t> levelCounts;
+	for(size_t i=0; i<pages.size(); ++i)
+	{
+		levelRefs.push_back(pages[i].ref);
+		levelCounts.push_back(1);
+	}
+	bool pagesLevel=true;
+	size_t levelStart=0;
+	while(levelRefs.size()>maxKids)
+	{
+		size_t groups=(levelRefs.size()+maxKids-1)/maxKids;
+		size_t upperStart=nodes.size();
+		std::vector<IndiRef> upperRefs;
+		std::vector<size_t> upperCounts;
+		for(size_t g=0; g<groups; ++g)
+		{
+			RebalancedNode node;
+			node.ref=xref->reserveRef();
+			node.parent=rootRef;
+			node.count=0;
+			size_t end=levelRefs.size()*(g+1)/groups;
+			for(size_t i=levelRefs.size()*g/groups; i<end; ++i)
+			{
+				node.kids.push_back(levelRefs[i]);
+				node.count+=levelCounts[i];
+				if(pagesLevel)
+					pageParents[i]=node.ref;
+				else
+					nodes[levelStart+i].parent=node.ref;
+			}
+			upperRefs.push_back(node.ref);
+			upperCounts.push_back(node.count);
+			nodes.push_back(node);
+		}
+		levelRefs.swap(upperRefs);
+		levelCounts.swap(upperCounts);
+		levelStart=upperStart;
+		pagesLevel=false;
+	}
+
+	// page tree observers would consolidate page tree and pageList after each
+	// single change, so they are unregistered and everything is consolidated
+	// at once when done
+	boost::shared_ptr<IProperty> rootProp=rootDict;
+	unregisterPageTreeObservers(rootProp, true);
+	try
+	{
+		// stores new intermediate nodes
+		for(std::vector<RebalancedNode>::iterator i=nodes.begin(); i!=nodes.end(); ++i)
+		{
+			boost::shared_ptr<CDict> nodeDict(CDictFactory::getInstance());
+			boost::scoped_ptr<IProperty> nodeType(CNameFactory::getInstance("Pages"));
+			nodeDict->addProperty("Type", *nodeType);
+			CRef parentRef(i->parent);
+			nodeDict->addProperty("Parent", parentRef);
+			boost::scoped_ptr<CArray> kids(CArrayFactory::getInstance());
+			for(std::vector<IndiRef>::const_iterator kid=i->kids.begin(); kid!=i->kids.end(); ++kid)
+			{
+				CRef kidRef(*kid);
+				kids->addProperty(kidRef);
+			}
+			nodeDict->addProperty("Kids", *kids);
+			boost::scoped_ptr<IProperty> count(CIntFactory::getInstance((int)i->count));
+			nodeDict->addProperty("Count", *count);
+			registerIndirectProperty(nodeDict, i->ref);
+		}
+
+		// moves pages to new parents together with their inherited values
+		for(size_t i=0; i<pages.size(); ++i)
+		{
+			boost::shared_ptr<CDict> pageDict=IProperty::getSmartCObjectPtr<CDict>(getIndirectProperty(pages[i].ref));
+			if(pages[i].inherited)
+			{
+				InheritedValues::const_iterator value;
+				for(value=pages[i].inherited->begin(); value!=pages[i].inherited->end(); ++value)
+					if(!pageDict->containsProperty(value->first))
+						pageDict->addProperty(value->first, *(value->second));
+			}
+			CRef parentRef(pageParents[i]);
+			pageDict->setProperty("Parent", parentRef);
+		}
+
+		// replaces root Kids array
+		boost::scoped_ptr<CArray> rootKids(CArrayFactory::getInstance());
+		for(std::vector<IndiRef>::const_iterator i=levelRefs.begin(); i!=levelRefs.end(); ++i)
+		{
+			CRef kidRef(*i);
+			rootKids->addProperty(kidRef);
+		}
+		rootDict->setProperty("Kids", *rootKids);
+	}catch(...)
+	{
+		kernelPrintDbg(DBG_ERR, "Page tree rebalancing failed.");
+		utils::clearCache(nodeCountCache);
+		registerPageTreeObservers(rootProp);
+		pageIndexValid=false;
+		if(!pageList.empty())
+			buildPageIndex();
+		throw;
+	}
+
+	// consolidates root and registers observers to the new tree
+	utils::clearCache(nodeCountCache);
+	consolidatePageTree(rootDict);
+	registerPageTreeObservers(rootProp);
+
+	// order of pages hasn't changed but page tree has been rebuilt
+	pageIndexValid=false;
+	if(!pageList.empty())
+		buildPageIndex();
+
+	kernelPrintDbg(DBG_INFO, "Page tree rebalanced with "<<nodes.size()<<" new intermediate nodes.");
+	return true;
+}
+
 void CPdf::saveDecoded(char * name)
 {
 	FILE * file = fopen(name,"wb"); //TODO remove from headet
@@ -3117,7 +3592,7 @@ void CPdf::saveChangesToNew(char * name)
 {
 	xref->saveToNew(name);
 }
-void CPdf::save(bool newRevision)const
+void CPdf::save(bool newRevision)
 {
 	kernelPrintDbg(DBG_DBG, "");
 
@@ -3138,6 +3613,10 @@ void CPdf::save(bool newRevision)const
 		throw ReadOnlyDocumentException("Document is in read-only mode.");
 	}
 	
+	// rebalances page tree before it is stored if required
+	if(pageTreeFanout)
+		rebalancePageTree(pageTreeFanout);
+
 	// we are in the newest revision, so changes can be saved
 	// delegates all work to the XRefWriter and set change to 
 	// mark, that no changes were stored
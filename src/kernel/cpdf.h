@@ -32,6 +32,9 @@
 #include "kernel/modecontroller.h"
 #include "kernel/iproperty.h"
 #include "kernel/cstream.h"
+#include "kernel/pagetreeindex.h"
+#include "utils/mutex.h"
+#include "utils/atomic.h"
 
 class StreamWriter;
 
@@ -42,6 +45,7 @@ class IProperty;
 class CDict;
 class CXref;
 class CPage;
+class RenderContext;
 template<typename IP> inline boost::shared_ptr<CDict> getCDictFromDict (IP& ip, const std::string& key);
 
 namespace utils {
@@ -126,12 +130,35 @@ typedef std::pair<IndiRef, enum ResolveRefState> ResolvedRefEntry;
  *
  * @see CPdf::addIndirectProperty
  */
-typedef std::map<IndiRef, ResolvedRefEntry*, utils::IndComparator > ResolvedRefStorage;
+typedef IndexedObjectStorage<IndiRef, ResolvedRefEntry*, utils::IndComparator > ResolvedRefStorage;
+
+/**
+ * Usage order of indirect properties (the most recently used first).
+ */
+typedef std::list<IndiRef> IndirectUsage;
+
+/**
+ * Indirect properties mapping entry.
+ */
+struct IndirectEntry
+{
+	/** Indirect property. */
+	boost::shared_ptr<IProperty> property;
+	/** Estimated memory used by the property. */
+	size_t size;
+	/** Position in the usage list. */
+	IndirectUsage::iterator usage;
+	/** Set when the property is returned from the mapping, so that hits
+	 * don't have to reorder the usage list. Cleared by shrinking which 
+	 * gives such property another chance.
+	 */
+	bool used;
+};
 
 /**
  * Indirect properties mapping type.
  */
-typedef std::map<const IndiRef, boost::shared_ptr<IProperty>, utils::IndComparator> IndirectMapping;
+typedef IndexedObjectStorage<IndiRef, IndirectEntry, utils::IndComparator> IndirectMapping;
 
 /** Type for pdf identificator.
  */
@@ -283,15 +310,83 @@ public:
 	 * changes, ReadWrite can change objects byt with some restrictions and
 	 * Advanced have full control. If you want to add new enum value please
 	 * consider this ordering.  
+	 * <br>
+	 * Document opened in ReadOnly mode can be shared by more threads.
+	 * getPage, getPageCount, getPagePosition, getIndirectProperty, xref 
+	 * fetching and content stream parsing can be called concurrently. 
+	 * Returned properties are shared and must not be changed (which is
+	 * guaranteed by ReadOnly mode anyway) and observers registered on them
+	 * have to be thread safe as well.
 	 */
 	enum OpenMode {ReadOnly, ReadWrite, Advanced};
 
+	/** Writer for the document file.
+	 *
+	 * Possible values:
+	 * <ul>
+	 * <li>DirectWriter - FileStreamWriter which flushes the file after each 
+	 * write.
+	 * <li>BufferedWriter - BufferedFileStreamWriter which keeps written data
+	 * in the memory buffer and flushes them when the revision is saved.
+	 * <li>MappedWriter - MappedFileStreamWriter which maps the file to the
+	 * memory so reading doesn't need any system calls. Falls back to 
+	 * DirectWriter if the file can't be mapped (or mmap is not available).
+	 * </ul>
+	 */
+	enum WriterType {DirectWriter, BufferedWriter, MappedWriter};
+
+	/** Loading of the cross reference table.
+	 *
+	 * Possible values:
+	 * <ul>
+	 * <li>FullXRef - all xref sections are parsed when the document is 
+	 * opened.
+	 * <li>LazyXRef - only the most recent xref section is parsed when the 
+	 * document is opened. Older sections (and revisions) are parsed when 
+	 * an object which is not described by newer sections is required.
+	 * <li>IndexedXRef - parsed xref is stored to the sidecar index file (see
+	 * XRefIndex) and it is loaded from there when the same unchanged file 
+	 * is opened again. Older sections are parsed on demand if the index is 
+	 * not usable.
+	 * </ul>
+	 */
+	enum XRefMode {FullXRef, LazyXRef, IndexedXRef};
+
 	/** Constant for pdf id of no pdf.
 	 * This is used for properties which comes from no pdf. Each CPdf instance
 	 * must have id different from this value.
 	 */
 	static const cpdf_id_t NO_PDF_ID=0;
 
+	/** Default memory budget for indirect properties mapping (in bytes).
+	 * @see setIndirectCacheBudget
+	 */
+	static const size_t DEFAULT_INDIRECT_CACHE_BUDGET=64*1024*1024;
+
+	/** Default maximal number of kids for page tree rebalancing.
+	 * @see rebalancePageTree
+	 */
+	static const size_t DEFAULT_PAGE_TREE_FANOUT=32;
+
+	/** Statistics of indirect properties mapping.
+	 * @see getIndirectCacheStatistics
+	 */
+	struct IndirectCacheStatistics
+	{
+		/** Number of getIndirectProperty calls with mapping found. */
+		size_t hits;
+		/** Number of getIndirectProperty calls which had to fetch object. */
+		size_t misses;
+		/** Number of properties discarded because of memory budget. */
+		size_t evictions;
+		/** Number of attempts to fit mapped properties into the budget. */
+		size_t shrinks;
+		/** Estimated memory used by mapped properties. */
+		size_t size;
+		/** Memory budget. */
+		size_t budget;
+	};
+
 protected:
 	/** Type for list of all alive pdfs.
 	 */
@@ -375,8 +470,8 @@ protected:
 		 * <li>tries to get dictionary from oldValue (if it is reference) and 
 		 * unregister observers from whole page tree (uses 
 		 * pdf::unregisterPageTreeObservers method). 
-		 * <li>invalidates pdf-::pageCount
-		 * <li>clears pdf::pageList and invalidates all pages.
+		 * <li>clears pdf::pageList, invalidates all pages and discards
+		 * pdf::pageIndex.
 		 * <li>clears pdf::nodeCountCache
 		 * <li>tries to get dictionary from newValue (if it is reference) and
 		 * registers observers to whole new page tree (uses
@@ -549,13 +644,12 @@ protected:
 		 * kind of work around to handle situation when Kids array is indirect
 		 * property (cache entries are done just for such Kids arrays). Uses
 		 * CPdf::consolidatePageTree method. If this method returns with
-		 * false, discards CPdf::pageCount field (sets it to 0). Consolidation
+		 * false, discards CPdf::pageIndex. Consolidation
 		 * will change node's Count property and checks all direct childs
 		 * whether they contain correct reference to parent (consolidated node).
 		 * <li>consolidate CPdf::pageList with Cpdf::consolidatePageList
 		 * method. Consolidation will remove and invalidate all pages from
-		 * oldValue subtree and moves all which position has changed because of
-		 * this removing.
+		 * oldValue subtree and moves all which position has changed.
 		 * <li>If oldValue is reference, discards Cpdf::nodeCountCache for it
 		 * and all nodes in its subtree.
 		 * <li>If newValue is reference, registers obserers to new subtree. Uses
@@ -654,26 +748,15 @@ protected:
 	 * @param oldValue Old reference (CNull if no previous state).
 	 * @param newValue New reference (CNull if no future state).
 	 *
-	 * Removes all CPages, which are in old reference sub tree (if oldValue is 
-	 * not CNull - what means that new element to Kids array has been added) 
-	 * from pageList and invalidates them. Uses isNodeDescendant method for each 
-	 * page from pageList to find out if it is in sub tree.
-	 * <br>
-	 * Also calculates difference between lost pages and newly added pages (each
-	 * is calculated by number of leaf nodes from oldValue resp. newValue sub
-	 * tree - uses getKidsCount helper function). If oldValue or newValue is
-	 * CNull 0 is used.
+	 * If the change is the one announced by insertPage or removePage (see
+	 * pageTreeEdit), pageIndex and pageList are updated at known position in
+	 * logarithmic time.
 	 * <br>
-	 * Tries to determine which pages have to be consolidated (those which
-	 * position has changed). If newValue is CNull, we have no information about 
-	 * oldValue position so we can either get page information from all pages in 
-	 * the list or if at least one page from oldValue subtree has been removed 
-	 * from pageList, we can use this as starting point and just change position
-	 * according calculated difference.
-	 * <br>
-	 * Page position getting is rather complex operation and may lead to whole 
-	 * page tree searching. This is done only if no page position is available 
-	 * from oldValue subtree.
+	 * Otherwise pageIndex is built again (see buildPageIndex) which moves all
+	 * returned CPage instances to their new positions and invalidates those
+	 * which are not in the page tree anymore (e.g. from removed subtree) or
+	 * which are ambiguous now. If no page has been returned yet, index is just
+	 * invalidated and it is built when it is needed next time.
 	 * <br>
 	 * This guaranties, that pages from removed subtree are not available 
 	 * anymore and are invalidated and also valid returned CPage instances are 
@@ -681,30 +764,10 @@ protected:
 	 * <p>
 	 * <b>Implementation notes</b><br>
 	 * This method should be called by obsever monitoring Kids array and Kids
-	 * array elements.
-	 * Some previous checking and consolidation of page tree should be done
-	 * before, because this method relies on proper page tree structure.
-	 * <br>
-	 * No parameters checking is done here. Caller must be sure that:
-	 * <ul>
-	 * <li>parameter must be CNull or CRef
-	 * <li>CRef must point to dictionary
-	 * <li>dictionary must have Type field with value Page or Pages
-	 * <li>Pages dictionary must contain Count field with integer value
-	 * </ul>
+	 * array elements after the page tree has been changed.
 	 * <br>
 	 * oldValue and newValue can be CNull or CRef instances. CNull case stands 
-	 * for adding (if oldValue) resp. deleting (if newValue) event. If both of 
-	 * them are CNull no change is done by this method. 
-	 * <br>
-	 * CRef stands for reference from Kids array in Intermediate node. It has 
-	 * to refer to page or pages dictionary. 
-	 * <br>
-	 * If both values are CRef instances then oldValue has been replaced by 
-	 * newValue reference. This implementation assumes that both of them were 
-	 * on same position in the page tree - one sub tree was replaced by new one
-	 * but on the same position. It is not possible that these values could be 
-	 * on different positions (this would cause page numbering problem).
+	 * for adding (if oldValue) resp. deleting (if newValue) event. 
 	 */
 	void consolidatePageList(const boost::shared_ptr<IProperty> & oldValue, const boost::shared_ptr<IProperty> & newValue);
 
@@ -852,6 +915,23 @@ private:
 	 */
 	mutable bool change;
 	
+	/** Number of shards of the indirect mapping. */
+	static const size_t INDIRECT_SHARDS=16;
+
+	/** Part of the indirect mapping with its own lock.
+	 *
+	 * Object numbers are spread over shards by their remainder and keys
+	 * in the shard mapping hold the quotient, so that indexed tables of all
+	 * shards stay dense (see getIndirectShard).
+	 */
+	struct IndirectShard
+	{
+		/** Properties mapped in this shard. */
+		IndirectMapping mapping;
+		/** Lock for mapping. */
+		threads::Mutex mutex;
+	};
+
 	/** Mapping between IndiRef and indirect properties. 
 	 *
 	 * This is essential when we want to access an indirect object from 
@@ -859,7 +939,72 @@ private:
 	 * with same reference has to share value and this is guarantied by this 
 	 * mapping.
 	 */
-	mutable IndirectMapping indMap;
+	mutable IndirectShard indShards[INDIRECT_SHARDS];
+
+	/** Usage order of mapped properties.
+	 * It is approximate, because properties are moved only when they are
+	 * mapped and when shrinking finds them used (see IndirectEntry::used).
+	 */
+	mutable IndirectUsage indUsage;
+
+	/** Statistics of the mapping (also holds its size and budget).
+	 * Hits are counted separately in indHits.
+	 */
+	mutable IndirectCacheStatistics indStats;
+
+	/** Number of getIndirectProperty calls with mapping found.
+	 * It is updated atomically without any lock.
+	 */
+	mutable volatile long indHits;
+
+	/** Size of the mapping which triggers shrinkIndirectMapping.
+	 *
+	 * It is the budget unless properties held by somebody else didn't fit
+	 * into it during the last shrinking. Then it is moved half of the
+	 * mapping size above, so that each new property doesn't check all held
+	 * ones again.
+	 */
+	mutable size_t indShrinkSize;
+
+	/** Lock for indUsage, indStats and indShrinkSize.
+	 *
+	 * It is held when properties are added to or removed from the mapping
+	 * and it is always locked before the shard lock. Threads which find
+	 * their properties in the mapping hold only the lock of the shard, so 
+	 * they don't wait for each other nor for those which parse. Missing
+	 * property is fetched and created without any lock and the first one
+	 * stored to the mapping is used by all threads (see 
+	 * getIndirectProperty).
+	 */
+	mutable threads::Mutex indMutex;
+
+	/** Returns shard of the indirect mapping for given reference.
+	 * @param ref Reference.
+	 * @param key Output key of the reference in the shard mapping.
+	 * @return Shard.
+	 */
+	IndirectShard & getIndirectShard(const IndiRef & ref, IndiRef & key)const;
+
+	/** Checks whether given reference is mapped. */
+	bool isIndirectMapped(const IndiRef & ref)const;
+
+	/** Removes mapping for given reference (if any). */
+	void removeIndirectMapping(const IndiRef & ref)const;
+
+	/** Removes all indirect mappings. */
+	void clearIndirectMapping()const;
+
+	/** Discards least recently used properties until the mapping fits into
+	 * the memory budget.
+	 *
+	 * Only properties which are not held by anybody else (including their
+	 * children) and have no observers registered are discarded, so 
+	 * getIndirectProperty still returns the same instance for all users of
+	 * an indirect object. Discarded properties are created again from xref
+	 * when needed. Properties used since the last shrinking are kept and
+	 * lose their mark. Updates indShrinkSize.
+	 */
+	void shrinkIndirectMapping()const;
 
 	/** Document catalog dictionary.
 	 *
@@ -872,10 +1017,10 @@ private:
 
 	/** Type of returned pages list.
 	 *
-	 * It is association of page position with CPage instance. Elements are
-	 * sorted according their position.
+	 * Dense list of CPage instances indexed by page position - 1. Pages which
+	 * haven't been returned yet have NULL element.
 	 */
-	typedef std::map<size_t, boost::shared_ptr<CPage> > PageList;
+	typedef std::vector<boost::shared_ptr<CPage> > PageList;
 
 	/** Returned pages list.
 	 *
@@ -891,21 +1036,81 @@ private:
 	 * It is safe to try to find page in this list at first and if not found,
 	 * than searching is neccessary. 
 	 * <br>
-	 * This storage behaves like CPage cache.
+	 * This storage behaves like CPage cache. It has always the same size as
+	 * pageIndex if pageIndexValid is set.
 	 */
 	mutable PageList pageList;
 
-	/** Number of pages in document.
+	/** Index of page dictionaries in the document order.
+	 *
+	 * Built by buildPageIndex with one page tree walk when it is needed for
+	 * the first time. Page position to page dictionary and page dictionary to
+	 * position mapping is logarithmic then. insertPage and removePage update
+	 * index incrementally (see pageTreeEdit), all other page tree changes
+	 * invalidate it.
+	 */
+	mutable PageTreeIndex pageIndex;
+
+	/** Flag for valid pageIndex.
+	 *
+	 * Cleared whenever page tree changes in a way which can't be applied to
+	 * the index incrementally and in initRevisionSpecific method.
+	 */
+	mutable bool pageIndexValid;
+
+	/** Page tree change done by insertPage or removePage.
+	 *
+	 * These methods know the position of inserted or removed page, so
+	 * consolidatePageList can update pageIndex and pageList directly instead
+	 * of building the index again.
+	 */
+	struct PageTreeEdit
+	{
+		/** Flag for pending change. */
+		bool active;
+		/** Position of inserted or removed page. */
+		size_t pos;
+		/** Reference of inserted or removed page dictionary. */
+		IndiRef ref;
+		/** True for insertion, false for removal. */
+		bool insert;
+	};
+
+	/** Pending page tree change (if active).
+	 */
+	PageTreeEdit pageTreeEdit;
+
+	/** Builds pageIndex from the current page tree.
 	 *
-	 * Keeps value of actual number of pages or 0 if value is invalid and
-	 * getPageCount has to find out it. Whenever this is set to non 0 and change
-	 * in page tree occures which can change total number of pages, it is set to
-	 * 0. Value is also invalidated in initRevisionSpecific method.
+	 * Walks whole page tree (starting from getPageTreeRoot) and collects all
+	 * page dictionary references in the document order. All instances from 
+	 * pageList are moved to their current positions. Pages which are not in
+	 * the tree anymore or whose position is ambiguous are invalidated.
 	 * <br>
-	 * This is kind of optimalization to prevent geting Root of page tree node
-	 * each time when total number of pages is required.
+	 * Caller has to hold pageMutex if document may be accessed from more 
+	 * threads.
+	 */
+	void buildPageIndex()const;
+
+	/** Builds pageIndex if it is not valid.
+	 */
+	void ensurePageIndex()const
+	{
+		if(!pageIndexValid)
+			buildPageIndex();
+	}
+
+	/** Invalidates and removes all pages from pageList and discards 
+	 * pageIndex.
+	 */
+	void discardPages()const;
+
+	/** Maximal number of kids for page tree rebalancing on save.
+	 *
+	 * Zero value means that the page tree is saved as it is.
+	 * @see setPageTreeFanout
 	 */
-	mutable size_t pageCount;
+	size_t pageTreeFanout;
 
 	/** Cache for page count information for intermediate nodes.
 	 *
@@ -922,6 +1127,17 @@ private:
 	 */
 	mutable PageTreeNodeCountCache nodeCountCache;
 
+	/** Lock for pageList, pageIndex and nodeCountCache.
+	 *
+	 * Locks have to be taken in the order pageMutex, contentMutex, xref
+	 * read mutex (see CXref::getReadMutex) and indMutex to prevent
+	 * deadlocks.
+	 */
+	mutable threads::Mutex pageMutex;
+
+	/** Lock for content stream parsing (see getContentMutex). */
+	mutable threads::Mutex contentMutex;
+
 	/** Cache for indirect Kids arrays mapping to their parents.
 	 *
 	 * This cache enables to overcome problem with indirect Kids arrays in
@@ -976,6 +1192,13 @@ private:
 	 */
 	XRefWriter * xref;
 
+	/** Document wide rendering state.
+	 *
+	 * Created in constructor together with xref and deallocated before it.
+	 * @see getRenderContext
+	 */
+	boost::shared_ptr<RenderContext> renderContext;
+
 	/** Open mode of document.
 	 * 
 	 */
@@ -1009,12 +1232,15 @@ private:
 	/** Initializating constructor.
 	 * @param stream Stream with data.
 	 * @param openMode Mode for this file.
+	 * @param loading Xref sections loading mode.
+	 * @param index Persistent xref index (may be NULL).
 	 *
 	 * Creates XRefWriter, initializes pageTreeWatchDog and finally calls
 	 * initRevisionSpecific method for initialization of internal structures
 	 * which depends on current revision.
 	 */
-	CPdf(StreamWriter * stream, OpenMode openMode);
+	CPdf(StreamWriter * stream, OpenMode openMode, 
+			XRefLoading loading = xrefLoadAll, XRefIndex * index = NULL);
 	
 	/** Destructor.
 	 * 
@@ -1039,6 +1265,9 @@ public:
 	 * @param filename File name with pdf content (if null, new document 
 	 *	will be created).
 	 * @param mode Mode to open file.
+	 * @param writer Type of the writer used for file changes.
+	 * @param xrefMode Loading of the cross reference table. Index file name
+	 * for IndexedXRef is given by XRefIndex::getIndexFileName.
 	 *
 	 * This is only way how to get instance of CPdf type. All necessary 
 	 * initialization is done.
@@ -1046,7 +1275,8 @@ public:
 	 * @throw PdfOpenException if file open fails.
 	 * @return Initialized (and ready to be used) CPdf instance.
 	 */
-	static boost::shared_ptr<CPdf> getInstance(const char * filename, OpenMode mode);
+	static boost::shared_ptr<CPdf> getInstance(const char * filename, OpenMode mode, 
+			WriterType writer = DirectWriter, XRefMode xrefMode = FullXRef);
 
 	/** Returns unique identificator for this pdf.
 	 *
@@ -1072,6 +1302,34 @@ public:
 	{
 		return dynamic_cast<CXref *>(xref);
 	}
+
+	/** Returns lock for content stream parsing.
+	 *
+	 * Content streams are parsed from data of their CStream objects, which
+	 * are already in memory, so parsing doesn't need the xref read lock.
+	 * CStream keeps its parser while it is read and more pages may share
+	 * the same stream, so parsing and the parsed state of content streams
+	 * (CContentStream, CPageContents) are guarded by this lock.
+	 *
+	 * @return Mutex guarding content stream parsing.
+	 */
+	threads::Mutex & getContentMutex()const
+	{
+		return contentMutex;
+	}
+
+	/** Returns rendering state of the document.
+	 *
+	 * Holds data which can be shared by all page renderings (e.g. xpdf
+	 * catalog). It may be used only with the document read lock held (see
+	 * CXref::getReadMutex).
+	 *
+	 * @return Render context of this document.
+	 */
+	RenderContext & getRenderContext()const
+	{
+		return *renderContext;
+	}
        
 	/** Returns actually used mode controller.
 	 *
@@ -1115,6 +1373,30 @@ public:
 	 */
 	boost::shared_ptr<IProperty> getIndirectProperty(const IndiRef &ref)const;
 
+	/** Sets memory budget for properties kept by getIndirectProperty.
+	 * @param budget Maximal estimated size of kept properties in bytes.
+	 *
+	 * Properties which are held by somebody else are always kept, so
+	 * the budget may be exceeded.
+	 */
+	void setIndirectCacheBudget(size_t budget)
+	{
+		threads::ScopedLock lock(indMutex);
+		indStats.budget = budget;
+		shrinkIndirectMapping();
+	}
+
+	/** Returns statistics of properties kept by getIndirectProperty.
+	 * @return Statistics.
+	 */
+	IndirectCacheStatistics getIndirectCacheStatistics()const
+	{
+		threads::ScopedLock lock(indMutex);
+		IndirectCacheStatistics stats = indStats;
+		stats.hits = static_cast<size_t>(threads::atomicRead(indHits));
+		return stats;
+	}
+
 	/** Adds new indirect object.
 	 * @param prop Original property.
 	 * @param followRefs Flag for reference properties in complex type
@@ -1235,12 +1517,15 @@ public:
 	 * Next call of this function will overwrite older one.
 	 * </ul>
 	 * <br>
+	 * If page tree rebalancing is enabled (see setPageTreeFanout), page tree
+	 * is rebalanced by rebalancePageTree before changes are stored.
+	 * <br>
 	 * As a side effect sets change field to false
 	 *
 	 * @throw ReadOnlyDocumentException if mode is set to ReadOnly or we aren't
 	 * in the newest revision (where changes are enabled).
 	 */
-	void save(bool newRevision=false)const;
+	void save(bool newRevision=false);
 
 	/** Makes clone to file.
 	 * @param fname File handle, where to store content.
@@ -1366,6 +1651,46 @@ public:
 	 */
 	void removePage(size_t pos);
 
+	/** Rebuilds page tree to the balanced form.
+	 * @param maxKids Maximal number of Kids for intermediate nodes.
+	 *
+	 * Documents are often produced with one intermediate node which holds
+	 * all pages directly. Each change of such Kids array has to touch all its
+	 * members. This method places all pages under new intermediate nodes
+	 * with at most maxKids kids each so that the tree depth is logarithmic.
+	 * The page tree root dictionary is kept, its Kids array is replaced.
+	 * <br>
+	 * Nothing is done if no intermediate node has more than maxKids kids.
+	 * Nothing is done also if the page tree is ambiguous (some page or
+	 * intermediate node is referenced more times), because such page can't
+	 * have just one parent.
+	 * <br>
+	 * Inheritable attributes (Resources, MediaBox, CropBox and Rotate) of
+	 * all original intermediate nodes but the root are copied to pages which
+	 * don't have their own value, so that pages look the same way under new
+	 * nodes. Original intermediate nodes are not used anymore.
+	 * <br>
+	 * All pages returned by getPage keep their positions.
+	 *
+	 * @throw ReadOnlyDocumentException if mode is set to ReadOnly or we are in
+	 * older revision (where no changes are allowed).
+	 * @throw OutOfRange if maxKids is smaller than 2.
+	 * @return true if page tree has been rebuilt, false otherwise.
+	 */
+	bool rebalancePageTree(size_t maxKids=DEFAULT_PAGE_TREE_FANOUT);
+
+	/** Sets page tree rebalancing for save.
+	 * @param maxKids Maximal number of Kids for intermediate nodes (0 to
+	 * disable rebalancing).
+	 *
+	 * If set, save calls rebalancePageTree with given value before changes
+	 * are stored. Rebalancing is disabled by default.
+	 */
+	void setPageTreeFanout(size_t maxKids)
+	{
+		pageTreeFanout = maxKids;
+	}
+
 	/** Returns absolute position of given page.
 	 * @param page Page to look for.
 	 * 
@@ -1373,6 +1698,9 @@ public:
 	 * by this CPdf instance or it is no longer available, exception is thrown.
 	 * <br>
 	 * NOTE: instances are same if they are stand for same instance.
+	 * <br>
+	 * Position is found in pageIndex by the page dictionary reference so it
+	 * is logarithmic (pageList is searched only for ambiguous pages).
 	 *
 	 * @throw PageNotFoundException if given page is not recognized by CPdf
 	 * instance.
@@ -1381,8 +1709,8 @@ public:
 
 	/** Returnes total page count.
 	 *
-	 * Calculates (uses getKidsCount helper function) all direct pages under
-	 * page tree root node.
+	 * Returns number of all direct pages under page tree root node (size of
+	 * pageIndex which is built if necessary).
 	 * <br>
 	 * Note that if page tree root doesn't exists, it will return 0 rather than
 	 * error (exception) announcing.
@@ -1398,9 +1726,8 @@ public:
 	 * @param pos Position (starting from 1).
 	 *
 	 * At first tries to find page with given position in pageList. If found,
-	 * returns instance from list. Otherwise, searches page tree by findPageDict
-	 * helper function and if page dictionary is found, creates new CPage
-	 * instance and inserts new mapping (postion to CPage instance) to pageList.
+	 * returns instance from list. Otherwise, gets page dictionary reference
+	 * from pageIndex, creates new CPage instance and stores it to pageList.
 	 *
 	 * @throw PageNotFoundException if pos can't be found or out of range.
 	 * @return CPage instance wrapped by smart pointer.
@@ -26,6 +26,7 @@
 #include "xpdf/Object.h"
 #include "xpdf/encrypt_utils.h"
 #include "kernel/cxref.h"
+#include "kernel/cobjectsimple.h"
 #include "utils/debug.h"
 #include "kernel/factories.h"
 #include "kernel/pdfedit-core-dev.h"
@@ -52,7 +53,7 @@ void CXref::init()
 	internal_fetch = false;
 }
 
-CXref::CXref(BaseStream * stream):XRef(stream), internal_fetch(true)
+CXref::CXref(BaseStream * stream):XRef(stream), internal_fetch(true), changeStamp(0), indexed(false)
 {
 	try
 	{
@@ -64,6 +65,56 @@ CXref::CXref(BaseStream * stream):XRef(stream), internal_fetch(true)
 	}
 }
 
+CXref::CXref(BaseStream * stream, XRefLoading loading, XRefIndex * index)
+	:XRef(stream, (index)?xrefLoadDeferred:loading), internal_fetch(true), changeStamp(0), indexed(false)
+{
+	try
+	{
+		if(index && isOk())
+			initDeferred(index);
+		init();
+	}catch(...)
+	{
+		delete stream;
+		throw;
+	}
+}
+
+void CXref::initDeferred(XRefIndex * index)
+{
+	if(index->load())
+	{
+		const XRefIndex::Data & data=index->getData();
+		// index is bound to the file content but check also the xref
+		// position to be sure
+		if(data.lastXRefPos==lastXRefPos)
+		{
+			::Object * trailer=NULL;
+			try
+			{
+				trailer=utils::xpdfObjFromString(data.trailer, NULL);
+			}catch(MalformedFormatExeption &)
+			{
+				kernelPrintDbg(debug::DBG_WARN, "Unable to parse indexed trailer");
+			}
+			bool initialized=trailer && initFromEntries((Guint)data.lastXRefPos, 
+					&data.entries[0], (int)data.entries.size(),
+					(Guint)data.maxObj, trailer);
+			if(trailer)
+				xpdf::freeXpdfObject(trailer);
+			if(initialized)
+			{
+				indexed=true;
+				kernelPrintDbg(debug::DBG_INFO, "Xref initialized from index "<<index->getIndexName());
+				return;
+			}
+		}
+		kernelPrintDbg(debug::DBG_WARN, "Index "<<index->getIndexName()<<" doesn't describe the file");
+	}
+
+	XRef::initInternals(lastXRefPos);
+}
+
 void CXref::cleanUp()
 {
 	using namespace debug;
@@ -192,6 +243,8 @@ using namespace debug;
 		kernelPrintDbg(DBG_DBG, "newStorage entry changed to INITIALIZED_REF for "<<ref);
 	}
 	
+	++changeStamp;
+
 	// returns old version
 	return changed;
 }
@@ -240,6 +293,7 @@ using namespace debug;
 	if(prev)
 		gfree(key);
 
+	++changeStamp;
 	return prev;
 }
 
@@ -259,6 +313,9 @@ using namespace debug;
 	// Considers just first XRef::getNumObjects because entries array
 	// is allocated by blocks and so there are entries which are marked 
 	// as free but they are not realy removed objects.
+	// NOTE: XRef::getNumObjects reads all (lazily loaded) xref sections
+	// so that entries which are described only by older sections are not
+	// considered free
 	int objectCount=0, xrefCount=XRef::getNumObjects();
 	for(; i<size && i<MAXOBJNUM && objectCount<xrefCount; ++i)
 	{
@@ -420,7 +477,9 @@ using namespace debug;
 	}
 
 	kernelPrintDbg(DBG_DBG, "Reference is not in newStorage. Trying XRef.");
-	// object has to be in in XRef
+	// object has to be in in XRef - it may read older xref sections so
+	// the read lock is required
+	threads::ScopedLock lock(readMutex);
 	state=XRef::knowsRef(ref);
 	kernelPrintDbg(DBG_DBG, "Reference state in XRef is "<<state);
 	return state;
@@ -573,6 +632,7 @@ using namespace debug;
 	using namespace debug;
 
 	kernelPrintDbg(DBG_DBG, "num="<<num<<" gen="<<gen);
+	threads::ScopedLock lock(readMutex);
 	
 	// internal objects fetching don't require credentials.
 	// However we have to be very carefull where to enable
@@ -697,10 +757,12 @@ using namespace debug;
 	XRef::destroyInternals();
 	kernelPrintDbg(DBG_DBG, "Initializes XRef internals");
 	XRef::initInternals(xrefOff);
+	indexed=false;
 
 	// sets lastXRefPos to xrefOff, because initRevisionSpecific doesn't do it
 	lastXRefPos=xrefOff;
 	kernelPrintDbg(DBG_DBG, "New lastXRefPos value="<<lastXRefPos);
+	++changeStamp;
 
 	// checks encryption state for the revision
 	checkEncryptedContent();
@@ -31,6 +31,8 @@
 #include "kernel/static.h"
 
 #include "kernel/indiref.h"
+#include "kernel/xrefindex.h"
+#include "utils/mutex.h"
 
 namespace pdfobjects
 {
@@ -111,17 +113,40 @@ private:
 	 */
 	bool internal_fetch;
 
+	/** Lock for reading from the document.
+	 * xpdf parser shares one position in the underlying file stream (and
+	 * the object stream cache) so all reads have to be serialized.
+	 */
+	mutable threads::Mutex readMutex;
+
+	/** Change stamp of the document content.
+	 * Incremented each time when an object or the trailer is changed or
+	 * the xref is reopened (see getChangeStamp).
+	 */
+	size_t changeStamp;
+
+	/** Flag for xref initialized from the persistent index. */
+	bool indexed;
+
 	/** Core initialization for instance.
 	 * Called by constructor only.
 	 */
 	void init();
+
+	/** Initializes xpdf XRef in deferred loading mode.
+	 * @param index Persistent xref index (may be NULL).
+	 *
+	 * Uses data from the index if they are available and usable, otherwise
+	 * reads the most recent xref section (older ones are read on demand).
+	 */
+	void initDeferred(XRefIndex * index);
 protected:
 	/** Empty constructor.
 	 *
 	 * This constructor is protected to prevent uninitialized instances.
 	 * We need at least to specify stream with data.
 	 */
-	CXref(): XRef(NULL), needs_credentials(false), internal_fetch(false){}
+	CXref(): XRef(NULL), needs_credentials(false), internal_fetch(false), changeStamp(0), indexed(false){}
 
 	/** Entry for ChangedStorage.
 	 *
@@ -133,7 +158,7 @@ protected:
 		::Object * object;
 	} ObjectEntry;
 	
-	typedef ObjectStorage<const ::Ref, ObjectEntry*, xpdf::RefComparator> ChangedStorage;
+	typedef IndexedObjectStorage< ::Ref, ObjectEntry*, xpdf::RefComparator> ChangedStorage;
 
 	/** Object storage for changed objects.
 	 * Mapping from object referencies to the ObjectEntry structure.
@@ -142,7 +167,7 @@ protected:
 	 */
 	ChangedStorage changedStorage;   
 
-	typedef ObjectStorage<const ::Ref, RefState, xpdf::RefComparator> RefStorage;
+	typedef IndexedObjectStorage< ::Ref, RefState, xpdf::RefComparator> RefStorage;
 
 	/** Object storage for newly created objects.
 	 * Value is the flag of newly created reference. When new entry is added, it
@@ -347,6 +372,20 @@ public:
 	 */
 	CXref(BaseStream * stream);
 
+	/** Initialize constructor with xref loading mode.
+	 * @param stream Stream with file data.
+	 * @param loading Xref sections loading mode (xrefLoadLazy to read only 
+	 * the most recent xref section and older ones on demand).
+	 * @param index Persistent xref index (may be NULL). Data are loaded from
+	 * the index if it is valid for the stream. Index is used only by the 
+	 * constructor.
+	 *
+	 * Same as the constructor above otherwise. Note that indexed or lazy xref
+	 * reads all xref sections as soon as a complete xref table is required
+	 * (e.g. new object reference is reserved).
+	 */
+	CXref(BaseStream * stream, XRefLoading loading, XRefIndex * index=NULL);
+
 	/** Initialize constructor with cache.
 	 * @param stream Stream with file data.
 	 * @param c Cache instance.
@@ -476,6 +515,47 @@ public:
 	 */
 	virtual int getNumObjects()const; 
 
+	/** Returns lock for reading from the document.
+	 *
+	 * Everybody who reads from the document stream (parses objects or
+	 * decodes stream data which are not in memory) has to hold this lock
+	 * to make concurrent usage of the read-only document safe. fetch takes
+	 * it on its own and returns a copy, so objects it returns may be used
+	 * without the lock. Content streams are parsed from such copies and
+	 * they have their own lock (CPdf::getContentMutex). The lock is
+	 * recursive, so it is ok to call fetch while holding it.
+	 *
+	 * @return Mutex guarding the document stream.
+	 */
+	threads::Mutex& getReadMutex()const
+	{
+		return readMutex;
+	}
+
+	/** Returns change stamp of the document content.
+	 *
+	 * The value is different each time when the content visible through
+	 * this xref may have changed (object or trailer change, revision
+	 * change, reopen after save). Data derived from the document (e.g.
+	 * xpdf Catalog used for rendering) may be cached with this stamp and
+	 * reused as long as the stamp is the same.
+	 *
+	 * @return Current change stamp.
+	 */
+	size_t getChangeStamp()const
+	{
+		return changeStamp;
+	}
+
+	/** Checks whether the xref has been initialized from the index.
+	 * @return true if entries have been loaded from the persistent xref
+	 * index (see XRefIndex), false if they have been parsed from the file.
+	 */
+	bool isIndexed()const
+	{
+		return indexed;
+	}
+
 	/** Fetches object.
 	 * @param num Object number.
 	 * @param gen Object generation.
@@ -501,6 +581,8 @@ public:
 	 * document.
 	 * @return Pointer with initialized object given as parameter, if not
 	 * found obj is set to objNull.
+	 * <br>
+	 * The method holds read lock (see getReadMutex) during fetching.
 	 */
 	virtual ::Object * fetch(int num, int gen, ::Object *obj)const;
 };
@@ -79,6 +79,7 @@ class IPdfWriter;
  * Use static factory method for instance creation:
  * <pre>
  * // we will use OldStylePdfWriter IPdfWriter implementator
+ * // (XRefStreamPdfWriter produces smaller documents with object streams)
  * IPdfWriter * contentWriter=new OldStylePdfWriter();
  * boost::shared_ptr<Delinearizator> delinearizator=Delinearizator::getInstance(fileName, contentWriter);
  *
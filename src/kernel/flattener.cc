@@ -25,6 +25,7 @@
 #include "kernel/static.h" // WIN32 port - precompiled headers - REMOVE IN FUTURE!
 #include <errno.h>
 #include "kernel/flattener.h"
+#include "kernel/xrefwriter.h"
 #include "utils/debug.h"
 #include "kernel/streamwriter.h"
 #include "kernel/factories.h"
@@ -64,116 +65,6 @@ boost::shared_ptr<Flattener> Flattener::getInstance(const char * fileName, IPdfW
 			FileStreamDataDeleter<Flattener>(*streamData));
 }
 
-namespace {
-
-/** Equality operator for refList lookup.
- */
-bool operator==(const ::Ref& r1, const ::Ref& r2)
-{
-	return r1.num == r2.num && r1.gen== r2.gen;
-}
-
-bool containsRef(const Flattener::RefList & refList, const ::Ref& ref)
-{
-	Flattener::RefList::const_iterator i;
-	for(i=refList.begin(); i!=refList.end(); ++i)
-		if(*i == ref)
-			return true;
-	return false;
-}
-
-// fwd declaration
-void collectReachableRefs(::XRef& xref, const ::Object &obj, Flattener::RefList &refList);
-
-/** Helper function to find all references from given dictionary.
- * @param xref XRef table.
- * @param dict Dictionary to be examined.
- * @param refList List of already collected references.
- * 
- */
-void collectDictRefElems(::XRef &xref, const ::Dict &dict, Flattener::RefList &refList)
-{
-	boost::shared_ptr< ::Object> elem(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-	for(int i=0; i<dict.getLength(); i++)
-	{
-		if(!dict.getValNF(i, elem.get()))
-		{
-			utilsPrintDbg(debug::DBG_ERR, "Unable to get dictionary entry with index "<<i);
-			throw MalformedFormatExeption("bad data stream");
-		}
-		collectReachableRefs(xref, *elem, refList);
-		elem->free();
-	}
-}
-
-/** Collects all reachable objects from the given one.
- * @param xref XRef table.
- * @param obj Object to traverse.
- * @param refList List of alreadt collected references.
- *
- * Fills the given list with references which are recursively reachable 
- * from the given object.
- * <br>
- * If you start with the Trailer then you will collect all reachable 
- * objects.
- */
-void collectReachableRefs(XRef& xref, const ::Object &obj, Flattener::RefList &refList)
-{
-	switch(obj.getType())
-	{
-		case objArray:
-		{
-			boost::shared_ptr< ::Object> elem(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-			for(int i=0; i<obj.arrayGetLength(); i++)
-			{
-				if(!obj.arrayGetNF(i, elem.get()))
-				{
-					utilsPrintDbg(debug::DBG_ERR, "Unable to get array entry");
-					throw MalformedFormatExeption("bad data stream");
-				}
-				collectReachableRefs(xref, *elem, refList);
-				elem->free();
-			}
-			break;
-		}
-		case objDict:
-		{
-			const Dict *dict = obj.getDict();
-			collectDictRefElems(xref, *dict, refList);
-			break;
-		}
-		case objStream:
-		{
-			const Dict *streamDict = obj.streamGetDict();
-			collectDictRefElems(xref, *streamDict, refList);
-			break;
-		}
-		case objRef:
-		{
-			::Ref ref = obj.getRef();
-			// check for already seen referencies and skip them
-			if (containsRef(refList, ref))
-				return;
-			// TODO should be sorted by offset to keep the same
-			// ordering in the file as the original document
-			refList.push_back(ref);
-			boost::shared_ptr< ::Object> target(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-			if(!obj.fetch(&xref, target.get()) || !xref.isOk())
-			{
-				kernelPrintDbg(debug::DBG_ERR, ref<<" object fetching failed with code="
-						<<xref.getErrorCode());
-				throw MalformedFormatExeption("bad data stream");
-			}
-			collectReachableRefs(xref, *target, refList);
-			break;
-		}
-		default:
-			// nothing really interesting here
-			break;
-	}
-}
-} // annonymous namespace
-
 void Flattener::initReachableObjects()
 {
 	utilsPrintDbg(debug::DBG_DBG, "Creating a list of the reachable objects");
@@ -51,6 +51,7 @@ namespace utils
  * Use static factory method for instance creation:
  * <pre>
  * // we will use OldStylePdfWriter IPdfWriter implementator
+ * // (XRefStreamPdfWriter produces smaller documents with object streams)
  * IPdfWriter * contentWriter=new OldStylePdfWriter();
  * boost::shared_ptr<Flattener> flattener = Flattener::getInstance(fileName, contentWriter);
  *
@@ -70,7 +71,6 @@ namespace utils
 class Flattener: public PdfDocumentWriter
 {
 public:
-	// TODO maybe some more lookup efficient structure
 	typedef std::vector<Ref> RefList;
 
 	/** List of all reachable indirect objects.
@@ -95,8 +95,9 @@ public:
 protected:
 	/** Initializes all reachable objects.
 	 *
-	 * Starts with the Trailer and recursively travels all reachable
-	 * indirect objects which are stored in reachAbleRefs container.
+	 * Starts with the Trailer and travels all reachable indirect objects
+	 * which are stored in reachAbleRefs container ordered by their 
+	 * position in the file (see collectReachableRefs).
 	 */
 	void initReachableObjects();
 
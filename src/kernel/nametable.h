@@ -0,0 +1,238 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+#ifndef _NAMETABLE_H_
+#define _NAMETABLE_H_
+
+#include <string>
+#include <ostream>
+
+//=====================================================================================
+namespace pdfobjects {
+//=====================================================================================
+
+/**
+ * Process wide table of interned pdf names.
+ *
+ * Each distinct name is stored only once and is identified by an atom
+ * (pointer to its table entry). Same names used by many objects (e.g. /Type,
+ * /F1, /Im0 keys and operands) share one string and can be compared by their
+ * atoms.
+ *
+ * Entries are reference counted by Name handles. Entries which are not used
+ * any more are purged when new names are interned, so the table doesn't grow
+ * with names of already closed documents. Only interning and purging take
+ * the table lock, name strings of atoms held by Name handles are read
+ * without any lock.
+ */
+class NameTable
+{
+public:
+	/** Table entry of an interned name. */
+	struct Entry
+	{
+		/** Name string. */
+		std::string name;
+		/** Hash of the name (see hash). */
+		size_t hash;
+		/** Number of Name handles using the entry. */
+		mutable volatile long refs;
+	};
+
+	/** Name identifier. */
+	typedef const Entry* Atom;
+
+	/**
+	 * Get atom of the name.
+	 *
+	 * Name is added to the table if it is not present yet. Returned atom is
+	 * referenced and it has to be released by release.
+	 *
+	 * @param name Name.
+	 * @return Atom of the name.
+	 */
+	static Atom intern (const std::string& name);
+
+	/** \copydoc intern(const std::string&) */
+	static Atom intern (const char* name);
+
+	/**
+	 * Get atom of the name.
+	 *
+	 * @param name Name (doesn't have to be terminated).
+	 * @param len Length of the name.
+	 * @return Referenced atom of the name.
+	 */
+	static Atom intern (const char* name, size_t len);
+
+	/**
+	 * Get atom of the empty name.
+	 *
+	 * Empty name is never purged, so it is referenced without the table
+	 * lock.
+	 *
+	 * @return Referenced atom of the empty name.
+	 */
+	static Atom empty ();
+
+	/**
+	 * Add reference to the atom.
+	 *
+	 * @param atom Atom which is already referenced by the caller.
+	 */
+	static void acquire (Atom atom);
+
+	/**
+	 * Drop reference to the atom.
+	 *
+	 * Atom must not be used after its last reference has been dropped. Its
+	 * entry is deleted by the next purge.
+	 *
+	 * @param atom Referenced atom.
+	 */
+	static void release (Atom atom);
+
+	/**
+	 * Get hash of the name.
+	 *
+	 * Can be used to compare a string with names without interning it (see
+	 * Name::equals).
+	 *
+	 * @param name Name.
+	 * @return Hash of the name.
+	 */
+	static size_t hash (const std::string& name);
+
+	/**
+	 * Get name of the atom.
+	 *
+	 * @param atom Referenced atom.
+	 * @return Name stored in the table (reference is valid until the atom
+	 * is released).
+	 */
+	static const std::string& get (Atom atom)
+		{ return atom->name; }
+
+	/**
+	 * Get number of interned names (including not purged unused ones).
+	 */
+	static size_t size ();
+};
+
+
+/**
+ * Interned pdf name.
+ *
+ * Holds only a referenced atom from NameTable, so the copying and comparing
+ * names is a trivial operation. It can be used everywhere a constant string
+ * is expected.
+ */
+class Name
+{
+private:
+	/** Atom of the name. */
+	NameTable::Atom atom;
+
+public:
+	/** Empty name. */
+	Name () : atom (NameTable::empty ()) {}
+	/** Interns given name. */
+	explicit Name (const std::string& name) : atom (NameTable::intern (name)) {}
+	/** Interns given name. */
+	explicit Name (const char* name) : atom (NameTable::intern (name)) {}
+	/** Shares the atom of other name. */
+	Name (const Name& other) : atom (other.atom)
+		{ NameTable::acquire (atom); }
+	/** Releases the atom. */
+	~Name ()
+		{ NameTable::release (atom); }
+
+	/** Shares the atom of other name. */
+	Name& operator= (const Name& other)
+	{
+		NameTable::acquire (other.atom);
+		NameTable::release (atom);
+		atom = other.atom;
+		return *this;
+	}
+	/** Interns given name. */
+	Name& operator= (const std::string& name)
+		{ return assign (NameTable::intern (name)); }
+	/** Interns given name. */
+	Name& operator= (const char* name)
+		{ return assign (NameTable::intern (name)); }
+
+	/** Get atom of the name. */
+	NameTable::Atom getAtom () const
+		{ return atom; }
+
+	/** Get name string. */
+	const std::string& str () const
+		{ return NameTable::get (atom); }
+	/** Get name string. */
+	operator const std::string& () const
+		{ return str (); }
+
+	/**
+	 * Compares with given string.
+	 *
+	 * Doesn't access the table, so strings which are not names of any object
+	 * are not interned and no lock is taken.
+	 *
+	 * @param name String.
+	 * @param nameHash Hash of the string (see NameTable::hash).
+	 */
+	bool equals (const std::string& name, size_t nameHash) const
+		{ return atom->hash == nameHash && atom->name == name; }
+
+	/** Is equal. Compares atoms only. */
+	bool operator== (const Name& other) const
+		{ return atom == other.atom; }
+	/** Is not equal. Compares atoms only. */
+	bool operator!= (const Name& other) const
+		{ return atom != other.atom; }
+
+private:
+	/** Replaces atom by an already referenced one. */
+	Name& assign (NameTable::Atom other)
+	{
+		NameTable::release (atom);
+		atom = other;
+		return *this;
+	}
+};
+
+/** Prints the name string. */
+inline std::ostream&
+operator<< (std::ostream& out, const Name& name)
+{
+	return out << name.str ();
+}
+
+
+//=====================================================================================
+} // pdfobjects
+//=====================================================================================
+
+#endif  //_NAMETABLE_H_
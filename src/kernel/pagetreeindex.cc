@@ -0,0 +1,294 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#include "kernel/static.h"
+#include "kernel/pagetreeindex.h"
+#include "kernel/exceptions.h"
+
+namespace pdfobjects {
+
+void PageTreeIndex::deleteNode(Node * node)
+{
+	for(size_t i=0; i<node->children.size(); ++i)
+		deleteNode(node->children[i]);
+	delete node;
+}
+
+void PageTreeIndex::clear()
+{
+	if(root)
+		deleteNode(root);
+	root=NULL;
+	refMap.clear();
+}
+
+void PageTreeIndex::addRef(const IndiRef & ref, Node * block)
+{
+	RefMap::iterator i=refMap.find(ref);
+	if(i==refMap.end())
+	{
+		RefEntry entry={block, 1};
+		refMap.insert(RefMap::value_type(ref, entry));
+		return;
+	}
+	++i->second.occurrences;
+	i->second.block=block;
+}
+
+void PageTreeIndex::removeRef(const IndiRef & ref)
+{
+	RefMap::iterator i=refMap.find(ref);
+	if(i==refMap.end())
+		return;
+	if(!--i->second.occurrences)
+	{
+		refMap.erase(i);
+		return;
+	}
+	// block is not maintained for ambiguous references
+	if(i->second.occurrences==1)
+		i->second.block=findRef(root, ref);
+}
+
+PageTreeIndex::Node * PageTreeIndex::findRef(Node * node, const IndiRef & ref)
+{
+	if(!node)
+		return NULL;
+	if(node->leaf)
+		return (std::find(node->refs.begin(), node->refs.end(), ref)!=node->refs.end())?node:NULL;
+	for(size_t i=0; i<node->children.size(); ++i)
+	{
+		Node * block=findRef(node->children[i], ref);
+		if(block)
+			return block;
+	}
+	return NULL;
+}
+
+void PageTreeIndex::build(const std::vector<IndiRef> & refs)
+{
+	clear();
+	if(refs.empty())
+		return;
+
+	// leaf blocks are filled up to 3/4 so that following insertions don't
+	// split them immediately
+	const size_t fill=MAX_FANOUT*3/4;
+	std::vector<Node *> level;
+	for(size_t i=0; i<refs.size(); i+=fill)
+	{
+		Node * block=new Node(true);
+		size_t end=std::min(refs.size(), i+fill);
+		block->refs.assign(refs.begin()+i, refs.begin()+end);
+		block->count=block->refs.size();
+		for(size_t j=0; j<block->refs.size(); ++j)
+			addRef(block->refs[j], block);
+		level.push_back(block);
+	}
+
+	// builds intermediate levels until there is only one node
+	while(level.size()>1)
+	{
+		std::vector<Node *> upper;
+		for(size_t i=0; i<level.size(); i+=fill)
+		{
+			Node * node=new Node(false);
+			size_t end=std::min(level.size(), i+fill);
+			for(size_t j=i; j<end; ++j)
+			{
+				level[j]->parent=node;
+				node->count+=level[j]->count;
+				node->children.push_back(level[j]);
+			}
+			upper.push_back(node);
+		}
+		level.swap(upper);
+	}
+	root=level.front();
+}
+
+PageTreeIndex::Node * PageTreeIndex::findBlock(size_t & index)const
+{
+	Node * node=root;
+	while(!node->leaf)
+	{
+		size_t i=0;
+		// index equal to the node count is used for appending, so the last
+		// child takes it
+		for(; i+1<node->children.size() && index>=node->children[i]->count; ++i)
+			index-=node->children[i]->count;
+		node=node->children[i];
+	}
+	return node;
+}
+
+IndiRef PageTreeIndex::at(size_t index)const
+{
+	if(index>=size())
+		throw OutOfRange();
+	Node * block=findBlock(index);
+	return block->refs[index];
+}
+
+size_t PageTreeIndex::occurrences(const IndiRef & ref)const
+{
+	RefMap::const_iterator i=refMap.find(ref);
+	return (i==refMap.end())?0:i->second.occurrences;
+}
+
+bool PageTreeIndex::getPosition(const IndiRef & ref, size_t & index)const
+{
+	RefMap::const_iterator entry=refMap.find(ref);
+	if(entry==refMap.end() || entry->second.occurrences>1)
+		return false;
+
+	const Node * node=entry->second.block;
+	std::vector<IndiRef>::const_iterator i=std::find(node->refs.begin(), node->refs.end(), ref);
+	assert(i!=node->refs.end());
+	index=i-node->refs.begin();
+
+	// adds counts of all left siblings on the way to the root
+	while(node->parent)
+	{
+		const Node * parent=node->parent;
+		for(size_t j=0; parent->children[j]!=node; ++j)
+			index+=parent->children[j]->count;
+		node=parent;
+	}
+	return true;
+}
+
+void PageTreeIndex::updateCounts(Node * node, int difference)
+{
+	for(; node; node=node->parent)
+		node->count+=difference;
+}
+
+void PageTreeIndex::split(Node * node)
+{
+	while(node->leaf?(node->refs.size()>MAX_FANOUT):(node->children.size()>MAX_FANOUT))
+	{
+		Node * sibling=new Node(node->leaf);
+		if(node->leaf)
+		{
+			size_t half=node->refs.size()/2;
+			sibling->refs.assign(node->refs.begin()+half, node->refs.end());
+			node->refs.resize(half);
+			sibling->count=sibling->refs.size();
+			// moved references live in the new block now (ambiguous ones
+			// don't care)
+			for(size_t i=0; i<sibling->refs.size(); ++i)
+			{
+				RefMap::iterator entry=refMap.find(sibling->refs[i]);
+				if(entry->second.occurrences==1)
+					entry->second.block=sibling;
+			}
+		}else
+		{
+			size_t half=node->children.size()/2;
+			sibling->children.assign(node->children.begin()+half, node->children.end());
+			node->children.resize(half);
+			for(size_t i=0; i<sibling->children.size(); ++i)
+			{
+				sibling->children[i]->parent=sibling;
+				sibling->count+=sibling->children[i]->count;
+			}
+		}
+		node->count-=sibling->count;
+
+		if(!node->parent)
+		{
+			// root is split - tree grows
+			Node * newRoot=new Node(false);
+			newRoot->count=node->count+sibling->count;
+			newRoot->children.push_back(node);
+			node->parent=newRoot;
+			root=newRoot;
+		}
+		Node * parent=node->parent;
+		std::vector<Node *>::iterator pos=std::find(parent->children.begin(), parent->children.end(), node);
+		parent->children.insert(pos+1, sibling);
+		sibling->parent=parent;
+		node=parent;
+	}
+}
+
+void PageTreeIndex::removeEmpty(Node * node)
+{
+	while(node && !node->count)
+	{
+		Node * parent=node->parent;
+		if(!parent)
+		{
+			// whole tree is empty
+			deleteNode(node);
+			root=NULL;
+			return;
+		}
+		std::vector<Node *>::iterator pos=std::find(parent->children.begin(), parent->children.end(), node);
+		parent->children.erase(pos);
+		deleteNode(node);
+		node=parent;
+	}
+
+	// root with just one child is useless
+	while(root && !root->leaf && root->children.size()==1)
+	{
+		Node * child=root->children.front();
+		root->children.clear();
+		deleteNode(root);
+		child->parent=NULL;
+		root=child;
+	}
+}
+
+void PageTreeIndex::insert(size_t index, const IndiRef & ref)
+{
+	if(index>size())
+		throw OutOfRange();
+	if(!root)
+		root=new Node(true);
+
+	Node * block=findBlock(index);
+	block->refs.insert(block->refs.begin()+index, ref);
+	addRef(ref, block);
+	updateCounts(block, 1);
+	split(block);
+}
+
+void PageTreeIndex::remove(size_t index)
+{
+	if(index>=size())
+		throw OutOfRange();
+
+	Node * block=findBlock(index);
+	IndiRef ref=block->refs[index];
+	block->refs.erase(block->refs.begin()+index);
+	updateCounts(block, -1);
+	removeRef(ref);
+	removeEmpty(block);
+}
+
+} // namespace pdfobjects
@@ -0,0 +1,187 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _PAGETREEINDEX_H_
+#define _PAGETREEINDEX_H_
+
+#include "kernel/static.h"
+#include "kernel/indiref.h"
+
+/**
+ * @file pagetreeindex.h
+ *
+ * Index of page dictionaries in the document page order.
+ */
+
+namespace pdfobjects {
+
+/** Order statistic tree of page dictionary referencies.
+ *
+ * Keeps references of all leaf nodes of the page tree in the document order
+ * (page at position 1 is at index 0). Internally this is a B-tree where each
+ * node knows number of referencies in its subtree, so both position to
+ * reference and reference to position mapping is logarithmic, same as
+ * insertion and removal at given position.
+ * <br>
+ * The same page dictionary may be referenced more times from a (damaged)
+ * page tree. Such reference is ambiguous and position can't be determined
+ * for it (see getPosition).
+ * <br>
+ * Note that the index doesn't know anything about the page tree itself. It
+ * is filled and updated by CPdf.
+ */
+class PageTreeIndex: boost::noncopyable
+{
+	/** Maximal number of children (references in leaf blocks). */
+	static const size_t MAX_FANOUT = 64;
+
+	/** Tree node.
+	 *
+	 * Leaf blocks contain references, intermediate nodes contain children.
+	 */
+	struct Node
+	{
+		/** Parent node (NULL for root). */
+		Node * parent;
+		/** Number of references in the subtree. */
+		size_t count;
+		/** Children of intermediate node. */
+		std::vector<Node *> children;
+		/** References of leaf block. */
+		std::vector<IndiRef> refs;
+		/** Flag for leaf block. */
+		bool leaf;
+
+		Node(bool leafA):parent(NULL), count(0), leaf(leafA) {}
+	};
+
+	/** Ordering of references. */
+	struct RefLess
+	{
+		bool operator()(const IndiRef & one, const IndiRef & two)const
+		{
+			return (one.num == two.num) ? (one.gen < two.gen) : (one.num < two.num);
+		}
+	};
+
+	/** Location of reference in the tree.
+	 * Block is meaningful only if the reference is not ambiguous.
+	 */
+	struct RefEntry
+	{
+		Node * block;
+		size_t occurrences;
+	};
+	typedef std::map<IndiRef, RefEntry, RefLess> RefMap;
+
+	/** Root of the tree (NULL if empty). */
+	Node * root;
+
+	/** Reference to leaf block mapping. */
+	RefMap refMap;
+
+	/** Deallocates given subtree. */
+	static void deleteNode(Node * node);
+
+	/** Finds leaf block which contains given index.
+	 * @param index Index in the document order (updated to index in block).
+	 * @return leaf block.
+	 */
+	Node * findBlock(size_t & index)const;
+
+	/** Adds difference to the count of given node and all its ancestors. */
+	static void updateCounts(Node * node, int difference);
+
+	/** Splits given node if it is overfull. */
+	void split(Node * node);
+
+	/** Removes empty node from its parent (recursively). */
+	void removeEmpty(Node * node);
+
+	/** Registers reference in given block. */
+	void addRef(const IndiRef & ref, Node * block);
+
+	/** Unregisters one occurrence of reference. */
+	void removeRef(const IndiRef & ref);
+
+	/** Finds leaf block with given reference in the subtree (linear).
+	 * @return leaf block or NULL if not found.
+	 */
+	static Node * findRef(Node * node, const IndiRef & ref);
+public:
+	PageTreeIndex():root(NULL) {}
+	~PageTreeIndex()
+	{
+		clear();
+	}
+
+	/** Removes all references. */
+	void clear();
+
+	/** Initializes index with given references.
+	 * @param refs References of all pages in the document order.
+	 */
+	void build(const std::vector<IndiRef> & refs);
+
+	/** Returns number of pages. */
+	size_t size()const
+	{
+		return (root)?root->count:0;
+	}
+
+	/** Returns reference of page at given index.
+	 * @param index Page index (0 based).
+	 * @throw OutOfRange if index is not smaller than size().
+	 */
+	IndiRef at(size_t index)const;
+
+	/** Returns number of occurrences of the given reference. */
+	size_t occurrences(const IndiRef & ref)const;
+
+	/** Gets index of given reference.
+	 * @param ref Page dictionary reference.
+	 * @param index Where to store the index (0 based).
+	 * @return true if reference is in the index exactly once, false
+	 * otherwise (missing or ambiguous).
+	 */
+	bool getPosition(const IndiRef & ref, size_t & index)const;
+
+	/** Inserts reference to given index.
+	 * @param index Index of inserted reference (size() to append).
+	 * @param ref Page dictionary reference.
+	 * @throw OutOfRange if index is greater than size().
+	 */
+	void insert(size_t index, const IndiRef & ref);
+
+	/** Removes reference at given index.
+	 * @param index Page index (0 based).
+	 * @throw OutOfRange if index is not smaller than size().
+	 */
+	void remove(size_t index);
+};
+
+} // namespace pdfobjects
+
+#endif // _PAGETREEINDEX_H_
@@ -34,6 +34,8 @@
 #include "kernel/stateupdater.h"
 #include "kernel/factories.h"
 
+#include <boost/ref.hpp>
+
 //==========================================================
 namespace pdfobjects {
 //==========================================================
@@ -53,7 +55,8 @@ using namespace utils;
 //
 SimpleGenericOperator::SimpleGenericOperator (const char* opTxt, 
 											  const size_t numOper, 
-											  Operands& opers) : _opText (opTxt)
+											  Operands& opers,
+											  int opcode) : PdfOperator (opcode), _opText (opTxt)
 {
 		//utilsPrintDbg (debug::DBG_DBG, "Operator [" << opTxt << "] Operand size: " << numOper << " got " << opers.size());
 		assert (numOper >= opers.size());
@@ -79,7 +82,7 @@ SimpleGenericOperator::SimpleGenericOperator (const char* opTxt,
 //
 //
 SimpleGenericOperator::SimpleGenericOperator (const std::string& opTxt, 
-											  Operands& opers): _opText (opTxt)
+											  Operands& opers): PdfOperator (StateUpdater::findOpcode (opTxt)), _opText (opTxt)
 {
 		utilsPrintDbg (debug::DBG_DBG, opTxt);
 	//
@@ -629,7 +632,19 @@ void TextSimpleOperator::setRawText( std::string codeStr )
 //
 //
 UnknownCompositePdfOperator::UnknownCompositePdfOperator 
-	(const char* opBegin, const char* opEnd) : CompositePdfOperator (), _opBegin (opBegin), _opEnd (opEnd)
+	(const char* opBegin, const char* opEnd) 
+		: CompositePdfOperator (StateUpdater::findOpcode (opBegin)), _opBegin (opBegin), _opEnd (opEnd)
+{
+	utilsPrintDbg (DBG_DBG, "Unknown composite operator: " << _opBegin << " " << _opEnd);
+
+}
+
+//
+//
+//
+UnknownCompositePdfOperator::UnknownCompositePdfOperator 
+	(const char* opBegin, const char* opEnd, int opcode) 
+		: CompositePdfOperator (opcode), _opBegin (opBegin), _opEnd (opEnd)
 {
 	utilsPrintDbg (DBG_DBG, "Unknown composite operator: " << _opBegin << " " << _opEnd);
 
@@ -654,7 +669,7 @@ UnknownCompositePdfOperator::getStringRepresentation (string& str) const
 boost::shared_ptr<PdfOperator> 
 UnknownCompositePdfOperator::clone ()
 {
-	boost::shared_ptr<UnknownCompositePdfOperator> clone (new UnknownCompositePdfOperator(_opBegin,_opEnd));
+	boost::shared_ptr<UnknownCompositePdfOperator> clone (new UnknownCompositePdfOperator(_opBegin,_opEnd,getOpcode()));
 
 	for (PdfOperators::iterator it = _children.begin(); it != _children.end(); ++it)
 		clone->push_back ((*it)->clone(),getLastOperator(clone));
@@ -684,7 +699,7 @@ InlineImageCompositePdfOperator::getHeight() const
 //
 InlineImageCompositePdfOperator::InlineImageCompositePdfOperator 
 	(boost::shared_ptr<CInlineImage> im, const char* opBegin, const char* opEnd) 
-		: CompositePdfOperator (), _opBegin (opBegin), _opEnd (opEnd), _inlineimage (im)
+		: CompositePdfOperator (StateUpdater::findOpcode (opBegin)), _opBegin (opBegin), _opEnd (opEnd), _inlineimage (im)
 {
 	utilsPrintDbg (DBG_DBG, _opBegin << " " << _opEnd);
 }
@@ -753,42 +768,91 @@ InlineImageCompositePdfOperator::clone ()
 // Helper funcions
 //==========================================================
 
-boost::shared_ptr<PdfOperator> createOperator(const std::string& name, PdfOperator::Operands& operands)
-{
-	if (name == "BI")
-		throw NotImplementedException("Inline images not implemented here");
+namespace {
 
-	// Try to find the op by its name
-	const StateUpdater::CheckTypes* chcktp = StateUpdater::findOp (name.c_str());
-	// Operator not found, create unknown operator
-	if (NULL == chcktp)
-		return boost::shared_ptr<PdfOperator> (new SimpleGenericOperator (name ,operands));
-	
-	assert (chcktp);
-	utilsPrintDbg (DBG_DBG, "Operator found. " << chcktp->name);
-	// Check the type against specification
-	// 
-	if (!checkAndFixOperator (*chcktp, operands))
+	/** Creates operators on the heap. */
+	struct HeapOperatorMaker
+	{
+		template<typename Op, typename A1, typename A2>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2) const
+			{ return boost::shared_ptr<PdfOperator> (new Op (a1, a2)); }
+		template<typename Op, typename A1, typename A2, typename A3>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2, const A3& a3) const
+			{ return boost::shared_ptr<PdfOperator> (new Op (a1, a2, a3)); }
+		template<typename Op, typename A1, typename A2, typename A3, typename A4>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2, const A3& a3, const A4& a4) const
+			{ return boost::shared_ptr<PdfOperator> (new Op (a1, a2, a3, a4)); }
+	};
+
+	/** Creates operators (together with their reference counters) by an allocator. */
+	struct AllocOperatorMaker
 	{
-		//assert (!"Content stream bad operator type.");
-		throw ElementBadTypeException ("Content stream operator has incorrect operand type.");
+		const OperatorAllocator& alloc;
+		AllocOperatorMaker (const OperatorAllocator& a) : alloc (a) {}
+
+		template<typename Op, typename A1, typename A2>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2) const
+			{ return boost::allocate_shared<Op> (alloc, a1, a2); }
+		template<typename Op, typename A1, typename A2, typename A3>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2, const A3& a3) const
+			{ return boost::allocate_shared<Op> (alloc, a1, a2, a3); }
+		template<typename Op, typename A1, typename A2, typename A3, typename A4>
+		boost::shared_ptr<PdfOperator> make (const A1& a1, const A2& a2, const A3& a3, const A4& a4) const
+			{ return boost::allocate_shared<Op> (alloc, a1, a2, a3, a4); }
+	};
+
+	/** Creates operator using given maker. */
+	template<typename Maker>
+	boost::shared_ptr<PdfOperator> 
+	createOperatorWith (const Maker& maker, const std::string& name, PdfOperator::Operands& operands)
+	{
+		if (name == "BI")
+			throw NotImplementedException("Inline images not implemented here");
+
+		// Try to find the op by its name
+		const StateUpdater::CheckTypes* chcktp = StateUpdater::findOp (name.c_str());
+		// Operator not found, create unknown operator
+		if (NULL == chcktp)
+			return maker.template make<SimpleGenericOperator> (name, boost::ref (operands));
+		
+		assert (chcktp);
+		utilsPrintDbg (DBG_DBG, "Operator found. " << chcktp->name);
+		// Check the type against specification
+		// 
+		if (!checkAndFixOperator (*chcktp, operands))
+		{
+			//assert (!"Content stream bad operator type.");
+			throw ElementBadTypeException ("Content stream operator has incorrect operand type.");
+		}
+		
+		// Get operands count
+		size_t argNum = static_cast<size_t> ((chcktp->argNum > 0) ? chcktp->argNum : -chcktp->argNum);
+		// Operator code is known from the lookup
+		int opcode = StateUpdater::getOpcode (chcktp);
+
+		//
+		// If endTag is "" it is a simple operator, composite otherwise
+		// 
+		if (isTextOp(*chcktp))
+			return maker.template make<TextSimpleOperator> (chcktp->name, argNum, boost::ref (operands), opcode);
+
+		if (isSimpleOp(*chcktp))
+			return maker.template make<SimpleGenericOperator> (chcktp->name, argNum, boost::ref (operands), opcode);
+			
+		// Composite operator
+		return maker.template make<UnknownCompositePdfOperator> (chcktp->name, chcktp->endTag, opcode);
 	}
-	
-	// Get operands count
-	size_t argNum = static_cast<size_t> ((chcktp->argNum > 0) ? chcktp->argNum : -chcktp->argNum);
 
-	//
-	// If endTag is "" it is a simple operator, composite otherwise
-	// 
-	if (isTextOp(*chcktp))
-		return boost::shared_ptr<PdfOperator> (new TextSimpleOperator(chcktp->name, argNum, operands));
+} // namespace
 
-	if (isSimpleOp(*chcktp))
-		return boost::shared_ptr<PdfOperator> (new SimpleGenericOperator (chcktp->name, argNum, operands));
-		
-	// Composite operator
-	return boost::shared_ptr<PdfOperator> (new UnknownCompositePdfOperator (chcktp->name, chcktp->endTag));
+boost::shared_ptr<PdfOperator> createOperator(const std::string& name, PdfOperator::Operands& operands)
+{
+	return createOperatorWith (HeapOperatorMaker (), name, operands);
+}
 
+boost::shared_ptr<PdfOperator> createOperator(const std::string& name, PdfOperator::Operands& operands, const OperatorAllocator& alloc)
+{
+	return createOperatorWith (AllocOperatorMaker (alloc), name, operands);
 }
 
 boost::shared_ptr<PdfOperator> createOperator(const char *name, PdfOperator::Operands& operands)
@@ -29,6 +29,7 @@
 // static includes
 #include "kernel/pdfoperatorsbase.h"
 #include "kernel/pdfoperatorsiter.h"
+#include "utils/arena.h"
 
 //==========================================================
 namespace pdfobjects {
@@ -69,8 +70,16 @@ public:
 	 * @param numOper (Maximum) Number of operands.
 	 * @param opers This is a stack of operands from which we take number specified
 	 * 				by numOper or while any operand left.
+	 * @param opcode Operator code of opTxt (see PdfOperator::getOpcode).
+	 */
+	SimpleGenericOperator (const char* opTxt, const size_t numOper, Operands& opers, int opcode);
+	/** 
+	 * Constructor. 
+	 * Takes all operands, operator code is looked up by the name.
+	 *
+	 * @param opTxt Operator name text representation.
+	 * @param opers Operands (emptied).
 	 */
-	SimpleGenericOperator (const char* opTxt, const size_t numOper, Operands& opers);
 	SimpleGenericOperator (const std::string& opTxt, Operands& opers);
 
 	
@@ -85,6 +94,9 @@ public:
 	virtual void getParameters (Operands& container) const
 		{ copy (_operands.begin(), _operands.end(), back_inserter(container)); }
 
+	virtual const Operands* getOperands () const
+		{ return &_operands; }
+
 	virtual void getOperatorName (std::string& first) const
 		{ first = _opText;}
 	
@@ -148,8 +160,8 @@ protected:
 	
 public:
 	GfxFont* getCurrentFont()const;
-	TextSimpleOperator (const char* opTxt, const size_t numOper, Operands& opers)
-		:SimpleGenericOperator(opTxt, numOper, opers), fontData(NULL) {}
+	TextSimpleOperator (const char* opTxt, const size_t numOper, Operands& opers, int opcode)
+		:SimpleGenericOperator(opTxt, numOper, opers, opcode), fontData(NULL) {}
 	TextSimpleOperator(const std::string& opTxt, Operands& opers)
 		:SimpleGenericOperator(opTxt, opers), fontData(NULL) {}
 
@@ -235,11 +247,22 @@ public:
 	 * Constructor. 
 	 * Create it as a standalone object. Prev and Next are not valid.
 	 *
+	 * Operator code is looked up by the start operator name.
+	 *
 	 * @param opBegin_ Start operator name text representation.
 	 * @param opEnd_ End operator name text representation.
 	 */
 	UnknownCompositePdfOperator (const char* opBegin, const char* opEnd);
 
+	/** 
+	 * Constructor with already known operator code.
+	 *
+	 * @param opBegin_ Start operator name text representation.
+	 * @param opEnd_ End operator name text representation.
+	 * @param opcode Operator code of opBegin (see PdfOperator::getOpcode).
+	 */
+	UnknownCompositePdfOperator (const char* opBegin, const char* opEnd, int opcode);
+
 public:
 	// End operator is added to composite as normal operator so just prepand start operator
 	virtual void getStringRepresentation (std::string& str) const;
@@ -333,6 +356,21 @@ protected:
  */
 boost::shared_ptr<PdfOperator> createOperator(const std::string& name, PdfOperator::Operands& operands);
 
+/** Allocator used for operators created together with their content stream. */
+typedef ArenaAllocator<PdfOperator> OperatorAllocator;
+
+/** Factory function for operators creation.
+ * The same as createOperator(std::string&, PdfOperator::Operands&) but the
+ * operator and its reference counter are allocated by given allocator.
+ * @param name Opertor name.
+ * @param operands Operands for operator.
+ * @param alloc Allocator.
+ * @return Valid pdfoperator object.
+ * @throw ElementBadTypeException if operator or its operands are not valid.
+ * @throw NotImplementedException if given operator is inline image (BI).
+ */
+boost::shared_ptr<PdfOperator> createOperator(const std::string& name, PdfOperator::Operands& operands, const OperatorAllocator& alloc);
+
 /** Factory function for operators creation.
  * Transforms const char parameter to the string and delegates to 
  * createOperator(std::string&, PdfOperator::Operands&)
@@ -31,6 +31,7 @@
 #include "kernel/iproperty.h"
 
 #include "kernel/ccontentstream.h"
+#include "kernel/stateupdater.h"
 
 //==========================================================
 namespace pdfobjects {
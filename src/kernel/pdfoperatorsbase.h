@@ -111,11 +111,17 @@ public:
 private:
 	/** This enables mapping between pdfoperator and contentstream. */
 	CContentStream* _contentstream;
+	/** Operator code, see getOpcode(). */
+	const int _opcode;
 	
 	// Ctor & Dtor
 protected:
-	/** Constructor. */
-	PdfOperator () : _contentstream (NULL) {}
+	/** 
+	 * Constructor. 
+	 *
+	 * @param opcode Operator code (see getOpcode).
+	 */
+	explicit PdfOperator (int opcode) : _contentstream (NULL), _opcode (opcode) {}
 
 	// Destructor
 public:
@@ -156,6 +162,26 @@ public:
 	 */
 	virtual void getOperatorName (std::string& first) const = 0;
 
+	/**
+	 * Get the operator code.
+	 *
+	 * Operator code is set when the operator is created (operator name
+	 * never changes during operator's life).
+	 *
+	 * @return Index to StateUpdater::KNOWN_OPERATORS or
+	 * StateUpdater::UNKNOWN_OPCODE if the operator is not known.
+	 */
+	int getOpcode () const
+		{ return _opcode; }
+
+	/**
+	 * Get the parameters without copying them.
+	 *
+	 * @return Operands of the operator or NULL if the operator doesn't
+	 * keep them (use getParameters then).
+	 */
+	virtual const Operands* getOperands () const
+		{ return NULL; }
 	
 	//
 	// Composite interface
@@ -360,8 +386,12 @@ protected:
 	// Ctor & Dtor
 	//
 protected:
-	/** Constructor. */
-	CompositePdfOperator () {}
+	/** 
+	 * Constructor. 
+	 *
+	 * @param opcode Operator code (see PdfOperator::getOpcode).
+	 */
+	explicit CompositePdfOperator (int opcode) : PdfOperator (opcode) {}
 
 	/** Destructor. */
 	virtual ~CompositePdfOperator() {}
@@ -28,6 +28,7 @@
 #include "kernel/cobject.h"
 #include "kernel/streamwriter.h"
 #include "kernel/factories.h"
+#include "utils/thread.h"
 #include <zlib.h>
 
 /** Size of buffer for xref table row.
@@ -173,17 +174,83 @@ unsigned char * NullFilterStreamWriter::null_extractor(const Object&obj, size_t&
 	return buffer;
 }
 
-void NullFilterStreamWriter::compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const
+bool NullFilterStreamWriter::isRawCopyable(const Object& obj)
 {
 	assert(obj.isStream());
-	CharBuffer charBuffer;
-	size_t size=streamToCharBuffer(obj, ref, charBuffer, null_extractor);
-	if(!size)
+	// only streams parsed from the document file are based on the
+	// FileStream. Changed streams are created from the CStream buffer
+	// and so they are always based on MemStream
+	Stream* str = obj.getStream()->getBaseStream();
+	if(!str || str->getKind()!=strFile)
+		return false;
+	// file data of encrypted documents are encrypted as well and
+	// decryption is not part of the filter chain
+	const XRef * xref = obj.streamGetDict()->getXRef();
+	if(xref && xref->isEncrypted())
+		return false;
+	// streams without filters are compressed by the registered filter 
+	// writers same as before
+	std::vector<std::string> filters; 
+	return getFiltersFromStream(obj, filters) > 0;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+namespace {
+
+/** Gets mapped data of the given stream.
+ * @param obj Stream object.
+ *
+ * Data of streams based on MappedStream are available directly in the
+ * memory mapping of the document file, so they don't have to be extracted
+ * to a separate buffer.
+ *
+ * @return MappedStream of the stream or NULL if the stream data are not
+ * mapped.
+ */
+const MappedStream * getMappedStream(const Object & obj)
+{
+	const MappedStream * mapped = dynamic_cast<const MappedStream *>(
+			obj.getStream()->getBaseStream());
+	if(!mapped)
+		return NULL;
+	Object lengthObj;
+	obj.streamGetDict()->lookup("Length", &lengthObj);
+	if(!lengthObj.isInt() || lengthObj.getInt()<0)
 	{
-		utilsPrintDbg(debug::DBG_WARN, "zero size stream returned. Probably error in the the object");
-		return;
+		// let streamToCharBuffer to report the problem
+		lengthObj.free();
+		return NULL;
 	}
-	outStream.putLine(charBuffer.get(), size);
+	if((Guint)lengthObj.getInt() != mapped->getLength())
+		utilsPrintDbg(debug::DBG_WARN, "Retrieved stream doesn't have correct length. "
+				<<mapped->getLength()<<" bytes read but "<<lengthObj.getInt()<<" expected");
+	return mapped;
+}
+
+} // annonymous namespace
+#endif
+
+size_t NullFilterStreamWriter::encode(const Object& obj, Ref* ref, CharBuffer& buffer, UNUSED_PARAM bool use)const
+{
+	assert(obj.isStream());
+#ifdef HAVE_SYS_MMAN_H
+	// mapped data are copied only once directly to the result buffer
+	const MappedStream * mapped = getMappedStream(obj);
+	if(mapped)
+	{
+		std::string prefix, suffix;
+		size_t length = mapped->getLength();
+		streamFraming(obj, ref, length, prefix, suffix);
+		size_t size = prefix.length() + length + suffix.length();
+		char * buf = char_buffer_new(size);
+		buffer = CharBuffer(buf, char_buffer_delete());
+		memcpy(buf, prefix.data(), prefix.length());
+		memcpy(buf + prefix.length(), mapped->getData(), length);
+		memcpy(buf + prefix.length() + length, suffix.data(), suffix.length());
+		return size;
+	}
+#endif
+	return streamToCharBuffer(obj, ref, buffer, null_extractor);
 }
 
 void ZlibFilterStreamWriter::update_dict(const Object& obj)
@@ -205,6 +272,16 @@ boost::shared_ptr<ZlibFilterStreamWriter> ZlibFilterStreamWriter::getInstance()
 	return instance;
 }
 
+void ZlibFilterStreamWriter::setCompressionLevel(int level)
+{
+	if(level!=Z_DEFAULT_COMPRESSION && (level<Z_NO_COMPRESSION || level>Z_BEST_COMPRESSION))
+	{
+		utilsPrintDbg(debug::DBG_ERR, "Bad compression level="<<level);
+		throw OutOfRange();
+	}
+	compressionLevel = level;
+}
+
 bool ZlibFilterStreamWriter::supportObject(const Object& obj)const
 {
 	assert(obj.isStream());
@@ -246,7 +323,7 @@ unsigned char* ZlibFilterStreamWriter::deflate_buffer(unsigned char * in, size_t
 	}
 	z.next_out = out_buff; 
 	z.avail_out = out_size;
-	if ((ret = deflateInit(&z, Z_DEFAULT_COMPRESSION)) != Z_OK)
+	if ((ret = deflateInit(&z, compressionLevel)) != Z_OK)
 	{
 		utilsPrintDbg(debug::DBG_ERR, "deflateInit failed with ret="<<ret);
 		goto out_free_error;
@@ -324,27 +401,31 @@ out:
 	return deflateBuff;
 }
 
-void ZlibFilterStreamWriter::compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool decompress)const
+size_t ZlibFilterStreamWriter::encode(const Object& obj, Ref* ref, CharBuffer& buffer, bool decompress)const
 {
 	assert(obj.isStream());
-	CharBuffer charBuffer;
-	size_t size;
 	if (decompress)
-		size = streamToCharBuffer(obj,ref, charBuffer, convertStreamToDecodedData);
-	else
-		size = streamToCharBuffer(obj, ref, charBuffer, deflate);
+		return streamToCharBuffer(obj,ref, buffer, convertStreamToDecodedData);
+	return streamToCharBuffer(obj, ref, buffer, deflate);
+}
+
+void FilterStreamWriter::compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const
+{
+	assert(obj.isStream());
+	CharBuffer charBuffer;
+	size_t size=encode(obj, ref, charBuffer, use);
 	if(!size)
 	{
 		utilsPrintDbg(debug::DBG_WARN, "zero size stream returned. Probably error in the the object");
 		return;
 	}
 	outStream.putLine(charBuffer.get(), size);
-	return;
 }
 
 // initialization of static data for FilterStreamWriter classes
 boost::shared_ptr<NullFilterStreamWriter> NullFilterStreamWriter::instance;
 boost::shared_ptr<ZlibFilterStreamWriter> ZlibFilterStreamWriter::instance;
+int ZlibFilterStreamWriter::compressionLevel = Z_DEFAULT_COMPRESSION;
 boost::shared_ptr<FilterStreamWriter> FilterStreamWriter::defaultWriter;
 FilterStreamWriter::WritersList FilterStreamWriter::writers;
 
@@ -409,20 +490,28 @@ boost::shared_ptr<FilterStreamWriter> FilterStreamWriter::getInstance(const Obje
 		
 }
 
-/** Helper method for xpdf object writing to the stream.
- * @param obj Xpdf object to write.
+/** Helper method for xpdf object conversion to its pdf representation.
+ * @param obj Xpdf object to convert.
+ * @param buffer Buffer for the result.
  * @param ref Object's reference (NULL for indirect object).
- * @param stream Stream where to write.
  * @param indirect Flag for indirect object
+ * @param ignoreFilter Flag for writing decoded stream data.
  *
- * Creates correct pdf string representation of given object, adds indirect
- * header and footer if indirect flag is specified and writes everything to 
- * the given stream. 
+ * Creates correct pdf string representation of given object and adds
+ * indirect header and footer if indirect flag is specified. 
+ * <br>
+ * Streams which were not changed keep their encoded data and filters and 
+ * they are copied directly from the original file (see 
+ * NullFilterStreamWriter::isRawCopyable). Changed streams, streams without
+ * or with incorrect filters and streams of encrypted documents are encoded 
+ * by the appropriate FilterStreamWriter.
  * <br>
  * Given xpdf object data (like stream or string) can contain unprintable or 
  * 0 bytes.
+ *
+ * @return number of bytes in the buffer.
  */
-void writeObject(const ::Object & obj, StreamWriter & stream, ::Ref* ref, bool indirect,bool ignoreFilter)
+size_t objectToCharBuffer(const ::Object & obj, CharBuffer & buffer, ::Ref* ref, bool indirect,bool ignoreFilter)
 {
 using namespace boost;
 using namespace std;
@@ -434,37 +523,79 @@ using boost::shared_ptr;
 	{
 		shared_ptr<FilterStreamWriter> filter; 
 	
-		filter = FilterStreamWriter::getInstance(obj);
+		// unchanged streams are copied with their original filters
+		// unless we are asked to write decoded data
+		if(!ignoreFilter && NullFilterStreamWriter::isRawCopyable(obj))
+			filter = NullFilterStreamWriter::getInstance();
+		else
+			filter = FilterStreamWriter::getInstance(obj);
 		assert(filter->supportObject(obj));
-		filter->compress(obj, ref, stream, ignoreFilter);
-	}else
+		size_t size = filter->encode(obj, ref, buffer, ignoreFilter);
+		if(!size)
+			utilsPrintDbg(debug::DBG_WARN, "zero size stream returned. Probably error in the the object");
+		return size;
+	}
+
+	// converts xpdf object to cobject and gets correct string
+	// representation
+	scoped_ptr<IProperty> cobj_ptr(createObjFromXpdfObj(obj));
+	string objPdfFormat;
+	cobj_ptr->getStringRepresentation(objPdfFormat);
+	
+	if(indirect)
 	{
-		// converts xpdf object to cobject and gets correct string
-		// representation
-		scoped_ptr<IProperty> cobj_ptr(createObjFromXpdfObj(obj));
-		string objPdfFormat;
-		cobj_ptr->getStringRepresentation(objPdfFormat);
-		
-		if(indirect)
+		// we have to add some more information to write indirect
+		// object (this includes header and footer)
+		std::string indirectFormat;
+		IndiRef indiRef(*ref);
+		createIndirectObjectStringFromString(indiRef, objPdfFormat, indirectFormat);
+		objPdfFormat = indirectFormat;
+	}
+
+	// indirectFormat may contain 0 bytes, so we can't use c_str()
+	// method and have to copy all bytes to the CharBuffer (which also
+	// handles correct deallocation)
+	size_t bufSize=objPdfFormat.length();
+	char * buf=char_buffer_new(bufSize);
+	buffer = CharBuffer(buf, char_buffer_delete());
+	for(size_t i=0; i<bufSize; i++)
+		buf[i]=objPdfFormat[i];
+	return bufSize;
+}
+
+/** Helper method for xpdf object writing to the stream.
+ * @param obj Xpdf object to write.
+ * @param stream Stream where to write.
+ * @param ref Object's reference (NULL for indirect object).
+ * @param indirect Flag for indirect object
+ * @param ignoreFilter Flag for writing decoded stream data.
+ *
+ * Writes data prepared by objectToCharBuffer to the given stream.
+ */
+void writeObject(const ::Object & obj, StreamWriter & stream, ::Ref* ref, bool indirect,bool ignoreFilter)
+{
+#ifdef HAVE_SYS_MMAN_H
+	// unchanged mapped streams are written directly from the mapping
+	// without any intermediate buffer. CSTREAM_HEADER ends and
+	// CSTREAM_FOOTER starts with EOL which is supplied by putLine.
+	if(obj.isStream() && !ignoreFilter && NullFilterStreamWriter::isRawCopyable(obj))
+	{
+		const MappedStream * mapped = getMappedStream(obj);
+		if(mapped)
 		{
-			// we have to add some more information to write indirect
-			// object (this includes header and footer)
-			std::string indirectFormat;
-			IndiRef indiRef(*ref);
-			createIndirectObjectStringFromString(indiRef, objPdfFormat, indirectFormat);
-			objPdfFormat = indirectFormat;
+			std::string prefix, suffix;
+			streamFraming(obj, ref, mapped->getLength(), prefix, suffix);
+			stream.putLine(prefix.data(), prefix.length()-1);
+			stream.putLine(mapped->getData(), mapped->getLength());
+			stream.putLine(suffix.data()+1, suffix.length()-1);
+			return;
 		}
-
-		// indirectFormat may contain 0 bytes, so we can't use c_str()
-		// method and have to copy all bytes to the CharBuffer (which also
-		// handles correct deallocation)
-		size_t bufSize=objPdfFormat.length();
-		char * buf=char_buffer_new(bufSize);
-		CharBuffer charBuffer(buf, char_buffer_delete());
-		for(size_t i=0; i<bufSize; i++)
-			buf[i]=objPdfFormat[i];
-		stream.putLine(buf, bufSize);
 	}
+#endif
+	CharBuffer buffer;
+	size_t size = objectToCharBuffer(obj, buffer, ref, indirect, ignoreFilter);
+	if(size)
+		stream.putLine(buffer.get(), size);
 }
 
 void IPdfWriter::writeHeader(const char* version, StreamWriter &stream)
@@ -490,6 +621,215 @@ void IPdfWriter::writeHeader(const char* version, StreamWriter &stream)
 	stream.putLine(buffer, strlen(buffer));
 }
 
+namespace {
+
+/** Object prepared for writing by ObjectEncoder.
+ */
+struct EncodedObject
+{
+	/** Object's reference. */
+	::Ref ref;
+	/** Object to encode. */
+	const Object * obj;
+	/** Pdf representation of the object. */
+	CharBuffer buffer;
+	/** Number of bytes in buffer. */
+	size_t size;
+	/** Flag set when the object has been processed. */
+	bool done;
+	/** Flag set when the encoding failed. */
+	bool failed;
+	/** Error message if the encoding failed. */
+	std::string error;
+};
+
+/** Objects shared by ObjectEncoder workers and writeContent.
+ * All fields except for objects content are protected by mutex. 
+ * EncodedObject fields are owned by the worker which took the object until
+ * it sets done flag.
+ */
+struct EncodeQueue
+{
+	typedef std::vector<EncodedObject> Objects;
+	/** Objects to encode in the output order. */
+	Objects objects;
+	/** Index of the first object which hasn't been taken by a worker. */
+	size_t next;
+	/** Number of objects already written. */
+	size_t written;
+	/** Maximum number of encoded objects waiting for writing. */
+	size_t window;
+	/** Flag for writing decoded stream data. */
+	bool ignoreFilter;
+	threads::Mutex mutex;
+	/** Signaled when an object is done or written. */
+	threads::Condition cond;
+
+	EncodeQueue(bool ignore, size_t windowSize)
+		:next(0), written(0), window(windowSize), ignoreFilter(ignore) {}
+
+	/** Stops all workers. Objects which are already taken are finished.
+	 */
+	void stop()
+	{
+		threads::ScopedLock lock(mutex);
+		next=objects.size();
+		cond.broadcast();
+	}
+};
+
+/** Mutex for streams which don't belong to a CXref.
+ */
+threads::Mutex fallbackReadMutex;
+
+/** Gets mutex which protects file reading for the given object.
+ * @param obj Object to be encoded.
+ *
+ * Streams based on FileStream share the file handle with the whole document
+ * so they have to be read under the same lock as CXref uses.
+ *
+ * @return mutex or NULL if the object doesn't read any file data.
+ */
+threads::Mutex * getSourceMutex(const Object & obj)
+{
+	if(!obj.isStream())
+		return NULL;
+	Stream * str = obj.getStream()->getBaseStream();
+	if(!str || str->getKind()!=strFile)
+		return NULL;
+#ifdef HAVE_SYS_MMAN_H
+	// mapped data are read without touching the file handle
+	if(dynamic_cast<MappedStream *>(str))
+		return NULL;
+#endif
+	const CXref * cxref = dynamic_cast<const CXref *>(obj.streamGetDict()->getXRef());
+	if(cxref)
+		return &cxref->getReadMutex();
+	return &fallbackReadMutex;
+}
+
+/** Creates copy of the stream object which doesn't read the document file.
+ * @param obj Stream object based on the document file.
+ *
+ * Reads encoded data of the stream to the memory and builds the same filter
+ * chain on top of them, so that the copy can be decoded and compressed
+ * without holding the source mutex (see getSourceMutex). Has to be called
+ * with the source mutex held.
+ *
+ * @return new stream object (deallocate by xpdf::freeXpdfObject) or NULL
+ * if the stream can't be copied (encrypted document or read error).
+ */
+::Object * detachStream(const ::Object & obj)
+{
+	// decryption is not part of the filter chain from the dictionary
+	const XRef * xref = obj.streamGetDict()->getXRef();
+	if(xref && xref->isEncrypted())
+		return NULL;
+
+	Object lengthObj;
+	obj.streamGetDict()->lookup("Length", &lengthObj);
+	size_t length = (lengthObj.isInt() && lengthObj.getInt()>0)?(size_t)lengthObj.getInt():0;
+	lengthObj.free();
+	size_t size;
+	unsigned char * data = bufferFromStream(*obj.getStream()->getBaseStream(), length, size);
+	if(!data)
+		return NULL;
+	// MemStream deallocates its buffer by gfree
+	char * buffer = (char *)gmalloc((int)(size+1));
+	memcpy(buffer, data, size);
+	free(data);
+
+	Object dictObj;
+	dictObj.initDict((Dict *)obj.streamGetDict());
+	Object * cloneDict = dictObj.clone();
+	dictObj.free();
+	MemStream * memStream = new MemStream(buffer, 0, (Guint)size, cloneDict, true);
+	// MemStream uses shallow copy of stream dictionary (see MemStream::clone)
+	gfree(cloneDict);
+	dictObj.initDict((Dict *)memStream->getDict());
+	Stream * str = memStream->addFilters(&dictObj);
+	dictObj.free();
+
+	::Object * result = XPdfObjectFactory::getInstance();
+	result->initStream(str);
+	return result;
+}
+
+/** Worker thread which converts objects from EncodeQueue to their pdf 
+ * representation.
+ */
+class ObjectEncoder: public threads::Thread
+{
+	EncodeQueue & queue;
+public:
+	ObjectEncoder(EncodeQueue & q):queue(q) {}
+
+	/** Encodes objects until the queue is empty.
+	 */
+	void encode()
+	{
+		for(;;)
+		{
+			size_t index;
+			{
+				threads::ScopedLock lock(queue.mutex);
+				// don't run too far ahead of the writer
+				while(queue.next<queue.objects.size() && 
+						queue.next>=queue.written+queue.window)
+					queue.cond.wait(queue.mutex);
+				if(queue.next>=queue.objects.size())
+					return;
+				index=queue.next++;
+			}
+
+			EncodedObject & item = queue.objects[index];
+			::Object * detached = NULL;
+			threads::Mutex * source = getSourceMutex(*item.obj);
+			if(source)
+			{
+				source->lock();
+				// raw copy only reads the file, other streams are
+				// decoded and compressed from their copy without the lock
+				if(queue.ignoreFilter || !NullFilterStreamWriter::isRawCopyable(*item.obj))
+					detached = detachStream(*item.obj);
+				if(detached)
+				{
+					source->unlock();
+					source = NULL;
+				}
+			}
+			try
+			{
+				item.size = objectToCharBuffer((detached)?*detached:*item.obj, 
+						item.buffer, &item.ref, true, queue.ignoreFilter);
+			}catch(std::exception & e)
+			{
+				item.failed = true;
+				item.error = e.what();
+			}catch(...)
+			{
+				item.failed = true;
+				item.error = "unknown error";
+			}
+			if(source)
+				source->unlock();
+			if(detached)
+				xpdf::freeXpdfObject(detached);
+
+			threads::ScopedLock lock(queue.mutex);
+			item.done=true;
+			queue.cond.broadcast();
+		}
+	}
+protected:
+	virtual void run()
+	{
+		encode();
+	}
+};
+
+} // annonymous namespace
+
 const std::string OldStylePdfWriter::CONTENT = "Content phase"; 
 const std::string OldStylePdfWriter::TRAILER = "XREF/TRAILER phase";
 
@@ -505,6 +845,12 @@ using namespace boost;
 	if(off)
 		stream.setPos(off);
 
+	if(workers>1 && objectList.size()>1)
+	{
+		writeContentParallel(objectList, stream);
+		return;
+	}
+
 	ObjectList::const_iterator i;
 	size_t index=0;
 	
@@ -580,6 +926,122 @@ void stripXRefStreamFields(const Object &trailer)
 	}
 }
 
+/** Helper function for trailer update for a new cross reference section.
+ * @param trailer Trailer dictionary.
+ * @param prevSection Context for previous section.
+ * @param size Value for the Size entry.
+ *
+ * Sets Prev entry to the previous section (or removes it if there is no 
+ * previous section), removes XRefStm and all cross reference stream entries
+ * and sets Size entry.
+ */
+void updateTrailer(const Object &trailer, const IPdfWriter::PrevSecInfo &prevSection, size_t size)
+{
+	using namespace debug;
+
+	// updates Prev field - to say where previous xref table starts
+	// if 0, removes Prev entry if present
+	if(!prevSection.xrefPos)
+	{
+		// FIXME prepare for stream trailers - we don't have this
+		// problem at the moment, becayse we don't create such 
+		// trailers and the first one never contains Prev. However
+		// this can be problem if we had incremental update from 
+		// other party which uses stream trailers for all.
+		Object * prev=trailer.dictDel("Prev");
+		if(prev)
+			xpdf::freeXpdfObject(prev);
+		utilsPrintDbg(DBG_DBG, "No previous xref section. Removing Trailer::Prev.");
+	}else
+	{
+		Object newPrev;
+		newPrev.initInt((int)prevSection.xrefPos);
+		char * key=copyString("Prev");
+		Object * originalPrev=trailer.dictUpdate(key, &newPrev);
+		if(originalPrev)
+		{
+			// value has been set to something different, we have to deallocate it
+			// and to free key, because it is not stored in update
+			utilsPrintDbg(DBG_DBG, "Removing old Trailer::Prev="<<originalPrev->getInt());
+			free(key);
+			xpdf::freeXpdfObject(originalPrev);
+		}
+		utilsPrintDbg(DBG_DBG, "Linking to previous xref section. Trailer::Prev="<<newPrev.getInt());
+	}
+
+	// hybrid xref files can contain both xref table and xref stream
+	// in such a case startxref points to xreftable and trailer::XrefStm
+	// to the additional objects in xref stream. PDF>=1.5 capable readers
+	// reads both of them and so we have to remove XRefStm for later 
+	// revisions to prevent from confusions.
+	Object * xrefStm = trailer.dictDel("XRefStm");
+	if(xrefStm)
+	{
+		utilsPrintDbg(DBG_DBG, "Removing old Trailer::XRefStm.");
+		xpdf::freeXpdfObject(xrefStm);
+	}
+
+	// some documents (e.g. those generated by Word with Acrobad 9 pdf printer)
+	// generate strange xref layout (xref table with trailer containig additional
+	// fields valid for trailer stream dictionary which references the xref stream
+	// by means of Prev field). We have to strip all those fields to provide a 
+	// proper document
+	stripXRefStreamFields(trailer);
+
+	// sets Size entry
+	Object newSize;
+	newSize.initInt((int)size);
+	char * key=copyString("Size");
+	Object * originalSize=trailer.dictUpdate(key, &newSize);
+	if(originalSize)
+	{
+		// value has been set to something different, we have to deallocate it
+		// and to free key, because it is not stored in update
+		utilsPrintDbg(DBG_DBG, "Removing old Trailer::Size="<<originalSize->getInt());
+		gfree(key);
+		xpdf::freeXpdfObject(originalSize);
+	}
+	utilsPrintDbg(DBG_DBG, "Setting Trailer::Size="<<newSize.getInt());
+}
+
+/** Helper function for revision end writing.
+ * @param xrefPos Position of the cross reference section.
+ * @param stream Stream writer where to write.
+ *
+ * Writes startxref with given position and %%EOF marker and removes all data
+ * behind the marker.
+ * @return stream position of the %%EOF marker.
+ */
+size_t writeRevisionEnd(size_t xrefPos, StreamWriter & stream)
+{
+	using namespace debug;
+
+	// stores offset of last (created one) xref table
+	stream.putLine(STARTXREF_KEYWORD, strlen(STARTXREF_KEYWORD));
+	char xrefPosStr[128];
+	sprintf(xrefPosStr, "%u", (unsigned int)xrefPos);
+	stream.putLine(xrefPosStr, strlen(xrefPosStr));
+	
+	// Finaly puts %%EOF behind but keeps position of marker start
+	size_t pos=stream.getPos();
+	stream.putLine(EOFMARKER, strlen(EOFMARKER));
+	kernelPrintDbg(DBG_DBG, "PDF end of file marker saved");
+
+	// stream may contain some non sense information behind, so they has to be
+	// cleaned.
+	size_t currPos=stream.getPos();
+	stream.setPos(0, -1);
+	size_t eofPos=stream.getPos();
+	if(eofPos>currPos)
+	{
+		size_t size=eofPos-currPos;
+		kernelPrintDbg(DBG_DBG, "Cleaning pending ("<<size<<"B) data behind stored revision.");
+		stream.trim(currPos);
+	}
+
+	return pos;
+}
+
 size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo &prevSection, StreamWriter & stream, size_t off)
 {
 	using namespace std;
@@ -720,108 +1182,460 @@ size_t OldStylePdfWriter::writeTrailer(const Object & trailer,const PrevSecInfo
 		notifyObservers(newValue, context);
 	}
 
-	// updates Prev field - to say where previous xref table starts
-	// if 0, removes Prev entry if present
-	if(!prevSection.xrefPos)
+	// updates trailer for this section
+	updateTrailer(trailer, prevSection, 
+			std::max(prevSection.entriesNum, (size_t)(maxObjNum + 1)));
+
+	// stores changed trailer to the file
+	stream.putLine(TRAILER_KEYWORD, strlen(TRAILER_KEYWORD));
+	writeObject(trailer, stream, NULL, false, ignore_stream_);
+	kernelPrintDbg(DBG_DBG, "Trailer saved");
+
+	size_t pos=writeRevisionEnd(xrefPos, stream);
+	lastXRefPos=xrefPos;
+
+	// resets internal data
+	reset();
+
+	return pos;
+}
+
+void OldStylePdfWriter::writeContentParallel(const ObjectList & objectList, StreamWriter & stream)
+{
+using namespace debug;
+using namespace boost;
+
+	// window of 4 objects per worker keeps all workers busy while 
+	// big streams are written without holding the whole batch in memory
+	EncodeQueue queue(ignore_stream_, 4*workers);
+
+	// prepares objects in the same way as the serial writer does
+	OffsetTab queued;
+	ObjectList::const_iterator i;
+	for(i=objectList.begin(); i!=objectList.end(); ++i)
 	{
-		// FIXME prepare for stream trailers - we don't have this
-		// problem at the moment, becayse we don't create such 
-		// trailers and the first one never contains Prev. However
-		// this can be problem if we had incremental update from 
-		// other party which uses stream trailers for all.
-		Object * prev=trailer.dictDel("Prev");
-		if(prev)
-			xpdf::freeXpdfObject(prev);
-		utilsPrintDbg(DBG_DBG, "No previous xref section. Removing Trailer::Prev.");
-	}else
+		::Ref ref=i->first;
+		Object * obj=i->second;
+		if(!obj)
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is not valid. Skipping.");
+			continue;
+		}
+		if(offTable.find(ref)!=offTable.end() || queued.find(ref)!=queued.end())
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is already stored. Skipping.");
+			continue;
+		}
+		queued.insert(OffsetTab::value_type(ref, 0));
+		if(ref.num>maxObjNum)
+			maxObjNum=ref.num;
+
+		EncodedObject item;
+		item.ref=ref;
+		item.obj=obj;
+		item.size=0;
+		item.done=false;
+		item.failed=false;
+		queue.objects.push_back(item);
+	}
+
+	// shared instances are created lazily so make sure they exist
+	// before workers start
+	NullFilterStreamWriter::getInstance();
+
+	typedef std::vector<shared_ptr<ObjectEncoder> > Encoders;
+	Encoders encoders;
+	size_t count=std::min(workers, queue.objects.size());
+	for(size_t w=0; w<count; ++w)
 	{
-		Object newPrev;
-		newPrev.initInt(prevSection.xrefPos);
-		char * key=copyString("Prev");
-		Object * originalPrev=trailer.dictUpdate(key, &newPrev);
-		if(originalPrev)
+		shared_ptr<ObjectEncoder> encoder(new ObjectEncoder(queue));
+		if(!encoder->start())
 		{
-			// value has been set to something different, we have to deallocate it
-			// and to free key, because it is not stored in update
-			utilsPrintDbg(DBG_DBG, "Removing old Trailer::Prev="<<originalPrev->getInt());
-			free(key);
-			xpdf::freeXpdfObject(originalPrev);
+			utilsPrintDbg(DBG_WARN, "Unable to start encoder thread. Using "<<encoders.size()<<" workers.");
+			break;
 		}
-		utilsPrintDbg(DBG_DBG, "Linking to previous xref section. Trailer::Prev="<<newPrev.getInt());
+		encoders.push_back(encoder);
+	}
+	if(encoders.empty())
+	{
+		// no thread available, encodes everything by ourselves. Window
+		// is not used because nothing is written in the meantime
+		queue.window=queue.objects.size();
+		ObjectEncoder(queue).encode();
 	}
 
-	// hybrid xref files can contain both xref table and xref stream
-	// in such a case startxref points to xreftable and trailer::XrefStm
-	// to the additional objects in xref stream. PDF>=1.5 capable readers
-	// reads both of them and so we have to remove XRefStm for later 
-	// revisions to prevent from confusions.
-	Object * xrefStm = trailer.dictDel("XRefStm");
-	if(xrefStm)
+	try
 	{
-		utilsPrintDbg(DBG_DBG, "Removing old Trailer::XRefStm.");
-		xpdf::freeXpdfObject(xrefStm);
+		for(size_t index=0; index<queue.objects.size(); ++index)
+		{
+			EncodedObject & item=queue.objects[index];
+			{
+				threads::ScopedLock lock(queue.mutex);
+				while(!item.done)
+					queue.cond.wait(queue.mutex);
+			}
+			if(item.failed)
+			{
+				utilsPrintDbg(DBG_ERR, "Unable to write object with "<<item.ref<<". Cause="<<item.error);
+				throw MalformedFormatExeption(item.error);
+			}
+
+			// associate given reference with current position.
+			size_t objPos=stream.getPos();
+			offTable.insert(OffsetTab::value_type(item.ref, objPos));
+			if(item.size)
+				stream.putLine(item.buffer.get(), item.size);
+			item.buffer.reset();
+			utilsPrintDbg(DBG_DBG, "Object with "<<item.ref<<" stored at offset="<<objPos);
+
+			threads::ScopedLock lock(queue.mutex);
+			queue.written=index+1;
+			queue.cond.broadcast();
+		}
+	}catch(...)
+	{
+		// workers have to finish before queue is destroyed
+		queue.stop();
+		for(Encoders::iterator e=encoders.begin(); e!=encoders.end(); ++e)
+			(*e)->join();
+		throw;
 	}
+	for(Encoders::iterator e=encoders.begin(); e!=encoders.end(); ++e)
+		(*e)->join();
+	
+	utilsPrintDbg(DBG_DBG, "All objects (number="<<queue.objects.size()<<") stored by "
+			<<encoders.size()<<" workers.");
+}
 
-	// some documents (e.g. those generated by Word with Acrobad 9 pdf printer)
-	// generate strange xref layout (xref table with trailer containig additional
-	// fields valid for trailer stream dictionary which references the xref stream
-	// by means of Prev field). We have to strip all those fields to provide a 
-	// proper document
-	stripXRefStreamFields(trailer);
+void OldStylePdfWriter::reset()
+{
+	offTable.clear();
+	maxObjNum=0;
+}
 
-	// sets Size entry with the maximum from the original entries count and 
-	// the highest changed object reference number
-	Object newSize;
-	newSize.initInt(std::max(prevSection.entriesNum, (size_t)(maxObjNum + 1)));
-	char * key=copyString("Size");
-	Object * originalSize=trailer.dictUpdate(key, &newSize);
-	if(originalSize)
+namespace {
+
+/** Helper function to write stream object with already encoded data.
+ * @param ref Reference of the stream object.
+ * @param dict Stream dictionary without Length entry.
+ * @param data Stream data.
+ * @param size Number of bytes in data.
+ * @param stream Stream writer where to write.
+ */
+void writeEncodedStream(const ::Ref & ref, Object & dict, const char * data, size_t size, StreamWriter & stream)
+{
+	Object length;
+	length.initInt((int)size);
+	dict.dictAdd(copyString("Length"), &length);
+
+	std::string dictStr;
+	xpdfObjToString(dict, dictStr);
+
+	std::ostringstream header;
+	header << ref << " " << Specification::INDIRECT_HEADER << "\n";
+	std::string output = header.str();
+	output += dictStr;
+	output += Specification::CSTREAM_HEADER;
+	output.append(data, size);
+	output += Specification::CSTREAM_FOOTER;
+	output += Specification::INDIRECT_FOOTER;
+	stream.putLine(output.data(), output.length());
+}
+
+/** Helper function to compress stream data.
+ * @param data Data to compress.
+ * @param dict Stream dictionary where to set Filter entry.
+ * @param size Size of the returned data.
+ *
+ * @return allocated compressed buffer with Filter set in the dict or NULL
+ * if data couldn't be compressed and should be used as they are.
+ */
+unsigned char * compressStreamData(const std::string & data, Object & dict, size_t & size)
+{
+	unsigned char * buffer = ZlibFilterStreamWriter::deflate_buffer(
+			(unsigned char *)data.data(), data.length(), size);
+	if(!buffer)
 	{
-		// value has been set to something different, we have to deallocate it
-		// and to free key, because it is not stored in update
-		utilsPrintDbg(DBG_DBG, "Removing old Trailer::Size="<<originalSize->getInt());
-		gfree(key);
-		xpdf::freeXpdfObject(originalSize);
+		utilsPrintDbg(debug::DBG_WARN, "Unable to compress stream data. Writing them uncompressed.");
+		return NULL;
 	}
-	utilsPrintDbg(DBG_DBG, "Setting Trailer::Size="<<newSize.getInt());
+	Object filter;
+	filter.initName("FlateDecode");
+	dict.dictAdd(copyString("Filter"), &filter);
+	return buffer;
+}
 
-	// stores changed trailer to the file
-	stream.putLine(TRAILER_KEYWORD, strlen(TRAILER_KEYWORD));
-	writeObject(trailer, stream, NULL, false, ignore_stream_);
-	kernelPrintDbg(DBG_DBG, "Trailer saved");
+/** Gets number of bytes needed for given value.
+ * @param value Value to store.
+ * @return number of bytes (at least 1).
+ */
+int fieldWidth(size_t value)
+{
+	int width=1;
+	while(value>>=8)
+		++width;
+	return width;
+}
 
-	// stores offset of last (created one) xref table
-	stream.putLine(STARTXREF_KEYWORD, strlen(STARTXREF_KEYWORD));
-	char xrefPosStr[128];
-	sprintf(xrefPosStr, "%u", (unsigned int)xrefPos);
-	stream.putLine(xrefPosStr, strlen(xrefPosStr));
-	
-	// Finaly puts %%EOF behind but keeps position of marker start
-	size_t pos=stream.getPos();
-	stream.putLine(EOFMARKER, strlen(EOFMARKER));
-	kernelPrintDbg(DBG_DBG, "PDF end of file marker saved");
+/** Appends given value in big-endian byte order.
+ * @param data Data buffer.
+ * @param value Value to append.
+ * @param width Number of bytes to use.
+ */
+void appendField(std::string & data, size_t value, int width)
+{
+	for(int i=width-1; i>=0; --i)
+		data += (char)((value >> (8*i)) & 0xff);
+}
 
-	// stream may contain some non sense information behind, so they has to be
-	// cleaned.
-	size_t currPos=stream.getPos();
-	stream.setPos(0, -1);
-	size_t eofPos=stream.getPos();
-	if(eofPos>currPos)
+} // annonymous namespace
+
+const std::string XRefStreamPdfWriter::TRAILER = "XREF stream phase";
+
+void XRefStreamPdfWriter::writeHeader(const char* version, StreamWriter &stream)
+{
+	// cross reference streams are available since PDF 1.5
+	static const char * MIN_VERSION = "1.5";
+	if(!version || strcmp(version, MIN_VERSION)<0)
 	{
-		size_t size=eofPos-currPos;
-		kernelPrintDbg(DBG_DBG, "Cleaning pending ("<<size<<"B) data behind stored revision.");
-		stream.trim(currPos);
+		utilsPrintDbg(debug::DBG_INFO, "Upgrading PDF version to "<<MIN_VERSION);
+		version=MIN_VERSION;
 	}
+	IPdfWriter::writeHeader(version, stream);
+}
+
+void XRefStreamPdfWriter::writeContent(const ObjectList & objectList, StreamWriter & stream, size_t off)
+{
+using namespace debug;
+
+	utilsPrintDbg(DBG_DBG, "pos="<<off);
+	if(off)
+		stream.setPos((Guint)off);
+
+	for(ObjectList::const_iterator i=objectList.begin(); i!=objectList.end(); ++i)
+	{
+		::Ref ref=i->first;
+		Object * obj=i->second;
+		if(!obj)
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is not valid. Skipping.");
+			continue;
+		}
+		if(entryTable.find(ref.num)!=entryTable.end())
+		{
+			utilsPrintDbg(DBG_WARN, "Object with "<<ref<<" is already stored. Skipping.");
+			continue;
+		}
+		if(ref.num>maxObjNum)
+			maxObjNum=ref.num;
+
+		// streams and objects with non zero generation number can't be 
+		// stored in object streams
+		if(obj->isStream() || ref.gen)
+		{
+			Entry entry={UncompressedEntry, (size_t)stream.getPos(), (size_t)ref.gen};
+			entryTable.insert(EntryTab::value_type(ref.num, entry));
+			writeObject(*obj, stream, &ref, true, ignore_stream_);
+			utilsPrintDbg(DBG_DBG, "Object with "<<ref<<" stored at offset="<<entry.field2);
+			continue;
+		}
+
+		// the rest waits for writeTrailer which knows free object numbers
+		// for object streams. Entry is finished there
+		CharBuffer buffer;
+		size_t size=objectToCharBuffer(*obj, buffer, NULL, false, ignore_stream_);
+		packed.push_back(PackedObject(ref.num, std::string(buffer.get(), size)));
+		Entry entry={CompressedEntry, 0, 0};
+		entryTable.insert(EntryTab::value_type(ref.num, entry));
+	}
+
+	utilsPrintDbg(DBG_DBG, "All objects (number="<<objectList.size()<<") processed. "
+			<<packed.size()<<" waiting for object streams.");
+}
+
+void XRefStreamPdfWriter::writeObjectStream(int num, PackedObjects::const_iterator begin, 
+		PackedObjects::const_iterator end, StreamWriter & stream)
+{
+	// object stream starts with pairs of object numbers and offsets 
+	// (relative to the First entry) followed by objects
+	std::ostringstream pairs;
+	std::string objects;
+	size_t index=0;
+	for(PackedObjects::const_iterator i=begin; i!=end; ++i, ++index)
+	{
+		pairs << i->first << " " << objects.length() << " ";
+		objects += i->second;
+		objects += "\n";
+		Entry entry={CompressedEntry, (size_t)num, index};
+		entryTable[i->first]=entry;
+	}
+	std::string data=pairs.str();
+	size_t first=data.length();
+	data+=objects;
+
+	Object dict, value;
+	dict.initDict((XRef *)NULL);
+	value.initName("ObjStm");
+	dict.dictAdd(copyString("Type"), &value);
+	value.initInt((int)index);
+	dict.dictAdd(copyString("N"), &value);
+	value.initInt((int)first);
+	dict.dictAdd(copyString("First"), &value);
+
+	size_t size;
+	unsigned char * compressed=compressStreamData(data, dict, size);
+	::Ref ref={num, 0};
+	Entry entry={UncompressedEntry, (size_t)stream.getPos(), 0};
+	entryTable[num]=entry;
+	if(compressed)
+		writeEncodedStream(ref, dict, (const char *)compressed, size, stream);
+	else
+		writeEncodedStream(ref, dict, data.data(), data.length(), stream);
+	free(compressed);
+	dict.free();
+	utilsPrintDbg(debug::DBG_DBG, "Object stream "<<ref<<" with "<<index<<" objects stored at offset="<<entry.field2);
+}
+
+size_t XRefStreamPdfWriter::writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off)
+{
+using namespace debug;
+
+	// nothing has been stored, so no need for cross ref and trailer
+	if(entryTable.empty())
+	{
+		utilsPrintDbg(DBG_WARN, "No data stored. Skipping cross ref and trailer.");
+		return stream.getPos();
+	}
+	if(off)
+		stream.setPos((Guint)off);
+
+	// encryption dictionary can't be stored in object stream, so it is
+	// written as normal indirect object
+	Object encrypt;
+	trailer.dictLookupNF("Encrypt", &encrypt);
+	int encryptNum=(encrypt.isRef())?encrypt.getRefNum():-1;
+	encrypt.free();
+	PackedObjects objects;
+	objects.reserve(packed.size());
+	for(PackedObjects::const_iterator i=packed.begin(); i!=packed.end(); ++i)
+	{
+		if(i->first!=encryptNum)
+		{
+			objects.push_back(*i);
+			continue;
+		}
+		Entry entry={UncompressedEntry, (size_t)stream.getPos(), 0};
+		entryTable[i->first]=entry;
+		std::string indirectFormat;
+		createIndirectObjectStringFromString(IndiRef(i->first, 0), i->second, indirectFormat);
+		stream.putLine(indirectFormat.data(), indirectFormat.length());
+	}
+	packed.clear();
+
+	// object streams and cross reference stream get numbers behind all 
+	// objects
+	size_t nextNum=std::max(prevSection.entriesNum, (size_t)(maxObjNum + 1));
+	for(size_t i=0; i<objects.size(); i+=objectsPerStream)
+	{
+		size_t count=std::min(objectsPerStream, objects.size()-i);
+		writeObjectStream((int)nextNum++, objects.begin()+i, objects.begin()+i+count, stream);
+	}
+	objects.clear();
+
+	// cross reference stream contains also its own entry
+	size_t xrefPos=stream.getPos();
+	::Ref xrefRef={(int)nextNum++, 0};
+	Entry xrefEntry={UncompressedEntry, xrefPos, 0};
+	entryTable[xrefRef.num]=xrefEntry;
+
+	size_t maxField2=0, maxField3=0;
+	for(EntryTab::const_iterator i=entryTable.begin(); i!=entryTable.end(); ++i)
+	{
+		maxField2=std::max(maxField2, i->second.field2);
+		maxField3=std::max(maxField3, i->second.field3);
+	}
+	int w2=fieldWidth(maxField2), w3=fieldWidth(maxField3);
+
+	// collects subsections (first object number and count) - entries for
+	// all subsections are stored in the stream data in the same order
+	typedef std::vector<std::pair<int, size_t> > SubSections;
+	SubSections subSections;
+	std::string data;
+	for(EntryTab::const_iterator i=entryTable.begin(); i!=entryTable.end(); ++i)
+	{
+		if(subSections.empty() || 
+				(size_t)i->first!=subSections.back().first+subSections.back().second)
+			subSections.push_back(std::make_pair(i->first, (size_t)0));
+		++subSections.back().second;
+		appendField(data, i->second.type, 1);
+		appendField(data, i->second.field2, w2);
+		appendField(data, i->second.field3, w3);
+	}
+
+	boost::shared_ptr<OperationScope> scope(new OperationScope());
+	scope->total=subSections.size();
+	scope->task=TRAILER;
+	boost::shared_ptr<ChangeContext> context(new ChangeContext(scope));
+	Object index, value;
+	index.initArray((XRef *)NULL);
+	size_t step=1;
+	for(SubSections::const_iterator i=subSections.begin(); i!=subSections.end(); ++i, ++step)
+	{
+		value.initInt(i->first);
+		index.arrayAdd(&value);
+		value.initInt((int)i->second);
+		index.arrayAdd(&value);
+
+		boost::shared_ptr<OperationStep> newValue(new OperationStep());
+		newValue->currStep=step;
+		notifyObservers(newValue, context);
+	}
+
+	// stream dictionary is the trailer with cross reference stream entries
+	updateTrailer(trailer, prevSection, nextNum);
+	Object dict;
+	dict.initDict((XRef *)NULL);
+	const Dict * trailerDict=trailer.getDict();
+	for(int i=0; i<trailerDict->getLength(); ++i)
+	{
+		trailerDict->getValNF(i, &value);
+		dict.dictAdd(copyString(trailerDict->getKey(i)), &value);
+	}
+	value.initName("XRef");
+	dict.dictAdd(copyString("Type"), &value);
+	dict.dictAdd(copyString("Index"), &index);
+	Object widths;
+	widths.initArray((XRef *)NULL);
+	value.initInt(1);
+	widths.arrayAdd(&value);
+	value.initInt(w2);
+	widths.arrayAdd(&value);
+	value.initInt(w3);
+	widths.arrayAdd(&value);
+	dict.dictAdd(copyString("W"), &widths);
+
+	size_t size;
+	unsigned char * compressed=compressStreamData(data, dict, size);
+	if(compressed)
+		writeEncodedStream(xrefRef, dict, (const char *)compressed, size, stream);
+	else
+		writeEncodedStream(xrefRef, dict, data.data(), data.length(), stream);
+	free(compressed);
+	dict.free();
+	kernelPrintDbg(DBG_DBG, "Cross reference stream "<<xrefRef<<" saved at offset="<<xrefPos);
+
+	size_t pos=writeRevisionEnd(xrefPos, stream);
+	lastXRefPos=xrefPos;
 
-	// resets internal data
 	reset();
 
 	return pos;
 }
 
-void OldStylePdfWriter::reset()
+void XRefStreamPdfWriter::reset()
 {
-	offTable.clear();
+	entryTable.clear();
+	packed.clear();
 	maxObjNum=0;
 }
 
@@ -917,7 +1731,7 @@ using namespace debug;
 	// creates outputStream writer from given file
 	Object dict;
 	boost::shared_ptr<StreamWriter> outputStream(
-			new FileStreamWriter(file, 0, false, 0, &dict));
+			new BufferedFileStreamWriter(file, 0, false, 0, &dict));
 
 	// Writes header with the same PDF version
 	pdfWriter->writeHeader(getPDFVersion(), *outputStream);
@@ -274,16 +274,34 @@ public:
 	 */
 	virtual bool supportObject(const Object& obj)const =0;
 
-	/** Writes given stream object to the output stream.
+	/** Encodes given stream object to the buffer.
 	 * Implementation has to follow pdf specification in format of the data
 	 * writen in the stream. Nevertheless it is absolutely free in how it does it.
 	 * It can modify given object to use those filters (and all associated 
 	 * parameters) which are then used when data are written.
+	 * <br>
+	 * Implementation must not touch any shared state because different
+	 * objects can be encoded by more threads at the same time (see 
+	 * OldStylePdfWriter::setWorkers).
+	 * @param obj Object to write (must be stream).
+	 * @param ref Indirect reference for object (NULL for direct object).
+	 * @param buffer Buffer for the complete pdf representation of the object.
+	 * @param use Flag for writing decoded data.
+	 * @return number of bytes in the buffer (0 on error).
+	 */
+	virtual size_t encode(const Object& obj, Ref* ref, CharBuffer& buffer, bool use)const =0;
+
+	/** Writes given stream object to the output stream.
 	 * @param obj Object to write (must be stream).
 	 * @param ref Indirect reference for object (NULL for direct object).
 	 * @param outStream Output stream where to put data.
+	 * @param use Flag for writing decoded data.
+	 *
+	 * Writes data prepared by encode method.
 	 */
-	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const =0;
+	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const;
+
+	virtual ~FilterStreamWriter(){}
 };
 
 /** Stream writer implementation with no filters.
@@ -305,14 +323,30 @@ public:
 	 */
 	static unsigned char * null_extractor(const Object&obj, size_t& size);
 
-	/** Writes given stream object to the stream.
+	/** Checks whether given stream can be copied as it is.
+	 * @param obj Stream object.
+	 * @return true if the stream data come unchanged from the document file
+	 * and they are encoded by a well formed non empty filter chain, false 
+	 * otherwise.
+	 *
+	 * Such a stream doesn't have to be decoded and encoded again when it is
+	 * written, because its encoded data can be taken directly from the
+	 * original file. Streams changed by the user are always backed by memory
+	 * and so they are never reported as copyable. Streams without any filter
+	 * are not copyable either, so that they are still compressed by the
+	 * registered filter writers. Data of encrypted documents are stored 
+	 * encrypted in the file and so they have to be decoded as well.
+	 */
+	static bool isRawCopyable(const Object& obj);
+
+	/** Encodes given stream object.
 	 * @param obj Stream object.
 	 * @param ref Indirect reference for object (NULL if direct).
-	 * @param outStream Stream where to write data.
+	 * @param buffer Buffer for data.
 	 *
 	 * Uses streamToCharBuffer with null_extractor extractor.
 	 */
-	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const;
+	virtual size_t encode(const Object& obj, Ref* ref, CharBuffer& buffer, bool use)const;
 };
 
 /** Implementation of FlateDecode filter stream writer.
@@ -323,6 +357,9 @@ class ZlibFilterStreamWriter: public FilterStreamWriter
 	/** Shared writer instance */
 	static boost::shared_ptr<ZlibFilterStreamWriter> instance;
 
+	/** Compression level used by deflate_buffer. */
+	static int compressionLevel;
+
 	/** Updates given stream object with the applied fiter data.
 	 * @param obj Stream object.
 	 *
@@ -332,6 +369,21 @@ class ZlibFilterStreamWriter: public FilterStreamWriter
 public:
 	static boost::shared_ptr<ZlibFilterStreamWriter> getInstance();
 
+	/** Sets compression level for all compressed streams.
+	 * @param level zlib compression level (0 - no compression, 9 - best
+	 * compression, Z_DEFAULT_COMPRESSION).
+	 * @throw OutOfRange if the level is not valid.
+	 */
+	static void setCompressionLevel(int level);
+
+	/** Gets current compression level.
+	 * @return zlib compression level (Z_DEFAULT_COMPRESSION by default).
+	 */
+	static int getCompressionLevel()
+	{
+		return compressionLevel;
+	}
+
 	/** Checks whether given stream object is supported by this writer.
 	 * @param obj Stream object.
 	 * @return true if no filter FlateDecode are used.
@@ -344,7 +396,8 @@ public:
 	 * @param size Size of the output buffer data.
 	 * @return allocated buffer with the size data bytes or NULL on failure.
 	 *
-	 * Uses zlib interface to deflate given data.
+	 * Uses zlib interface to deflate given data with the current 
+	 * compression level.
 	 */
 	static unsigned char* deflate_buffer(unsigned char * in, size_t in_size, size_t& size);
 
@@ -360,7 +413,7 @@ public:
 	 */
 	static unsigned char* deflate(const Object& obj, size_t& size);
 
-	virtual void compress(const Object& obj, Ref* ref, StreamWriter& outStream,bool use)const;
+	virtual size_t encode(const Object& obj, Ref* ref, CharBuffer& buffer, bool use)const;
 };
 
 /** Interface for pdf content writer.
@@ -397,8 +450,13 @@ class IPdfWriter:public observer::ObserverHandler<OperationStep>
 protected:
   bool ignore_stream_;
 
+	/** Position of the last cross reference section.
+	 * Set by writeTrailer implementation.
+	 */
+	size_t lastXRefPos;
+
 public:
-	IPdfWriter() : ignore_stream_(false){} 
+	IPdfWriter() : ignore_stream_(false), lastXRefPos(0){} 
 
 	/** Type for ObjectList element. */
 	typedef std::pair<Ref, Object *> ObjectElement;
@@ -487,6 +545,16 @@ public:
 	 */
 	virtual size_t writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off=0)=0;
 
+	/** Returns position of the last written cross reference section.
+	 * This is the value stored behind startxref keyword by the last 
+	 * writeTrailer call and it can be used to open written revision.
+	 * @return stream position of the cross reference section.
+	 */
+	size_t getLastXRefPos()const
+	{
+		return lastXRefPos;
+	}
+
 	/** Resets internal data collected in writeContent method.
 	 *
 	 * Everything collected in writeContent method, which is needed by
@@ -542,6 +610,23 @@ class OldStylePdfWriter: public IPdfWriter
 	 * chapter for more information).
 	 */
 	int maxObjNum;
+
+	/** Number of threads which prepare objects in writeContent.
+	 * 1 means that everything is done by the calling thread.
+	 */
+	size_t workers;
+
+	/** Writes given objects with more workers.
+	 * @param objectList List of objects to write.
+	 * @param stream Stream writer where to write.
+	 *
+	 * Worker threads convert objects to their pdf representation and the
+	 * calling thread writes them to the stream in the original order and
+	 * stores their offsets to the offTable mapping.
+	 *
+	 * @throw MalformedFormatExeption if an object cannot be converted.
+	 */
+	void writeContentParallel(const ObjectList & objectList, StreamWriter & stream);
 public:
 	/** String for context task in writeContent.
 	 * This value is used in ScopedChangeContext's task field in writeContent
@@ -559,7 +644,32 @@ public:
 	 *
 	 * Initializes CONTENT and TRAILER fields to default values.
 	 */
-	OldStylePdfWriter():maxObjNum(0){}
+	OldStylePdfWriter():maxObjNum(0), workers(1){}
+
+	/** Sets number of threads used to prepare objects.
+	 * @param count Number of worker threads (0 is treated as 1).
+	 *
+	 * If more than one worker is set, writeContent converts objects to their
+	 * pdf representation (this includes stream compression) in parallel 
+	 * and the calling thread writes them in the original order. Streams 
+	 * backed by the document file are read under the read lock of their 
+	 * CXref (see CXref::getReadMutex), so the output stream must not share 
+	 * the file handle with the source document if more workers are used.
+	 * Only reading is done under the lock, decoding and compression work
+	 * with a memory copy of the stream data.
+	 */
+	void setWorkers(size_t count)
+	{
+		workers = (count)?count:1;
+	}
+
+	/** Gets number of threads used to prepare objects.
+	 * @return number of workers.
+	 */
+	size_t getWorkers()const
+	{
+		return workers;
+	}
 
 	/** Writes given objects.
 	 * @param objectList List of objects to write.
@@ -572,6 +682,10 @@ public:
 	 * helper writeIndirectObject function) and stores stream offset to the
 	 * offTable mapping. 
 	 * <br>
+	 * If more workers are set (see setWorkers), objects are prepared by the
+	 * worker threads and only writing and offTable updates are done by the
+	 * calling thread.
+	 * <br>
 	 * Notifies all observers immediately after object has been written to the
 	 * stream. newValue parameter is number of written objects until now and
 	 * context (typed as ChangeContext with OperationScope typed scope)
@@ -641,6 +755,141 @@ public:
 	virtual void reset();
 };
 
+/** Implementator of pdf writer with cross reference streams.
+ *
+ * Writes content with cross reference stream (PDF 1.5, see 3.4.7 
+ * Cross-Reference Streams chapter in PDF specification) and packs all 
+ * objects which can be compressed to object streams (see 3.4.6 Object 
+ * Streams chapter). Stream objects and objects with non zero generation 
+ * number are written as usual indirect objects.
+ * <br>
+ * Both object streams and cross reference stream are compressed by 
+ * ZlibFilterStreamWriter::deflate_buffer and so they respect its compression
+ * level. They get new object numbers behind all written objects and the 
+ * previous section entries.
+ * <br>
+ * Note that documents with classic cross reference tables can be updated by
+ * this writer too, but only PDF 1.5 capable readers will see such revision.
+ */
+class XRefStreamPdfWriter: public IPdfWriter
+{
+public:
+	/** Default maximum number of objects in one object stream. */
+	static const size_t DEFAULT_OBJECTS_PER_STREAM = 100;
+
+	/** Type of cross reference entry. Values are the same as in cross
+	 * reference stream data.
+	 */
+	enum EntryType {FreeEntry=0, UncompressedEntry=1, CompressedEntry=2};
+
+	/** Cross reference entry.
+	 */
+	struct Entry
+	{
+		EntryType type;
+		/** File offset for uncompressed and object stream number for 
+		 * compressed entries. */
+		size_t field2;
+		/** Generation number for uncompressed and index in the object stream
+		 * for compressed entries. */
+		size_t field3;
+	};
+private:
+	/** Mapping from object number to its cross reference entry.
+	 */
+	typedef std::map<int, Entry> EntryTab;
+	EntryTab entryTable;
+
+	/** Object waiting for an object stream.
+	 * Object number and pdf representation of the object.
+	 */
+	typedef std::pair<int, std::string> PackedObject;
+	typedef std::vector<PackedObject> PackedObjects;
+
+	/** Objects which will be written to object streams by writeTrailer.
+	 */
+	PackedObjects packed;
+
+	/** Maximum object number written (see OldStylePdfWriter::maxObjNum).
+	 */
+	int maxObjNum;
+
+	/** Maximum number of objects in one object stream.
+	 */
+	size_t objectsPerStream;
+
+	/** Writes given objects to the object stream.
+	 * @param num Object stream number.
+	 * @param begin First object to be written.
+	 * @param end Object behind the last one.
+	 * @param stream Stream writer where to write.
+	 *
+	 * Updates entryTable with the compressed entries for all objects and the
+	 * object stream entry.
+	 */
+	void writeObjectStream(int num, PackedObjects::const_iterator begin, 
+			PackedObjects::const_iterator end, StreamWriter & stream);
+public:
+	/** String for context task in writeTrailer.
+	 */
+	static const std::string TRAILER;
+
+	XRefStreamPdfWriter():maxObjNum(0), objectsPerStream(DEFAULT_OBJECTS_PER_STREAM){}
+
+	/** Sets maximum number of objects in one object stream.
+	 * @param count Number of objects (0 is treated as 1).
+	 */
+	void setObjectsPerStream(size_t count)
+	{
+		objectsPerStream = (count)?count:1;
+	}
+
+	/** Writes PDF header to the given stream.
+	 * @param version Version of the PDF standard used for this document.
+	 * @param stream Stream writer where to write.
+	 *
+	 * Cross reference streams require at least PDF 1.5 so this version is
+	 * used for documents with lower version.
+	 */
+	virtual void writeHeader(const char* version, StreamWriter &stream);
+
+	/** Writes given objects.
+	 * @param objectList List of objects to write.
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing (if 0, uses current
+	 * position).
+	 *
+	 * Streams and objects with non zero generation number are written
+	 * immediately. All other objects are kept until writeTrailer which 
+	 * packs them to object streams.
+	 */
+	virtual void writeContent(const ObjectList & objectList, StreamWriter & stream, size_t off=0);
+
+	/** Writes object streams and cross reference stream.
+	 * @param trailer Trailer object.
+	 * @param prevSection Context for previous section.
+	 * @param stream Stream writer where to write.
+	 * @param off Stream offset where to start writing (if 0, uses current
+	 * position).
+	 *
+	 * Writes all pending objects to object streams (encryption dictionary
+	 * is written as an indirect object because it can't be compressed). 
+	 * Then writes cross reference stream which contains all trailer entries
+	 * (updated in the same way as OldStylePdfWriter does) followed by 
+	 * startxref and %%EOF marker.
+	 * <br>
+	 * Notifies observers after each cross reference subsection is 
+	 * prepared, context task field contains TRAILER string.
+	 *
+	 * @return stream position of pdf end of file %%EOF marker.
+	 */
+	virtual size_t writeTrailer(const Object & trailer, const PrevSecInfo &prevSection, StreamWriter & stream, size_t off=0);
+
+	/** Resets all collected data.
+	 */
+	virtual void reset();
+};
+
 /** Helper data structure which keeps all file stream related data.
  */
 struct FileStreamData 
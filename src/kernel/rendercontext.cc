@@ -0,0 +1,105 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#include "kernel/static.h"
+#include "kernel/rendercontext.h"
+#include "kernel/cxref.h"
+#include "utils/mutex.h"
+
+namespace pdfobjects {
+
+using namespace debug;
+
+namespace {
+
+/** Lock for lastDocId. */
+threads::Mutex docIdMutex;
+
+/** The most recently assigned document content id. */
+Gulong lastDocId=0;
+
+} // annonymous namespace
+
+RenderContext::RenderContext(CXref * xrefA)
+	:xref(xrefA), catalog(NULL), stamp(xrefA->getChangeStamp()), docId(nextDocId())
+{
+}
+
+RenderContext::~RenderContext()
+{
+	delete catalog;
+}
+
+Gulong RenderContext::nextDocId()
+{
+	threads::ScopedLock lock(docIdMutex);
+	// 0 is reserved for devices which haven't been started by any context
+	if(!++lastDocId)
+		++lastDocId;
+	return lastDocId;
+}
+
+void RenderContext::invalidate()
+{
+	delete catalog;
+	catalog=NULL;
+	// devices started for the previous id will be restarted
+	docId=nextDocId();
+}
+
+void RenderContext::checkStamp()
+{
+	size_t current=xref->getChangeStamp();
+	if(current==stamp)
+		return;
+	kernelPrintDbg(DBG_DBG, "Document has changed. Discarding render context.");
+	invalidate();
+	stamp=current;
+}
+
+Catalog * RenderContext::getCatalog()
+{
+	checkStamp();
+	if(!catalog)
+	{
+		kernelPrintDbg(DBG_DBG, "Creating catalog");
+		catalog=new Catalog(xref);
+	}
+	return catalog;
+}
+
+void RenderContext::startDoc(SplashOutputDev & out)
+{
+	checkStamp();
+
+	if(out.getDocId()==docId)
+		return;
+
+	kernelPrintDbg(DBG_DBG, "Starting output device "<<&out);
+	out.startDoc(xref);
+	out.setDocId(docId);
+}
+
+} // namespace pdfobjects
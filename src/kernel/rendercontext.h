@@ -0,0 +1,116 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _RENDERCONTEXT_H_
+#define _RENDERCONTEXT_H_
+
+#include "kernel/static.h"
+
+/**
+ * @file rendercontext.h
+ *
+ * Document wide state shared by page rendering.
+ */
+
+namespace pdfobjects {
+
+class CXref;
+
+/** Document wide xpdf rendering state.
+ *
+ * xpdf rendering needs a Catalog of the document (annotations, forms,
+ * optional content) and SplashOutputDev has to be started for the document
+ * (startDoc), which drops its font engine with all loaded fonts and glyph
+ * caches. Both are expensive and their result doesn't depend on the
+ * rendered page, so this class keeps them between CPageDisplay::displayPage
+ * calls.
+ * <br>
+ * Everything is bound to the CXref change stamp (CXref::getChangeStamp).
+ * When the document content changes, the catalog is created again and
+ * output devices are restarted when they are used for the first time after
+ * the change. Each content version gets a process wide unique id which is
+ * stored to the started device (SplashOutputDev::setDocId), so the context
+ * doesn't keep any references to devices.
+ * <br>
+ * Each CPdf instance owns one context (CPdf::getRenderContext). The context
+ * is not synchronized on its own - callers have to hold the document read
+ * lock (CXref::getReadMutex) as CPageDisplay::displayPage does.
+ */
+class RenderContext: boost::noncopyable
+{
+	/** Document xref. */
+	CXref * xref;
+
+	/** Cached catalog (NULL if not created yet). */
+	Catalog * catalog;
+
+	/** Change stamp for which catalog and docId are valid. */
+	size_t stamp;
+
+	/** Unique id of the document content with the stamp.
+	 * Output devices started for this content hold the same id.
+	 */
+	Gulong docId;
+
+	/** Returns a new process wide unique document content id. */
+	static Gulong nextDocId();
+
+	/** Discards all cached data if the document has changed. */
+	void checkStamp();
+public:
+	/** Creates empty context for given document.
+	 * @param xrefA Document xref.
+	 */
+	RenderContext(CXref * xrefA);
+
+	/** Deallocates cached catalog. */
+	~RenderContext();
+
+	/** Returns catalog of the document.
+	 *
+	 * Catalog is created when it is needed for the first time and each time
+	 * after the document has changed.
+	 *
+	 * @return Catalog instance owned by this context (valid until the next
+	 * call of this method or invalidate).
+	 */
+	Catalog * getCatalog();
+
+	/** Starts given output device for the document if it is needed.
+	 * @param out Output device.
+	 *
+	 * Calls SplashOutputDev::startDoc only if the device hasn't been started
+	 * for the current document content yet, so fonts loaded by previous
+	 * renderings are reused.
+	 */
+	void startDoc(SplashOutputDev & out);
+
+	/** Discards all cached data. */
+	void invalidate();
+};
+
+} // namespace pdfobjects
+
+#endif // _RENDERCONTEXT_H_
@@ -308,6 +308,21 @@ namespace {
 		// return changed state
 		return state;
 	}
+	// "n" and path painting operators
+	GfxState *
+	opnUpdate (GfxState* state, boost::shared_ptr<GfxResources>, const boost::shared_ptr<PdfOperator>, const PdfOperator::Operands&, BBox* rc)
+	{
+		// Set rectangle from actual position on output devices
+		state->transform(state->getCurX (), state->getCurY(), & rc->xleft, & rc->yleft);
+		rc->xright = rc->xleft;
+		rc->yright = rc->yleft;
+
+		// path ends here as in xpdf Gfx::doEndPath
+		state->clearPath ();
+
+		// return changed state
+		return state;
+	}
 	// "Tc"
 	GfxState *
 	opTcUpdate (GfxState* state, boost::shared_ptr<GfxResources>, const boost::shared_ptr<PdfOperator>, const PdfOperator::Operands& args, BBox* rc)
@@ -1013,9 +1028,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"'",   1, {setNthBitsShort (pString)}, 
 			opApoUpdate, "" },	
 	{"B",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"B*",  0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"BDC", 2, {setNthBitsShort (pName), setNthBitsShort (pDict, pName)}, 
 			unknownUpdate, "" },	
 	{"BI",  -1, {setNoneBitsShort ()}, 
@@ -1041,7 +1056,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"EX",  0, {setNoneBitsShort ()}, 
 			unknownUpdate, "" },	
 	{"F",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"G",   1, {setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
 	{"ID",  0, {setNoneBitsShort ()},
@@ -1060,7 +1075,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"RG",  3, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
 	{"S",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"SC",  -4, {setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),    
 				setNthBitsShort (pInt, pReal),	setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
@@ -1100,9 +1115,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"W*",  0, {setNoneBitsShort ()}, 
 			unknownUpdate, "" },	
 	{"b",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"b*",  0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"c",   6, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),    
 				 setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)}, 
 			opcUpdate, "" },	
@@ -1119,9 +1134,9 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 				 setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
 	{"f",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"f*",  0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"g",   1, {setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
 	{"gs",  1, {setNthBitsShort (pName)}, 
@@ -1140,7 +1155,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"m",   2, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)}, 
 			opmUpdate, "" },	
 	{"n",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"q",   0, {setNoneBitsShort ()}, 
 			opqUpdate, "Q" },	
 	{"re",  4, 	{setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal), 
@@ -1151,7 +1166,7 @@ StateUpdater::CheckTypes StateUpdater::KNOWN_OPERATORS[] = {
 	{"ri",  1, {setNthBitsShort (pName)}, 
 			unknownUpdate, "" },	
 	{"s",   0, {setNoneBitsShort ()}, 
-			unknownUpdate, "" },	
+			opnUpdate, "" },	
 	{"sc",  -4, {setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal),    
 				setNthBitsShort (pInt, pReal), setNthBitsShort (pInt, pReal)}, 
 			unknownUpdate, "" },	
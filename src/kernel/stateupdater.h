@@ -127,6 +127,39 @@ public:
 	 * @return Operator end tag. Can be empty.
 	 */
 	static std::string getEndTag (const std::string& name);
+
+	/** Operator code of an operator which is not in KNOWN_OPERATORS. */
+	static const int UNKNOWN_OPCODE = -1;
+
+	/**
+	 * Find operator code.
+	 *
+	 * @param name Name of the operator.
+	 *
+	 * @return Index to KNOWN_OPERATORS or UNKNOWN_OPCODE.
+	 */
+	static int findOpcode (const std::string& name)
+		{ return getOpcode (findOp (name)); }
+
+	/**
+	 * Get operator code of operator specification.
+	 *
+	 * @param chcktp Operator specification returned by findOp or NULL.
+	 *
+	 * @return Index to KNOWN_OPERATORS or UNKNOWN_OPCODE.
+	 */
+	static int getOpcode (const CheckTypes* chcktp)
+		{ return (NULL != chcktp) ? static_cast<int> (chcktp - KNOWN_OPERATORS) : UNKNOWN_OPCODE; }
+
+	/**
+	 * Get operator specification by operator code.
+	 *
+	 * @param opcode Operator code (see PdfOperator::getOpcode).
+	 *
+	 * @return Operator specification or NULL for UNKNOWN_OPCODE.
+	 */
+	static const CheckTypes* getOp (int opcode)
+		{ return (UNKNOWN_OPCODE == opcode) ? NULL : &KNOWN_OPERATORS[opcode]; }
 	
 public:
 	/**
@@ -146,6 +179,28 @@ public:
 						boost::shared_ptr<GfxResources> res, 
 						/*const*/ GfxState& state, 
 						Ftor ftor) 
+		{ return updatePdfOperators (it, res, state, ftor, NeverStop ()); }
+
+	/**
+	 * Update pdf operators until a condition is met.
+	 *
+	 * Same as the above but the update stops after an operator for which the
+	 * until predicate returns true. The predicate is called after the functor
+	 * with the same operator and the updated state.
+	 *
+	 * @param it Iterator that will be used to traverse all operators.
+	 * @param res Graphical resources.
+	 * @param state Graphical state.
+	 * @param ftor Functor applied after each update.
+	 * @param until Stop predicate.
+	 */
+	template <typename Ftor, typename Until>
+	static boost::shared_ptr<GfxState> 
+	updatePdfOperators (PdfOperator::Iterator it, 
+						boost::shared_ptr<GfxResources> res, 
+						/*const*/ GfxState& state, 
+						Ftor ftor,
+						Until until) 
 	{
 		assert (!state.isPath());		// if isPath, state is from other ccontentstream or is bad
 		GfxState* tmpstate = state.copy (false);
@@ -161,14 +216,18 @@ public:
 		while (!it.isEnd ())
 		{
 			op = it.getCurrent();
-			// Get operator name
-			std::string frst;
-			op->getOperatorName(frst);
-			// Get operator specification
-			const CheckTypes* chcktp = findOp (frst);
-			// Get operands
-			PdfOperator::Operands ops;
-			op->getParameters (ops);
+			// Get operator specification (operator code is set when the
+			// operator is created)
+			const CheckTypes* chcktp = getOp (op->getOpcode ());
+			// Get operands, simple operators don't copy them
+			PdfOperator::Operands tmpops;
+			const PdfOperator::Operands* opsptr = op->getOperands ();
+			if (NULL == opsptr)
+			{
+				op->getParameters (tmpops);
+				opsptr = &tmpops;
+			}
+			const PdfOperator::Operands& ops = *opsptr;
 			// If operator found use the function else use default
 			if (NULL != chcktp)
 			{
@@ -194,6 +253,8 @@ public:
 
 			assert (tmpstate);
 			ftor (op, rc, *tmpstate);
+			if (until (op, *tmpstate))
+				break;
 			it = it.next ();
 		
 		} // while
@@ -207,6 +268,13 @@ public:
 	}
 
 
+	/** Default stop predicate which never stops the update. */
+	struct NeverStop
+	{
+		bool operator() (const boost::shared_ptr<PdfOperator>&, const GfxState&) const 
+			{ return false; }
+	};
+
 	//
 	// Helper functions
 	//
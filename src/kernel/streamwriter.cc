@@ -26,6 +26,17 @@
 #include "kernel/static.h"
 #include <stdio.h>
 #include <errno.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <unistd.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
 #include "utils/debug.h"
 #include "kernel/streamwriter.h"
 
@@ -122,6 +133,8 @@ using namespace debug;
 	char buffer[BUFSIZ];
 	size_t read=0;
 	size_t totalWriten=0;
+	if(!length)
+		length=(size_t)-1;
 
 	// copies content until there is something to read or length is fulfilled.
 	while((read=fread(buffer, sizeof(char), std::min((size_t)BUFSIZ, length-totalWriten), f))>0)
@@ -140,3 +153,351 @@ using namespace debug;
 
 	return totalWriten;
 }
+
+void BufferedFileStreamWriter::writeBuffer()const
+{
+using namespace debug;
+
+	// writes at the buffered position (file position may have been changed
+	// by substreams)
+#if HAVE_FSEEKO
+	fseeko(f, bufferStart, SEEK_SET);
+#else
+	fseek(f, bufferStart, SEEK_SET);
+#endif
+	size_t totalWriten=0;
+	while(totalWriten<buffer.size())
+	{
+		size_t writen=fwrite(&buffer[totalWriten], sizeof(char), buffer.size()-totalWriten, f);
+		if(!writen)
+		{
+			int err = errno;
+			kernelPrintDbg(DBG_ERR, "Write error \"" << strerror(err) << "\"");
+			break;
+		}
+		totalWriten+=writen;
+	}
+	// buffer never exceeds capacity, so its size fits to Guint
+	Guint end=bufferStart+(Guint)buffer.size();
+	buffer.clear();
+
+	// FileStream::setPos synchronizes FILE stream (no fflush is needed) and
+	// invalidates read buffer
+	const_cast<BufferedFileStreamWriter *>(this)->FileStream::setPos(end);
+}
+
+void BufferedFileStreamWriter::write(const char * data, size_t length)
+{
+	while(length)
+	{
+		if(buffer.empty())
+		{
+			bufferStart=FileStream::getPos();
+			buffer.reserve(capacity);
+		}
+		size_t chunk=std::min(length, capacity-buffer.size());
+		buffer.insert(buffer.end(), data, data+chunk);
+		data+=chunk;
+		length-=chunk;
+		if(buffer.size()>=capacity)
+			writeBuffer();
+	}
+}
+
+void BufferedFileStreamWriter::putChar(int ch)
+{
+	char c=(char)ch;
+	write(&c, 1);
+}
+
+void BufferedFileStreamWriter::putLine(const char * line, size_t length)
+{
+	if(!line)
+		return;
+	write(line, length);
+	putChar(0xA);
+}
+
+size_t BufferedFileStreamWriter::cloneToFile(FILE * file, size_t start, size_t length)
+{
+using namespace debug;
+
+	if(!file)
+		return 0;
+	flushBuffer();
+
+#ifdef HAVE_SYS_SENDFILE_H
+	kernelPrintDbg(DBG_DBG, "start="<<start<<" length="<<length);
+
+	// output file has to be synchronized with its descriptor
+	fflush(file);
+	int in=fileno(f), out=fileno(file);
+	off_t offset=start;
+	size_t totalWriten=0;
+	if(!length)
+		length=(size_t)-1;
+	while(totalWriten<length)
+	{
+		size_t chunk=std::min(length-totalWriten, (size_t)0x40000000);
+		ssize_t writen=sendfile(out, in, &offset, chunk);
+		if(writen<0)
+		{
+			// sendfile is not supported for given files - fall back to 
+			// read & write only if nothing has been sent yet
+			int err = errno;
+			if(totalWriten || (err!=EINVAL && err!=ENOSYS))
+				kernelPrintDbg(DBG_ERR, "sendfile failed \"" << strerror(err) << "\"");
+			if(!totalWriten)
+				return FileStreamWriter::cloneToFile(file, start, length);
+			break;
+		}
+		if(!writen)
+			break;
+		totalWriten+=writen;
+	}
+
+	// FILE position has to follow its descriptor which has been moved by
+	// sendfile
+#if HAVE_FSEEKO
+	fseeko(file, lseek(out, 0, SEEK_CUR), SEEK_SET);
+#else
+	fseek(file, lseek(out, 0, SEEK_CUR), SEEK_SET);
+#endif
+	kernelPrintDbg(DBG_INFO, totalWriten<<" bytes written to output file");
+	return totalWriten;
+#else
+	return FileStreamWriter::cloneToFile(file, start, length);
+#endif
+}
+
+#ifdef HAVE_SYS_MMAN_H
+Stream * MappedStream::makeSubStream(Guint startA, GBool limitedA,
+		Guint lengthA, const Object *dictA)
+{
+	Guint newLength;
+	if(!limitedA || startA+lengthA>start+length)
+		newLength=start+length-startA;
+	else
+		newLength=lengthA;
+	return new MappedStream(buf, startA, newLength, dictA);
+}
+
+MappedFileStreamWriter::MappedFileStreamWriter(FILE * fA, Object * dictA)
+	: BaseStream(dictA),
+	  StreamWriter(dictA),
+	  f(fA), fd(fileno(fA)), data(NULL), mapped(0), fileLength(0),
+	  start(0), pos(0)
+{
+}
+
+MappedFileStreamWriter * MappedFileStreamWriter::getInstance(FILE * fA, Object * dictA)
+{
+using namespace debug;
+
+	if(!fA)
+		return NULL;
+	struct stat st;
+	if(fstat(fileno(fA), &st) || !S_ISREG(st.st_mode) || !st.st_size)
+	{
+		kernelPrintDbg(DBG_WARN, "File can't be mapped (not a regular file or empty)");
+		return NULL;
+	}
+	// stream offsets are Guint
+	if((off_t)(Guint)st.st_size!=st.st_size)
+	{
+		kernelPrintDbg(DBG_WARN, "File can't be mapped (too big)");
+		return NULL;
+	}
+	MappedFileStreamWriter * stream = new MappedFileStreamWriter(fA, dictA);
+	stream->fileLength = (Guint)st.st_size;
+	if(!stream->remap())
+	{
+		delete stream;
+		return NULL;
+	}
+	return stream;
+}
+
+MappedFileStreamWriter::~MappedFileStreamWriter()
+{
+	for(size_t i=0; i<mappings.size(); ++i)
+		munmap(mappings[i].first, mappings[i].second);
+}
+
+bool MappedFileStreamWriter::remap()
+{
+using namespace debug;
+
+	if(fileLength<=mapped)
+		return true;
+	void * addr = mmap(NULL, fileLength, PROT_READ, MAP_SHARED, fd, 0);
+	if(addr==MAP_FAILED)
+	{
+		int err = errno;
+		kernelPrintDbg(DBG_ERR, "Unable to map "<<fileLength<<"B (\""<<strerror(err)<<"\")");
+		return false;
+	}
+	// older mappings may be still used by substreams
+	data = (char *)addr;
+	mapped = fileLength;
+	mappings.push_back(std::make_pair(data, mapped));
+	kernelPrintDbg(DBG_DBG, "File mapped. size="<<mapped);
+	return true;
+}
+
+void MappedFileStreamWriter::releaseTail(size_t length)
+{
+using namespace debug;
+
+	size_t pageSize=(size_t)sysconf(_SC_PAGESIZE);
+	size_t keep=(length+pageSize-1)/pageSize*pageSize;
+	for(size_t i=0; i<mappings.size(); ++i)
+	{
+		char * addr=mappings[i].first;
+		size_t size=mappings[i].second;
+		if(size<=keep)
+			continue;
+		// the range stays reserved so substreams read zeros rather than
+		// crash and the destructor can unmap the whole mapping as before
+		if(mmap(addr+keep, size-keep, PROT_READ, MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED,
+					-1, 0)==MAP_FAILED)
+		{
+			int err = errno;
+			kernelPrintDbg(DBG_ERR, "Unable to release mapping behind "<<keep<<
+					"B (\""<<strerror(err)<<"\")");
+		}
+	}
+}
+
+bool MappedFileStreamWriter::write(const char * buf, size_t length)
+{
+using namespace debug;
+
+	size_t totalWriten=0;
+	while(totalWriten<length)
+	{
+		ssize_t writen=pwrite(fd, buf+totalWriten, length-totalWriten, pos);
+		if(writen<=0)
+		{
+			int err = errno;
+			if(writen<0 && err==EINTR)
+				continue;
+			kernelPrintDbg(DBG_ERR, "Write error \"" << strerror(err) << "\"");
+			return false;
+		}
+		totalWriten+=writen;
+		pos+=(Guint)writen;
+	}
+	if(pos>fileLength)
+		fileLength=pos;
+	return true;
+}
+
+void MappedFileStreamWriter::putChar(int ch)
+{
+	char c=(char)ch;
+	write(&c, 1);
+}
+
+void MappedFileStreamWriter::putLine(const char * line, size_t length)
+{
+	if(!line)
+		return;
+	if(write(line, length))
+		putChar(0xA);
+}
+
+bool MappedFileStreamWriter::trim(size_t offset)
+{
+using namespace debug;
+
+	kernelPrintDbg(DBG_DBG, "Triming all data behind absolute file offset="<<start+offset);
+	releaseTail(start+offset);
+	if(ftruncate(fd, start+offset)==-1)
+	{
+		int err = errno;
+		kernelPrintDbg(DBG_ERR, "Unable to truncate trailing data from "<<start+offset<<
+				"B (\""<< strerror(err)<<"\")");
+		return false;
+	}
+	fileLength=(Guint)(start+offset);
+	if(pos>fileLength)
+		pos=fileLength;
+	// mapping behind file end can't be accessed anymore and we have to
+	// map again if the file grows
+	if(mapped>fileLength)
+		mapped=fileLength;
+	return true;
+}
+
+size_t MappedFileStreamWriter::cloneToFile(FILE * file, size_t startA, size_t length)
+{
+using namespace debug;
+
+	if(!file || startA>=fileLength || !ensureMapped())
+		return 0;
+
+	kernelPrintDbg(DBG_DBG, "start="<<startA<<" length="<<length);
+	if(!length || length>fileLength-startA)
+		length=fileLength-startA;
+	size_t totalWriten=fwrite(data+startA, sizeof(char), length, file);
+	if(totalWriten<length)
+	{
+		int err = errno;
+		kernelPrintDbg(DBG_ERR, "Write error \"" << strerror(err) << "\"");
+	}
+	pos=(Guint)(startA+totalWriten);
+	kernelPrintDbg(DBG_INFO, totalWriten<<" bytes written to output file");
+	return totalWriten;
+}
+
+Stream * MappedFileStreamWriter::makeSubStream(Guint startA, GBool limitedA,
+		Guint lengthA, const Object *dictA)
+{
+	ensureMapped();
+	Guint end=std::min(fileLength, (Guint)mapped);
+	if(startA>end)
+		startA=end;
+	Guint newLength;
+	if(!limitedA || startA+lengthA>end)
+		newLength=end-startA;
+	else
+		newLength=lengthA;
+	return new MappedStream(data, startA, newLength, dictA);
+}
+
+Stream * MappedFileStreamWriter::clone()
+{
+	if(!ensureMapped())
+		return NULL;
+	Guint length=fileLength-start;
+	char * buffer=(char *)gmalloc(sizeof(char)*(length+1));
+	memcpy(buffer, data+start, length);
+	buffer[length]='\0';
+	Object * cloneDict=dict.clone();
+	MemStream * cloneStream=new MemStream(buffer, 0, length, cloneDict, true);
+	// MemStream uses shallow copy of stream dictionary (see MemStream::clone)
+	gfree(cloneDict);
+	return cloneStream;
+}
+
+void MappedFileStreamWriter::setPos(Guint offset, int dir)
+{
+	if(dir>=0)
+	{
+		// same as FileStream - position behind the end is allowed for
+		// writing
+		pos=offset;
+		return;
+	}
+	pos=(offset>fileLength)?0:fileLength-offset;
+	if(pos<start)
+		pos=start;
+}
+
+void MappedFileStreamWriter::moveStart(int delta)
+{
+	start+=delta;
+	pos=start;
+}
+#endif
@@ -208,4 +208,395 @@ public:
 	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
 };
 
+/** Buffered FileStream writer.
+ *
+ * FileStreamWriter flushes the file after each write operation which is 
+ * really slow when a lot of small pieces of data (e.g. whole document 
+ * content) are written. This writer collects written data in the user space
+ * buffer and writes them to the file only when the buffer is full, when
+ * the stream is read or repositioned or when flush is called explicitly. 
+ * So the only fflush is done by flush (which is called when a revision is
+ * stored).
+ * <br>
+ * cloneToFile uses sendfile if it is available so cloned data don't have
+ * to be copied through the user space.
+ */
+class BufferedFileStreamWriter: public FileStreamWriter
+{
+	/** Data which have not been written to the file yet. */
+	mutable std::vector<char> buffer;
+
+	/** File offset where buffer content belongs to. */
+	mutable Guint bufferStart;
+
+	/** Maximal size of the buffer. */
+	size_t capacity;
+
+	/** Writes buffer content to the file.
+	 *
+	 * Stream position is set behind written data.
+	 */
+	void writeBuffer()const;
+
+	/** Writes buffer content to the file if there is any.
+	 */
+	void flushBuffer()const
+	{
+		if(!buffer.empty())
+			writeBuffer();
+	}
+
+	/** Adds data to the buffer at the current position.
+	 * @param data Data to be written.
+	 * @param length Number of bytes.
+	 */
+	void write(const char * data, size_t length);
+public:
+	/** Default size of the buffer. */
+	static const size_t DEFAULT_CAPACITY = 1024*1024;
+
+	/** Costructor.
+	 * @param fA File handle for stream.
+	 * @param startA Start offset in the file.
+	 * @param limitedA Limited flag for stream (true if stream has limited
+	 * size).
+	 * @param lengthA Length of the stream (ignored if limitedA is false).
+	 * @param dictA Dictionary for the stream (should be initialized as NULL
+	 * object).
+	 * @param capacityA Size of the buffer.
+	 *
+	 * @see FileStreamWriter::FileStreamWriter
+	 */
+	BufferedFileStreamWriter(FILE *fA, Guint startA, GBool limitedA, Guint lengthA, 
+			Object * dictA, size_t capacityA = DEFAULT_CAPACITY)
+		: BaseStream(dictA),
+		  StreamWriter(dictA),
+		  FileStreamWriter(fA, startA, limitedA, lengthA, dictA),
+		  bufferStart(0),
+		  capacity(capacityA)
+		  {}
+
+	/** Destructor.
+	 *
+	 * Writes buffered data to the file. Doesn't close the file handle (see
+	 * FileStreamWriter::~FileStreamWriter).
+	 */
+	virtual ~BufferedFileStreamWriter()
+	{
+		flushBuffer();
+	}
+
+	/** Puts character to the buffer.
+	 * @param ch Character to write.
+	 *
+	 * Position is moved after inserted character.
+	 */
+	virtual void putChar(int ch);
+
+	/** Puts exactly length number of byte to the buffer.
+	 * @param line Line buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 *
+	 * Appends LF after given string and moves position after it.
+	 */
+	virtual void putLine(const char * line, size_t length);
+
+	/** Writes buffered data and removes all data behind given position.
+	 * @param pos Stream offset where to start removing.
+	 * @see FileStreamWriter::trim
+	 */
+	virtual bool trim(size_t pos)
+	{
+		flushBuffer();
+		return FileStreamWriter::trim(pos);
+	}
+
+	/** Writes buffered data and flushes the file.
+	 */
+	virtual void flush()const
+	{
+		flushBuffer();
+		FileStreamWriter::flush();
+	}
+
+	/** Duplicates content to given file.
+	 * @param file File where to put duplicated content.
+	 * @param start Position where to start duplication.
+	 * @param length Number of bytes to be duplicated.
+	 *
+	 * Buffered data are written at first. Data are copied directly by 
+	 * kernel (sendfile) if possible.
+	 *
+	 * @see FileStreamWriter::cloneToFile
+	 * @return number of bytes writen to given file.
+	 */ 
+	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
+
+	// all reading methods have to write buffered data at first
+	virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, const Object *dictA)
+	{
+		flushBuffer();
+		return FileStreamWriter::makeSubStream(startA, limitedA, lengthA, dictA);
+	}
+	virtual void reset()
+	{
+		flushBuffer();
+		FileStreamWriter::reset();
+	}
+	virtual void close()
+	{
+		flushBuffer();
+		FileStreamWriter::close();
+	}
+	virtual Stream * clone()
+	{
+		flushBuffer();
+		return FileStreamWriter::clone();
+	}
+	virtual int getChar()
+	{
+		flushBuffer();
+		return FileStreamWriter::getChar();
+	}
+	virtual int lookChar()
+	{
+		flushBuffer();
+		return FileStreamWriter::lookChar();
+	}
+	virtual int getBlock(char *blk, int size)
+	{
+		flushBuffer();
+		return FileStreamWriter::getBlock(blk, size);
+	}
+	virtual int getPos()const
+	{
+		if(!buffer.empty())
+			return (int)(bufferStart + (Guint)buffer.size());
+		return FileStreamWriter::getPos();
+	}
+	virtual void setPos(Guint pos, int dir = 0)
+	{
+		flushBuffer();
+		FileStreamWriter::setPos(pos, dir);
+	}
+	virtual void moveStart(int delta)
+	{
+		flushBuffer();
+		FileStreamWriter::moveStart(delta);
+	}
+};
+
+#ifdef HAVE_SYS_MMAN_H
+/** Stream over memory mapped file content.
+ *
+ * Substream created by MappedFileStreamWriter. It reads data directly from
+ * the mapping without any copying or system calls. Stream reports strFile
+ * kind because data are part of the document file (same as FileStream
+ * substreams) and so they can be copied without decoding (see
+ * NullFilterStreamWriter::isRawCopyable).
+ * <br>
+ * Note that the stream must not be used after its MappedFileStreamWriter
+ * has been destroyed (mapping is released then).
+ */
+class MappedStream: public MemStream
+{
+public:
+	/** Constructor.
+	 * @param bufA Start of the mapping.
+	 * @param startA Start offset of the stream in the mapping.
+	 * @param lengthA Length of the stream.
+	 * @param dictA Dictionary for the stream.
+	 */
+	MappedStream(const char * bufA, Guint startA, Guint lengthA, const Object * dictA)
+		: BaseStream(dictA),
+		  MemStream(const_cast<char *>(bufA), startA, lengthA, dictA)
+		  {}
+
+	virtual StreamKind getKind()const { return strFile; }
+
+	virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, const Object *dictA);
+
+	/** Returns stream data.
+	 *
+	 * Data are directly in the mapping and so they are valid only while
+	 * the stream exists.
+	 * @return Pointer to the first byte of the stream.
+	 */
+	const char * getData()const
+	{
+		return buf+start;
+	}
+
+	/** Returns number of bytes in the stream.
+	 */
+	Guint getLength()const
+	{
+		return length;
+	}
+};
+
+/** Memory mapped file stream writer.
+ *
+ * Maps the whole file to the memory and all reading methods (and so also
+ * XRef, Lexer and Parser which use substreams) work directly with the
+ * mapping. Substreams are MappedStream instances which share the mapping.
+ * <br>
+ * Writes are done by pwrite on the file descriptor of the given file handle
+ * and the file is mapped again when data behind the current mapping are
+ * requested. Old mappings are kept until the writer is destroyed because
+ * some substreams may still use them.
+ * <br>
+ * Instances are created by getInstance factory method which returns NULL if
+ * the file can't be mapped (e.g. it is empty or it is not a regular file).
+ */
+class MappedFileStreamWriter: virtual public StreamWriter
+{
+	/** File handle (not closed by this class). */
+	FILE * f;
+
+	/** File descriptor of f. */
+	int fd;
+
+	/** All mappings created for the file (start, size). */
+	std::vector<std::pair<char *, size_t> > mappings;
+
+	/** Current (the biggest) mapping. */
+	char * data;
+
+	/** Size of the current mapping. */
+	size_t mapped;
+
+	/** Current file size. */
+	Guint fileLength;
+
+	/** Stream start offset. */
+	Guint start;
+
+	/** Current position. */
+	Guint pos;
+
+	/** Maps the whole file again.
+	 * @return true if mapping covers whole file, false otherwise.
+	 */
+	bool remap();
+
+	/** Makes sure that the current mapping covers whole file.
+	 * @return true if whole file is mapped.
+	 */
+	bool ensureMapped()
+	{
+		return (fileLength<=mapped) || remap();
+	}
+
+	/** Releases mapped pages behind given file size.
+	 * @param length New file size.
+	 *
+	 * Pages which would be completely behind the end of the file after
+	 * truncation are replaced by anonymous zero pages. Accessing file pages
+	 * behind the end of file raises SIGBUS and some substreams may still
+	 * point there.
+	 */
+	void releaseTail(size_t length);
+
+	/** Writes data at the current position.
+	 * @param buf Data to write.
+	 * @param length Number of bytes.
+	 * @return true if all data were written.
+	 */
+	bool write(const char * buf, size_t length);
+
+	/** Constructor.
+	 * @param fA File handle.
+	 * @param dictA Stream dictionary.
+	 *
+	 * Use getInstance to create instances.
+	 */
+	MappedFileStreamWriter(FILE * fA, Object * dictA);
+public:
+	/** Creates writer for given file.
+	 * @param fA File handle of the document.
+	 * @param dictA Dictionary for the stream (should be initialized as NULL
+	 * object).
+	 *
+	 * @return New instance or NULL if the file can't be mapped.
+	 */
+	static MappedFileStreamWriter * getInstance(FILE * fA, Object * dictA);
+
+	/** Destructor.
+	 *
+	 * Releases all mappings. Doesn't close the file handle (see
+	 * FileStreamWriter::~FileStreamWriter).
+	 */
+	virtual ~MappedFileStreamWriter();
+
+	/** Puts character at the current position.
+	 * @param ch Character to write.
+	 */
+	virtual void putChar(int ch);
+
+	/** Puts exactly length number of byte and LF at the current position.
+	 * @param line Line buffer pointer.
+	 * @param length Number of bytes to be printed.
+	 */
+	virtual void putLine(const char * line, size_t length);
+
+	/** Removes all data behind given position.
+	 * @param pos Stream offset where to start removing.
+	 * @see FileStreamWriter::trim
+	 */
+	virtual bool trim(size_t pos);
+
+	/** Data are written by pwrite directly so there is nothing to flush.
+	 */
+	virtual void flush()const {}
+
+	/** Duplicates content to given file.
+	 * @param file File where to put duplicated content.
+	 * @param start Position where to start duplication.
+	 * @param length Number of bytes to be duplicated (0 means until the end
+	 * of stream).
+	 *
+	 * Data are written directly from the mapping.
+	 * @return number of bytes writen to given file.
+	 */
+	virtual size_t cloneToFile(FILE * file, size_t start, size_t length);
+
+	virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, const Object *dictA);
+	virtual StreamKind getKind()const { return strFile; }
+	virtual void reset() { pos = start; }
+	virtual void close() {}
+	virtual Stream * clone();
+	virtual int getChar()
+	{
+		if(pos<fileLength && (pos<mapped || remap()))
+			return data[pos++] & 0xff;
+		return EOF;
+	}
+	virtual int lookChar()
+	{
+		if(pos<fileLength && (pos<mapped || remap()))
+			return data[pos] & 0xff;
+		return EOF;
+	}
+	virtual int getBlock(char *blk, int size)
+	{
+		// block may reach behind the current mapping even if pos doesn't
+		if(pos>=fileLength || size<=0 || (!ensureMapped() && pos>=mapped))
+			return 0;
+		size_t end=std::min((size_t)fileLength, mapped);
+		size_t length=std::min((size_t)size, end-pos);
+		memcpy(blk, data+pos, length);
+		pos+=(Guint)length;
+		return (int)length;
+	}
+	virtual int getPos()const { return (int)pos; }
+	virtual void setPos(Guint offset, int dir = 0);
+	virtual Guint getStart()const { return start; }
+	virtual void moveStart(int delta);
+};
+#endif
+
 #endif
@@ -0,0 +1,315 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#include "kernel/static.h"
+#include "kernel/xrefindex.h"
+
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace pdfobjects {
+
+using namespace debug;
+
+const char * XRefIndex::INDEX_SUFFIX = ".xrefidx";
+
+std::string XRefIndex::indexDirectory;
+
+namespace {
+
+/** Magic string at the beginning and the end of the index file. */
+const char INDEX_MAGIC[] = "PDFEDIT-XREFIDX1";
+
+/** Size of the magic string (without terminating 0). */
+const size_t INDEX_MAGIC_LEN = sizeof(INDEX_MAGIC)-1;
+
+/** Number of bytes from the beginning and the end of the file which are
+ * hashed to the key.
+ */
+const size_t HASH_BLOCK = 4096;
+
+/** Sizes of xref entry fields in the index file. */
+const size_t ENTRY_OFFSET_BYTES = 4;
+const size_t ENTRY_GEN_BYTES = 4;
+const size_t ENTRY_TYPE_BYTES = 1;
+
+/** Updates FNV-1a hash with given data. */
+unsigned hashData(unsigned hash, const unsigned char * buffer, size_t len)
+{
+	for(size_t i=0; i<len; ++i)
+	{
+		hash^=buffer[i];
+		hash*=16777619U;
+	}
+	return hash;
+}
+
+/** Hashes the first and the last HASH_BLOCK bytes of the file.
+ * The last block holds the most recent trailer and startxref, so it changes
+ * with each incremental update.
+ */
+unsigned hashFile(FILE * file, size_t fileSize)
+{
+	unsigned char buffer[HASH_BLOCK];
+	unsigned hash=2166136261U;
+
+	fseek(file, 0, SEEK_SET);
+	size_t len=fread(buffer, 1, sizeof(buffer), file);
+	hash=hashData(hash, buffer, len);
+	if(fileSize>HASH_BLOCK)
+	{
+		fseek(file, -(long)HASH_BLOCK, SEEK_END);
+		len=fread(buffer, 1, sizeof(buffer), file);
+		hash=hashData(hash, buffer, len);
+	}
+	return hash;
+}
+
+/** Writes number in little endian.
+ * @param file File to write to.
+ * @param value Number to write.
+ * @param bytes Number of bytes used for the value (at most 8).
+ */
+void writeNumber(FILE * file, size_t value, size_t bytes=8)
+{
+	unsigned char buffer[8];
+	for(size_t i=0; i<bytes; ++i)
+	{
+		buffer[i]=(unsigned char)(value & 0xff);
+		// shifted in two steps to be correct also for 32b size_t
+		value=(value>>4)>>4;
+	}
+	fwrite(buffer, 1, bytes, file);
+}
+
+/** Reads number written by writeNumber.
+ * @return false if there are no more data.
+ */
+bool readNumber(FILE * file, size_t & value, size_t bytes=8)
+{
+	unsigned char buffer[8];
+	if(fread(buffer, 1, bytes, file)!=bytes)
+		return false;
+	value=0;
+	for(size_t i=bytes; i>0; --i)
+		value=((value<<4)<<4)|buffer[i-1];
+	return true;
+}
+
+/** Reads and checks magic string. */
+bool readMagic(FILE * file)
+{
+	char buffer[INDEX_MAGIC_LEN];
+	if(fread(buffer, 1, INDEX_MAGIC_LEN, file)!=INDEX_MAGIC_LEN)
+		return false;
+	return !memcmp(buffer, INDEX_MAGIC, INDEX_MAGIC_LEN);
+}
+
+/** Reads content of the index file.
+ * @return true if the whole content has been read and key matches.
+ */
+bool readIndex(FILE * file, const XRefIndex::Key & key, XRefIndex::Data & data)
+{
+	if(!readMagic(file))
+		return false;
+
+	size_t fileSize, mtime, hash;
+	if(!readNumber(file, fileSize) || !readNumber(file, mtime) || !readNumber(file, hash))
+		return false;
+	if(fileSize!=key.fileSize || mtime!=key.mtime || hash!=key.hash)
+	{
+		kernelPrintDbg(DBG_INFO, "Index key doesn't match the file.");
+		return false;
+	}
+
+	size_t count;
+	if(!readNumber(file, data.lastXRefPos) || !readNumber(file, data.maxObj)
+			|| !readNumber(file, count))
+		return false;
+	data.revisions.resize(count);
+	for(size_t i=0; i<count; ++i)
+		if(!readNumber(file, data.revisions[i]))
+			return false;
+
+	if(!readNumber(file, count))
+		return false;
+	data.trailer.resize(count);
+	if(count && fread(&data.trailer[0], 1, count, file)!=count)
+		return false;
+
+	if(!readNumber(file, count) || !count || count>(size_t)INT_MAX)
+		return false;
+	data.entries.resize(count);
+	for(size_t i=0; i<count; ++i)
+	{
+		size_t offset, gen, type;
+		if(!readNumber(file, offset, ENTRY_OFFSET_BYTES) 
+				|| !readNumber(file, gen, ENTRY_GEN_BYTES)
+				|| !readNumber(file, type, ENTRY_TYPE_BYTES))
+			return false;
+		if(type>xrefEntryCompressed)
+			return false;
+		data.entries[i].offset=(Guint)offset;
+		data.entries[i].gen=(int)(unsigned)gen;
+		data.entries[i].type=(XRefEntryType)type;
+	}
+
+	// the index is written completely only if it ends with the magic
+	return readMagic(file);
+}
+
+/** Writes index content.
+ * @return true if all data have been written.
+ */
+bool writeIndex(FILE * file, const XRefIndex::Key & key, const XRefIndex::Data & data)
+{
+	fwrite(INDEX_MAGIC, 1, INDEX_MAGIC_LEN, file);
+	writeNumber(file, key.fileSize);
+	writeNumber(file, key.mtime);
+	writeNumber(file, key.hash);
+
+	writeNumber(file, data.lastXRefPos);
+	writeNumber(file, data.maxObj);
+	writeNumber(file, data.revisions.size());
+	for(size_t i=0; i<data.revisions.size(); ++i)
+		writeNumber(file, data.revisions[i]);
+
+	writeNumber(file, data.trailer.size());
+	fwrite(data.trailer.data(), 1, data.trailer.size(), file);
+
+	writeNumber(file, data.entries.size());
+	for(size_t i=0; i<data.entries.size(); ++i)
+	{
+		const XRefEntry & entry=data.entries[i];
+		writeNumber(file, entry.offset, ENTRY_OFFSET_BYTES);
+		writeNumber(file, (unsigned)entry.gen, ENTRY_GEN_BYTES);
+		writeNumber(file, entry.type, ENTRY_TYPE_BYTES);
+	}
+	fwrite(INDEX_MAGIC, 1, INDEX_MAGIC_LEN, file);
+
+	return !ferror(file);
+}
+
+} // annonymous namespace
+
+void XRefIndex::setIndexDirectory(const std::string & dir)
+{
+	kernelPrintDbg(DBG_INFO, "Index directory set to \""<<dir<<"\"");
+	indexDirectory=dir;
+}
+
+std::string XRefIndex::getIndexFileName(const std::string & filename)
+{
+	if(indexDirectory.empty())
+		return filename+INDEX_SUFFIX;
+
+#ifdef WIN32
+	std::string::size_type sep=filename.find_last_of("/\\");
+#else
+	std::string::size_type sep=filename.rfind('/');
+#endif
+	std::string baseName=(sep==std::string::npos)?filename:filename.substr(sep+1);
+	return indexDirectory+"/"+baseName+INDEX_SUFFIX;
+}
+
+XRefIndex * XRefIndex::getInstance(FILE * file, const std::string & indexName)
+{
+	struct stat st;
+	if(fstat(fileno(file), &st))
+	{
+		kernelPrintDbg(DBG_WARN, "Unable to stat indexed file (reason="<<strerror(errno)<<")");
+		return NULL;
+	}
+
+	long pos=ftell(file);
+	Key key;
+	key.fileSize=(size_t)st.st_size;
+	key.mtime=(size_t)st.st_mtime;
+	key.hash=hashFile(file, key.fileSize);
+	fseek(file, pos, SEEK_SET);
+
+	return new XRefIndex(indexName, key);
+}
+
+bool XRefIndex::load()
+{
+	FILE * file=fopen(indexName.c_str(), "rb");
+	if(!file)
+	{
+		kernelPrintDbg(DBG_DBG, "No index file "<<indexName);
+		return false;
+	}
+	loaded=readIndex(file, key, data);
+	fclose(file);
+	if(!loaded)
+	{
+		kernelPrintDbg(DBG_WARN, "Index file "<<indexName<<" is not usable");
+		data=Data();
+		return false;
+	}
+	kernelPrintDbg(DBG_INFO, "Index file "<<indexName<<" loaded ("<<data.entries.size()<<" entries)");
+	return true;
+}
+
+bool XRefIndex::store(const Data & dataA)const
+{
+	// temporary file name is unique for the process, so concurrent writers
+	// don't overwrite each other's data
+	std::ostringstream tempName;
+	tempName<<indexName<<".tmp"<<getpid();
+	std::string tmp=tempName.str();
+
+	FILE * file=fopen(tmp.c_str(), "wb");
+	if(!file)
+	{
+		kernelPrintDbg(DBG_WARN, "Unable to create index file "<<tmp<<" (reason="<<strerror(errno)<<")");
+		return false;
+	}
+	bool result=writeIndex(file, key, dataA);
+	if(fclose(file) || !result)
+	{
+		kernelPrintDbg(DBG_WARN, "Unable to write index file "<<tmp);
+		remove(tmp.c_str());
+		return false;
+	}
+
+#ifdef WIN32
+	// rename doesn't replace existing files on windows
+	remove(indexName.c_str());
+#endif
+	if(rename(tmp.c_str(), indexName.c_str()))
+	{
+		kernelPrintDbg(DBG_WARN, "Unable to rename "<<tmp<<" to "<<indexName<<" (reason="<<strerror(errno)<<")");
+		remove(tmp.c_str());
+		return false;
+	}
+	kernelPrintDbg(DBG_INFO, "Index file "<<indexName<<" stored ("<<dataA.entries.size()<<" entries)");
+	return true;
+}
+
+} // namespace pdfobjects
@@ -0,0 +1,187 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _XREFINDEX_H_
+#define _XREFINDEX_H_
+
+#include "kernel/static.h"
+
+/**
+ * @file xrefindex.h
+ *
+ * Persistent index of the cross reference table.
+ */
+
+namespace pdfobjects {
+
+/** Persistent (sidecar file) index of the cross reference table.
+ *
+ * Keeps already parsed xref entries, the most recent trailer and revisions
+ * of a pdf file in a separate file, so that the document doesn't have to
+ * parse all its xref sections when it is opened again.
+ * <br>
+ * Index is bound to the indexed file by the key composed of the file size,
+ * its modification time and hash of its beginning and end. Index with
+ * different key is ignored (and overwritten when stored) - this happens
+ * e.g. when changes are saved to the file.
+ * <br>
+ * Index files are stored next to indexed files by default. Another
+ * directory can be set by setIndexDirectory (e.g. when indexed files are
+ * on read-only media).
+ * <br>
+ * Instances are used only during CPdf construction (see
+ * CPdf::IndexedXRef).
+ */
+class XRefIndex: boost::noncopyable
+{
+public:
+	/** Suffix of the index file name. */
+	static const char * INDEX_SUFFIX;
+
+	/** Identification of the indexed file. */
+	struct Key
+	{
+		size_t fileSize;
+		size_t mtime;
+		unsigned hash;
+	};
+
+	/** Indexed data.
+	 */
+	struct Data
+	{
+		/** Position of the most recent xref section. */
+		size_t lastXRefPos;
+		/** Maximum present indirect object number. */
+		size_t maxObj;
+		/** Xref entries. */
+		std::vector<XRefEntry> entries;
+		/** The most recent trailer dictionary in pdf syntax. */
+		std::string trailer;
+		/** Xref section positions of all revisions (the oldest first). */
+		std::vector<size_t> revisions;
+	};
+private:
+	/** Index file name. */
+	std::string indexName;
+
+	/** Key of the indexed file. */
+	Key key;
+
+	/** Data loaded by load. */
+	Data data;
+
+	/** Flag for successfully loaded data. */
+	bool loaded;
+
+	/** Directory for index files (empty for the directory of the indexed
+	 * file).
+	 */
+	static std::string indexDirectory;
+
+	XRefIndex(const std::string & indexNameA, const Key & keyA)
+		:indexName(indexNameA), key(keyA), loaded(false) {}
+public:
+	/** Creates index for given file.
+	 * @param file Indexed file.
+	 * @param indexName Name of the index file.
+	 *
+	 * Computes key of the file content. Position in the file is kept.
+	 *
+	 * @return Index instance (allocated by new) or NULL if the file can't
+	 * be identified.
+	 */
+	static XRefIndex * getInstance(FILE * file, const std::string & indexName);
+
+	/** Sets directory where index files are stored.
+	 * @param dir Directory name (empty string for the directory of the
+	 * indexed file).
+	 *
+	 * Index files in the directory are named by base names of indexed
+	 * files, so files with the same name share the index file. This is
+	 * safe because the key doesn't match then, the index is just created
+	 * again.
+	 * <br>
+	 * Not synchronized, should be set before documents are opened.
+	 */
+	static void setIndexDirectory(const std::string & dir);
+
+	/** Gets directory where index files are stored.
+	 * @return Directory name (empty by default).
+	 */
+	static const std::string & getIndexDirectory()
+	{
+		return indexDirectory;
+	}
+
+	/** Returns index file name for given file.
+	 * @param filename Indexed file name.
+	 * @return filename with INDEX_SUFFIX if no index directory is set,
+	 * base name of the filename with INDEX_SUFFIX in the index directory
+	 * otherwise.
+	 */
+	static std::string getIndexFileName(const std::string & filename);
+
+	/** Returns index file name. */
+	const std::string & getIndexName()const
+	{
+		return indexName;
+	}
+
+	/** Loads data from the index file.
+	 *
+	 * @return true if the index file exists, it is valid and its key matches
+	 * the indexed file, false otherwise.
+	 */
+	bool load();
+
+	/** Returns true if data has been loaded by load method. */
+	bool isLoaded()const
+	{
+		return loaded;
+	}
+
+	/** Returns loaded data.
+	 * Meaningful only if isLoaded returns true.
+	 */
+	const Data & getData()const
+	{
+		return data;
+	}
+
+	/** Stores given data to the index file.
+	 * @param dataA Data to store.
+	 *
+	 * Data are written to a temporary file which replaces the index file
+	 * when it is complete, so readers never see a partially written index.
+	 *
+	 * @return true on success, false if the index file can't be written.
+	 */
+	bool store(const Data & dataA)const;
+};
+
+} // namespace pdfobjects
+
+#endif // _XREFINDEX_H_
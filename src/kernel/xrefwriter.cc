@@ -30,6 +30,8 @@
 #include "kernel/streamwriter.h"
 #include "kernel/pdfwriter.h"
 #include "kernel/factories.h"
+#include <algorithm>
+#include <set>
 
 using namespace debug;
 
@@ -139,10 +141,180 @@ malformedErr:
 
 bool isLatestRevision(const XRefWriter &xref)
 {
+	// revisions are collected before the revision can be changed, so 
+	// the most recent one is used until then
+	if(!xref.hasCollectedRevisions())
+		return true;
+
 	// The most recent revision has the highest number
 	return xref.getActualRevision() == xref.getRevisionCount()-1;
 }
 
+namespace {
+
+/** Position of an object in the file used for reachable objects sorting.
+ * Objects from object streams are placed behind their object stream
+ * ordered by their index. Objects unknown to the xref table are the last
+ * ones ordered by their number.
+ */
+typedef std::pair<std::pair<Guint, int>, ::Ref> RefPosition;
+
+RefPosition getRefPosition(const ::XRef &xref, const ::Ref &ref)
+{
+	Guint offset = UINT_MAX;
+	int index = ref.num;
+	if(ref.num < xref.getSize())
+	{
+		const XRefEntry *entry = xref.getEntry(ref.num);
+		switch(entry->type)
+		{
+			case xrefEntryUncompressed:
+				offset = entry->offset;
+				index = 0;
+				break;
+			case xrefEntryCompressed:
+				// offset is the object stream number and gen is
+				// the index inside
+				if((int)entry->offset < xref.getSize())
+				{
+					offset = xref.getEntry(entry->offset)->offset;
+					index = entry->gen + 1;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return RefPosition(std::make_pair(offset, index), ref);
+}
+
+bool lessRefPosition(const RefPosition &p1, const RefPosition &p2)
+{
+	if(p1.first != p2.first)
+		return p1.first < p2.first;
+	return p1.second.num < p2.second.num;
+}
+
+/** Pushes all direct values of the given composite object to the stack.
+ * Values which can't contain references are not pushed at all. Values are
+ * pushed in the reverse order so that they are popped in the original one.
+ */
+void pushChildren(const ::Object &obj, std::vector< ::Object> &stack)
+{
+	const Dict *dict = NULL;
+	switch(obj.getType())
+	{
+		case objArray:
+			for(int i=obj.arrayGetLength()-1; i>=0; --i)
+			{
+				stack.push_back(::Object());
+				if(!obj.arrayGetNF(i, &stack.back()))
+				{
+					stack.pop_back();
+					utilsPrintDbg(debug::DBG_ERR, "Unable to get array entry");
+					throw MalformedFormatExeption("bad data stream");
+				}
+			}
+			return;
+		case objDict:
+			dict = obj.getDict();
+			break;
+		case objStream:
+			dict = obj.streamGetDict();
+			break;
+		default:
+			return;
+	}
+	for(int i=dict->getLength()-1; i>=0; --i)
+	{
+		stack.push_back(::Object());
+		if(!dict->getValNF(i, &stack.back()))
+		{
+			stack.pop_back();
+			utilsPrintDbg(debug::DBG_ERR, "Unable to get dictionary entry with index "<<i);
+			throw MalformedFormatExeption("bad data stream");
+		}
+	}
+}
+
+} // annonymous namespace
+
+void collectReachableRefs(::XRef &xref, const ::Object &root, 
+		std::vector< ::Ref> &refList, bool sortByOffset)
+{
+	refList.clear();
+
+	// already seen objects (indexed by object number) - objects behind the
+	// xref size (new objects or dangling references with arbitrary numbers)
+	// are tracked separately, so the bitmap is never bigger than the table
+	std::vector<bool> visited(xref.getSize(), false);
+	std::set<int> visitedOutside;
+
+	// objects which still have to be examined - they are owned by the stack
+	std::vector< ::Object> stack;
+	stack.push_back(::Object());
+	root.copy(&stack.back());
+	try
+	{
+		while(!stack.empty())
+		{
+			::Object obj = stack.back();
+			stack.pop_back();
+			if(!obj.isRef())
+			{
+				try
+				{
+					pushChildren(obj, stack);
+				}catch(...)
+				{
+					obj.free();
+					throw;
+				}
+				obj.free();
+				continue;
+			}
+
+			::Ref ref = obj.getRef();
+			if(ref.num < 0)
+				continue;
+			// check for already seen referencies and skip them
+			if((size_t)ref.num < visited.size())
+			{
+				if(visited[ref.num])
+					continue;
+				visited[ref.num] = true;
+			}else if(!visitedOutside.insert(ref.num).second)
+				continue;
+			refList.push_back(ref);
+
+			stack.push_back(::Object());
+			if(!obj.fetch(&xref, &stack.back()) || !xref.isOk())
+			{
+				stack.pop_back();
+				kernelPrintDbg(debug::DBG_ERR, ref<<" object fetching failed with code="
+						<<xref.getErrorCode());
+				throw MalformedFormatExeption("bad data stream");
+			}
+		}
+	}catch(...)
+	{
+		for(std::vector< ::Object>::iterator i=stack.begin(); i!=stack.end(); ++i)
+			i->free();
+		throw;
+	}
+
+	if(!sortByOffset)
+		return;
+
+	std::vector<RefPosition> positions;
+	positions.reserve(refList.size());
+	for(std::vector< ::Ref>::const_iterator i=refList.begin(); i!=refList.end(); ++i)
+		positions.push_back(getRefPosition(xref, *i));
+	std::sort(positions.begin(), positions.end(), lessRefPosition);
+	for(size_t i=0; i<positions.size(); ++i)
+		refList[i] = positions[i].second;
+}
+
 } // end of utils namespace
 
 XRefWriter::XRefWriter(StreamWriter * stream, CPdf * _pdf)
@@ -150,7 +322,24 @@ XRefWriter::XRefWriter(StreamWriter * stream, CPdf * _pdf)
 	mode(paranoid), 
 	pdf(_pdf), 
 	revision(0), 
+	revisionsCollected(false),
+	pdfWriter(new utils::OldStylePdfWriter())
+{
+	initWriter(*stream, xrefLoadAll, NULL);
+}
+
+XRefWriter::XRefWriter(StreamWriter * stream, CPdf * _pdf, XRefLoading loading, XRefIndex * index)
+	:CXref(stream, loading, index), 
+	mode(paranoid), 
+	pdf(_pdf), 
+	revision(0), 
+	revisionsCollected(false),
 	pdfWriter(new utils::OldStylePdfWriter())
+{
+	initWriter(*stream, loading, index);
+}
+
+void XRefWriter::initWriter(StreamWriter & stream, XRefLoading loading, XRefIndex * index)
 {
 	// gets storePos
 	// searches %%EOF element from startxref position.
@@ -165,20 +354,60 @@ XRefWriter::XRefWriter(StreamWriter * stream, CPdf * _pdf)
 	// documents because only strings are encrypted and the
 	// Linearized entry is the name object
 	Ref linearizedRef;
-	linearized=utils::checkLinearized(*stream, this, &linearizedRef);
+	linearized=utils::checkLinearized(stream, this, &linearizedRef);
 	if(linearized)
 		kernelPrintDbg(DBG_DBG, "Pdf content is linearized. Linearized dictionary "<<linearizedRef);
 
-	// revisions can be collected also for encrypted documents, because
-	// we are parsing only trailer which doesn't contain any directly
-	// encrypted data - strings
-	// revision is initialized to the most recent one
-	collectRevisions();
+	if(index && index->isLoaded() && !index->getData().revisions.empty())
+	{
+		// index is valid for this file so its revisions are as well
+		revisions=index->getData().revisions;
+		revision=(unsigned)(revisions.size()-1);
+		revisionsCollected=true;
+		kernelPrintDbg(DBG_INFO, "This document contains "<<revisions.size()<<" revisions (from index).");
+	}else if(loading==xrefLoadAll || index)
+	{
+		// revisions can be collected also for encrypted documents, because
+		// we are parsing only trailer which doesn't contain any directly
+		// encrypted data - strings
+		// revision is initialized to the most recent one
+		collectRevisions();
+	}
+
+	// index wasn't usable so it is created from the freshly parsed xref
+	if(index && !index->isLoaded())
+		storeIndex(*index);
 
 	// sets internal fetch back to normal
 	disableInternalFetch();
 }
 
+void XRefWriter::storeIndex(const XRefIndex & index)const
+{
+	// makes the xref table complete
+	readAllXRef();
+	if(!isOk() || streamEndsLen)
+	{
+		kernelPrintDbg(DBG_WARN, "Xref is damaged. Index is not stored.");
+		return;
+	}
+
+	XRefIndex::Data data;
+	data.lastXRefPos=lastXRefPos;
+	data.maxObj=maxObj;
+	data.entries.assign(entries, entries+size);
+	data.revisions=revisions;
+	Object * trailer=XRef::getTrailerDict()->clone();
+	if(!trailer)
+	{
+		kernelPrintDbg(DBG_ERR, "Unable to clone trailer. Index is not stored.");
+		return;
+	}
+	utils::xpdfObjToString(*trailer, data.trailer);
+	xpdf::freeXpdfObject(trailer);
+	index.store(data);
+}
+
 XRefWriter::~XRefWriter()
 {
 	kernelPrintDbg(debug::DBG_DBG, "");
@@ -472,91 +701,6 @@ RefState XRefWriter::knowsRef(const IndiRef& ref)const
 }
 
 //peskova
-void collectDictRefElems(::XRef &xref, const ::Dict &dict, XRefWriter::RefList &refList);
-
-bool operator==(const ::Ref& r1, const ::Ref& r2)
-{
-	return r1.num == r2.num && r1.gen== r2.gen;
-}
-
-bool containsRef(const XRefWriter::RefList & refList, const ::Ref& ref)
-{
-	XRefWriter::RefList::const_iterator i;
-	for(i=refList.begin(); i!=refList.end(); ++i)
-		if(*i == ref)
-			return true;
-	return false;
-}
-
-void collectReachableRefs(XRef& xref, const ::Object &obj, XRefWriter::RefList &refList)
-{
-	switch(obj.getType())
-	{
-		case objArray:
-		{
-			boost::shared_ptr< ::Object> elem(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-			for(int i=0; i<obj.arrayGetLength(); i++)
-			{
-				if(!obj.arrayGetNF(i, elem.get()))
-				{
-					utilsPrintDbg(debug::DBG_ERR, "Unable to get array entry");
-					throw MalformedFormatExeption("bad data stream");
-				}
-				collectReachableRefs(xref, *elem, refList);
-				elem->free();
-			}
-			break;
-		}
-		case objDict:
-		{
-			const Dict *dict = obj.getDict();
-			collectDictRefElems(xref, *dict, refList);
-			break;
-		}
-		case objStream:
-		{
-			const Dict *streamDict = obj.streamGetDict();
-			collectDictRefElems(xref, *streamDict, refList);
-			break;
-		}
-		case objRef:
-		{
-			::Ref ref = obj.getRef();
-			// check for already seen referencies and skip them
-			if (containsRef(refList, ref))
-				return;
-			// TODO should be sorted by offset to keep the same
-			// ordering in the file as the original document
-			refList.push_back(ref);
-			boost::shared_ptr< ::Object> target(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-			if(!obj.fetch(&xref, target.get()) || !xref.isOk())
-			{
-				kernelPrintDbg(debug::DBG_ERR, ref<<" object fetching failed with code="
-						<<xref.getErrorCode());
-				throw MalformedFormatExeption("bad data stream");
-			}
-			collectReachableRefs(xref, *target, refList);
-			break;
-		}
-		default:
-			// nothing really interesting here
-			break;
-	}
-}
-void collectDictRefElems(::XRef &xref, const ::Dict &dict, XRefWriter::RefList &refList)
-{
-	boost::shared_ptr< ::Object> elem(XPdfObjectFactory::getInstance(), xpdf::object_deleter());
-	for(int i=0; i<dict.getLength(); i++)
-	{
-		if(!dict.getValNF(i, elem.get()))
-		{
-			utilsPrintDbg(debug::DBG_ERR, "Unable to get dictionary entry with index "<<i);
-			throw MalformedFormatExeption("bad data stream");
-		}
-		collectReachableRefs(xref, *elem, refList);
-		elem->free();
-	}
-}
 int XRefWriter::fillObjectList(pdfobjects::utils::IPdfWriter::ObjectList &objectList, int maxObjectCount)
 {
 	using namespace utils;
@@ -574,22 +718,29 @@ int XRefWriter::fillObjectList(pdfobjects::utils::IPdfWriter::ObjectList &object
 		if(maxObjectCount>0 && objectList.size()>=(size_t)maxObjectCount)
 			break;
 
-		::Object * obj=XPdfObjectFactory::getInstance();
-		XRef::fetch(num, gen, obj);
-		//if (obj->isNull())
+		// changed objects are taken directly from the changedStorage, so the
+		// original value doesn't have to be parsed at all
+		::Object * obj;
+		ObjectEntry * entry=changedStorage.get(ref);
+		if(entry && entry->object)
 		{
-			//try to look in the changed things
-			ChangedStorage::Iterator i;
-			for(i=changedStorage.begin(); i!=changedStorage.end(); ++i)
-				if (i->first == ref)
-					obj = i->second->object->clone();
-		}
-		if(!isOk())
+			obj = entry->object->clone();
+			if(!obj)
+			{
+				kernelPrintDbg(debug::DBG_ERR, ref<<" changed object can't be cloned");
+				throw NotImplementedException("clone failure.");
+			}
+		}else
 		{
-			kernelPrintDbg(debug::DBG_ERR, ref<<" object fetching failed with code="
-					<<errCode);
-			xpdf::freeXpdfObject(obj);
-			throw MalformedFormatExeption("bad data stream");
+			obj=XPdfObjectFactory::getInstance();
+			XRef::fetch(num, gen, obj);
+			if(!isOk())
+			{
+				kernelPrintDbg(debug::DBG_ERR, ref<<" object fetching failed with code="
+						<<errCode);
+				xpdf::freeXpdfObject(obj);
+				throw MalformedFormatExeption("bad data stream");
+			}
 		}
 		objectList.push_back(IPdfWriter::ObjectElement(ref, obj));
 	}
@@ -605,7 +756,7 @@ void XRefWriter::initReachableObjects()
 	// to the reachAbleRefs - this should provide complete list of all objects
 	// required for document
 	const Object *trailer = getTrailerDict();
-	collectReachableRefs(*this, *trailer, reachAbleRefs);
+	utils::collectReachableRefs(*this, *trailer, reachAbleRefs);
 	utilsPrintDbg(debug::DBG_INFO, reachAbleRefs.size()<<" indirect objects collected");
 	lastIndex=0;
 }
@@ -641,7 +792,7 @@ using namespace utils;
 	// creates outputStream writer from given file
 	Object dict;
 	boost::shared_ptr<StreamWriter> outputStream(
-			new FileStreamWriter(file, 0, false, 0, &dict));
+			new BufferedFileStreamWriter(file, 0, false, 0, &dict));
 
 	// Writes header with the same PDF version
 	pdfWriter->ignore_stream( true );
@@ -726,19 +877,14 @@ FILE * file = fopen(name,"wb");
 
 	StreamWriter * streamWriter=dynamic_cast<StreamWriter *>(XRef::str);
 
-	size_t pos=0;
-	size_t written;
-	do
-	{
-		written = streamWriter->cloneToFile(file,pos,10000);
-		pos += written;
-	}
-	while ( written !=0);
+	// copies whole original content at once (length 0 means until the end)
+	streamWriter->cloneToFile(file, 0, 0);
 
 	//uloz tiez vsetky zmeny
 	Object nl;
 	nl.initNull();
-	StreamWriter * nStream=new FileStreamWriter(file, 0, gFalse, 0, &nl); //TODO zapamataj odznova
+	boost::shared_ptr<StreamWriter> nStream(
+			new BufferedFileStreamWriter(file, 0, gFalse, 0, &nl)); //TODO zapamataj odznova
 using namespace utils;
 	// gets vector of all changed objects
 	IPdfWriter::ObjectList changed;
@@ -759,9 +905,12 @@ using namespace utils;
 
 	// Stores position of the cross reference section to xrefPos
 	size_t xrefPos=streamWriter->getPos();
+	// maxObj is known only when all xref sections are read
+	readAllXRef();
 	IPdfWriter::PrevSecInfo secInfo={lastXRefPos, XRef::maxObj+1};
 	size_t newEofPos=pdfWriter->writeTrailer(*getTrailerDict(), secInfo, *nStream);
 
+	nStream.reset();
 	fclose(file);
 //	pdfWriter->writeContent
 	//// Writes header with the same PDF version
@@ -793,6 +942,9 @@ void XRefWriter::saveChanges(bool newRevision)
 		kernelPrintDbg(DBG_ERR, "No pdfWriter defined");
 		return;
 	}
+
+	// revisions has to be known before the new one is added
+	ensureRevisions();
 	
 	// casts stream (from XRef super type) and casts it to the FileStreamWriter
 	// instance - it is ok, because it is initialized with this type of stream
@@ -819,10 +971,18 @@ void XRefWriter::saveChanges(bool newRevision)
 		xpdf::freeXpdfObject(o);
 	}
 
-	// Stores position of the cross reference section to xrefPos
-	size_t xrefPos=streamWriter->getPos();
+	// writes cross reference section and stores its position to xrefPos (it
+	// doesn't have to start at the current position, e.g. object streams
+	// may be written before cross reference stream)
+	// maxObj is known only when all xref sections are read
+	readAllXRef();
 	IPdfWriter::PrevSecInfo secInfo={lastXRefPos, XRef::maxObj+1};
 	size_t newEofPos=pdfWriter->writeTrailer(*getTrailerDict(), secInfo, *streamWriter);
+	size_t xrefPos=pdfWriter->getLastXRefPos();
+
+	// revision is complete so this is the place where data have to reach
+	// the file
+	streamWriter->flush();
 
 	// if new revision should be created, moves storePos behind stored content
 	// (more preciselly before pdf end of file marker %%EOF) and forces CXref 
@@ -1008,6 +1168,7 @@ void XRefWriter::collectRevisions()
 	{
 		// creates just one revision information with the newest one
 		revisions.push_back(off);
+		revisionsCollected = true;
 		kernelPrintDbg(DBG_WARN, "collectRevisions not implemented for linearized pdf");
 		return;
 	}
@@ -1024,6 +1185,7 @@ void XRefWriter::collectRevisions()
 	if(!trailer)
 	{
 		kernelPrintDbg(DBG_ERR, "Unable to clone trailer. Ignoring revision collecting.");
+		revisionsCollected = true;
 		return;
 	}
 
@@ -1121,6 +1283,7 @@ void XRefWriter::collectRevisions()
 
 	// initiailizes the current revision to the most recent one.
 	revision = revisions.size()-1;
+	revisionsCollected = true;
 	kernelPrintDbg(DBG_INFO, "This document contains "<<revisions.size()<<" revisions.");
 }
 
@@ -1130,6 +1293,8 @@ void XRefWriter::changeRevision(unsigned revNumber)
 
 	check_need_credentials(this);
 	
+	ensureRevisions();
+
 	// change to same revision
 	if(revNumber==revision)
 	{
@@ -1210,6 +1375,7 @@ using namespace debug;
 	size_t pos=streamWriter->getPos();
 
 	// gets current revision end
+	ensureRevisions();
 	size_t revisionEOF=getRevisionEnd(revisions[revision]);
 
 	kernelPrintDbg(DBG_DBG, "Copies until "<<revisionEOF<<" offset");
@@ -1235,6 +1401,8 @@ using namespace debug;
 
 	kernelPrintDbg(DBG_DBG, "rev="<<rev<<" includeXref="<<includeXref);
 
+	ensureRevisions();
+
 	// constrains check
 	if(rev>revisions.size()-1)
 	{
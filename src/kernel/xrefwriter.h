@@ -71,6 +71,31 @@ bool checkLinearized(StreamWriter & stream, CXref * xref, Ref * ref);
  */
 bool isLatestRevision(const XRefWriter &xref);
 
+/** Collects all indirect objects reachable from the given object.
+ * @param xref XRef table used for fetching.
+ * @param root Object to start with (Trailer for the whole document).
+ * @param refList Container for collected references (cleared at first).
+ * @param sortByOffset Flag whether references should be sorted by the 
+ * position of objects in the original file.
+ *
+ * Traversal is not recursive (deeply nested objects can't overflow the 
+ * stack) and already seen objects are tracked in the bitmap indexed by 
+ * the object number, so the whole collection is linear to the number of 
+ * reachable objects. The bitmap covers only the xref table, objects with
+ * bigger numbers (new objects or dangling references) are tracked in a 
+ * set.
+ * <br>
+ * Objects are collected in depth first order unless sortByOffset is set.
+ * In such a case objects are ordered in the same way as they are stored in
+ * the file (compressed objects are placed at their object stream position)
+ * followed by objects which are not stored in the file yet (ordered by
+ * their numbers).
+ *
+ * @throw MalformedFormatExeption if an object can't be fetched.
+ */
+void collectReachableRefs(::XRef &xref, const ::Object &root, 
+		std::vector< ::Ref> &refList, bool sortByOffset = true);
+
 } // end of namespace utils
 
 	
@@ -104,7 +129,6 @@ class XRefWriter:public CXref
 public:
 	
 	int lastIndex;
-	// TODO maybe some more lookup efficient structure
 	typedef std::vector<Ref> RefList;
 
 	/** List of all reachable indirect objects.
@@ -161,6 +185,13 @@ private:
 	 */
 	RevisionStorage revisions;
 
+	/** Flag for collected revisions.
+	 * Revisions are collected by constructor unless xref is loaded lazily.
+	 * In such a case, they are collected when they are needed for the first
+	 * time (see ensureRevisions).
+	 */
+	bool revisionsCollected;
+
 	/** File offset for write changes.
 	 *
 	 * This offset is used as file position where to start writing changes. It
@@ -175,7 +206,8 @@ private:
 	/** Pdf writer implementator.
 	 *
 	 * Uses OldStylePdfWriter by default. This can be changed by setPdfWriter
-	 * method.
+	 * method (e.g. to XRefStreamPdfWriter to save changes with object 
+	 * streams and cross reference stream).
 	 */
 	utils::IPdfWriter * pdfWriter;
 	
@@ -191,7 +223,7 @@ private:
 	 * It's not available to prevent uninitialized instances.
 	 * Sets mode to paranoid.
 	 */
-	XRefWriter():CXref(), mode(paranoid), pdf(NULL), revision(0), linearized(false)
+	XRefWriter():CXref(), mode(paranoid), pdf(NULL), revision(0), revisionsCollected(false), linearized(false)
 	{
 	}
 protected:
@@ -246,6 +278,32 @@ protected:
 	 */
 	void collectRevisions();
 
+	/** Collects revisions if they are not collected yet.
+	 *
+	 * Revisions information doesn't change the visible state of the
+	 * instance so it is allowed also for const instances.
+	 */
+	void ensureRevisions()const
+	{
+		if(!revisionsCollected)
+			const_cast<XRefWriter *>(this)->collectRevisions();
+	}
+
+	/** Common initialization for constructors.
+	 * @param stream File stream with pdf content.
+	 * @param loading Xref sections loading mode.
+	 * @param index Persistent xref index (may be NULL).
+	 */
+	void initWriter(StreamWriter & stream, XRefLoading loading, XRefIndex * index);
+
+	/** Stores xref to the persistent index.
+	 * @param index Index to store to.
+	 *
+	 * Reads all xref sections if they are not read yet. Reconstructed xref
+	 * of a damaged file is not stored.
+	 */
+	void storeIndex(const XRefIndex & index)const;
+
 	/** Returns end of current revision offset. 
 	 * @param xrefStart Stream offset of xref section start.
 	 *
@@ -282,6 +340,19 @@ public:
 	 */
 	XRefWriter(StreamWriter * stream, CPdf * _pdf);
 
+	/** Initialize constructor with xref loading mode.
+	 * @param stream File stream with pdf content.
+	 * @param _pdf Pdf instance which maintains this instance (may be NULL).
+	 * @param loading Xref sections loading mode.
+	 * @param index Persistent xref index (may be NULL).
+	 *
+	 * Same as the constructor above but delegates loading parameters to
+	 * the CXref constructor. Revisions are taken from the index if it has
+	 * been loaded. Otherwise they are collected when needed in the lazy 
+	 * mode. Xref is stored to the index if the index was not usable.
+	 */
+	XRefWriter(StreamWriter * stream, CPdf * _pdf, XRefLoading loading, XRefIndex * index=NULL);
+
 	/** Destrucrtor.
 	 *
 	 * Deallocates pdfWriter field if it is non NULL.
@@ -454,6 +525,7 @@ public:
 	 */
 	unsigned getActualRevision()const
 	{
+		ensureRevisions();
 		return revision;
 	}
 
@@ -463,10 +535,19 @@ public:
 	 */
 	size_t getRevisionCount()const
 	{
+		ensureRevisions();
 		// revisions contains all revisions
 		return revisions.size();
 	}
 
+	/** Returns true if revisions are already collected.
+	 * Instance is always in the most recent revision otherwise.
+	 */
+	bool hasCollectedRevisions()const
+	{
+		return revisionsCollected;
+	}
+
 	/** Clones content of stream until end of current position.
 	 * @param file File handle where to copy content.
 	 * 
@@ -526,7 +607,9 @@ public:
 			return CXref::fetch(num, gen, obj);
 
 		// we are in an older revision, we have to use only XRef
-		// implementation
+		// implementation - it moves the shared file position, so it
+		// has to hold the read lock as well
+		threads::ScopedLock lock(getReadMutex());
 		return XRef::fetch(num, gen, obj);
 	}
 		
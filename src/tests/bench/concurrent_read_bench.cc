@@ -0,0 +1,166 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include <kernel/cpdf.h>
+#include <kernel/cpage.h>
+#include <kernel/ccontentstream.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// stress test for documents shared by more threads. Each thread walks all
+// pages (starting from a different one) and parses their content streams and
+// fetches all indirect objects. Run it with a thread sanitizer build 
+// (configure --enable-thread-sanitizer) to check for data races.
+
+#define DEFAULT_THREADS 4
+
+struct worker
+{
+	pthread_t thread;
+	shared_ptr<CPdf> pdf;
+	size_t start;
+	// properties returned by getIndirectProperty indexed by object number
+	vector<shared_ptr<IProperty> > props;
+	size_t operators;
+	bool failed;
+};
+
+void * work(void * arg)
+{
+	struct worker * w = static_cast<struct worker *>(arg);
+	try
+	{
+		size_t count = w->pdf->getPageCount();
+		for (size_t i = 0; i < count; ++i)
+		{
+			shared_ptr<CPage> page = w->pdf->getPage((w->start + i) % count + 1);
+			vector<shared_ptr<CContentStream> > streams;
+			page->getContentStreams(streams);
+			for (size_t s = 0; s < streams.size(); ++s)
+			{
+				CContentStream::Operators ops;
+				streams[s]->getPdfOperators(ops);
+				w->operators += ops.size();
+			}
+		}
+
+		int total = w->pdf->getCXref()->getNumObjects();
+		w->props.resize(total + 1);
+		for (int i = 0; i < total; ++i)
+		{
+			IndiRef ref;
+			ref.num = (w->start + i) % total + 1;
+			w->props[ref.num] = w->pdf->getIndirectProperty(ref);
+		}
+	}catch (std::exception & e)
+	{
+		fprintf(stderr, "thread %lu failed: %s\n", (unsigned long)w->start, e.what());
+		w->failed = true;
+	}
+	return NULL;
+}
+
+// runs given number of threads on one instance and checks that all of them
+// have got the same results
+int bench_concurrent_read(size_t threads, struct result * result)
+{
+	time_stamp_t start, end;
+	shared_ptr<CPdf> pdf = open_file(file_name, CPdf::ReadOnly);
+	vector<struct worker> workers(threads);
+	size_t pages = pdf->getPageCount();
+
+	get_time_stamp(&start);
+	for (size_t i = 0; i < threads; ++i)
+	{
+		workers[i].pdf = pdf;
+		workers[i].start = (pages) ? i * pages / threads : 0;
+		workers[i].operators = 0;
+		workers[i].failed = false;
+		if (pthread_create(&workers[i].thread, NULL, work, &workers[i]))
+		{
+			fprintf(stderr, "pthread_create failed\n");
+			return 1;
+		}
+	}
+	for (size_t i = 0; i < threads; ++i)
+		pthread_join(workers[i].thread, NULL);
+	get_time_stamp(&end);
+	update_result(time_diff(start, end), *result);
+
+	int ret = 0;
+	for (size_t i = 0; i < threads; ++i)
+	{
+		if (workers[i].failed || workers[0].failed)
+		{
+			ret = 1;
+			continue;
+		}
+		if (workers[i].operators != workers[0].operators)
+		{
+			fprintf(stderr, "thread %lu parsed %lu operators instead of %lu\n",
+					(unsigned long)i, (unsigned long)workers[i].operators,
+					(unsigned long)workers[0].operators);
+			ret = 1;
+		}
+		// all threads have to share the same properties
+		for (size_t p = 0; p < workers[i].props.size(); ++p)
+			if (workers[i].props[p] != workers[0].props[p] 
+					&& workers[i].props[p] && !isNull(workers[i].props[p]))
+			{
+				fprintf(stderr, "thread %lu got different instance for object %lu\n",
+						(unsigned long)i, (unsigned long)p);
+				ret = 1;
+			}
+	}
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if((ret = init_bench(argc, argv)))
+		return ret;
+	size_t threads = (argc > 2) ? atoi(argv[2]) : DEFAULT_THREADS;
+	if (!threads)
+		threads = DEFAULT_THREADS;
+
+	DEFINE_RESULTS(single_thread, "concurrent_read_1_thread");
+	DEFINE_RESULTS(more_threads, "concurrent_read_n_threads");
+	ret = bench_concurrent_read(1, &single_thread);
+	ret |= bench_concurrent_read(threads, &more_threads);
+
+	struct result *all_results [] = {
+		&single_thread,
+		&more_threads,
+		NULL
+	};
+	print_results(stdout, all_results);
+	return ret;
+}
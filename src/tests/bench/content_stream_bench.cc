@@ -45,7 +45,7 @@ void bench_get_ccstreams(shared_ptr<CPdf> pdf, struct result *results, int start
 	}
 }
 
-void addText(shared_ptr<CPage> page, double x, double y, std::string &fontName, std::string &text)
+shared_ptr<PdfOperator> createText(double x, double y, std::string &fontName, std::string &text)
 {
 	// copy of operatorAddTextLine script function with
 	// font: PDFEDIT_F1
@@ -68,8 +68,13 @@ void addText(shared_ptr<CPage> page, double x, double y, std::string &fontName,
 	PdfOperator::Operands emptyOperands;
 	BT->push_back(createOperator("ET", emptyOperands), getLastOperator(BT));
 	q->push_back(createOperator("Q", emptyOperands), getLastOperator(q));
+	return q;
+}
+
+void addText(shared_ptr<CPage> page, double x, double y, std::string &fontName, std::string &text)
+{
 	std::deque<shared_ptr<PdfOperator> > stack;
-	stack.push_back(q);
+	stack.push_back(createText(x, y, fontName, text));
 	page->addContentStreamToFront(stack);
 }
 
@@ -93,6 +98,55 @@ void bench_addTextToStream(shared_ptr<CPdf> pdf, const std::string &fontName, st
 	}
 }
 
+void bench_insertToStream(shared_ptr<CPdf> pdf, const std::string &fontName, struct result *results, int p, int numberOfInsertions)
+{
+	shared_ptr<CPage> page = pdf->getPage(p);
+	std::string fontId; 
+	if(getFontId(page, fontName, fontId))
+		fontId = page->addSystemType1Font(fontName);
+	time_stamp_t start,  end;
+	std::string text="Foooo";
+	vector<shared_ptr<CContentStream> > cs;
+	page->getContentStreams(cs);
+	if (cs.empty())
+		return;
+	for(int iter = 0; iter < numberOfInsertions; ++iter)
+	{
+		shared_ptr<PdfOperator> op = createText(10, 10, fontId, text);
+		get_time_stamp(&start);
+		cs.front()->frontInsertOperator(op);
+		get_time_stamp(&end);
+		if (results)
+			update_result(time_diff(start, end), *results);
+	}
+}
+
+void bench_insertToStreamTransaction(shared_ptr<CPdf> pdf, const std::string &fontName, struct result *results, int p, int numberOfInsertions)
+{
+	shared_ptr<CPage> page = pdf->getPage(p);
+	std::string fontId; 
+	if(getFontId(page, fontName, fontId))
+		fontId = page->addSystemType1Font(fontName);
+	time_stamp_t start,  end;
+	std::string text="Foooo";
+	vector<shared_ptr<CContentStream> > cs;
+	page->getContentStreams(cs);
+	if (cs.empty())
+		return;
+	vector<shared_ptr<PdfOperator> > ops;
+	for(int iter = 0; iter < numberOfInsertions; ++iter)
+		ops.push_back(createText(10, 10, fontId, text));
+	// all insertions including the commit are measured as one sample
+	get_time_stamp(&start);
+	CContentStream::Transaction transaction(cs.front());
+	for(vector<shared_ptr<PdfOperator> >::iterator it = ops.begin(); it != ops.end(); ++it)
+		cs.front()->frontInsertOperator(*it);
+	transaction.commit();
+	get_time_stamp(&end);
+	if (results)
+		update_result(time_diff(start, end), *results);
+}
+
 int main(int argc, char ** argv)
 {
 	int ret;
@@ -143,6 +197,22 @@ int main(int argc, char ** argv)
 	DEFINE_RESULTS(addTextToStream1000cumulative, "addToStream1000cumulative");
 	bench_addTextToStream(pdf, fontName, &addTextToStream1000cumulative, 1, 1000);
 
+	// insert operators directly to the existing content stream
+	pdf = open_file(file_name);
+	DEFINE_RESULTS(insertToStream10cumulative, "insertToStream10cumulative");
+	bench_insertToStream(pdf, fontName, &insertToStream10cumulative, 1, 10);
+
+	DEFINE_RESULTS(insertToStream100cumulative, "insertToStream100cumulative");
+	bench_insertToStream(pdf, fontName, &insertToStream100cumulative, 1, 100);
+
+	DEFINE_RESULTS(insertToStream1000cumulative, "insertToStream1000cumulative");
+	bench_insertToStream(pdf, fontName, &insertToStream1000cumulative, 1, 1000);
+
+	// the same insertions batched in one edit transaction
+	pdf = open_file(file_name);
+	DEFINE_RESULTS(insertToStream1000transaction, "insertToStream1000transaction");
+	bench_insertToStreamTransaction(pdf, fontName, &insertToStream1000transaction, 1, 1000);
+
 	pdf.reset();
 	struct result *all_results [] = {
 		&getCStreams_first,
@@ -155,6 +225,10 @@ int main(int argc, char ** argv)
 		&addTextToStream10cumulative,
 		&addTextToStream100cumulative,
 		&addTextToStream1000cumulative,
+		&insertToStream10cumulative,
+		&insertToStream100cumulative,
+		&insertToStream1000cumulative,
+		&insertToStream1000transaction,
 		NULL
 	};
 
@@ -84,6 +84,15 @@ void bench_getIndirectProperty(shared_ptr<CPdf> pdf,
 	}
 }
 
+void print_cache_stats(FILE * out, shared_ptr<CPdf> pdf, const char * name)
+{
+	CPdf::IndirectCacheStatistics stats = pdf->getIndirectCacheStatistics();
+	fprintf(out, "%s:hits=%lu:misses=%lu:evictions=%lu:shrinks=%lu:size=%lu:budget=%lu\n", name,
+			(unsigned long)stats.hits, (unsigned long)stats.misses, 
+			(unsigned long)stats.evictions, (unsigned long)stats.shrinks,
+			(unsigned long)stats.size, (unsigned long)stats.budget);
+}
+
 void bench_changeIndirectObject(shared_ptr<CPdf> pdf, struct result *result, int per)
 {
 	XRefWriter * xref = dynamic_cast<XRefWriter*>(pdf->getCXref());
@@ -250,6 +259,47 @@ void bench_bwd_iter(shared_ptr<CPdf> pdf, struct result * result)
 	// we don't use last unseccessfull hasPrevPage
 }
 
+size_t gcd(size_t a, size_t b)
+{
+	while(b)
+	{
+		size_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// measures getPage and getPagePosition for pages in pseudo-random order
+// (every page once)
+void bench_random_access(shared_ptr<CPdf> pdf, struct result * get_result, 
+		struct result * pos_result)
+{
+	time_stamp_t start, end;
+	size_t count = pdf->getPageCount();
+	if(!count)
+		return;
+	// step which is coprime to count visits all pages
+	size_t step = count / 2 + 1;
+	while(gcd(step, count) != 1)
+		++step;
+	size_t pos = 0;
+	for(size_t i=0; i<count; ++i)
+	{
+		pos = (pos + step) % count;
+		get_time_stamp(&start);
+		shared_ptr<CPage> page = pdf->getPage(pos + 1);
+		get_time_stamp(&end);
+		if(get_result)
+			update_result(time_diff(start, end), *get_result);
+		get_time_stamp(&start);
+		pdf->getPagePosition(page);
+		get_time_stamp(&end);
+		if(pos_result)
+			update_result(time_diff(start, end), *pos_result);
+	}
+}
+
 // add all page dictionaries from helper_pdf to the pdf 
 // (if follow_refs is true, removes Parent entry from each one before 
 // addIndirectProperty is called)
@@ -334,6 +384,19 @@ int main(int argc, char **argv)
 	bench_getIndirectProperty(pdf,
 			&getIndirectProperty_known_no_changes2, 
 			&getIndirectProperty_unknown_no_changes2);
+	print_cache_stats(stdout, pdf, "indirect_cache_default_budget");
+
+	// the same with tiny memory budget for cached properties - nothing
+	// holds fetched properties so they are discarded and fetched again
+	pdf = open_file(file_name);
+	pdf->setIndirectCacheBudget(16*1024);
+	bench_getIndirectProperty(pdf, NULL, NULL);
+	DEFINE_RESULTS(getIndirectProperty_known_small_budget,"getIndirectProperty_known_small_budget_again");
+	DEFINE_RESULTS(getIndirectProperty_unknown_small_budget,"getIndirectProperty_unknown_small_budget_again");
+	bench_getIndirectProperty(pdf,
+			&getIndirectProperty_known_small_budget, 
+			&getIndirectProperty_unknown_small_budget);
+	print_cache_stats(stdout, pdf, "indirect_cache_small_budget");
 
 	// changeIndirectProperty to all properties - we simply create
 	// deep copy and call changeIndirectProperty
@@ -383,7 +446,11 @@ int main(int argc, char **argv)
 	pdf = open_file(file_name);
 	bench_bwd_iter(pdf, &page_bwd_iteration);
 
-	// TODO getPagePosition
+	// random page access and getPagePosition
+	DEFINE_RESULTS(getPage_random, "getPage_random");
+	DEFINE_RESULTS(getPagePosition_random, "getPagePosition_random");
+	pdf = open_file(file_name);
+	bench_random_access(pdf, &getPage_random, &getPagePosition_random);
 	
 	// insertPage - same document opened in different CPdf all pages
 	// are inserted to the back and front
@@ -420,6 +487,8 @@ int main(int argc, char **argv)
 		&getIndirectProperty_unknown_no_changes1,
 		&getIndirectProperty_known_no_changes2, 
 		&getIndirectProperty_unknown_no_changes2,
+		&getIndirectProperty_known_small_budget,
+		&getIndirectProperty_unknown_small_budget,
 		&changeIndirectProperty_all1,
 		&getIndirectProperty_known_all_changes,
 		&getIndirectProperty_unknown_all_changes,
@@ -429,6 +498,8 @@ int main(int argc, char **argv)
 		&getPageCount,
 		&page_fwd_iteration,
 		&page_bwd_iteration,
+		&getPage_random,
+		&getPagePosition_random,
 		&insertPage_all_end,
 		&insertPage_all_front,
 		&removePage_all_end,
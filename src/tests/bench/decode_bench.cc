@@ -0,0 +1,139 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <map>
+#include <string>
+#include <kernel/cpdf.h>
+#include <kernel/xrefwriter.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// measures decode throughput (MB/s) of all streams in the document grouped by
+// their (first) filter - both per character and block reading
+
+const char * method_names[] = {"getChar", "getBlock"};
+
+struct throughput
+{
+	long bytes;
+	double time;
+};
+
+typedef map<string, throughput> throughput_map;
+
+void print_throughput(FILE * out, const char * name, const char * method, long bytes, double time)
+{
+	// time is in miliseconds
+	double mbps = (time > 0) ? (bytes / (1024.0*1024.0)) / (time / 1000.0) : 0;
+	fprintf(out, "decode_%s_%s:bytes=%ld:time=%g:MBps=%g\n", name, method, bytes, time, mbps);
+}
+
+// returns name of the first filter of the stream or "none"
+string filter_name(Object & obj)
+{
+	Object filter;
+	string name = "none";
+	obj.streamGetDict()->lookup("Filter", &filter);
+	if(filter.isName())
+		name = filter.getName();
+	else if(filter.isArray() && filter.arrayGetLength() > 0)
+	{
+		Object first;
+		filter.arrayGet(0, &first);
+		if(first.isName())
+			name = first.getName();
+		first.free();
+	}
+	filter.free();
+	return name;
+}
+
+long decode_stream(Stream * str, int method)
+{
+	long bytes = 0;
+	str->reset();
+	if(method == 0)
+	{
+		while(str->getChar() != EOF)
+			++bytes;
+	}else
+	{
+		char buffer[16*1024];
+		int read;
+		while((read = str->getBlock(buffer, sizeof(buffer))) > 0)
+			bytes += read;
+	}
+	str->close();
+	return bytes;
+}
+
+int bench_decode(shared_ptr<CPdf> pdf, int method)
+{
+	XRefWriter * xref = dynamic_cast<XRefWriter*>(pdf->getCXref());
+	throughput_map results;
+	time_stamp_t start, end;
+	for(int num = 1; num < xref->getSize(); ++num)
+	{
+		XRefEntry * entry = xref->getEntry(num);
+		if(!entry || entry->type == xrefEntryFree)
+			continue;
+		Object obj;
+		xref->fetch(num, entry->gen, &obj);
+		if(!obj.isStream())
+		{
+			obj.free();
+			continue;
+		}
+		string name = filter_name(obj);
+		get_time_stamp(&start);
+		long bytes = decode_stream(obj.getStream(), method);
+		get_time_stamp(&end);
+		obj.free();
+
+		throughput & result = results[name];
+		result.bytes += bytes;
+		result.time += time_diff(start, end);
+	}
+
+	for(throughput_map::iterator i = results.begin(); i != results.end(); ++i)
+		print_throughput(stdout, i->first.c_str(), method_names[method], 
+				i->second.bytes, i->second.time);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if((ret = init_bench(argc, argv)))
+		return ret;
+
+	shared_ptr<CPdf> pdf = open_file(file_name, CPdf::ReadOnly);
+	ret = bench_decode(pdf, 0);
+	ret |= bench_decode(pdf, 1);
+	return ret;
+}
@@ -21,12 +21,33 @@
  *
  * Project is hosted on http://sourceforge.net/projects/pdfedit
  */
+#include <stdlib.h>
 #include <kernel/delinearizator.h>
 #include <kernel/pdfedit-core-dev.h>
 #include "utils.h"
 
 using namespace pdfobjects;
 using namespace utils;
+
+#define DEFAULT_WORKERS 4
+
+// delinearizes the file with given number of workers
+int bench_delinearize(size_t workers, const std::string& output_file, struct result * result)
+{
+	OldStylePdfWriter * writer = new OldStylePdfWriter();
+	writer->setWorkers(workers);
+	boost::shared_ptr<Delinearizator> delin = Delinearizator::getInstance(file_name, writer);
+	if (!delin)
+		return 1;
+
+	time_stamp_t start, end;
+	get_time_stamp(&start);
+	int ret = delin->delinearize(output_file.c_str());
+	get_time_stamp(&end);
+	update_result(time_diff(start, end), *result);
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
 	int ret;
@@ -36,27 +57,24 @@ int main(int argc, char **argv)
 
 	if((ret = init_bench(argc, argv)))
 		return ret;
+	size_t workers = (argc > 2) ? atoi(argv[2]) : DEFAULT_WORKERS;
+	if (!workers)
+		workers = DEFAULT_WORKERS;
 
-	boost::shared_ptr<Delinearizator> delin = Delinearizator::getInstance(file_name, new OldStylePdfWriter());
-
-	// check for existing file and remove it
 	std::string output_file = file_name+std::string("-delinearized.pdf");
-	time_stamp_t start, end;
 	DEFINE_RESULTS(delinearize, "delinearize");
+	DEFINE_RESULTS(delinearize_workers, "delinearize_n_workers");
 
-	get_time_stamp(&start);
-	delin->delinearize(output_file.c_str());
-	get_time_stamp(&end);
-	update_result(time_diff(start, end), delinearize);
+	ret |= bench_delinearize(1, output_file, &delinearize);
+	ret |= bench_delinearize(workers, output_file, &delinearize_workers);
 	struct result *all_results [] = {
 		&delinearize,
+		&delinearize_workers,
 		NULL
 	};
 	print_results(stdout, all_results);
 
 	fprintf(stdout, "\n---\n");
 	gMemReport(stdout);
-	return 0;
-
-
+	return ret;
 }
@@ -0,0 +1,155 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <kernel/cpdf.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// compares std::map based ObjectStorage with IndexedObjectStorage as used by
+// CXref for changed and newly created objects
+typedef ObjectStorage< ::Ref, int, xpdf::RefComparator> MapStorage;
+typedef IndexedObjectStorage< ::Ref, int, xpdf::RefComparator> TableStorage;
+
+// how many times each operation is repeated
+const int passes = 10;
+
+template<typename Storage>
+void bench_put(Storage &storage, int count, struct result *result)
+{
+	time_stamp_t start, end;
+	for(int pass=0; pass<passes; ++pass)
+	{
+		storage.clear();
+		get_time_stamp(&start);
+		for(int i=1; i<=count; ++i)
+		{
+			::Ref ref={i, 0};
+			storage.put(ref, i);
+		}
+		get_time_stamp(&end);
+		update_result(time_diff(start, end), *result);
+	}
+}
+
+template<typename Storage>
+int bench_get(Storage &storage, int count, struct result *result_known, struct result *result_unknown)
+{
+	time_stamp_t start, end;
+	// prevents compiler from optimizing lookups away
+	int sum=0;
+	for(int pass=0; pass<passes; ++pass)
+	{
+		get_time_stamp(&start);
+		// pseudo random order to defeat sequential access
+		for(int i=0, num=1; i<count; ++i, num=(int)(((long)num*7919)%count)+1)
+		{
+			::Ref ref={num, 0};
+			sum+=storage.get(ref);
+		}
+		get_time_stamp(&end);
+		update_result(time_diff(start, end), *result_known);
+
+		get_time_stamp(&start);
+		for(int i=1; i<=count; ++i)
+		{
+			::Ref ref={i, 1};
+			sum+=storage.contains(ref);
+		}
+		get_time_stamp(&end);
+		update_result(time_diff(start, end), *result_unknown);
+	}
+	return sum;
+}
+
+template<typename Storage>
+int bench_iterate(Storage &storage, struct result *result)
+{
+	time_stamp_t start, end;
+	int sum=0;
+	for(int pass=0; pass<passes; ++pass)
+	{
+		get_time_stamp(&start);
+		for(typename Storage::Iterator i=storage.begin(); i!=storage.end(); ++i)
+			sum+=i->second;
+		get_time_stamp(&end);
+		update_result(time_diff(start, end), *result);
+	}
+	return sum;
+}
+
+int main(int argc, char ** argv)
+{
+	int ret;
+	if((ret = init_bench(argc, argv)))
+		return ret;
+
+	// uses number of objects in the document but at least some reasonable 
+	// amount of objects to see the difference
+	shared_ptr<CPdf> pdf = open_file(file_name);
+	int count = pdf->getCXref()->getNumObjects();
+	pdf.reset();
+	if(count < 100000)
+		count = 100000;
+	printf("Number of objects: %d\n", count);
+
+	int sum = 0;
+	MapStorage map;
+	DEFINE_RESULTS(map_put, "map_put");
+	DEFINE_RESULTS(map_get_known, "map_get_known");
+	DEFINE_RESULTS(map_get_unknown, "map_get_unknown");
+	DEFINE_RESULTS(map_iterate, "map_iterate");
+	bench_put(map, count, &map_put);
+	sum += bench_get(map, count, &map_get_known, &map_get_unknown);
+	sum += bench_iterate(map, &map_iterate);
+
+	TableStorage table;
+	DEFINE_RESULTS(table_put, "table_put");
+	DEFINE_RESULTS(table_get_known, "table_get_known");
+	DEFINE_RESULTS(table_get_unknown, "table_get_unknown");
+	DEFINE_RESULTS(table_iterate, "table_iterate");
+	bench_put(table, count, &table_put);
+	sum -= bench_get(table, count, &table_get_known, &table_get_unknown);
+	sum -= bench_iterate(table, &table_iterate);
+
+	// both storages have to give the same results
+	assert(sum == 0);
+
+	struct result *all_results [] = {
+		&map_put,
+		&map_get_known,
+		&map_get_unknown,
+		&map_iterate,
+		&table_put,
+		&table_get_known,
+		&table_get_unknown,
+		&table_iterate,
+		NULL
+	};
+
+	print_results(stdout, all_results);
+	return 0;
+}
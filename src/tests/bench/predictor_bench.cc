@@ -0,0 +1,145 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+#include <kernel/static.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace std;
+
+// measures throughput (MB/s) of predictors applied to Flate streams and of
+// image sample unpacking on synthetic images
+// usage: predictor_bench [width height]
+
+const int repeat = 10;
+
+int width = 2000;
+int height = 500;
+
+void print_throughput(FILE * out, const char * name, int param, long bytes, double time)
+{
+	// time is in miliseconds
+	double mbps = (time > 0) ? (bytes / (1024.0*1024.0)) / (time / 1000.0) : 0;
+	fprintf(out, "%s_%d:bytes=%ld:time=%g:MBps=%g\n", name, param, bytes, time, mbps);
+}
+
+// creates image data with given PNG filter type (or without filter bytes if
+// filter is negative) compressed without compression, so that the flate
+// decoder doesn't influence the result much
+vector<char> make_data(int rowBytes, int filter)
+{
+	vector<unsigned char> raw;
+	for(int y = 0; y < height; ++y)
+	{
+		if(filter >= 0)
+			raw.push_back((unsigned char)filter);
+		for(int x = 0; x < rowBytes; ++x)
+			raw.push_back((unsigned char)rand());
+	}
+	uLongf size = compressBound(raw.size());
+	vector<char> data(size);
+	compress2((Bytef *)&data[0], &size, &raw[0], raw.size(), 0);
+	data.resize(size);
+	return data;
+}
+
+void bench_predictor(const char * name, int predictor, int filter, int colors)
+{
+	time_stamp_t start, end;
+	vector<char> data = make_data(width * colors, filter);
+	Object dict;
+	dict.initNull();
+	long bytes = 0;
+	char buffer[16*1024];
+	int read;
+
+	FlateStream * str = new FlateStream(
+			new MemStream(&data[0], 0, data.size(), &dict),
+			predictor, width, colors, 8);
+	get_time_stamp(&start);
+	for(int i = 0; i < repeat; ++i)
+	{
+		str->reset();
+		while((read = str->getBlock(buffer, sizeof(buffer))) > 0)
+			bytes += read;
+	}
+	get_time_stamp(&end);
+	delete str;
+	print_throughput(stdout, name, colors, bytes, time_diff(start, end));
+}
+
+void bench_unpack(int bits)
+{
+	time_stamp_t start, end;
+	int rowBytes = (width * bits + 7) / 8;
+	vector<char> data(rowBytes * height);
+	for(size_t i = 0; i < data.size(); ++i)
+		data[i] = (char)rand();
+	Object dict;
+	dict.initNull();
+
+	MemStream * str = new MemStream(&data[0], 0, data.size(), &dict);
+	ImageStream * imgStr = new ImageStream(str, width, 1, bits);
+	get_time_stamp(&start);
+	for(int i = 0; i < repeat; ++i)
+	{
+		imgStr->reset();
+		for(int y = 0; y < height; ++y)
+			imgStr->getLine();
+	}
+	get_time_stamp(&end);
+	delete imgStr;
+	delete str;
+	// throughput of unpacked samples
+	print_throughput(stdout, "unpack", bits, (long)width * height * repeat, time_diff(start, end));
+}
+
+int main(int argc, char **argv)
+{
+	if(pdfedit_core_dev_init(&argc, &argv))
+		return 1;
+	if(argc > 2)
+	{
+		width = atoi(argv[1]);
+		height = atoi(argv[2]);
+	}
+
+	const int colors[] = {1, 3, 4};
+	for(size_t i = 0; i < sizeof(colors)/sizeof(*colors); ++i)
+	{
+		bench_predictor("tiff", 2, -1, colors[i]);
+		bench_predictor("png_none", 12, 0, colors[i]);
+		bench_predictor("png_sub", 12, 1, colors[i]);
+		bench_predictor("png_up", 12, 2, colors[i]);
+		bench_predictor("png_average", 12, 3, colors[i]);
+		bench_predictor("png_paeth", 12, 4, colors[i]);
+	}
+	const int bits[] = {1, 2, 4, 8};
+	for(size_t i = 0; i < sizeof(bits)/sizeof(*bits); ++i)
+		bench_unpack(bits[i]);
+	return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <kernel/cpdf.h>
+#include <kernel/xrefwriter.h>
+#include <kernel/pdfedit-core-dev.h>
+#include "utils.h"
+
+using namespace boost;
+using namespace pdfobjects;
+using namespace std;
+
+// measures save throughput (MB/s) for all stream writers
+
+const char * writer_names[] = {"direct", "buffered", "mapped"};
+
+long file_size(const char * name)
+{
+	struct stat st;
+	if(stat(name, &st))
+		return -1;
+	return st.st_size;
+}
+
+// copies file_name to a temporary file and returns its name
+string make_copy()
+{
+	char name[] = "/tmp/save_benchXXXXXX";
+	int fd = mkstemp(name);
+	if(fd < 0)
+		return string();
+	FILE * out = fdopen(fd, "wb");
+	FILE * in = fopen(file_name, "rb");
+	char buffer[BUFSIZ];
+	size_t read;
+	while(in && (read = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		fwrite(buffer, 1, read, out);
+	if(in)
+		fclose(in);
+	fclose(out);
+	return name;
+}
+
+void print_throughput(FILE * out, const char * name, const char * writer, long bytes, double time)
+{
+	// time is in miliseconds
+	double mbps = (time > 0) ? (bytes / (1024.0*1024.0)) / (time / 1000.0) : 0;
+	fprintf(out, "%s_%s:bytes=%ld:time=%g:MBps=%g\n", name, writer, bytes, time, mbps);
+}
+
+// changes all objects so that the whole document has to be written
+void change_all(shared_ptr<CPdf> pdf)
+{
+	XRefWriter * xref = dynamic_cast<XRefWriter*>(pdf->getCXref());
+	int total = xref->getNumObjects();
+	IndiRef ref;
+	for(ref.num = 1; total > 0 && ref.num < xref->getSize(); ++ref.num)
+	{
+		if(xref->knowsRef(ref) != INITIALIZED_REF)
+			continue;
+		--total;
+		shared_ptr<IProperty> orig_obj = pdf->getIndirectProperty(ref);
+		shared_ptr<IProperty> changed_obj = orig_obj->clone();
+		if(!changed_obj)
+			continue;
+		changed_obj->setPdf(orig_obj->getPdf());
+		changed_obj->setIndiRef(orig_obj->getIndiRef());
+		pdf->changeIndirectProperty(changed_obj);
+	}
+}
+
+int bench_save(CPdf::WriterType writer)
+{
+	time_stamp_t start, end;
+	const char * writer_name = writer_names[writer];
+
+	// save of new revision with all objects changed
+	string name = make_copy();
+	if(name.empty())
+		return 1;
+	shared_ptr<CPdf> pdf = CPdf::getInstance(name.c_str(), CPdf::ReadWrite, writer);
+	if(pdf->getMode() == CPdf::ReadOnly)
+	{
+		fprintf(stderr, "Document can't be changed\n");
+		unlink(name.c_str());
+		return 1;
+	}
+	change_all(pdf);
+	long size = file_size(name.c_str());
+	get_time_stamp(&start);
+	pdf->save(true);
+	get_time_stamp(&end);
+	print_throughput(stdout, "save_all_changed", writer_name, 
+			file_size(name.c_str()) - size, time_diff(start, end));
+
+	// clone of the whole document
+	string clone_name = make_copy();
+	FILE * clone_file = fopen(clone_name.c_str(), "wb");
+	get_time_stamp(&start);
+	pdf->clone(clone_file);
+	get_time_stamp(&end);
+	fclose(clone_file);
+	print_throughput(stdout, "clone", writer_name, 
+			file_size(clone_name.c_str()), time_diff(start, end));
+
+	// complete document rewrite
+	get_time_stamp(&start);
+	pdf->saveDecoded(const_cast<char *>(clone_name.c_str()));
+	get_time_stamp(&end);
+	print_throughput(stdout, "saveDecoded", writer_name, 
+			file_size(clone_name.c_str()), time_diff(start, end));
+
+	pdf.reset();
+	unlink(clone_name.c_str());
+	unlink(name.c_str());
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	if((ret = init_bench(argc, argv)))
+		return ret;
+
+	ret = bench_save(CPdf::DirectWriter);
+	ret |= bench_save(CPdf::BufferedWriter);
+	ret |= bench_save(CPdf::MappedWriter);
+	return ret;
+}
@@ -196,6 +196,19 @@ void bench_fetch(XRefWriter *xref, struct result * result_known, struct result *
 
 }
 
+// collects all objects reachable from the trailer (this is what saveDecoded
+// does before it writes anything)
+void bench_reachableObjects(XRefWriter *xref, struct result * result, bool sortByOffset)
+{
+	time_stamp_t start, end;
+	vector< ::Ref> refs;
+	get_time_stamp(&start);
+	utils::collectReachableRefs(*xref, *xref->getTrailerDict(), refs, sortByOffset);
+	get_time_stamp(&end);
+	if(result)
+		update_result(time_diff(start, end), *result);
+}
+
 int main(int argc, char ** argv)
 {
 	int ret;
@@ -246,6 +259,13 @@ int main(int argc, char ** argv)
 		bench_fetch(xref, &fetch_known2, &fetch_unknown2);
 	}
 
+	// reachable objects collection - sorted and in traversal order
+	open_and_get_xrefwriter(pdf, xref, file_name);
+	DEFINE_RESULTS(reachable_sorted, "reachableObjects_sorted");
+	DEFINE_RESULTS(reachable_unsorted, "reachableObjects_unsorted");
+	bench_reachableObjects(xref, &reachable_sorted, true);
+	bench_reachableObjects(xref, &reachable_unsorted, false);
+
 	// clone (???)
 	// reserveRef (RESERVED_NUMBER)
 	struct result *all_results [] = {
@@ -255,6 +275,7 @@ int main(int argc, char ** argv)
 		&changeObject_all,
 		&fetch_known1, &fetch_unknown1,
 		&fetch_known2, &fetch_unknown2,
+		&reachable_sorted, &reachable_unsorted,
 		NULL
 	};
 
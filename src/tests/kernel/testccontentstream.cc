@@ -26,6 +26,7 @@
 #include "kernel/static.h"
 #include "xpdf/PDFDoc.h"
 #include "kernel/cstreamsxpdfreader.h"
+#include "kernel/stateupdater.h"
 #include "tests/kernel/testmain.h"
 #include "tests/kernel/testcobject.h"
 #include "tests/kernel/testcpage.h"
@@ -140,6 +141,400 @@ frontinsert (ostream& oss, const char* fileName)
 
 //=====================================================================================
 
+namespace {
+	/** Content of all cstreams of the content stream. */
+	string cstreamsContent (shared_ptr<CContentStream> cs)
+	{
+		vector<shared_ptr<CStream> > strs;
+		cs->getCStreams (strs);
+		string result;
+		for (vector<shared_ptr<CStream> >::iterator it = strs.begin(); it != strs.end(); ++it)
+			result.append ((*it)->getBuffer().begin(), (*it)->getBuffer().end());
+		return result;
+	}
+
+	/** Counts notifications. */
+	template<typename T>
+	class CountingObserver : public observer::IObserver<T>
+	{
+	public:
+		mutable size_t count;
+		CountingObserver () : count (0) {}
+		virtual ~CountingObserver () throw() {}
+		void notify (boost::shared_ptr<T>, boost::shared_ptr<const observer::IChangeContext<T> >) const throw()
+			{ ++count; }
+		typename observer::IObserver<T>::priority_t getPriority () const throw()
+			{ return 0; }
+	};
+} // namespace
+
+bool
+incremental (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		assert (!ccs.empty());
+		shared_ptr<CContentStream> cs = ccs.front();
+		if (cs->empty())
+			continue;
+
+		// first change writes everything, next ones only changed operators
+		PdfOperator::Operands operands;
+		for (size_t j = 0; j < 3; ++j)
+		{
+			shared_ptr<PdfOperator> q (new UnknownCompositePdfOperator ("q","Q"));
+			q->push_back (createOperator ("n", operands), q);
+			q->push_back (createOperator ("Q", operands), getLastOperator (q));
+			cs->frontInsertOperator (q);
+
+			string tmp;
+			cs->getStringRepresentation (tmp);
+			CPPUNIT_ASSERT (tmp == cstreamsContent (cs));
+		}
+
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		cs->deleteOperator (ops.front());
+		cs->getPdfOperators (ops);
+		cs->insertOperator (ops.back(), createOperator ("n", operands));
+		
+		string tmp;
+		cs->getStringRepresentation (tmp);
+		CPPUNIT_ASSERT (tmp == cstreamsContent (cs));
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+bool
+transaction (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	
+	for (size_t i = 0; i < pdf->getPageCount () && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		if (ccs.empty() || ccs.front()->empty())
+			continue;
+		shared_ptr<CContentStream> cs = ccs.front();
+
+		string before;
+		cs->getStringRepresentation (before);
+		string content = cstreamsContent (cs);
+
+		// observers of the content stream and of its first cstream
+		vector<shared_ptr<CStream> > strs;
+		cs->getCStreams (strs);
+		shared_ptr<CountingObserver<CContentStream> > csobserver (new CountingObserver<CContentStream> ());
+		shared_ptr<CountingObserver<IProperty> > strobserver (new CountingObserver<IProperty> ());
+		cs->registerObserver (csobserver);
+		strs.front()->registerObserver (strobserver);
+
+		PdfOperator::Operands operands;
+		// aborted changes are rolled back and not written
+		{
+			CContentStream::Transaction t (cs);
+			for (size_t j = 0; j < 10; ++j)
+				cs->frontInsertOperator (createOperator ("n", operands));
+			CPPUNIT_ASSERT (content == cstreamsContent (cs));
+		}
+		string tmp;
+		cs->getStringRepresentation (tmp);
+		CPPUNIT_ASSERT (before == tmp);
+		CPPUNIT_ASSERT (content == cstreamsContent (cs));
+		CPPUNIT_ASSERT (0 == csobserver->count);
+		CPPUNIT_ASSERT (0 == strobserver->count);
+
+		// committed changes are written at once
+		{
+			CPage::Transaction t (page);
+			for (size_t j = 0; j < 10; ++j)
+				cs->frontInsertOperator (createOperator ("n", operands));
+			CPPUNIT_ASSERT (content == cstreamsContent (cs));
+			CPPUNIT_ASSERT (0 == csobserver->count);
+			t.commit ();
+		}
+		cs->getStringRepresentation (tmp);
+		CPPUNIT_ASSERT (before != tmp);
+		CPPUNIT_ASSERT (tmp == cstreamsContent (cs));
+		CPPUNIT_ASSERT (1 == csobserver->count);
+		CPPUNIT_ASSERT (1 == strobserver->count);
+
+		// nested transactions are committed with the outermost one
+		{
+			CPage::Transaction t (page);
+			{
+				CContentStream::Transaction nested (cs);
+				for (size_t j = 0; j < 10; ++j)
+					cs->frontInsertOperator (createOperator ("n", operands));
+				nested.commit ();
+			}
+			CPPUNIT_ASSERT (1 == csobserver->count);
+			cs->frontInsertOperator (createOperator ("n", operands));
+			t.commit ();
+		}
+		CPPUNIT_ASSERT (2 == csobserver->count);
+		CPPUNIT_ASSERT (2 == strobserver->count);
+
+		cs->unregisterObserver (csobserver);
+		strs.front()->unregisterObserver (strobserver);
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+bool
+lazyparse (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	boost::shared_ptr<CPdf> original = getTestCPdf (fileName);
+	
+	for (size_t i = 0; i < pdf->getPageCount () && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		PdfOperator::Operands operands;
+		vector<boost::shared_ptr<PdfOperator> > ops;
+		ops.push_back (createOperator ("n", operands));
+
+		// adding content streams does not create existing ones
+		page->addContentStreamToFront (ops);
+		page->addContentStreamToBack (ops);
+		CPPUNIT_ASSERT (!page->isContentParsed ());
+
+		// they are split the same way as if they were created before
+		vector<boost::shared_ptr<CContentStream> > ccs, originalccs;
+		original->getPage (i + 1)->getContentStreams (originalccs);
+		page->getContentStreams (ccs);
+		CPPUNIT_ASSERT (ccs.size() == originalccs.size() + 2);
+		for (size_t j = 0; j < ccs.size(); ++j)
+		{
+			CContentStream::CStreams streams;
+			ccs[j]->getCStreams (streams);
+			if (0 == j || ccs.size() == j + 1)
+			{
+				CPPUNIT_ASSERT (1 == streams.size());
+				continue;
+			}
+			CContentStream::CStreams originalstreams;
+			originalccs[j - 1]->getCStreams (originalstreams);
+			CPPUNIT_ASSERT (streams.size() == originalstreams.size());
+			CPPUNIT_ASSERT (streams.front()->getIndiRef() == originalstreams.front()->getIndiRef());
+		}
+		ccs.erase (ccs.begin());
+		ccs.pop_back ();
+
+		// adding a content stream does not parse existing ones
+		page->addContentStreamToFront (ops);
+		for (size_t j = 0; j < ccs.size(); ++j)
+			CPPUNIT_ASSERT (!ccs[j]->isParsed());
+
+		// index of blocks is available without parsing
+		vector<CContentStream::Blocks> scanned (ccs.size());
+		for (size_t j = 0; j < ccs.size(); ++j)
+		{
+			ccs[j]->getBlocks (scanned[j]);
+			bool empty = ccs[j]->empty ();
+			CPPUNIT_ASSERT (empty == scanned[j].empty());
+			CPPUNIT_ASSERT (!ccs[j]->isParsed());
+		}
+
+		// operators are parsed with the first access
+		for (size_t j = 0; j < ccs.size(); ++j)
+		{
+			CContentStream::Operators opers;
+			ccs[j]->getPdfOperators (opers);
+			CPPUNIT_ASSERT (ccs[j]->isParsed());
+
+			// the scanned index matches parsed operators
+			CContentStream::Blocks parsed;
+			ccs[j]->getBlocks (parsed);
+			CPPUNIT_ASSERT (parsed.size() == scanned[j].size());
+			size_t count = 0;
+			for (size_t k = 0; k < parsed.size(); ++k)
+			{
+				CPPUNIT_ASSERT (parsed[k].kind == scanned[j][k].kind);
+				CPPUNIT_ASSERT (parsed[k].count == scanned[j][k].count);
+				count += parsed[k].count;
+			}
+			CPPUNIT_ASSERT (count == opers.size());
+			CContentStream::Operators::const_iterator op = opers.begin();
+			for (size_t k = 0; k < parsed.size(); ++k)
+			{
+				string name;
+				(*op)->getOperatorName (name);
+				if (CContentStream::Block::GraphicState == parsed[k].kind)
+					CPPUNIT_ASSERT (name == "q");
+				else if (CContentStream::Block::Text == parsed[k].kind)
+					CPPUNIT_ASSERT (name == "BT");
+				else if (CContentStream::Block::Simple == parsed[k].kind)
+					CPPUNIT_ASSERT (!isCompositeOp (*op));
+				std::advance (op, parsed[k].count);
+			}
+		}
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+bool
+opcodes (ostream& oss, const char* fileName)
+{
+	// created operators know their code
+	PdfOperator::Operands operands;
+	shared_ptr<PdfOperator> op = createOperator ("n", operands);
+	CPPUNIT_ASSERT (StateUpdater::findOpcode ("n") == op->getOpcode());
+	CPPUNIT_ASSERT (StateUpdater::UNKNOWN_OPCODE != op->getOpcode());
+	op = createOperator ("unknownop", operands);
+	CPPUNIT_ASSERT (StateUpdater::UNKNOWN_OPCODE == op->getOpcode());
+	shared_ptr<PdfOperator> q (new UnknownCompositePdfOperator ("q","Q"));
+	CPPUNIT_ASSERT (StateUpdater::findOpcode ("q") == q->getOpcode());
+
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+	for (size_t i = 0; i < pdf->getPageCount () && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		for (size_t j = 0; j < ccs.size(); ++j)
+		{
+			CContentStream::Operators ops;
+			ccs[j]->getPdfOperators (ops);
+			if (ops.empty())
+				continue;
+			// parsed operators know their code and simple ones give
+			// their operands without copying
+			for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+			{
+				shared_ptr<PdfOperator> cur = it.getCurrent();
+				string name;
+				cur->getOperatorName (name);
+				CPPUNIT_ASSERT (StateUpdater::findOpcode (name) == cur->getOpcode());
+				PdfOperator::Operands params;
+				cur->getParameters (params);
+				const PdfOperator::Operands* operands = cur->getOperands ();
+				if (NULL != operands)
+					CPPUNIT_ASSERT (*operands == params);
+			}
+		}
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
+namespace {
+	/** Bounding boxes of all operators of the content stream. */
+	void allBBoxes (shared_ptr<CContentStream> cs, vector<PdfOperator::BBox>& bboxes)
+	{
+		bboxes.clear ();
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		if (ops.empty())
+			return;
+		for (PdfOperator::Iterator it = PdfOperator::getIterator (ops.front()); !it.isEnd(); it.next())
+			bboxes.push_back (it.getCurrent()->getBBox());
+	}
+} // namespace
+
+bool
+bboxupdate (ostream& oss, const char* fileName)
+{
+	boost::shared_ptr<CPdf> ppdf = getTestCPdf (fileName);
+	size_t pagecnt = ppdf->getPageCount ();
+	ppdf.reset();
+	
+	for (size_t i = 0; i < pagecnt && i < TEST_MAX_PAGE_COUNT; ++i)
+	{
+		boost::shared_ptr<CPdf> pdf = getTestCPdf (fileName);
+		boost::shared_ptr<CPage> page = pdf->getPage (i + 1);
+		
+		// long enough content stream to have state checkpoints in front of
+		// the change
+		PdfOperator::Operands operands;
+		vector<boost::shared_ptr<PdfOperator> > added;
+		for (int j = 0; j < 150; ++j)
+		{
+			for (int k = 0; k < 4; ++k)
+				operands.push_back (shared_ptr<IProperty> (CIntFactory::getInstance (j + 10 * k)));
+			added.push_back (createOperator ("re", operands));
+			operands.clear ();
+			added.push_back (createOperator ("n", operands));
+		}
+		page->addContentStreamToBack (added);
+		vector<boost::shared_ptr<CContentStream> > ccs;
+		page->getContentStreams (ccs);
+		CPPUNIT_ASSERT (!ccs.empty());
+		shared_ptr<CContentStream> cs = ccs.back();
+		CContentStream::Operators ops;
+		cs->getPdfOperators (ops);
+		CPPUNIT_ASSERT (ops.size() >= added.size());
+
+		// state neutral q/Q composite and path operator which changes the
+		// state are inserted close to the end
+		const PdfOperator::BBox mark (-1, -1, -1, -1);
+		for (size_t j = 0; j < 2; ++j)
+		{
+			shared_ptr<PdfOperator> op;
+			if (0 == j)
+			{
+				op = shared_ptr<PdfOperator> (new UnknownCompositePdfOperator ("q","Q"));
+				op->push_back (createOperator ("n", operands), op);
+				op->push_back (createOperator ("Q", operands), getLastOperator (op));
+			}else
+				op = createOperator ("n", operands);
+			ops.front()->setBBox (mark);
+			CContentStream::Operators::iterator it = ops.end();
+			std::advance (it, -3);
+			cs->insertOperator (*it, op);
+
+			// operators in front of the change are not updated
+			CPPUNIT_ASSERT (ops.front()->getBBox() == mark);
+
+			// the rest is the same as after the full update
+			vector<PdfOperator::BBox> updated, full;
+			allBBoxes (cs, updated);
+			cs->reparse (true);
+			allBBoxes (cs, full);
+			CPPUNIT_ASSERT (updated.size() == full.size());
+			for (size_t k = 1; k < full.size(); ++k)
+				CPPUNIT_ASSERT (updated[k] == full[k]);
+			cs->getPdfOperators (ops);
+		}
+
+		_working (oss);
+	}
+	
+	return true;
+}
+
+//=====================================================================================
+
 bool
 position (ostream& oss, const char* fileName, const libs::Rectangle rc)
 {
@@ -800,6 +1195,26 @@ public:
 				CPPUNIT_ASSERT (frontinsert (OUTPUT, (*it).c_str()));
 				OK_TEST;
 
+				TEST(" incremental save");
+				CPPUNIT_ASSERT (incremental (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
+				TEST(" bbox update");
+				CPPUNIT_ASSERT (bboxupdate (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
+				TEST(" edit transaction");
+				CPPUNIT_ASSERT (transaction (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
+				TEST(" lazy parsing");
+				CPPUNIT_ASSERT (lazyparse (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
+				TEST(" operator codes");
+				CPPUNIT_ASSERT (opcodes (OUTPUT, (*it).c_str()));
+				OK_TEST;
+
 				TEST(" add content stream");
 				CPPUNIT_ASSERT (addcc (OUTPUT, (*it).c_str()));
 				OK_TEST;
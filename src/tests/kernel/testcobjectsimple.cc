@@ -399,6 +399,90 @@ s_rel ()
 }
 
 
+//====================================================
+
+bool
+s_names ()
+{
+	// Same names share one atom
+	CName n1 ("FontDescriptor");
+	CName n2 ("FontDescriptor");
+	CPPUNIT_ASSERT (Name (n1.getValue ()) == Name (n2.getValue ()));
+	CPPUNIT_ASSERT (NameTable::get (Name ("FontDescriptor").getAtom ()) == "FontDescriptor");
+
+	// Lookup does not intern unknown names
+	size_t size = NameTable::size ();
+	CDict dict;
+	CPPUNIT_ASSERT (!dict.containsProperty ("NameWhichIsNotUsedAnywhere"));
+	CPPUNIT_ASSERT (size == NameTable::size ());
+
+	// Dictionary keys
+	CInt val (1);
+	dict.addProperty ("FontDescriptor", val);
+	CPPUNIT_ASSERT (dict.containsProperty ("FontDescriptor"));
+	CPPUNIT_ASSERT (1 == utils::getValueFromSimple<CInt> (dict.getProperty ("FontDescriptor")));
+	CPPUNIT_ASSERT (!dict.containsProperty ("FontDescriptor2"));
+
+	// Default names share the empty name, names read from xpdf objects are
+	// interned directly
+	CPPUNIT_ASSERT (Name () == Name (""));
+	CPPUNIT_ASSERT (Name () == Name (string ()));
+	CPPUNIT_ASSERT (Name () != Name ("FontDescriptor"));
+	Object obj;
+	obj.initName ("FontDescriptor");
+	CName parsed (obj);
+	obj.free ();
+	CPPUNIT_ASSERT ("FontDescriptor" == parsed.getValue ());
+	CPPUNIT_ASSERT (Name (parsed.getValue ()) == Name (n1.getValue ()));
+	obj.initInt (1);
+	try {
+		CName bad (obj);
+		CPPUNIT_FAIL ("name from int should have failed");
+	}catch (ElementBadTypeException&)
+	{
+	}
+
+	// Clone and change
+	boost::shared_ptr<CName> cl = IProperty::getSmartCObjectPtr<CName> (n1.clone ());
+	CPPUNIT_ASSERT ("FontDescriptor" == cl->getValue ());
+	cl->setValue ("F1");
+	CPPUNIT_ASSERT ("F1" == cl->getValue ());
+	CPPUNIT_ASSERT ("FontDescriptor" == n1.getValue ());
+	string str;
+	cl->getStringRepresentation (str);
+	CPPUNIT_ASSERT ("/F1" == str);
+
+	// Unused names are purged when new names are interned, used ones stay
+	Name held ("NameHeldDuringPurge");
+	{
+		std::vector<Name> names;
+		for (int i = 0; i < 5000; ++i)
+		{
+			std::ostringstream oss;
+			oss << "UnusedName" << i;
+			names.push_back (Name (oss.str ()));
+		}
+		size = NameTable::size ();
+		CPPUNIT_ASSERT (names.size () <= size);
+		CPPUNIT_ASSERT ("UnusedName0" == names.front ().str ());
+		CPPUNIT_ASSERT (Name ("UnusedName0") == names.front ());
+	}
+	for (int i = 0; i < 5000; ++i)
+	{
+		std::ostringstream oss;
+		oss << "OtherUnusedName" << i;
+		Name name (oss.str ());
+	}
+	CPPUNIT_ASSERT (NameTable::size () < size);
+	CPPUNIT_ASSERT ("NameHeldDuringPurge" == held.str ());
+	CPPUNIT_ASSERT (Name ("NameHeldDuringPurge") == held);
+	CPPUNIT_ASSERT ("FontDescriptor" == n1.getValue ());
+	CPPUNIT_ASSERT (dict.containsProperty ("FontDescriptor"));
+
+	return true;
+}
+
+
 //=========================================================================
 // class TestCObjectSimple
 //=========================================================================
@@ -515,6 +599,10 @@ public:
 			TEST(" __");
 			CPPUNIT_ASSERT (s_rel ());
 			OK_TEST;
+
+			TEST(" names");
+			CPPUNIT_ASSERT (s_names ());
+			OK_TEST;
 		}
 	}
 
@@ -33,6 +33,7 @@
 #include "kernel/factories.h"
 #include "kernel/cpage.h"
 #include "kernel/cannotation.h"
+#include "splash/SplashBitmap.h"
 
 
 //=====================================================================================
@@ -146,6 +147,114 @@ display (UNUSED_PARAM ostream& oss, const char* fileName)
 
 //=====================================================================================
 
+namespace {
+
+	// renders page and returns bitmap size and content
+	string rasterize (shared_ptr<CPage> page, SplashOutputDev& out)
+	{
+		page->displayPage (out);
+		SplashBitmap* bitmap = out.getBitmap ();
+		ostringstream oss;
+		oss << bitmap->getWidth () << "x" << bitmap->getHeight () << ":";
+		string result = oss.str ();
+		result.append ((const char*)bitmap->getDataPtr (), bitmap->getRowSize () * bitmap->getHeight ());
+		return result;
+	}
+
+	// renders page with the reused device (started for the document by a
+	// previous rendering) and with a new one, both results have to be same.
+	// The reused device has to be restarted only if the document has
+	// changed since its last rendering
+	string rasterize_reused (shared_ptr<CPage> page, SplashOutputDev& reused, bool changed)
+	{
+		SplashColor paperColor;
+		paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+		SplashOutputDev fresh (splashModeRGB8, 4, gFalse, paperColor);
+		string expected = rasterize (page, fresh);
+		Gulong docId = reused.getDocId ();
+		string result = rasterize (page, reused);
+		CPPUNIT_ASSERT (result == expected);
+		CPPUNIT_ASSERT (0 != reused.getDocId ());
+		CPPUNIT_ASSERT ((docId != reused.getDocId ()) == changed);
+		return result;
+	}
+
+	string size_of (const string& raster)
+		{ return raster.substr (0, raster.find (':')); }
+}
+
+//
+// Rendering state reused between page renderings (catalog, started output
+// device) has to follow document changes
+//
+bool
+rerender (UNUSED_PARAM ostream& oss, const char* fileName)
+{
+	// works on a copy because changes are saved
+	string copyName = string (fileName) + "-rerender.pdf";
+	{
+		ifstream in (fileName, ios::binary);
+		ofstream out (copyName.c_str(), ios::binary);
+		out << in.rdbuf ();
+	}
+	boost::shared_ptr<CPdf> pdf = getTestCPdf (copyName.c_str());
+	if (pdf->getMode () == CPdf::ReadOnly || !pdf->getPageCount ())
+	{
+		pdf.reset ();
+		remove (copyName.c_str());
+		return true;
+	}
+
+	SplashColor paperColor;
+	paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+	SplashOutputDev reused (splashModeRGB8, 4, gFalse, paperColor);
+	shared_ptr<CPage> page = pdf->getPage (1);
+	string original = rasterize_reused (page, reused, true);
+	CPPUNIT_ASSERT (rasterize_reused (page, reused, false) == original);
+
+	// page content edit
+	PdfOperator::Operands operands;
+	for (size_t i = 0; i < 4; ++i)
+		operands.push_back (shared_ptr<IProperty> (CIntFactory::getInstance (10 + 10 * (int)i)));
+	vector<shared_ptr<PdfOperator> > ops;
+	ops.push_back (createOperator ("re", operands));
+	operands.clear ();
+	ops.push_back (createOperator ("f", operands));
+	page->addContentStreamToBack (ops);
+	rasterize_reused (page, reused, true);
+
+	// inheritable attributes edited in the page and in its parent
+	shared_ptr<CDict> parent = utils::getCObjectFromRef<CDict> (page->getDictionary ()->getProperty ("Parent"));
+	if (parent->containsProperty ("Rotate"))
+		parent->delProperty ("Rotate");
+	parent->addProperty ("Rotate", CInt (90));
+	rasterize_reused (page, reused, true);
+	libs::Rectangle box = page->getMediabox ();
+	page->setMediabox (libs::Rectangle (box.xleft, box.yleft, box.xleft + 100, box.yleft + 50));
+	string changed = rasterize_reused (page, reused, true);
+	CPPUNIT_ASSERT (size_of (changed) != size_of (original));
+
+	// save reopens the document
+	pdf->save (true);
+	page = pdf->getPage (1);
+	CPPUNIT_ASSERT (rasterize_reused (page, reused, true) == changed);
+
+	// revision changes
+	pdf->changeRevision ((CPdf::revision_t)(pdf->getRevisionsCount () - 2));
+	page = pdf->getPage (1);
+	CPPUNIT_ASSERT (rasterize_reused (page, reused, true) == original);
+	pdf->changeRevision ((CPdf::revision_t)(pdf->getRevisionsCount () - 1));
+	page = pdf->getPage (1);
+	CPPUNIT_ASSERT (rasterize_reused (page, reused, true) == changed);
+
+	page.reset ();
+	pdf.reset ();
+	remove (copyName.c_str());
+	return true;
+}
+
+//=====================================================================================
+
 bool
 _export (UNUSED_PARAM ostream& oss, const char* fileName)
 {
@@ -503,6 +612,7 @@ class TestCPage : public CppUnit::TestFixture
 		CPPUNIT_TEST(Test);
 		CPPUNIT_TEST(TestCreation);
 		CPPUNIT_TEST(TestDisplay);
+		CPPUNIT_TEST(TestRerender);
 		CPPUNIT_TEST(TestExport);
 		CPPUNIT_TEST(TestFind);
 		//CPPUNIT_TEST(TestAnnotations);
@@ -598,6 +708,24 @@ public:
 	//
 	//
 	//
+	void TestRerender ()
+	{
+		OUTPUT << "CPage rendering after changes..." << endl;
+
+		for(TestParams::FileList::const_iterator it = TestParams::instance().files.begin(); 
+				it != TestParams::instance().files.end(); 
+					++it)
+		{
+			OUTPUT << "Testing filename: " << *it << endl;
+
+			TEST(" rerender");
+			CPPUNIT_ASSERT (rerender (OUTPUT, (*it).c_str()));
+			OK_TEST;
+		}
+	}
+	//
+	//
+	//
 	void TestCreation ()
 	{
 		OUTPUT << "CPage creation methods..." << endl;
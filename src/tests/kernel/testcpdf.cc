@@ -31,12 +31,174 @@
 #include "kernel/cpdf.h"
 #include "kernel/pdfwriter.h"
 #include "kernel/delinearizator.h"
+#include "kernel/flattener.h"
+#include "kernel/xrefwriter.h"
+#include "kernel/ccontentstream.h"
+#include "utils/thread.h"
+#include "utils/atomic.h"
 
 using namespace pdfobjects;
 using namespace utils;
 using namespace observer;
 using namespace boost;
 
+/** Checks whether both files have the same content.
+ */
+bool sameFiles(const string & name1, const string & name2)
+{
+	FILE * file1 = fopen(name1.c_str(), "rb");
+	FILE * file2 = fopen(name2.c_str(), "rb");
+	bool same = file1 && file2;
+	while(same)
+	{
+		int ch1 = fgetc(file1);
+		same = (ch1 == fgetc(file2));
+		if(ch1 == EOF)
+			break;
+	}
+	if(file1)
+		fclose(file1);
+	if(file2)
+		fclose(file2);
+	return same;
+}
+
+/** Reader of a document shared with other threads.
+ * Walks all pages (starting from the given one), parses their content
+ * streams and then fetches all indirect objects.
+ */
+class ConcurrentReader: public threads::Thread
+{
+public:
+	boost::shared_ptr<CPdf> pdf;
+	/** Offset of the first read page and object. */
+	size_t first;
+	/** Properties returned by getIndirectProperty indexed by object number. */
+	std::vector<boost::shared_ptr<IProperty> > props;
+	/** Number of parsed operators. */
+	size_t operators;
+	bool failed;
+
+	ConcurrentReader(boost::shared_ptr<CPdf> p, size_t s)
+		:pdf(p), first(s), operators(0), failed(false)
+	{
+	}
+
+protected:
+	void run()
+	{
+		try
+		{
+			size_t count = pdf->getPageCount();
+			for(size_t i = 0; i < count; ++i)
+			{
+				boost::shared_ptr<CPage> page = pdf->getPage((first + i) % count + 1);
+				std::vector<boost::shared_ptr<CContentStream> > streams;
+				page->getContentStreams(streams);
+				for(size_t s = 0; s < streams.size(); ++s)
+				{
+					CContentStream::Operators ops;
+					streams[s]->getPdfOperators(ops);
+					operators += ops.size();
+				}
+			}
+			int total = pdf->getCXref()->getNumObjects();
+			props.resize(total + 1);
+			for(int i = 0; i < total; ++i)
+			{
+				IndiRef ref;
+				ref.num = (first + i) % total + 1;
+				props[ref.num] = pdf->getIndirectProperty(ref);
+			}
+		}catch(...)
+		{
+			failed = true;
+		}
+	}
+};
+
+/** Reader of stream objects of a document shared with other threads.
+ * Repeatedly creates all stream properties and checks that their buffers
+ * don't change from one round to another.
+ */
+class StreamReader: public threads::Thread
+{
+public:
+	boost::shared_ptr<CPdf> pdf;
+	size_t rounds;
+	/** Stream buffers indexed by object number. */
+	std::vector<CStream::Buffer> buffers;
+	bool failed;
+
+	StreamReader(boost::shared_ptr<CPdf> p, size_t r)
+		:pdf(p), rounds(r), failed(false)
+	{
+	}
+
+protected:
+	void run()
+	{
+		try
+		{
+			int total = pdf->getCXref()->getNumObjects();
+			buffers.resize(total + 1);
+			for(size_t r = 0; r < rounds; ++r)
+				for(int i = 1; i <= total; ++i)
+				{
+					IndiRef ref;
+					ref.num = i;
+					// discards unused properties, so streams are created again
+					pdf->setIndirectCacheBudget(0);
+					boost::shared_ptr<IProperty> prop = pdf->getIndirectProperty(ref);
+					if(!isStream(prop))
+						continue;
+					const CStream::Buffer & buffer = IProperty::getSmartCObjectPtr<CStream>(prop)->getBuffer();
+					if(!r)
+						buffers[i] = buffer;
+					else if(buffers[i] != buffer)
+						failed = true;
+				}
+		}catch(...)
+		{
+			failed = true;
+		}
+	}
+};
+
+/** Thread fetching all objects directly through the document xref
+ * until it is stopped.
+ */
+class XRefFetcher: public threads::Thread
+{
+public:
+	boost::shared_ptr<CPdf> pdf;
+	volatile long stopped;
+
+	XRefFetcher(boost::shared_ptr<CPdf> p)
+		:pdf(p), stopped(0)
+	{
+	}
+
+	void stop()
+	{
+		threads::atomicIncrement(stopped);
+	}
+
+protected:
+	void run()
+	{
+		CXref * xref = pdf->getCXref();
+		int total = xref->getNumObjects();
+		while(!threads::atomicRead(stopped))
+			for(int i = 1; i <= total; ++i)
+			{
+				::Object obj;
+				xref->fetch(i, 0, &obj);
+				obj.free();
+			}
+	}
+};
+
 class ProgressBar:public IProgressBar
 {
 	int maxStep;
@@ -1139,7 +1301,506 @@ public:
 		delinearizator->delinearize(outputFile.c_str());
 	}
 
+	/** Collects references reachable from given object recursively.
+	 * Reference implementation for reachableRefsTC.
+	 */
+	void collectRefsRecursive(::XRef & xref, const ::Object & obj, std::set<int> & refs)
+	{
+		::Object child;
+		switch(obj.getType())
+		{
+			case objRef:
+				if(!refs.insert(obj.getRefNum()).second)
+					return;
+				obj.fetch(&xref, &child);
+				collectRefsRecursive(xref, child, refs);
+				child.free();
+				break;
+			case objArray:
+				for(int i=0; i<obj.arrayGetLength(); ++i)
+				{
+					obj.arrayGetNF(i, &child);
+					collectRefsRecursive(xref, child, refs);
+					child.free();
+				}
+				break;
+			case objDict:
+			case objStream:
+				{
+					const Dict * dict = (obj.isDict())?obj.getDict():obj.streamGetDict();
+					for(int i=0; i<dict->getLength(); ++i)
+					{
+						dict->getValNF(i, &child);
+						collectRefsRecursive(xref, child, refs);
+						child.free();
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	/** Returns position of the object in the file as (offset, index) pair.
+	 * Objects which are not in the file are placed at the end.
+	 */
+	std::pair<Guint, int> refPosition(::XRef & xref, const ::Ref & ref)
+	{
+		if(ref.num < xref.getSize())
+		{
+			const XRefEntry * entry = xref.getEntry(ref.num);
+			if(entry->type == xrefEntryUncompressed)
+				return std::make_pair(entry->offset, 0);
+			if(entry->type == xrefEntryCompressed && (int)entry->offset < xref.getSize())
+				return std::make_pair(xref.getEntry(entry->offset)->offset, entry->gen+1);
+		}
+		return std::make_pair((Guint)UINT_MAX, ref.num);
+	}
+
+	void reachableRefsTC(string fileName)
+	{
+	using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(fileName.c_str(), CPdf::ReadOnly);
+		::XRef & xref = *pdf->getCXref();
+		const ::Object * trailer = xref.getTrailerDict();
+
+		printf("TC01:\tReachable objects are the same as found by recursive traversal\n");
+		std::set<int> expected;
+		collectRefsRecursive(xref, *trailer, expected);
+		std::vector< ::Ref> unsorted, sorted;
+		collectReachableRefs(xref, *trailer, unsorted, false);
+		collectReachableRefs(xref, *trailer, sorted);
+		CPPUNIT_ASSERT(unsorted.size() == expected.size());
+		CPPUNIT_ASSERT(sorted.size() == expected.size());
+		std::set<int> unsortedNums, sortedNums;
+		for(size_t i=0; i<unsorted.size(); ++i)
+		{
+			unsortedNums.insert(unsorted[i].num);
+			sortedNums.insert(sorted[i].num);
+		}
+		CPPUNIT_ASSERT(unsortedNums == expected);
+		CPPUNIT_ASSERT(sortedNums == expected);
+
+		printf("TC02:\tSorted objects follow their position in the file\n");
+		for(size_t i=1; i<sorted.size(); ++i)
+		{
+			std::pair<Guint, int> prev = refPosition(xref, sorted[i-1]);
+			std::pair<Guint, int> pos = refPosition(xref, sorted[i]);
+			CPPUNIT_ASSERT(prev <= pos);
+		}
+
+		printf("TC03:\tDangling reference with a huge number is collected once at the end\n");
+		// the same dangling reference twice around the whole document
+		::Ref dangling = {INT_MAX-1, 0};
+		::Object root, item;
+		root.initArray(&xref);
+		item.initRef(dangling.num, dangling.gen);
+		root.arrayAdd(&item);
+		trailer->copy(&item);
+		root.arrayAdd(&item);
+		item.initRef(dangling.num, dangling.gen);
+		root.arrayAdd(&item);
+		collectReachableRefs(xref, root, sorted);
+		collectReachableRefs(xref, root, unsorted, false);
+		root.free();
+		CPPUNIT_ASSERT(sorted.size() == expected.size()+1);
+		CPPUNIT_ASSERT(unsorted.size() == expected.size()+1);
+		CPPUNIT_ASSERT(unsorted.front().num == dangling.num);
+		CPPUNIT_ASSERT(sorted.back().num == dangling.num);
+		for(size_t i=0; i+1<sorted.size(); ++i)
+			CPPUNIT_ASSERT(sorted[i].num != dangling.num);
+	}
+
+	/** Finds the first stream object in the document with(out) filters.
+	 * @param xref Document xref.
+	 * @param filtered Flag whether the stream should have a Filter entry.
+	 * @param ref Reference of found stream.
+	 * @return true if such a stream is found.
+	 *
+	 * Streams are fetched directly from the file by XRef::fetch (as Flattener
+	 * does), because CXref::fetch returns their memory copies.
+	 */
+	bool findStream(::XRef & xref, bool filtered, ::Ref & ref)
+	{
+		for(int num=1; num<xref.getSize(); ++num)
+		{
+			// streams can't be stored in object streams
+			const XRefEntry * entry = xref.getEntry(num);
+			if(entry->type != xrefEntryUncompressed)
+				continue;
+			::Object obj, filter;
+			xref.XRef::fetch(num, entry->gen, &obj);
+			bool found = false;
+			if(obj.isStream())
+			{
+				obj.streamGetDict()->lookupNF("Filter", &filter);
+				found = filtered != filter.isNull();
+				filter.free();
+			}
+			obj.free();
+			if(found)
+			{
+				ref.num = num;
+				ref.gen = entry->gen;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** Checks whether the stream with given reference is copied raw. */
+	bool isRawCopyable(::XRef & xref, const ::Ref & ref)
+	{
+		::Object obj;
+		xref.XRef::fetch(ref.num, ref.gen, &obj);
+		CPPUNIT_ASSERT(obj.isStream());
+		bool result = NullFilterStreamWriter::isRawCopyable(obj);
+		obj.free();
+		return result;
+	}
+
+	void rawCopyTC(string fileName)
+	{
+	using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(fileName.c_str(), CPdf::ReadWrite);
+		::XRef & xref = *pdf->getCXref();
+		::Ref filtered, unfiltered;
+
+		printf("TC01:\tUnchanged filtered stream is copied raw\n");
+		bool haveFiltered = findStream(xref, true, filtered);
+		if(haveFiltered)
+		{
+			CPPUNIT_ASSERT(isRawCopyable(xref, filtered));
+			// encoded data are written as they are in the file
+			::Object obj;
+			xref.XRef::fetch(filtered.num, filtered.gen, &obj);
+			size_t rawSize = 0;
+			unsigned char * raw = NullFilterStreamWriter::null_extractor(obj, rawSize);
+			CPPUNIT_ASSERT(raw);
+			CharBuffer buffer;
+			size_t size = NullFilterStreamWriter::getInstance()->encode(obj, &filtered, buffer, false);
+			obj.free();
+			CPPUNIT_ASSERT(size > rawSize);
+			CPPUNIT_ASSERT(std::search(buffer.get(), buffer.get()+size, 
+						(char *)raw, (char *)raw+rawSize) != buffer.get()+size);
+			free(raw);
+		}else
+			printf("\tNo filtered stream in the document\n");
+
+		printf("TC02:\tUnchanged stream without filters is compressed\n");
+		if(findStream(xref, false, unfiltered))
+		{
+			CPPUNIT_ASSERT(!isRawCopyable(xref, unfiltered));
+			::Object obj;
+			xref.XRef::fetch(unfiltered.num, unfiltered.gen, &obj);
+			CPPUNIT_ASSERT(FilterStreamWriter::getInstance(obj) == ZlibFilterStreamWriter::getInstance());
+			obj.free();
+		}else
+			printf("\tNo stream without filters in the document\n");
+
+		printf("TC03:\tChanged stream is not copied raw\n");
+		if(haveFiltered)
+		{
+			shared_ptr<CStream> stream = IProperty::getSmartCObjectPtr<CStream>(
+					pdf->getIndirectProperty(IndiRef(filtered)));
+			CStream::Buffer data(4, ' ');
+			stream->setRawBuffer(data);
+			::Object obj;
+			xref.fetch(filtered.num, filtered.gen, &obj);
+			CPPUNIT_ASSERT(obj.isStream());
+			CPPUNIT_ASSERT(!NullFilterStreamWriter::isRawCopyable(obj));
+			obj.free();
+		}
+	}
+
+	void xrefStreamWriterTC(string fileName)
+	{
+	using namespace pdfobjects::utils;
+
+		printf("%s\n", __FUNCTION__);
+		size_t pageCount = getTestCPdf(fileName.c_str(), CPdf::ReadOnly)->getPageCount();
+
+		printf("TC01:\tDocument written with object streams keeps its pages\n");
+		boost::shared_ptr<Flattener> flattener = Flattener::getInstance(fileName.c_str(), new XRefStreamPdfWriter());
+		CPPUNIT_ASSERT(flattener);
+		string outputFile = fileName+"-xrefstream.pdf";
+		CPPUNIT_ASSERT(0 == flattener->flatten(outputFile.c_str()));
+		CPPUNIT_ASSERT(pageCount == getTestCPdf(outputFile.c_str(), CPdf::ReadOnly)->getPageCount());
+
+		printf("TC02:\tChanges saved with cross reference stream are readable\n");
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(outputFile.c_str(), CPdf::ReadWrite);
+		XRefWriter * xref = dynamic_cast<XRefWriter *>(pdf->getCXref());
+		delete xref->setPdfWriter(new XRefStreamPdfWriter());
+		IndiRef ref = pdf->addIndirectProperty(boost::shared_ptr<CInt>(CIntFactory::getInstance(1)));
+		pdf->save(true);
+		pdf.reset();
+		pdf = getTestCPdf(outputFile.c_str(), CPdf::ReadOnly);
+		CPPUNIT_ASSERT(pageCount == pdf->getPageCount());
+		CPPUNIT_ASSERT(1 == getValueFromSimple<CInt>(pdf->getIndirectProperty(ref)));
+		CPPUNIT_ASSERT(2 == pdf->getRevisionsCount());
+		pdf.reset();
+
+		printf("TC03:\tParallel writer produces the same document\n");
+		// the same output for 1 and more workers both for streams copied
+		// as they are and for decoded streams
+		string serialFile = fileName+"-serial.pdf";
+		string parallelFile = fileName+"-parallel.pdf";
+		const size_t jobs[] = {1, 4};
+		for(size_t i=0; i<2; ++i)
+		{
+			const string & output = (jobs[i]==1)?serialFile:parallelFile;
+			OldStylePdfWriter * writer = new OldStylePdfWriter();
+			writer->setWorkers(jobs[i]);
+			flattener = Flattener::getInstance(fileName.c_str(), writer);
+			CPPUNIT_ASSERT(0 == flattener->flatten(output.c_str()));
+		}
+		flattener.reset();
+		CPPUNIT_ASSERT(pageCount == getTestCPdf(parallelFile.c_str(), CPdf::ReadOnly)->getPageCount());
+		CPPUNIT_ASSERT(sameFiles(serialFile, parallelFile));
+		for(size_t i=0; i<2; ++i)
+		{
+			const string & output = (jobs[i]==1)?serialFile:parallelFile;
+			pdf = getTestCPdf(fileName.c_str(), CPdf::ReadOnly);
+			OldStylePdfWriter * writer = new OldStylePdfWriter();
+			writer->setWorkers(jobs[i]);
+			delete dynamic_cast<XRefWriter *>(pdf->getCXref())->setPdfWriter(writer);
+			pdf->saveDecoded(const_cast<char *>(output.c_str()));
+			pdf.reset();
+		}
+		CPPUNIT_ASSERT(sameFiles(serialFile, parallelFile));
+		#if TEMP_FILES_CREATE
+		#else
+			remove (outputFile.c_str());
+			remove (serialFile.c_str());
+			remove (parallelFile.c_str());
+		#endif
+	}
+
 #define staticArraySize(array) sizeof(array)/sizeof(*array)
+	void indirectCacheTC(string& fname)
+	{
+		printf("%s\n", __FUNCTION__);
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(fname.c_str());
+		XRefWriter * xref = dynamic_cast<XRefWriter *>(pdf->getCXref());
+		int count = xref->getNumObjects();
+
+		printf("TC01:\tHeld properties are shared even if budget is exceeded\n");
+		pdf->setIndirectCacheBudget(0);
+		CPdf::IndirectCacheStatistics before = pdf->getIndirectCacheStatistics();
+		std::vector<boost::shared_ptr<IProperty> > held;
+		for (int i = 1; i <= count; ++i)
+		{
+			IndiRef ref;
+			ref.num = i;
+			if (UNUSED_REF == xref->knowsRef(ref))
+				continue;
+			boost::shared_ptr<IProperty> prop = pdf->getIndirectProperty(ref);
+			held.push_back(prop);
+			CPPUNIT_ASSERT(prop == pdf->getIndirectProperty(ref));
+		}
+		CPdf::IndirectCacheStatistics after = pdf->getIndirectCacheStatistics();
+		CPPUNIT_ASSERT(after.hits >= before.hits + held.size());
+		// held properties don't fit into the budget, so shrinking has to be
+		// backed off instead of checking all of them for each new one
+		CPPUNIT_ASSERT(after.shrinks - before.shrinks <= (after.misses - before.misses)/2 + 1);
+
+		printf("TC02:\tNot held properties are discarded\n");
+		size_t heldCount = held.size();
+		held.clear();
+		pdf->setIndirectCacheBudget(0);
+		after = pdf->getIndirectCacheStatistics();
+		CPPUNIT_ASSERT(0 == heldCount || after.evictions > before.evictions);
+	}
+
+	void concurrentReadTC(string& fname)
+	{
+		printf("%s\n", __FUNCTION__);
+		const size_t threadCount = 4;
+
+		printf("TC01:\tReaders of one read-only document get the same results\n");
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(fname.c_str(), CPdf::ReadOnly);
+		size_t pages = pdf->getPageCount();
+		std::vector<ConcurrentReader *> readers;
+		for(size_t i = 0; i < threadCount; ++i)
+			readers.push_back(new ConcurrentReader(pdf, i * pages / threadCount));
+		for(size_t i = 0; i < threadCount; ++i)
+			CPPUNIT_ASSERT(readers[i]->start());
+		for(size_t i = 0; i < threadCount; ++i)
+			readers[i]->join();
+		bool failed = false;
+		for(size_t i = 0; i < threadCount; ++i)
+		{
+			failed = failed || readers[i]->failed;
+			if(failed)
+				break;
+			CPPUNIT_ASSERT(readers[i]->operators == readers[0]->operators);
+			CPPUNIT_ASSERT(readers[i]->props.size() == readers[0]->props.size());
+			// all threads have to share the same properties
+			for(size_t p = 0; p < readers[i]->props.size(); ++p)
+				CPPUNIT_ASSERT(readers[i]->props[p] == readers[0]->props[p]
+						|| !readers[i]->props[p] || isNull(readers[i]->props[p]));
+		}
+		size_t operators = readers[0]->operators;
+		for(size_t i = 0; i < threadCount; ++i)
+			delete readers[i];
+		CPPUNIT_ASSERT(!failed);
+
+		printf("TC02:\tConcurrent readers parse the same as a single one\n");
+		boost::shared_ptr<CPdf> serialPdf = getTestCPdf(fname.c_str(), CPdf::ReadOnly);
+		ConcurrentReader serial(serialPdf, 0);
+		CPPUNIT_ASSERT(serial.start());
+		serial.join();
+		CPPUNIT_ASSERT(!serial.failed);
+		CPPUNIT_ASSERT(serial.operators == operators);
+
+		printf("TC03:\tStreams read concurrently with xref fetching are not corrupted\n");
+		pdf = CPdf::getInstance(fname.c_str(), CPdf::ReadOnly, CPdf::DirectWriter);
+		// older revisions read streams directly from the document
+		if(pdf->getRevisionsCount() > 1)
+			pdf->changeRevision(0);
+		StreamReader serialStreams(pdf, 1);
+		CPPUNIT_ASSERT(serialStreams.start());
+		serialStreams.join();
+		CPPUNIT_ASSERT(!serialStreams.failed);
+		std::vector<StreamReader *> streamReaders;
+		for(size_t i = 0; i < threadCount; ++i)
+			streamReaders.push_back(new StreamReader(pdf, 1000));
+		XRefFetcher fetcher(pdf);
+		CPPUNIT_ASSERT(fetcher.start());
+		for(size_t i = 0; i < threadCount; ++i)
+			CPPUNIT_ASSERT(streamReaders[i]->start());
+		for(size_t i = 0; i < threadCount; ++i)
+			streamReaders[i]->join();
+		fetcher.stop();
+		fetcher.join();
+		failed = false;
+		for(size_t i = 0; i < threadCount; ++i)
+		{
+			failed = failed || streamReaders[i]->failed
+				|| streamReaders[i]->buffers != serialStreams.buffers;
+			delete streamReaders[i];
+		}
+		CPPUNIT_ASSERT(!failed);
+	}
+
+	void rebalancePageTreeTC(string& fname)
+	{
+		printf("%s\n", __FUNCTION__);
+		boost::shared_ptr<CPdf> pdf = getTestCPdf(fname.c_str());
+		if (pdf->getMode() == CPdf::ReadOnly)
+		{
+			printf("%s: Document is read only and it is not usable for this test\n", __FUNCTION__);
+			return;
+		}
+		size_t count = pdf->getPageCount();
+		std::vector<boost::shared_ptr<CPage> > pages;
+		std::vector<IndiRef> refs;
+		std::vector<libs::Rectangle> mediaBoxes;
+		std::vector<int> rotations;
+		for (size_t pos = 1; pos <= count; ++pos)
+		{
+			boost::shared_ptr<CPage> page = pdf->getPage(pos);
+			pages.push_back(page);
+			refs.push_back(page->getDictionary()->getIndiRef());
+			mediaBoxes.push_back(page->getMediabox());
+			rotations.push_back(page->getRotation());
+		}
+
+		printf("TC01:\tNo intermediate node has more kids than allowed after rebalancing\n");
+		const size_t maxKids = 2;
+		if (!pdf->rebalancePageTree(maxKids))
+		{
+			printf("%s: Page tree is not suitable for this test\n", __FUNCTION__);
+			return;
+		}
+		CPPUNIT_ASSERT(!pdf->rebalancePageTree(maxKids));
+		CPPUNIT_ASSERT(pdf->isChanged());
+
+		printf("TC02:\tPages keep their positions and attributes\n");
+		CPPUNIT_ASSERT(pdf->getPageCount() == count);
+		for (size_t pos = 1; pos <= count; ++pos)
+		{
+			boost::shared_ptr<CPage> page = pdf->getPage(pos);
+			CPPUNIT_ASSERT(page == pages[pos-1]);
+			CPPUNIT_ASSERT(pdf->getPagePosition(page) == pos);
+			CPPUNIT_ASSERT(page->getDictionary()->getIndiRef() == refs[pos-1]);
+			CPPUNIT_ASSERT(page->getMediabox() == mediaBoxes[pos-1]);
+			CPPUNIT_ASSERT(page->getRotation() == rotations[pos-1]);
+			boost::shared_ptr<CDict> parent = page->getDictionary()->getProperty<CDict>("Parent");
+			CPPUNIT_ASSERT(parent->getProperty<CArray>("Kids")->getPropertyCount() <= maxKids);
+		}
+
+		printf("TC03:\tPage manipulation works in rebalanced tree\n");
+		pdf->removePage(1);
+		CPPUNIT_ASSERT(pdf->getPageCount() == count - 1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(pages.back()) == count - 1);
+		boost::shared_ptr<CPage> newPage = pdf->insertPage(pages.front(), 1);
+		CPPUNIT_ASSERT(pdf->getPageCount() == count);
+		CPPUNIT_ASSERT(pdf->getPagePosition(newPage) == 1);
+		CPPUNIT_ASSERT(pdf->getPagePosition(pages.back()) == count);
+	}
+
+	void xrefLoadingTC(string& fname)
+	{
+		printf("%s\n", __FUNCTION__);
+		boost::shared_ptr<CPdf> pdf = CPdf::getInstance(fname.c_str(), CPdf::ReadOnly);
+		size_t count = pdf->getPageCount();
+		size_t revisions = pdf->getRevisionsCount();
+		std::vector<IndiRef> refs;
+		for (size_t pos = 1; pos <= count; ++pos)
+			refs.push_back(pdf->getPage(pos)->getDictionary()->getIndiRef());
+		pdf.reset();
+
+		string indexName = XRefIndex::getIndexFileName(fname);
+		CPPUNIT_ASSERT(indexName == fname + XRefIndex::INDEX_SUFFIX);
+		remove(indexName.c_str());
+		CPdf::XRefMode modes[] = {CPdf::LazyXRef, CPdf::IndexedXRef, CPdf::IndexedXRef};
+		// index is stored only for undamaged documents
+		bool indexStored = false;
+		for (size_t i = 0; i < sizeof(modes)/sizeof(modes[0]); ++i)
+		{
+			printf("TC%02d:\tDocument opened with xref mode %d is same as fully loaded one\n", (int)i+1, modes[i]);
+			pdf = CPdf::getInstance(fname.c_str(), CPdf::ReadOnly, CPdf::DirectWriter, modes[i]);
+			CPPUNIT_ASSERT(pdf->getPageCount() == count);
+			for (size_t pos = 1; pos <= count; ++pos)
+				CPPUNIT_ASSERT(pdf->getPage(pos)->getDictionary()->getIndiRef() == refs[pos-1]);
+			CPPUNIT_ASSERT(pdf->getRevisionsCount() == revisions);
+			CPPUNIT_ASSERT(pdf->getActualRevision() == revisions - 1);
+			// the first indexed opening creates the index, the second one
+			// has to use it
+			CPPUNIT_ASSERT(pdf->getCXref()->isIndexed() == (i == 2 && indexStored));
+			pdf.reset();
+			if (i == 1)
+			{
+				FILE * file = fopen(indexName.c_str(), "rb");
+				indexStored = (file != NULL);
+				if (file)
+					fclose(file);
+			}
+		}
+		remove(indexName.c_str());
+
+		printf("TC04:\tIndex is stored to and used from the index directory\n");
+		XRefIndex::setIndexDirectory(".");
+		indexName = XRefIndex::getIndexFileName(fname);
+		string::size_type sep = fname.rfind('/');
+		CPPUNIT_ASSERT(indexName == "./" + fname.substr((sep == string::npos) ? 0 : sep + 1) + XRefIndex::INDEX_SUFFIX);
+		remove(indexName.c_str());
+		pdf = CPdf::getInstance(fname.c_str(), CPdf::ReadOnly, CPdf::DirectWriter, CPdf::IndexedXRef);
+		CPPUNIT_ASSERT(!pdf->getCXref()->isIndexed());
+		pdf.reset();
+		pdf = CPdf::getInstance(fname.c_str(), CPdf::ReadOnly, CPdf::DirectWriter, CPdf::IndexedXRef);
+		CPPUNIT_ASSERT(pdf->getCXref()->isIndexed() == indexStored);
+		CPPUNIT_ASSERT(pdf->getPageCount() == count);
+		pdf.reset();
+		remove(indexName.c_str());
+		XRefIndex::setIndexDirectory("");
+	}
+
 	void changeTrailerTC(string& fname)
 	{
 		printf("%s\n", __FUNCTION__);
@@ -1352,7 +2013,14 @@ public:
 			linearizedTC(pdf);
 
 			delinearizatorTC(fileName);
+			reachableRefsTC(fileName);
+			rawCopyTC(fileName);
+			xrefStreamWriterTC(fileName);
 			changeTrailerTC(fileName);
+			indirectCacheTC(fileName);
+			concurrentReadTC(fileName);
+			rebalancePageTreeTC(fileName);
+			xrefLoadingTC(fileName);
 		}
 		revisionsTC();
 		printf("TEST_CPDF testig finished\n");
@@ -237,6 +237,26 @@ class TestEncryptCPdf: public CppUnit::TestFixture
 		}
 		checkNeedCredentialMethods(pdf, true);
 	}
+
+	void rawCopyTC(shared_ptr<CPdf> pdf)
+	{
+		OUTPUT << "TC03: streams are not copied raw\n";
+		// encrypted data from the file have to be decrypted by the 
+		// stream writer. Streams are fetched directly from the file,
+		// because CXref::fetch returns their memory copies
+		XRef * xref = pdf->getCXref();
+		for(int num=1; num<xref->getSize(); ++num)
+		{
+			const XRefEntry * entry = xref->getEntry(num);
+			if(entry->type != xrefEntryUncompressed)
+				continue;
+			Object obj;
+			xref->XRef::fetch(num, entry->gen, &obj);
+			if(obj.isStream())
+				CPPUNIT_ASSERT(!NullFilterStreamWriter::isRawCopyable(obj));
+			obj.free();
+		}
+	}
 public:
 	void setUp()
 	{
@@ -272,6 +292,7 @@ public:
 			// only encrypted documents are cheched
 			noCredentialsTC(pdf);
 			credentialsTC(pdf, passwd);
+			rawCopyTC(pdf);
 		}
 		str.close();
 	}
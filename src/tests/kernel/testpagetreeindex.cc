@@ -0,0 +1,198 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#include "kernel/static.h"
+#include "tests/kernel/testmain.h"
+#include "kernel/pagetreeindex.h"
+
+
+class TestPageTreeIndex: public CppUnit::TestFixture
+{
+	CPPUNIT_TEST_SUITE(TestPageTreeIndex);
+		CPPUNIT_TEST(Test);
+	CPPUNIT_TEST_SUITE_END();
+
+	typedef std::vector<IndiRef> RefList;
+
+	/** Checks that index holds exactly given references in the same order.
+	 * Unique references have to be found at their position, duplicated ones
+	 * have to be reported as ambiguous.
+	 */
+	void checkIndex(const PageTreeIndex & index, const RefList & refs)
+	{
+		CPPUNIT_ASSERT(index.size()==refs.size());
+		for(size_t i=0; i<refs.size(); ++i)
+		{
+			CPPUNIT_ASSERT(index.at(i)==refs[i]);
+			size_t count=(size_t)std::count(refs.begin(), refs.end(), refs[i]);
+			CPPUNIT_ASSERT(index.occurrences(refs[i])==count);
+			size_t pos=refs.size();
+			bool found=index.getPosition(refs[i], pos);
+			CPPUNIT_ASSERT(found==(count==1));
+			if(found)
+				CPPUNIT_ASSERT(pos==i);
+		}
+	}
+
+public:
+
+	void pageTreeIndexTC()
+	{
+		printf("%s\n", __FUNCTION__);
+		PageTreeIndex index;
+		RefList refs;
+
+		printf("TC01:\tEmpty index\n");
+		size_t pos=0;
+		CPPUNIT_ASSERT(index.size()==0);
+		CPPUNIT_ASSERT(!index.getPosition(IndiRef(1, 0), pos));
+		CPPUNIT_ASSERT(index.occurrences(IndiRef(1, 0))==0);
+		try
+		{
+			index.at(0);
+			CPPUNIT_FAIL("at on empty index should have failed");
+		}catch(OutOfRange &)
+		{
+		}
+		try
+		{
+			index.remove(0);
+			CPPUNIT_FAIL("remove on empty index should have failed");
+		}catch(OutOfRange &)
+		{
+		}
+
+		printf("TC02:\tBuild keeps document order\n");
+		// more references than fit to one block, so the tree has more levels
+		for(int i=1; i<=1000; ++i)
+			refs.push_back(IndiRef(i, 0));
+		index.build(refs);
+		checkIndex(index, refs);
+		try
+		{
+			index.insert(refs.size()+1, IndiRef(5000, 0));
+			CPPUNIT_FAIL("insert behind the end should have failed");
+		}catch(OutOfRange &)
+		{
+		}
+		CPPUNIT_ASSERT(index.size()==refs.size());
+
+		printf("TC03:\tInsertions split blocks\n");
+		// inserts to the same place so that one block overflows repeatedly,
+		// then to the beginning and to the end
+		for(int i=0; i<300; ++i)
+		{
+			IndiRef ref(2000+i, 0);
+			index.insert(500, ref);
+			refs.insert(refs.begin()+500, ref);
+		}
+		for(int i=0; i<100; ++i)
+		{
+			IndiRef front(3000+i, 0), back(4000+i, 0);
+			index.insert(0, front);
+			refs.insert(refs.begin(), front);
+			index.insert(index.size(), back);
+			refs.push_back(back);
+		}
+		checkIndex(index, refs);
+
+		printf("TC04:\tRemovals merge blocks\n");
+		// removes a continuous range which empties whole blocks and then
+		// pseudo random positions
+		for(int i=0; i<400; ++i)
+		{
+			index.remove(300);
+			refs.erase(refs.begin()+300);
+		}
+		checkIndex(index, refs);
+		size_t seed=7;
+		while(refs.size()>10)
+		{
+			seed=(seed*1103515245+12345)%2147483648UL;
+			size_t at=seed%refs.size();
+			index.remove(at);
+			refs.erase(refs.begin()+at);
+		}
+		checkIndex(index, refs);
+
+		printf("TC05:\tDuplicate references are ambiguous\n");
+		// the same page dictionary referenced twice from a damaged tree
+		IndiRef dup=refs[3];
+		index.insert(8, dup);
+		refs.insert(refs.begin()+8, dup);
+		CPPUNIT_ASSERT(index.occurrences(dup)==2);
+		CPPUNIT_ASSERT(!index.getPosition(dup, pos));
+		checkIndex(index, refs);
+		// the same number with a different generation is a different page
+		IndiRef otherGen(dup.num, dup.gen+1);
+		CPPUNIT_ASSERT(index.occurrences(otherGen)==0);
+		CPPUNIT_ASSERT(!index.getPosition(otherGen, pos));
+
+		printf("TC06:\tRemoved duplicate makes reference unique again\n");
+		// the remaining occurrence is behind the removed one, so its
+		// block has to be found again
+		index.remove(3);
+		refs.erase(refs.begin()+3);
+		CPPUNIT_ASSERT(index.occurrences(dup)==1);
+		CPPUNIT_ASSERT(index.getPosition(dup, pos));
+		CPPUNIT_ASSERT(pos==7);
+		checkIndex(index, refs);
+
+		printf("TC07:\tRemoving everything empties the index\n");
+		while(index.size())
+		{
+			index.remove(index.size()-1);
+			refs.pop_back();
+		}
+		checkIndex(index, refs);
+		CPPUNIT_ASSERT(index.occurrences(dup)==0);
+		index.insert(0, dup);
+		refs.push_back(dup);
+		checkIndex(index, refs);
+		index.clear();
+		CPPUNIT_ASSERT(index.size()==0);
+		CPPUNIT_ASSERT(!index.getPosition(dup, pos));
+	}
+
+	virtual ~TestPageTreeIndex()
+	{
+	}
+
+	void setUp()
+	{
+	}
+
+	void tearDown()
+	{
+	}
+
+	void Test()
+	{
+		// index doesn't depend on any document
+		pageTreeIndexTC();
+	}
+};
+CPPUNIT_TEST_SUITE_REGISTRATION(TestPageTreeIndex);
+CPPUNIT_TEST_SUITE_NAMED_REGISTRATION(TestPageTreeIndex, "TEST_PAGETREEINDEX");
@@ -27,6 +27,7 @@
 #include <errno.h>
 #include "tests/kernel/testmain.h"
 #include "kernel/streamwriter.h"
+#include "kernel/cpdf.h"
 
 	
 class TestStreamWriter: public CppUnit::TestFixture
@@ -37,9 +38,9 @@ class TestStreamWriter: public CppUnit::TestFixture
 
 public:
 
-	void fileStreamWriterTC(string test_file)
+	void fileStreamWriterTC(string test_file, CPdf::WriterType writer)
 	{
-		printf("%s with file %s\n", __FUNCTION__, test_file.c_str());
+		printf("%s with file %s (writer=%d)\n", __FUNCTION__, test_file.c_str(), writer);
 		
 		FILE * file1=fopen(test_file.c_str(), "rb+");
 		// TODO ignore empty files
@@ -56,7 +57,22 @@ public:
 		}
 
 		Object dict;
-		FileStreamWriter * streamWriter=new FileStreamWriter(file1, 0, false, 0, &dict);
+		StreamWriter * streamWriter=NULL;
+#ifdef HAVE_SYS_MMAN_H
+		if(writer==CPdf::MappedWriter)
+			streamWriter=MappedFileStreamWriter::getInstance(file1, &dict);
+#endif
+		if(writer==CPdf::MappedWriter && !streamWriter)
+		{
+			printf("file: %s can't be mapped\n", test_file.c_str());
+			fclose(file1);
+			fclose(file2);
+			return;
+		}
+		if(writer==CPdf::BufferedWriter)
+			streamWriter=new BufferedFileStreamWriter(file1, 0, false, 0, &dict);
+		else if(writer==CPdf::DirectWriter)
+			streamWriter=new FileStreamWriter(file1, 0, false, 0, &dict);
 
 		printf("TC01:\tData from FileStreamWriter are same as file content\n");
 		int ch1,
@@ -108,6 +124,23 @@ public:
 			CPPUNIT_ASSERT(ch1==ch2);
 		}
 
+		printf("TC04:\tWritten data are visible in the stream\n");
+		// position moves with written data and they can be read back even
+		// without flush
+		streamWriter->setPos(0);
+		int orig1=streamWriter->getChar(), orig2=streamWriter->getChar();
+		streamWriter->setPos(0);
+		streamWriter->putChar(orig1+1);
+		streamWriter->putChar(orig2+1);
+		CPPUNIT_ASSERT(streamWriter->getPos()==2);
+		streamWriter->setPos(0);
+		CPPUNIT_ASSERT(streamWriter->getChar()==((orig1+1)&0xff));
+		CPPUNIT_ASSERT(streamWriter->getChar()==((orig2+1)&0xff));
+		streamWriter->setPos(0);
+		streamWriter->putChar(orig1);
+		streamWriter->putChar(orig2);
+		streamWriter->flush();
+
 		delete streamWriter;
 		fclose(file1);
 		fclose(file2);
@@ -115,6 +148,57 @@ public:
 		// removes clone file
 		remove(cloneName.c_str());
 	}
+
+#ifdef HAVE_SYS_MMAN_H
+	void mappedTrimTC()
+	{
+		printf("%s\n", __FUNCTION__);
+
+		// few pages of data so that truncation releases whole pages
+		string fileName="mapped_trim.tmp";
+		FILE * file=fopen(fileName.c_str(), "wb+");
+		CPPUNIT_ASSERT(file);
+		const size_t fileSize=64*1024;
+		for(size_t i=0; i<fileSize; i++)
+			fputc('a'+(int)(i%26), file);
+		fflush(file);
+
+		Object dict;
+		MappedFileStreamWriter * streamWriter=MappedFileStreamWriter::getInstance(file, &dict);
+		CPPUNIT_ASSERT(streamWriter);
+		Stream * subStream=streamWriter->makeSubStream(0, false, 0, &dict);
+
+		printf("TC01:\tSubstream behind truncated end doesn't crash\n");
+		// mapping is still bigger than the file, data behind the end
+		// are read as zeros
+		CPPUNIT_ASSERT(streamWriter->trim(10));
+		subStream->reset();
+		size_t count=0;
+		int ch;
+		while((ch=subStream->getChar())!=EOF)
+		{
+			if(count<10)
+				CPPUNIT_ASSERT(ch=='a'+(int)count);
+			else
+				CPPUNIT_ASSERT(ch==0);
+			count++;
+		}
+		CPPUNIT_ASSERT(count==fileSize);
+
+		printf("TC02:\tFile grows again after truncation\n");
+		streamWriter->setPos(10);
+		streamWriter->putLine("xyz", 3);
+		streamWriter->setPos(0);
+		char buf[14];
+		CPPUNIT_ASSERT(streamWriter->getBlock(buf, 14)==14);
+		CPPUNIT_ASSERT(!memcmp(buf, "abcdefghijxyz\n", 14));
+
+		delete subStream;
+		delete streamWriter;
+		fclose(file);
+		remove(fileName.c_str());
+	}
+#endif
 		
 	virtual ~TestStreamWriter()
 	{
@@ -136,8 +220,13 @@ public:
 				i != TestParams::instance().files.end(); 
 					++i)
 		{
-			fileStreamWriterTC(*i);
+			fileStreamWriterTC(*i, CPdf::DirectWriter);
+			fileStreamWriterTC(*i, CPdf::BufferedWriter);
+			fileStreamWriterTC(*i, CPdf::MappedWriter);
 		}
+#ifdef HAVE_SYS_MMAN_H
+		mappedTrimTC();
+#endif
 	}
 };
 CPPUNIT_TEST_SUITE_REGISTRATION(TestStreamWriter);
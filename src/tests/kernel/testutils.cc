@@ -26,6 +26,7 @@
 #include "kernel/static.h"
 #include "tests/kernel/testmain.h"
 #include "utils/confparser.h"
+#include "utils/arena.h"
 #include "kernel/modecontroller.h"
 #include "kernel/operatorhinter.h"
 
@@ -334,12 +335,63 @@ public:
 		return true;
 	}
 
+	bool arenaTC()
+	{
+		OUTPUT << "TC01:\tReleased memory is reused before a new block is allocated" << endl;
+		ArenaOwner owner;
+		ArenaAllocator<double> alloc(owner.get());
+		std::vector<double*> values;
+		while(values.empty() || 1 == owner.get()->getBlockCount())
+			values.push_back(alloc.allocate(1));
+		double * first = values.front();
+		alloc.deallocate(first, 1);
+		values.erase(values.begin());
+		bool reused = false;
+		while(!reused && 2 == owner.get()->getBlockCount())
+		{
+			values.push_back(alloc.allocate(1));
+			reused = (first == values.back());
+		}
+		CPPUNIT_ASSERT(reused);
+		CPPUNIT_ASSERT(2 == owner.get()->getBlockCount());
+
+		OUTPUT << "TC02:\tArena with allocations is not reset but replaced" << endl;
+		Arena * arena = owner.get();
+		boost::shared_ptr<int> held = boost::allocate_shared<int>(ArenaAllocator<int>(arena), 7);
+		for(std::vector<double*>::iterator i = values.begin(); i != values.end(); ++i)
+			alloc.deallocate(*i, 1);
+		CPPUNIT_ASSERT(!arena->reset());
+		owner.renew();
+		CPPUNIT_ASSERT(arena != owner.get());
+		// held memory stays valid until it is released
+		CPPUNIT_ASSERT(7 == *held);
+		held.reset();
+
+		OUTPUT << "TC03:\tArena without allocations is reset to its first block" << endl;
+		arena = owner.get();
+		ArenaAllocator<char> chars(arena);
+		std::vector<char*> buffers;
+		for(int i = 0; i < 100; ++i)
+			buffers.push_back(chars.allocate(1000));
+		CPPUNIT_ASSERT(1 < arena->getBlockCount());
+		for(std::vector<char*>::iterator i = buffers.begin(); i != buffers.end(); ++i)
+			chars.deallocate(*i, 1000);
+		owner.renew();
+		CPPUNIT_ASSERT(arena == owner.get());
+		CPPUNIT_ASSERT(1 == arena->getBlockCount());
+		char * buffer = chars.allocate(1000);
+		CPPUNIT_ASSERT(buffers.front() == buffer);
+		chars.deallocate(buffer, 1000);
+		return true;
+	}
+
 	void Test()
 	{
 		CPPUNIT_ASSERT(tokenizerTC());
 		CPPUNIT_ASSERT(modeControllerTC());
 		CPPUNIT_ASSERT(operatorHinterTC());
 		CPPUNIT_ASSERT(observerHandlerTC());
+		CPPUNIT_ASSERT(arenaTC());
 	}
 };
 CPPUNIT_TEST_SUITE_REGISTRATION(TestUtils);
@@ -28,6 +28,7 @@
 #include "kernel/pdfwriter.h"
 #include "kernel/streamwriter.h"
 #include "kernel/cxref.h"
+#include <zlib.h>
 
 using namespace std;
 using namespace pdfobjects;
@@ -35,12 +36,21 @@ using namespace pdfobjects::utils;
 using namespace boost;
 namespace po = program_options;
 
-int delinearize(const char *input, const char *output)
+int delinearize(const char *input, const char *output, size_t jobs, bool xrefStreams)
 {
 	Object dict;
 	dict.initNull();
+	IPdfWriter * writer;
+	if (xrefStreams)
+		writer = new XRefStreamPdfWriter();
+	else
+	{
+		OldStylePdfWriter * oldStyleWriter = new OldStylePdfWriter();
+		oldStyleWriter->setWorkers(jobs);
+		writer = oldStyleWriter;
+	}
 	boost::shared_ptr<Delinearizator> del = 
-		Delinearizator::getInstance(input, new OldStylePdfWriter());
+		Delinearizator::getInstance(input, writer);
 	if (!del) 
 		return 1;
 	int ret = del->delinearize(output);
@@ -61,6 +71,9 @@ int main(int argc, char ** argv)
 		("help", "produce help message")
 		("file", po::value<string>(), "Input pdf file")
 		("output", po::value<string>(), "Output pdf file")
+		("jobs", po::value<size_t>()->default_value(1), "number of threads preparing objects")
+		("level", po::value<int>()->default_value(Z_DEFAULT_COMPRESSION), "compression level for changed streams (0-9)")
+		("xref-streams", "pack objects to object streams and write cross reference stream")
 	;
 	
 	po::variables_map vm;
@@ -81,8 +94,16 @@ int main(int argc, char ** argv)
 
 	string input_file = vm["file"].as<string>(); 
 	string output_file = vm["output"].as<string>();
+	size_t jobs = vm["jobs"].as<size_t>();
+	try {
+		ZlibFilterStreamWriter::setCompressionLevel(vm["level"].as<int>());
+	}catch(OutOfRange&)
+	{
+		cout << "Bad compression level. Please, check your parameters." << endl;
+		return 1;
+	}
 
-	ret = delinearize(input_file.c_str(), output_file.c_str());
+	ret = delinearize(input_file.c_str(), output_file.c_str(), jobs, vm.count("xref-streams") > 0);
 
 	pdfedit_core_dev_destroy();
 	return ret;
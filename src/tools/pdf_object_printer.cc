@@ -52,7 +52,7 @@ void getStringRepresentation(boost::shared_ptr<IProperty> &prop, std::string &st
 
 void print_objects(const char *fname, RefContainer &refs)
 {
-	boost::shared_ptr<CPdf> pdf = pdfobjects::CPdf::getInstance(fname, CPdf::ReadOnly);
+	boost::shared_ptr<CPdf> pdf = pdfobjects::CPdf::getInstance(fname, CPdf::ReadOnly, CPdf::MappedWriter);
 
 	std::cout << "Document: \"" << fname << "\"" << std::endl;
 	RefContainer::const_iterator i;
@@ -0,0 +1,360 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+#include <kernel/pdfedit-core-dev.h>
+#include <kernel/cpdf.h>
+#include <kernel/cpage.h>
+#include <utils/mutex.h>
+#include <utils/thread.h>
+#include <splash/Splash.h>
+#include <splash/SplashBitmap.h>
+#include <splash/SplashErrorCodes.h>
+#include <xpdf/SplashOutputDev.h>
+
+#include <boost/program_options.hpp>
+#include <vector>
+#include <png.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+using namespace pdfobjects;
+using namespace std;
+using namespace boost;
+namespace po = program_options;
+
+//
+// Renders pages to PPM/PGM/PNG files. Pages can be rendered by more threads
+// (--jobs). Each thread opens the document on its own, because page display
+// holds the document read lock for the whole rendering.
+//
+namespace {
+
+	// wall clock time in miliseconds
+	struct _time {
+		double _start;
+		_time () : _start (now()) {}
+		static double now ()
+		{
+#ifdef WIN32
+			return ::GetTickCount();
+#else
+			struct timeval tv;
+			gettimeofday (&tv, NULL);
+			return (double)tv.tv_sec * 1000.0 + (double)tv.tv_usec / 1000.0;
+#endif
+		}
+		double passed () const
+			{ return now() - _start; }
+	};
+
+	// pages
+	typedef vector<size_t> Pages;
+	// library wrapper
+	struct _pdf_lib {
+		bool _ok;
+		_pdf_lib (int argc, char ** argv) {_ok = (0 == pdfedit_core_dev_init(&argc, &argv));}
+		~_pdf_lib () {pdfedit_core_dev_destroy();}
+	};
+
+	// rendering options
+	struct _options {
+		string file;
+		string output;
+		string format;
+		size_t hdpi, vdpi;
+		bool antialias;
+	};
+
+	// parses page ranges like 1-3,5,10- (all pages if empty)
+	bool parse_pages (const string& what, size_t count, Pages& pages)
+	{
+		if (what.empty())
+		{
+			for (size_t i = 1; i <= count; ++i)
+				pages.push_back (i);
+			return true;
+		}
+
+		istringstream iss (what);
+		string range;
+		while (getline (iss, range, ','))
+		{
+			size_t from = 0, to = 0;
+			string::size_type dash = range.find ('-');
+			if (string::npos == dash)
+			{
+				from = to = strtoul (range.c_str(), NULL, 10);
+			}else
+			{
+				from = (0 == dash) ? 1 : strtoul (range.substr (0, dash).c_str(), NULL, 10);
+				to = (dash + 1 == range.size()) ? count : strtoul (range.substr (dash + 1).c_str(), NULL, 10);
+			}
+			if (0 == from || to < from || to > count)
+				return false;
+			for (size_t i = from; i <= to; ++i)
+				pages.push_back (i);
+		}
+		return true;
+	}
+
+	// to png
+	bool save_png (const std::string& file, SplashBitmap* bitmap)
+	{
+		FILE* fp = fopen (file.c_str(), "wb");
+		if (!fp)
+			return false;
+		png_structp png_ptr = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+		png_infop info_ptr = (png_ptr) ? png_create_info_struct (png_ptr) : NULL;
+		if (!info_ptr || setjmp (png_jmpbuf (png_ptr)))
+		{
+			png_destroy_write_struct (&png_ptr, (info_ptr) ? &info_ptr : NULL);
+			fclose (fp);
+			return false;
+		}
+		png_init_io (png_ptr, fp);
+		int color_type = (splashModeMono8 == bitmap->getMode()) ? PNG_COLOR_TYPE_GRAY : PNG_COLOR_TYPE_RGB;
+		png_set_IHDR (png_ptr, info_ptr, bitmap->getWidth(), bitmap->getHeight(), 8, color_type,
+				PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		png_write_info (png_ptr, info_ptr);
+		SplashColorPtr row = bitmap->getDataPtr();
+		for (int y = 0; y < bitmap->getHeight(); ++y, row += bitmap->getRowSize())
+			png_write_row (png_ptr, row);
+		png_write_end (png_ptr, NULL);
+		png_destroy_write_struct (&png_ptr, &info_ptr);
+		return 0 == fclose (fp);
+	}
+
+	// what to do with a page
+	struct _rasterize {
+		string operator () (shared_ptr<CPage> page, const _options& opts, const std::string& file)
+		{
+			_time time;
+			bool gray = ("pgm" == opts.format);
+			SplashColor paperColor;
+			paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+			SplashOutputDev splash ((gray) ? splashModeMono8 : splashModeRGB8, 1, gFalse, paperColor, 
+					gTrue, (opts.antialias) ? gTrue : gFalse);
+
+			// alter display params
+			pdfobjects::DisplayParams displayparams;
+			displayparams.hDpi = (double)opts.hdpi;
+			displayparams.vDpi = (double)opts.vdpi;
+
+			// display it = create internal splash bitmap
+			page->displayPage (splash, displayparams);
+			double render = time.passed();
+
+			SplashBitmap* bitmap = splash.getBitmap();
+			bool ok = ("png" == opts.format) 
+				? save_png (file, bitmap)
+				: (splashOk == bitmap->writePNMFile (const_cast<char*> (file.c_str())));
+
+			ostringstream oss;
+			oss << " [" << bitmap->getWidth() << "x" << bitmap->getHeight() << "]"
+				<< " [render:" << render << "]"
+				<< " [write:" << (time.passed() - render) << "]";
+			if (!ok)
+				oss << " failed to write " << file;
+			return oss.str();
+		}
+	};
+
+	// pages shared by all jobs
+	struct _queue {
+		threads::Mutex mutex;
+		const Pages& pages;
+		size_t next;
+		_queue (const Pages& p) : pages (p), next (0) {}
+		// returns false if there are no more pages
+		bool get (size_t& page)
+		{
+			threads::ScopedLock lock (mutex);
+			if (next >= pages.size())
+				return false;
+			page = pages[next++];
+			return true;
+		}
+		// prints result of one page
+		void report (size_t page, const string& result)
+		{
+			threads::ScopedLock lock (mutex);
+			std::cout << "Page " << page << result << std::endl;
+		}
+		// prints message which doesn't belong to any page
+		void report (const string& result)
+		{
+			threads::ScopedLock lock (mutex);
+			std::cout << result << std::endl;
+		}
+	};
+
+	// one rendering job with its own document instance
+	struct _job : public threads::Thread {
+		_queue& queue;
+		const _options& opts;
+		bool failed;
+		_job (_queue& q, const _options& o) : queue (q), opts (o), failed (false) {}
+
+		void run ()
+		{
+			// page being rendered (0 while the document is opened)
+			size_t i = 0;
+			try
+			{
+				shared_ptr<CPdf> pdf = CPdf::getInstance (opts.file.c_str(), CPdf::ReadOnly, CPdf::MappedWriter);
+				while (queue.get (i))
+				{
+					ostringstream oss;
+					oss << opts.output << "-" << i << "." << opts.format;
+					_time time;
+					shared_ptr<CPage> page = pdf->getPage(i);
+					string result = _rasterize()(page, opts, oss.str());
+					ostringstream all;
+					all << " [all:" << time.passed() << "]";
+					queue.report (i, result + all.str());
+				}
+			}catch (std::exception& e)
+			{
+				if (0 == i)
+					queue.report (string ("exception - ") + e.what());
+				else
+					queue.report (i, string (" exception - ") + e.what());
+				failed = true;
+			}
+		}
+	};
+}
+
+int 
+main(int argc, char ** argv)
+{
+	// 
+	// parameter parsing
+	//
+	po::options_description desc("Allowed options");
+	desc.add_options()
+		("help", "produce help message")
+		("file", po::value<string>(), "input file")
+		("output", po::value<string>()->default_value(string("page")), "output file prefix (prefix-page.format)")
+		("format", po::value<string>()->default_value(string("ppm")), "output format (ppm, pgm, png)")
+		("what", po::value<string>(), "pages to convert (e.g. 1-3,5,10-)")
+		("dpi", po::value<size_t>(), "horizontal and vertical dpi")
+		("hdpi", po::value<size_t>()->default_value(72), "horizontal dpi")
+		("vdpi", po::value<size_t>()->default_value(72), "vertical dpi")
+		("antialias", po::value<string>()->default_value(string("yes")), "antialiasing (yes, no)")
+		("jobs", po::value<size_t>()->default_value(1), "number of rendering threads")
+	;
+
+	po::variables_map vm;
+	try {
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);    
+	}catch(std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << ". Please, check your parameters." << endl;
+		return 1;
+	}
+
+		if (!vm.count("file")) 
+		{
+			cout << desc << endl;
+			return 1;
+		}
+
+	_options opts;
+	opts.file = vm["file"].as<string>(); 
+	opts.output = vm["output"].as<string>();
+	opts.format = vm["format"].as<string>();
+	opts.hdpi = vm["hdpi"].as<size_t>();
+	opts.vdpi = vm["vdpi"].as<size_t>();
+	if (vm.count("dpi"))
+		opts.hdpi = opts.vdpi = vm["dpi"].as<size_t>();
+	opts.antialias = ("no" != vm["antialias"].as<string>());
+	size_t jobs = std::max ((size_t)1, vm["jobs"].as<size_t>());
+		if ("ppm" != opts.format && "pgm" != opts.format && "png" != opts.format)
+		{
+			cout << "Unsupported format " << opts.format << endl << desc << endl;
+			return 1;
+		}
+
+	int ret = 0;
+	try
+	{
+		// pdf lib init & work
+		_pdf_lib _lib(argc, argv);
+			if (!_lib._ok)
+				return 1;
+
+		GlobalParams::initGlobalParams(NULL)->setEnableT1lib("no");
+		GlobalParams::initGlobalParams(NULL)->setEnableFreeType("yes");
+		GlobalParams::initGlobalParams(NULL)->setErrQuiet(gTrue);
+		GlobalParams::initGlobalParams(NULL)->setupBaseFonts(".");
+
+		Pages pages;
+		{
+			shared_ptr<CPdf> pdf = CPdf::getInstance (opts.file.c_str(), CPdf::ReadOnly, CPdf::MappedWriter);
+			if (!parse_pages ((vm.count("what")) ? vm["what"].as<string>() : string(), pdf->getPageCount(), pages))
+			{
+				cout << "Invalid page range! " << endl << desc << endl;
+				return 1;
+			}
+		}
+		jobs = std::min (jobs, pages.size());
+
+		_time time;
+		_queue queue (pages);
+		vector<shared_ptr<_job> > workers;
+		for (size_t i = 0; i < jobs; ++i)
+			workers.push_back (shared_ptr<_job> (new _job (queue, opts)));
+		if (1 == jobs)
+		{
+			// no need for an extra thread
+			workers[0]->run ();
+		}else
+		{
+			for (size_t i = 0; i < workers.size(); ++i)
+				if (!workers[i]->start ())
+				{
+					std::cout << "Unable to start a rendering thread" << std::endl;
+					workers[i]->failed = true;
+				}
+			for (size_t i = 0; i < workers.size(); ++i)
+				workers[i]->join ();
+		}
+		for (size_t i = 0; i < workers.size(); ++i)
+			if (workers[i]->failed)
+				ret = 1;
+		std::cout << pages.size() << " pages [jobs:" << jobs << "] [all:" << time.passed() << "]" << std::endl;
+
+	}catch (std::exception& e)
+	{
+		std::cout << "exception - " << e.what() << std::endl;
+		ret = 1;
+	}
+
+	return ret;
+}
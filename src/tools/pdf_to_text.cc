@@ -25,8 +25,11 @@
 #include <kernel/cpdf.h>
 #include <kernel/cpage.h>
 #include <kernel/delinearizator.h>
+#include <utils/mutex.h>
+#include <utils/thread.h>
 #include <boost/program_options.hpp>
 #include <vector>
+#include <stdexcept>
 
 using namespace pdfobjects;
 using namespace std;
@@ -39,6 +42,7 @@ namespace {
 	const string DEFAULT_ENCODING( "UTF-8" );
 	const bool DEFAULT_OUTPUT_PAGES = false;
 	const string DEFAULT_FONT_DIR( "." );
+	const size_t DEFAULT_JOBS = 1;
 
 	// pages
 	typedef vector<size_t> Pages;
@@ -69,6 +73,170 @@ namespace {
 			return text;
 		}
 	};
+	// output of one page
+	void _output (size_t pos, const string& text, bool output_pages)
+	{
+		if (output_pages)
+			std::cout << "\nPage " << pos << ":\n";
+		std::cout << text;
+	}
+	// invalid page diagnostic
+	void _invalid (const po::options_description& desc)
+	{
+		cout << "Invalid page number! " << endl << desc << endl;
+	}
+	// textify pages one after another
+	void _textify_pages (shared_ptr<CPdf> pdf, const Pages& pages, const string& encoding, 
+			bool output_pages, const po::options_description& desc)
+	{
+		for (Pages::const_iterator it = pages.begin(); it != pages.end(); ++it)
+		{
+			if (*it > pdf->getPageCount())
+			{
+				_invalid (desc);
+				continue;
+			}
+			_output (*it, _textify()(pdf->getPage(*it), encoding), output_pages);
+		}
+	}
+
+	//
+	// Pages are textified by worker threads. Each worker opens the document
+	// on its own, because page display holds the document read lock for the
+	// whole rendering. Workers take pages from a shared queue and the main
+	// thread outputs each text as soon as all preceding ones are out.
+	//
+
+	// result of one requested page
+	struct _job {
+		string text;		// exception message if failed
+		bool failed;
+		bool done;
+	};
+	// pages shared by all workers and their results
+	struct _queue {
+		threads::Mutex mutex;
+		threads::Condition finished;
+		const Pages& pages;
+		size_t count;		// page count of the document
+		vector<_job> jobs;	// indexed by position in pages
+		size_t next;
+		_queue (const Pages& p, size_t c) : pages (p), count (c), next (0)
+		{
+			_job job = {string(), false, false};
+			jobs.resize (pages.size(), job);
+		}
+		// returns false if there are no more pages
+		bool get (size_t& pos)
+		{
+			threads::ScopedLock lock (mutex);
+			// invalid pages are reported by the main thread
+			while (next < pages.size() && pages[next] > count)
+				++next;
+			if (next >= pages.size())
+				return false;
+			pos = next++;
+			return true;
+		}
+		// stores result of one page
+		void put (size_t pos, const string& text, bool failed)
+		{
+			threads::ScopedLock lock (mutex);
+			jobs[pos].text = text;
+			jobs[pos].failed = failed;
+			jobs[pos].done = true;
+			finished.broadcast ();
+		}
+		// waits for result of one page and takes it over
+		void wait (size_t pos, _job& job)
+		{
+			threads::ScopedLock lock (mutex);
+			while (!jobs[pos].done)
+				finished.wait (mutex);
+			job = jobs[pos];
+			jobs[pos].text.clear ();
+		}
+		// no more pages will be given to workers
+		void stop ()
+		{
+			threads::ScopedLock lock (mutex);
+			next = pages.size();
+		}
+	};
+	// worker textifying pages from the queue
+	struct _worker : public threads::Thread {
+		_queue& queue;
+		const string& file;
+		const string& encoding;
+		_worker (_queue& q, const string& f, const string& e)
+			: queue (q), file (f), encoding (e) {}
+
+		void run ()
+		{
+			size_t pos;
+			shared_ptr<CPdf> pdf;
+			try
+			{
+				pdf = CPdf::getInstance (file.c_str(), CPdf::ReadOnly, CPdf::MappedWriter);
+			}catch (std::exception& e)
+			{
+				// all pages taken by this worker fail
+				while (queue.get (pos))
+					queue.put (pos, e.what(), true);
+				return;
+			}
+			while (queue.get (pos))
+			{
+				try
+				{
+					queue.put (pos, _textify()(pdf->getPage(queue.pages[pos]), encoding), false);
+				}catch (std::exception& e)
+				{
+					queue.put (pos, e.what(), true);
+				}
+			}
+		}
+	};
+	// textify pages by worker threads
+	void _textify_pages (const string& file, size_t count, const Pages& pages, size_t threads, 
+			const string& encoding, bool output_pages, const po::options_description& desc)
+	{
+		_queue queue (pages, count);
+		threads = std::min (threads, pages.size());
+		vector<shared_ptr<_worker> > workers;
+		for (size_t k = 0; k < threads; ++k)
+		{
+			shared_ptr<_worker> worker (new _worker (queue, file, encoding));
+			if (!worker->start ())
+				break;
+			workers.push_back (worker);
+		}
+
+		// output in the requested order, the first failure stops the
+		// output as in the sequential mode
+		string error;
+		if (workers.empty())
+			error = "unable to start workers";
+		for (size_t pos = 0; pos < pages.size() && error.empty(); ++pos)
+		{
+			if (pages[pos] > count)
+			{
+				_invalid (desc);
+				continue;
+			}
+			_job job;
+			queue.wait (pos, job);
+			if (job.failed)
+				error = job.text;
+			else
+				_output (pages[pos], job.text, output_pages);
+		}
+		queue.stop ();
+		for (size_t k = 0; k < workers.size(); ++k)
+			workers[k]->join ();
+		if (!error.empty())
+			throw std::runtime_error (error);
+	}
 }
 
 int 
@@ -85,6 +253,7 @@ main(int argc, char ** argv)
 		("output-pages", po::value<bool>()->default_value(DEFAULT_OUTPUT_PAGES), "output page number before each page")
 		("encoding", po::value<string>()->default_value(DEFAULT_ENCODING), "encoding to use")
 		("font-dir", po::value<string>()->default_value(DEFAULT_FONT_DIR), "(xpdf) font directory with font definitions(e.g. N019003L.PFB)")
+		("jobs", po::value<size_t>()->default_value(DEFAULT_JOBS), "number of pages converted concurrently")
 	;
 
 	po::variables_map vm;
@@ -106,6 +275,7 @@ main(int argc, char ** argv)
 	bool output_pages = vm["output-pages"].as<bool>(); 
 	string encoding = vm["encoding"].as<string>(); 
 	string font_dir = vm["font-dir"].as<string>(); 
+	size_t jobs = vm["jobs"].as<size_t>(); 
 	
 	Pages pages;
 	if (vm.count("what"))
@@ -118,34 +288,20 @@ main(int argc, char ** argv)
 			if (!_lib._ok)
 				return 1;
 
-		// open pdf
-		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), CPdf::ReadWrite);
+		// open pdf, workers open their own read-only instances
+		shared_ptr<CPdf> pdf = CPdf::getInstance (file.c_str(), 
+				(1 < jobs) ? CPdf::ReadOnly : CPdf::ReadWrite, CPdf::MappedWriter);
 
 		if (pages.empty())
 		{
 			for (size_t i = 1; i <= pdf->getPageCount(); ++i)
-			{
-				shared_ptr<CPage> page = pdf->getPage(i);
-				if (output_pages)
-					std::cout << "\nPage " << i << ":\n";
-				std::cout << _textify()(page, encoding);
-			}
+				pages.push_back (i);
 		}
-		
-		// do it for selected pages
-		for (Pages::const_iterator it = pages.begin(); it != pages.end(); ++it)
-		{
-				if (*it > pdf->getPageCount())
-				{
-					cout << "Invalid page number! " << endl << desc << endl;
-					continue;
-				}
 
-			shared_ptr<CPage> page = pdf->getPage(*it);
-			if (output_pages)
-				std::cout << "\nPage " << *it << ":\n";
-			std::cout << _textify()(page, encoding);
-		}
+		if (1 < jobs && 1 < pages.size())
+			_textify_pages (file, pdf->getPageCount(), pages, jobs, encoding, output_pages, desc);
+		else
+			_textify_pages (pdf, pages, encoding, output_pages, desc);
 
 	}catch (std::exception& e)
 	{
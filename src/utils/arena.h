@@ -0,0 +1,374 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the 
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, 
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include "utils/atomic.h"
+
+/**
+ * @file arena.h
+ *
+ * Arena (region) allocator. Many small objects with the same life time are
+ * allocated from few big blocks owned by one object (e.g. operators of a
+ * content stream) and the owner can reuse or release all blocks at once.
+ */
+
+/**
+ * Memory arena.
+ *
+ * Memory is handed out from blocks by moving a pointer. Released memory is
+ * kept in free lists by its size and reused by later allocations of the same
+ * size.
+ * <br>
+ * Arena is referenced by its owner (see ArenaOwner) and by each allocation
+ * which has not been released yet, it is deleted when the last of them is
+ * released. So objects allocated from the arena may outlive their owner,
+ * but the owner can reset the arena only when nothing is allocated from it.
+ * <br>
+ * Allocations have to be serialized by the owner (e.g. by a lock), memory
+ * may be released by any thread.
+ */
+class Arena : boost::noncopyable
+{
+public:
+	/** Default size of one block. */
+	static const size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+
+private:
+	/** Alignment of all allocations. */
+	union MaxAlign { long l; double d; long double ld; void* p; };
+	/** Released memory. */
+	struct FreeNode { FreeNode* next; size_t size; };
+	/** Allocated blocks. */
+	std::vector<char*> blocks;
+	/** First free byte of the current block. */
+	char* current;
+	/** Free bytes in the current block. */
+	size_t left;
+	/** Size of a regular block. */
+	size_t blockSize;
+	/** Released memory by its size (index is size in MaxAlign units). */
+	std::vector<FreeNode*> freeLists;
+	/** Memory released since the last allocation which needed it (may be
+	 * pushed by any thread). */
+	void* volatile released;
+	/** Owner and allocations which have not been released yet. */
+	volatile long refs;
+
+	/** Deallocates all blocks. */
+	~Arena ()
+	{
+		for (std::vector<char*>::iterator it = blocks.begin (); it != blocks.end (); ++it)
+			::free (*it);
+	}
+
+	/** Aligns allocation size. */
+	static size_t alignSize (size_t size)
+	{
+		const size_t align = sizeof (MaxAlign);
+		return (size + align - 1) / align * align;
+	}
+
+	/** Allocates memory. */
+	static char* mallocBlock (size_t size)
+	{
+		char* block = static_cast<char*> (::malloc (size));
+		if (!block)
+			throw std::bad_alloc ();
+		return block;
+	}
+
+	/** Moves all released memory to free lists. */
+	void collectReleased ()
+	{
+		FreeNode* node = static_cast<FreeNode*> (threads::atomicExchange (released, NULL));
+		while (node)
+		{
+			FreeNode* next = node->next;
+			FreeNode*& list = freeLists[node->size / sizeof (MaxAlign)];
+			node->next = list;
+			list = node;
+			node = next;
+		}
+	}
+
+	/** Drops one reference and deletes the arena if it was the last one. */
+	void unref ()
+	{
+		if (0 == threads::atomicDecrement (refs))
+			delete this;
+	}
+
+public:
+	/**
+	 * Constructor.
+	 *
+	 * Arena is referenced by the caller who has to release it. No memory is
+	 * allocated until the first allocation.
+	 *
+	 * @param size Size of a block.
+	 */
+	explicit Arena (size_t size = DEFAULT_BLOCK_SIZE)
+		: current (NULL), left (0), blockSize (size), 
+		  freeLists (alignSize (size / 4) / sizeof (MaxAlign) + 1, (FreeNode*) NULL), 
+		  released (NULL), refs (1) {}
+
+	/**
+	 * Allocate memory.
+	 *
+	 * Requests bigger than a quarter of the block are allocated separately
+	 * so that the rest of the current block is not wasted.
+	 *
+	 * @param size Number of bytes.
+	 * @return Memory aligned for any type.
+	 */
+	void* allocate (size_t size)
+	{
+		size = alignSize (size);
+		if (size > blockSize / 4)
+		{
+			void* result = mallocBlock (size);
+			threads::atomicIncrement (refs);
+			return result;
+		}
+		FreeNode*& list = freeLists[size / sizeof (MaxAlign)];
+		// released memory is collected only before a new block would be
+		// needed, so that allocations don't touch the shared list
+		if (!list && size > left)
+			collectReleased ();
+		char* result;
+		if (list)
+		{
+			result = reinterpret_cast<char*> (list);
+			list = list->next;
+		}else
+		{
+			if (size > left)
+			{
+				blocks.push_back (mallocBlock (blockSize));
+				current = blocks.back ();
+				left = blockSize;
+			}
+			result = current;
+			current += size;
+			left -= size;
+		}
+		threads::atomicIncrement (refs);
+		return result;
+	}
+
+	/**
+	 * Release memory.
+	 *
+	 * Can be called by any thread. Deletes the arena if its owner has already
+	 * released it and this was the last allocation.
+	 *
+	 * @param p Memory returned by allocate.
+	 * @param size The same size as given to allocate.
+	 */
+	void deallocate (void* p, size_t size)
+	{
+		size = alignSize (size);
+		if (size > blockSize / 4)
+			::free (p);
+		else
+		{
+			FreeNode* node = static_cast<FreeNode*> (p);
+			node->size = size;
+			void* head = released;
+			void* prev;
+			do
+			{
+				node->next = static_cast<FreeNode*> (head);
+				prev = head;
+			}while (prev != (head = threads::atomicCompareExchange (released, prev, node)));
+		}
+		unref ();
+	}
+
+	/**
+	 * Reuse the arena from the beginning.
+	 *
+	 * Possible only if nothing is allocated from the arena. All blocks but
+	 * the first one are deallocated.
+	 *
+	 * @return true if the arena has been reset, false if some allocations
+	 * have not been released yet.
+	 */
+	bool reset ()
+	{
+		if (1 != threads::atomicRead (refs))
+			return false;
+		if (blocks.size () > 1)
+		{
+			for (std::vector<char*>::iterator it = blocks.begin () + 1; it != blocks.end (); ++it)
+				::free (*it);
+			blocks.resize (1);
+		}
+		current = (blocks.empty ()) ? NULL : blocks.front ();
+		left = (blocks.empty ()) ? 0 : blockSize;
+		released = NULL;
+		std::fill (freeLists.begin (), freeLists.end (), (FreeNode*) NULL);
+		return true;
+	}
+
+	/**
+	 * Release the reference of the caller.
+	 *
+	 * Arena is deleted when also all allocations are released.
+	 */
+	void release ()
+		{ unref (); }
+
+	/** Get number of allocated blocks. */
+	size_t getBlockCount () const
+		{ return blocks.size (); }
+};
+
+/**
+ * Owner of an arena.
+ *
+ * Keeps its arena until it is renewed or until the owner is destroyed.
+ */
+class ArenaOwner : boost::noncopyable
+{
+	/** Owned arena (NULL if not created yet). */
+	Arena* arena;
+
+public:
+	/** Constructor. Arena is created when needed. */
+	ArenaOwner () : arena (NULL) {}
+	/** Releases the arena. */
+	~ArenaOwner ()
+	{
+		if (arena)
+			arena->release ();
+	}
+
+	/** Get the arena (created on the first use). */
+	Arena* get ()
+	{
+		if (!arena)
+			arena = new Arena ();
+		return arena;
+	}
+
+	/**
+	 * Start allocating from the beginning.
+	 *
+	 * The arena is reset if nothing is allocated from it, otherwise it is
+	 * released (and deleted together with the last allocation) and a new one
+	 * is used.
+	 */
+	void renew ()
+	{
+		if (arena && !arena->reset ())
+		{
+			arena->release ();
+			arena = NULL;
+		}
+	}
+};
+
+/**
+ * Standard allocator which allocates from an arena.
+ *
+ * Copies of the allocator don't keep the arena alive, each allocation does
+ * (see Arena). This makes it usable with boost::allocate_shared: control
+ * block holds a copy of the allocator and the memory is returned to the
+ * arena when the object is released.
+ */
+template<typename T>
+class ArenaAllocator
+{
+	template<typename U> friend class ArenaAllocator;
+
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	/** Allocator for other type sharing the same arena. */
+	template<typename U> struct rebind { typedef ArenaAllocator<U> other; };
+
+private:
+	/** Arena to allocate from. */
+	Arena* arena;
+
+public:
+	/**
+	 * Constructor.
+	 *
+	 * @param a Arena to allocate from.
+	 */
+	explicit ArenaAllocator (Arena* a) : arena (a) {}
+	/** Copy constructor. */
+	ArenaAllocator (const ArenaAllocator& other) : arena (other.arena) {}
+	/** Converting copy constructor. */
+	template<typename U>
+	ArenaAllocator (const ArenaAllocator<U>& other) : arena (other.arena) {}
+
+	/** Get the arena. */
+	Arena* getArena () const
+		{ return arena; }
+
+	pointer address (reference x) const
+		{ return &x; }
+	const_pointer address (const_reference x) const
+		{ return &x; }
+
+	pointer allocate (size_type n, const void* = 0)
+		{ return static_cast<pointer> (arena->allocate (n * sizeof (T))); }
+	void deallocate (pointer p, size_type n)
+		{ arena->deallocate (p, n * sizeof (T)); }
+
+	size_type max_size () const
+		{ return static_cast<size_type> (-1) / sizeof (T); }
+
+	void construct (pointer p, const T& val)
+		{ new (static_cast<void*> (p)) T (val); }
+	void destroy (pointer p)
+		{ p->~T (); }
+
+	template<typename U>
+	bool operator== (const ArenaAllocator<U>& other) const
+		{ return arena == other.arena; }
+	template<typename U>
+	bool operator!= (const ArenaAllocator<U>& other) const
+		{ return arena != other.arena; }
+};
+
+#endif // _ARENA_H_
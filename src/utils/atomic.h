@@ -0,0 +1,111 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _ATOMIC_H_
+#define _ATOMIC_H_
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+/**
+ * @file atomic.h
+ *
+ * Portable atomic operations on counters and pointers. All of them are full
+ * memory barriers.
+ */
+
+namespace threads {
+
+/** Atomically increments counter and returns its new value. */
+inline long
+atomicIncrement (volatile long& counter)
+{
+#ifdef WIN32
+	return InterlockedIncrement (&counter);
+#else
+	return __sync_add_and_fetch (&counter, 1);
+#endif
+}
+
+/** Atomically decrements counter and returns its new value. */
+inline long
+atomicDecrement (volatile long& counter)
+{
+#ifdef WIN32
+	return InterlockedDecrement (&counter);
+#else
+	return __sync_sub_and_fetch (&counter, 1);
+#endif
+}
+
+/** Atomically reads counter. */
+inline long
+atomicRead (volatile long& counter)
+{
+#ifdef WIN32
+	return InterlockedCompareExchange (&counter, 0, 0);
+#else
+	return __sync_add_and_fetch (&counter, 0);
+#endif
+}
+
+/**
+ * Atomically replaces pointer if it has the expected value.
+ *
+ * @return Previous value of the pointer (replaced if equal to expected).
+ */
+inline void*
+atomicCompareExchange (void* volatile& ptr, void* expected, void* value)
+{
+#ifdef WIN32
+	return InterlockedCompareExchangePointer (&ptr, value, expected);
+#else
+	return __sync_val_compare_and_swap (&ptr, expected, value);
+#endif
+}
+
+/**
+ * Atomically replaces pointer.
+ *
+ * @return Previous value of the pointer.
+ */
+inline void*
+atomicExchange (void* volatile& ptr, void* value)
+{
+#ifdef WIN32
+	return InterlockedExchangePointer (&ptr, value);
+#else
+	void* old = ptr;
+	void* prev;
+	while (old != (prev = __sync_val_compare_and_swap (&ptr, old, value)))
+		old = prev;
+	return old;
+#endif
+}
+
+} // namespace threads
+
+#endif // _ATOMIC_H_
@@ -77,6 +77,10 @@ namespace util {}
  */
  namespace debug {}
 
+/** Namespace for thread synchronization primitives. 
+ */
+ namespace threads {}
+
 /** TODO namespace filters       */
  namespace filters {}
 /** TODO namespace iterator      */
@@ -0,0 +1,146 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+#ifndef _MUTEX_H_
+#define _MUTEX_H_
+
+#include <boost/noncopyable.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * @file mutex.h
+ *
+ * Portable recursive mutex, its scoped lock and condition variable.
+ */
+
+namespace threads {
+
+/**
+ * Recursive mutex.
+ *
+ * The same thread can lock the mutex more times, it is released after the
+ * same number of unlocks.
+ */
+class Mutex : boost::noncopyable
+{
+	friend class Condition;
+#ifdef WIN32
+	/** Critical sections are recursive. */
+	CRITICAL_SECTION mutex;
+public:
+	Mutex ()
+		{ InitializeCriticalSection (&mutex); }
+	~Mutex ()
+		{ DeleteCriticalSection (&mutex); }
+	/** Lock the mutex. */
+	void lock ()
+		{ EnterCriticalSection (&mutex); }
+	/** Unlock the mutex. */
+	void unlock ()
+		{ LeaveCriticalSection (&mutex); }
+#else
+	pthread_mutex_t mutex;
+public:
+	Mutex ()
+	{
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init (&attr);
+		pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init (&mutex, &attr);
+		pthread_mutexattr_destroy (&attr);
+	}
+	~Mutex ()
+		{ pthread_mutex_destroy (&mutex); }
+	/** Lock the mutex. */
+	void lock ()
+		{ pthread_mutex_lock (&mutex); }
+	/** Unlock the mutex. */
+	void unlock ()
+		{ pthread_mutex_unlock (&mutex); }
+#endif
+};
+
+/**
+ * Scoped lock.
+ *
+ * Locks the mutex in the constructor and unlocks it in the destructor.
+ */
+class ScopedLock : boost::noncopyable
+{
+	Mutex& mutex;
+public:
+	/** Lock given mutex. */
+	explicit ScopedLock (Mutex& m) : mutex (m)
+		{ mutex.lock (); }
+	/** Unlock the mutex. */
+	~ScopedLock ()
+		{ mutex.unlock (); }
+};
+
+/**
+ * Condition variable.
+ *
+ * Waiting thread has to hold the associated mutex exactly once (recursive
+ * locking is not allowed around wait).
+ */
+class Condition : boost::noncopyable
+{
+#ifdef WIN32
+	CONDITION_VARIABLE cond;
+public:
+	Condition ()
+		{ InitializeConditionVariable (&cond); }
+	/** Release the mutex and wait for a signal. The mutex is locked again
+	 * before returning. */
+	void wait (Mutex& m)
+		{ SleepConditionVariableCS (&cond, &m.mutex, INFINITE); }
+	/** Wake up all waiting threads. */
+	void broadcast ()
+		{ WakeAllConditionVariable (&cond); }
+#else
+	pthread_cond_t cond;
+public:
+	Condition ()
+		{ pthread_cond_init (&cond, NULL); }
+	~Condition ()
+		{ pthread_cond_destroy (&cond); }
+	/** Release the mutex and wait for a signal. The mutex is locked again
+	 * before returning. */
+	void wait (Mutex& m)
+		{ pthread_cond_wait (&cond, &m.mutex); }
+	/** Wake up all waiting threads. */
+	void broadcast ()
+		{ pthread_cond_broadcast (&cond); }
+#endif
+};
+
+} // namespace threads
+
+#endif // _MUTEX_H_
@@ -25,6 +25,9 @@
 #define _OBJECTCOMPARATOR_H_
 
 #include <map>
+#include <vector>
+#include <utility>
+#include <cstddef>
 
 
 /**
@@ -33,6 +36,10 @@
  * File which implements template object storage class. This is basicaly
  * mapping keys to objects and provide simple interface to manipulate
  * with it. It wrapps STL map class functionality.
+ * <br>
+ * IndexedObjectStorage provides the same interface for keys which are pdf
+ * object referencies (have num and gen fields) and stores them in a table
+ * indexed directly by the object number.
  */
 
 /**
@@ -199,4 +206,386 @@ public:
 		return mapping.end();
 	}
 };
+
+/** Iterator for IndexedObjectStorage.
+ *
+ * Walks all slots of the table (and all entries in each slot) and then all
+ * entries from the overflow mapping.
+ */
+template<typename SlotsIter, typename OverflowIter, typename Value> 
+class IndexedStorageIterator
+{
+        template<typename, typename, typename> friend class IndexedStorageIterator;
+
+        SlotsIter slot;
+        SlotsIter slotsEnd;
+        size_t pos;
+        OverflowIter over;
+
+        /** Moves to the first non empty slot (if not at one already). */
+        void skip()
+        {
+                while(slot!=slotsEnd && pos>=slot->size())
+                {
+                        ++slot;
+                        pos=0;
+                }
+        }
+public:
+        /** Empty constructor.
+         *
+         * Creates singular iterator which has to be assigned before use.
+         */
+        IndexedStorageIterator():pos(0){}
+
+        /** Constructor.
+         * @param s Starting slot.
+         * @param e End of slots.
+         * @param o Starting overflow position.
+         */
+        IndexedStorageIterator(SlotsIter s, SlotsIter e, OverflowIter o)
+                :slot(s), slotsEnd(e), pos(0), over(o)
+        {
+                skip();
+        }
+
+        /** Conversion constructor (from iterator to const iterator).
+         * @param other Iterator to convert.
+         */
+        template<typename S, typename O, typename V>
+        IndexedStorageIterator(const IndexedStorageIterator<S, O, V> & other)
+                :slot(other.slot), slotsEnd(other.slotsEnd), pos(other.pos), over(other.over)
+        {
+        }
+
+        Value & operator*()const
+        {
+                return (slot!=slotsEnd)?(*slot)[pos]:over->second;
+        }
+
+        Value * operator->()const
+        {
+                return &(**this);
+        }
+
+        IndexedStorageIterator & operator++()
+        {
+                if(slot!=slotsEnd)
+                {
+                        ++pos;
+                        skip();
+                }else
+                        ++over;
+                return *this;
+        }
+
+        IndexedStorageIterator operator++(int)
+        {
+                IndexedStorageIterator tmp=*this;
+                ++(*this);
+                return tmp;
+        }
+
+        bool operator==(const IndexedStorageIterator & other)const
+        {
+                return slot==other.slot && pos==other.pos && over==other.over;
+        }
+
+        bool operator!=(const IndexedStorageIterator & other)const
+        {
+                return !(*this==other);
+        }
+};
+
+/** Object storage indexed by object number.
+ *
+ * Key has to provide num and gen fields (e.g. ::Ref or IndiRef). Values are
+ * kept in a table indexed by key's num, so lookups don't need any
+ * comparisons except for generation numbers of the same object number
+ * (there is usually just one). Keys with object numbers out of the table
+ * range (negative or higher than maxIndex) are kept in the overflow mapping
+ * ordered by Comp.
+ * <br>
+ * Iteration goes in the increasing order of (num, gen) for keys in the
+ * table range which is the same as for ObjectStorage with the reference
+ * comparator.
+ * <br>
+ * Table grows up to the highest object number stored, but at most to twice
+ * its current size (or minSlots) at once. Keys far beyond the table (e.g.
+ * from dangling references with huge object numbers) go to the overflow
+ * mapping and they are moved to the table when it grows over them.
+ */
+template<typename K, typename V, typename Comp> class IndexedObjectStorage
+{
+public:
+        /** Type of stored association. */
+        typedef std::pair<K, V> Association;
+
+private:
+        typedef std::vector<Association> Slot;
+        typedef std::vector<Slot> Slots;
+        typedef std::map<K, Association, Comp> Overflow;
+
+        /** Table of slots indexed by object number. */
+        Slots slots;
+
+        /** Associations out of table range. */
+        Overflow overflow;
+
+        /** Number of associations. */
+        size_t count;
+
+        /** Gets slot index for given key.
+         * @param key Key.
+         * @param index Output index.
+         *
+         * @return true if key belongs to the table, false if to the overflow.
+         */
+        bool getIndex(const K & key, size_t & index)const
+        {
+                long num=static_cast<long>(key.num);
+                if(num<0 || static_cast<size_t>(num)>=slots.size())
+                        return false;
+                index=static_cast<size_t>(num);
+                return true;
+        }
+
+        /** Grows the table to contain given key if it is not too far.
+         * @param key Key to be inserted.
+         *
+         * The table grows if key's object number is below maxIndex and twice
+         * the current table size (or minSlots). Overflow keys covered by the 
+         * grown table are moved to it.
+         */
+        void grow(const K & key)
+        {
+                long num=static_cast<long>(key.num);
+                size_t oldSize=slots.size();
+                if(num<0 || num>maxIndex || static_cast<size_t>(num)<oldSize)
+                        return;
+                size_t limit=2*oldSize;
+                if(limit<minSlots)
+                        limit=minSlots;
+                if(static_cast<size_t>(num)>=limit)
+                        return;
+                slots.resize(static_cast<size_t>(num)+1);
+
+                // overflow is ordered by object numbers, so the last one tells
+                // whether there is anything to move
+                if(overflow.empty() || static_cast<long>(overflow.rbegin()->first.num)<static_cast<long>(oldSize))
+                        return;
+                typename Overflow::iterator i=overflow.begin();
+                while(i!=overflow.end())
+                {
+                        long n=static_cast<long>(i->first.num);
+                        if(n<static_cast<long>(oldSize) || n>num)
+                        {
+                                ++i;
+                                continue;
+                        }
+                        // generations are ordered in the overflow as well
+                        slots[static_cast<size_t>(n)].push_back(i->second);
+                        overflow.erase(i++);
+                }
+        }
+
+        /** Finds association of the key in the table.
+         * @param key Key.
+         *
+         * @return Association or 0 if not found.
+         */
+        const Association * find(const K & key)const
+        {
+                size_t index;
+                if(getIndex(key, index))
+                {
+                        const Slot & slot=slots[index];
+                        for(typename Slot::const_iterator i=slot.begin(); i!=slot.end(); ++i)
+                                if(i->first.gen==key.gen)
+                                        return &(*i);
+                        return 0;
+                }
+                typename Overflow::const_iterator i=overflow.find(key);
+                if(i==overflow.end())
+                        return 0;
+                return &(i->second);
+        }
+
+        Association * find(const K & key)
+        {
+                const IndexedObjectStorage * ths=this;
+                return const_cast<Association *>(ths->find(key));
+        }
+
+public:
+        /** Maximal object number stored in the table.
+         * This is the implementation limit for number of indirect objects 
+         * from pdf specification.
+         */
+        static const long maxIndex=8388607;
+
+        /** Table size which is allowed regardless of the current size. */
+        static const size_t minSlots=1024;
+
+        /** Iterator type. */
+        typedef IndexedStorageIterator<typename Slots::iterator, 
+                typename Overflow::iterator, Association> Iterator;
+
+        /** Constant iterator type. */
+        typedef IndexedStorageIterator<typename Slots::const_iterator, 
+                typename Overflow::const_iterator, const Association> ConstIterator;
+
+        /** Empty constructor.
+         *
+         */
+        IndexedObjectStorage():count(0){}
+
+        /** Clears mapping.
+         *
+         * Doesn't deallocate values!
+         */
+        void clear()
+        {
+                slots.clear();
+                overflow.clear();
+                count=0;
+        }
+
+        /** Add/change mapping.
+         * @param key Key of the mapping.
+         * @param value Value of the mapping.
+         *
+         * @see ObjectStorage::put
+         *
+         * @returns Value of the previous mapping or default value if the key 
+         * was inserted to the mapping.
+         */
+        V put(const K & key, V value)
+        {
+                Association * assoc=find(key);
+                if(assoc)
+                {
+                        V old=assoc->second;
+                        assoc->second=value;
+                        return old;
+                }
+
+                grow(key);
+                size_t index;
+                if(getIndex(key, index))
+                {
+                        Slot & slot=slots[index];
+                        // keeps generations sorted
+                        typename Slot::iterator i=slot.begin();
+                        while(i!=slot.end() && i->first.gen<key.gen)
+                                ++i;
+                        slot.insert(i, Association(key, value));
+                }else
+                        overflow.insert(typename Overflow::value_type(key, Association(key, value)));
+                ++count;
+                return V();
+        }
+
+        /** Finds value with the key.
+         * @param key Key of the value.
+         *
+         * @return value of the value or default value (0 for pointers) if no
+         * such key found.
+         */
+        V get(const K & key)const
+        {
+                const Association * assoc=find(key);
+                if(!assoc)
+                        return V();
+                return assoc->second;
+        }
+
+        /** Checks of given key is in the storage.
+         * @param key Key object.
+         *
+         * @return true if given key is in the storage, false otherwise.
+         */
+        bool contains(const K & key)const
+        {
+                return find(key)!=0;
+        }
+
+        /** Removes association.
+         * @param key Key of the value.
+         *
+         * This method invalidates all iterators to the same object number.
+         *
+         * @return Value of the key or default value if not found (and not 
+         * removed).
+         */
+        V remove(const K & key)
+        {
+                size_t index;
+                if(getIndex(key, index))
+                {
+                        Slot & slot=slots[index];
+                        for(typename Slot::iterator i=slot.begin(); i!=slot.end(); ++i)
+                                if(i->first.gen==key.gen)
+                                {
+                                        V old=i->second;
+                                        slot.erase(i);
+                                        --count;
+                                        return old;
+                                }
+                        return V();
+                }
+                typename Overflow::iterator i=overflow.find(key);
+                if(i==overflow.end())
+                        return V();
+                V old=i->second.second;
+                overflow.erase(i);
+                --count;
+                return old;
+        }
+
+        /** Number of elements.
+         *
+         * @return Elements count.
+         */
+        size_t size()const
+        {
+                return count;
+        }
+
+        /** Returns iterator to first element.
+         *
+         * @return Iterator instance.
+         */
+        Iterator begin()
+        {
+                return Iterator(slots.begin(), slots.end(), overflow.begin());
+        }
+
+        /** Returns const iterator to first element.
+         *
+         * @return ConstIterator instance.
+         */
+        ConstIterator begin()const
+        {
+                return ConstIterator(slots.begin(), slots.end(), overflow.begin());
+        }
+
+        /** Returns iterator to end iterator.
+         *
+         * @return Iterator instance.
+         */
+        Iterator end()
+        {
+                return Iterator(slots.end(), slots.end(), overflow.end());
+        }
+
+        /** Returns const iterator to end iterator.
+         *
+         * @return ConstIterator instance.
+         */
+        ConstIterator end()const
+        {
+                return ConstIterator(slots.end(), slots.end(), overflow.end());
+        }
+};
 #endif
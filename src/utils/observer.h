@@ -633,6 +633,14 @@ public:
 			throw ObserverException ();
 	}
 
+	/** Checks whether there is any registered observer.
+	 * @return true if at least one observer is registered.
+	 */
+	bool hasObservers()const
+	{
+		return observers.size()>0;
+	}
+
 	/**
 	 * Notify all active observers about a change.
 	 *
@@ -0,0 +1,109 @@
+/*
+ * PDFedit - free program for PDF document manipulation.
+ * Copyright (C) 2006-2009  PDFedit team: Michal Hocko,
+ *                                        Jozef Misutka,
+ *                                        Martin Petricek
+ *                   Former team members: Miroslav Jahoda
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program (in doc/LICENSE.GPL); if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA  02111-1307  USA
+ *
+ * Project is hosted on http://sourceforge.net/projects/pdfedit
+ */
+// vim:tabstop=4:shiftwidth=4:noexpandtab:textwidth=80
+
+
+#ifndef _THREAD_H_
+#define _THREAD_H_
+
+#include <boost/noncopyable.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * @file thread.h
+ *
+ * Portable thread of execution.
+ */
+
+namespace threads {
+
+/**
+ * Thread base class.
+ *
+ * Descendants implement run method which is executed in a separate thread
+ * after start is called. Started thread has to be joined before the instance
+ * is destroyed.
+ */
+class Thread : boost::noncopyable
+{
+#ifdef WIN32
+	HANDLE handle;
+	static DWORD WINAPI entry (LPVOID arg)
+		{ static_cast<Thread*> (arg)->run (); return 0; }
+public:
+	Thread () : handle (NULL) {}
+	/** Start the thread.
+	 * @return true on success, false if the thread could not be created. */
+	bool start ()
+	{
+		handle = CreateThread (NULL, 0, entry, this, 0, NULL);
+		return NULL != handle;
+	}
+	/** Wait for the thread to finish. */
+	void join ()
+	{
+		if (!handle)
+			return;
+		WaitForSingleObject (handle, INFINITE);
+		CloseHandle (handle);
+		handle = NULL;
+	}
+#else
+	pthread_t thread;
+	bool started;
+	static void* entry (void* arg)
+		{ static_cast<Thread*> (arg)->run (); return NULL; }
+public:
+	Thread () : started (false) {}
+	/** Start the thread.
+	 * @return true on success, false if the thread could not be created. */
+	bool start ()
+	{
+		started = (0 == pthread_create (&thread, NULL, entry, this));
+		return started;
+	}
+	/** Wait for the thread to finish. */
+	void join ()
+	{
+		if (!started)
+			return;
+		pthread_join (thread, NULL);
+		started = false;
+	}
+#endif
+	virtual ~Thread () {}
+
+protected:
+	/** Code executed in the thread. */
+	virtual void run () = 0;
+};
+
+} // namespace threads
+
+#endif // _THREAD_H_
@@ -6,6 +6,8 @@
 //
 // Changes: 
 // Michal Hocko   - initGlobalParams, destroyGlobalParams methods added
+// PDFedit team   - mutexes are mutable because const getters lock them
+//                  when MULTITHREADED is defined
 //
 //========================================================================
 
@@ -462,9 +464,9 @@ private:
 #endif
 
 #if MULTITHREADED
-  GMutex mutex;
-  GMutex unicodeMapCacheMutex;
-  GMutex cMapCacheMutex;
+  mutable GMutex mutex;
+  mutable GMutex unicodeMapCacheMutex;
+  mutable GMutex cMapCacheMutex;
 #endif
 };
 
@@ -602,6 +602,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   splashColorCopy(paperColor, paperColorA);
 
   xref = NULL;
+  docId = 0;
 
   bitmap = new SplashBitmap(1, 1, bitmapRowPad, colorMode,
 			    colorMode != splashModeMono1, bitmapTopDown);
@@ -692,6 +693,7 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
   int i;
 
   xref = xrefA;
+  docId = 0;
   if (fontEngine) {
     delete fontEngine;
   }
@@ -4,6 +4,11 @@
 //
 // Copyright 2003 Glyph & Cog, LLC
 //
+// Changes:
+// PDFedit team - docId identifies the document content the device has been
+//                started for (startDoc drops font caches so callers can
+//                skip it for the same content)
+//
 //========================================================================
 
 #ifndef SPLASHOUTPUTDEV_H
@@ -160,6 +165,12 @@ public:
 
   // Called to indicate that a new PDF document has been loaded.
   void startDoc(XRef *xrefA);
+
+  // Caller defined identification of the document content for which
+  // the device has been started.  startDoc resets it to 0, callers set
+  // it after startDoc and compare it before the next rendering.
+  Gulong getDocId() { return docId; }
+  void setDocId(Gulong docIdA) { docId = docIdA; }
  
   void setPaperColor(SplashColorPtr paperColorA);
 
@@ -227,6 +238,7 @@ private:
   SplashScreenParams screenParams;
 
   XRef *xref;			// xref table for current document
+  Gulong docId;			// document content id (see setDocId)
 
   SplashBitmap *bitmap;
   Splash *splash;
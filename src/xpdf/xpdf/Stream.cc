@@ -76,6 +76,30 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
+int Stream::getRawBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -317,6 +341,439 @@ void FilterStream::setPos(Guint pos, int dir) {
   error(-1, "Internal: called setPos() on FilterStream");
 }
 
+//------------------------------------------------------------------------
+// Line kernels
+//------------------------------------------------------------------------
+
+// PNG row filters and image sample unpacking used by StreamPredictor
+// and ImageStream.  All kernels have a plain C version; SSE2 versions
+// are used when the compiler targets SSE2, and the up filter also has
+// an AVX2 version which is chosen at runtime.  All versions give the
+// same results.
+//
+// Row filters work on <n> bytes of <line>, which holds the previous
+// (up) row on input.  The <bpp> bytes before <line> are the left
+// padding and are always zero.
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STREAM_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(STREAM_USE_SSE2) && defined(__GNUC__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define STREAM_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+static void pngUpRowC(Guchar *line, const Guchar *raw, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] = line[i] + raw[i];
+  }
+}
+
+static void pngSubRowC(Guchar *line, const Guchar *raw, int n, int bpp) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] = line[i - bpp] + raw[i];
+  }
+}
+
+static void pngAvgRowC(Guchar *line, const Guchar *raw, int n, int bpp) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    line[i] = (Guchar)(((line[i - bpp] + line[i]) >> 1) + raw[i]);
+  }
+}
+
+// <upLeft> holds the (up) values of the last <bpp> bytes before <line>
+// which have been already overwritten.
+static void pngPaethRowC(Guchar *line, const Guchar *raw, int n, int bpp,
+			 Guchar *upLeft) {
+  int left, up, p, pa, pb, pc;
+  int i, j;
+
+  for (i = 0, j = 0; i < n; ++i) {
+    left = line[i - bpp];
+    up = line[i];
+    p = left + up - upLeft[j];
+    if ((pa = p - left) < 0)
+      pa = -pa;
+    if ((pb = p - up) < 0)
+      pb = -pb;
+    if ((pc = p - upLeft[j]) < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      line[i] = (Guchar)(left + raw[i]);
+    else if (pb <= pc)
+      line[i] = (Guchar)(up + raw[i]);
+    else
+      line[i] = (Guchar)(upLeft[j] + raw[i]);
+    upLeft[j] = (Guchar)up;
+    if (++j == bpp)
+      j = 0;
+  }
+}
+
+static void unpack1C(Guchar *out, const Guchar *in, int nVals) {
+  int c, i;
+
+  for (i = 0; i < nVals; i += 8) {
+    c = *in++;
+    out[i+0] = (Guchar)((c >> 7) & 1);
+    out[i+1] = (Guchar)((c >> 6) & 1);
+    out[i+2] = (Guchar)((c >> 5) & 1);
+    out[i+3] = (Guchar)((c >> 4) & 1);
+    out[i+4] = (Guchar)((c >> 3) & 1);
+    out[i+5] = (Guchar)((c >> 2) & 1);
+    out[i+6] = (Guchar)((c >> 1) & 1);
+    out[i+7] = (Guchar)(c & 1);
+  }
+}
+
+// Unpacks samples with <nBits> bits (at most 8) starting at <i>-th
+// sample of the line.
+static void unpackC(Guchar *out, const Guchar *in, int i, int nVals,
+		    int nBits) {
+  Gulong buf, bitMask;
+  int bits;
+
+  bitMask = (1 << nBits) - 1;
+  in += (i * nBits) >> 3;
+  buf = 0;
+  bits = 0;
+  for (; i < nVals; ++i) {
+    if (bits < nBits) {
+      buf = (buf << 8) | *in++;
+      bits += 8;
+    }
+    out[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
+    bits -= nBits;
+  }
+}
+
+#ifdef STREAM_USE_SSE2
+
+static void pngUpRowSSE2(Guchar *line, const Guchar *raw, int n) {
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm_storeu_si128((__m128i *)(line + i),
+		     _mm_add_epi8(_mm_loadu_si128((__m128i *)(line + i)),
+				  _mm_loadu_si128((__m128i *)(raw + i))));
+  }
+  pngUpRowC(line + i, raw + i, n - i);
+}
+
+// Sub filter is a prefix sum with step <bpp>: left pixel is added to
+// the first pixel of each 16 byte chunk, and the chunk is summed by
+// shifted additions.
+template <int bpp>
+static void pngSubRowSSE2(Guchar *line, const Guchar *raw, int n) {
+  __m128i firstPix, x;
+  int i;
+
+  firstPix = _mm_srli_si128(_mm_set1_epi8((char)0xff), 16 - bpp);
+  for (i = 0; i + 16 <= n; i += 16) {
+    x = _mm_add_epi8(_mm_loadu_si128((__m128i *)(raw + i)),
+		     _mm_and_si128(firstPix,
+				   _mm_loadu_si128((__m128i *)(line + i - bpp))));
+    x = _mm_add_epi8(x, _mm_slli_si128(x, bpp));
+    if (2 * bpp < 16) {
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 2 * bpp));
+    }
+    if (4 * bpp < 16) {
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4 * bpp));
+    }
+    if (8 * bpp < 16) {
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8 * bpp));
+    }
+    _mm_storeu_si128((__m128i *)(line + i), x);
+  }
+  pngSubRowC(line + i, raw + i, n - i, bpp);
+}
+
+// Left pixel is complete when bpp is at least 16, so whole chunks can be
+// added.
+static void pngSubRowWideSSE2(Guchar *line, const Guchar *raw, int n,
+			      int bpp) {
+  int i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm_storeu_si128((__m128i *)(line + i),
+		     _mm_add_epi8(_mm_loadu_si128((__m128i *)(line + i - bpp)),
+				  _mm_loadu_si128((__m128i *)(raw + i))));
+  }
+  pngSubRowC(line + i, raw + i, n - i, bpp);
+}
+
+static void pngSubRowSSE2(Guchar *line, const Guchar *raw, int n, int bpp) {
+  switch (bpp) {
+  case 1: pngSubRowSSE2<1>(line, raw, n); break;
+  case 2: pngSubRowSSE2<2>(line, raw, n); break;
+  case 3: pngSubRowSSE2<3>(line, raw, n); break;
+  case 4: pngSubRowSSE2<4>(line, raw, n); break;
+  case 5: pngSubRowSSE2<5>(line, raw, n); break;
+  case 6: pngSubRowSSE2<6>(line, raw, n); break;
+  case 7: pngSubRowSSE2<7>(line, raw, n); break;
+  case 8: pngSubRowSSE2<8>(line, raw, n); break;
+  case 9: pngSubRowSSE2<9>(line, raw, n); break;
+  case 10: pngSubRowSSE2<10>(line, raw, n); break;
+  case 11: pngSubRowSSE2<11>(line, raw, n); break;
+  case 12: pngSubRowSSE2<12>(line, raw, n); break;
+  case 13: pngSubRowSSE2<13>(line, raw, n); break;
+  case 14: pngSubRowSSE2<14>(line, raw, n); break;
+  case 15: pngSubRowSSE2<15>(line, raw, n); break;
+  default: pngSubRowWideSSE2(line, raw, n, bpp); break;
+  }
+}
+
+// Loads one pixel to the low bytes of the register.
+template <int bpp>
+static inline __m128i loadPixelSSE2(const Guchar *p) {
+  Guchar buf[16] = {0};
+
+  memcpy(buf, p, bpp);
+  return _mm_loadu_si128((__m128i *)buf);
+}
+
+template <int bpp>
+static inline void storePixelSSE2(Guchar *p, __m128i x) {
+  Guchar buf[16];
+
+  _mm_storeu_si128((__m128i *)buf, x);
+  memcpy(p, buf, bpp);
+}
+
+// Average and Paeth filters depend on the left pixel, so they are
+// computed one pixel at a time in 16 bit lanes.
+template <int bpp>
+static void pngAvgRowSSE2(Guchar *line, const Guchar *raw, int n) {
+  __m128i zero, a, b, d;
+  int i;
+
+  zero = _mm_setzero_si128();
+  a = zero;
+  for (i = 0; i + bpp <= n; i += bpp) {
+    b = _mm_unpacklo_epi8(loadPixelSSE2<bpp>(line + i), zero);
+    d = _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+    d = _mm_add_epi8(_mm_packus_epi16(d, d), loadPixelSSE2<bpp>(raw + i));
+    storePixelSSE2<bpp>(line + i, d);
+    a = _mm_unpacklo_epi8(d, zero);
+  }
+  pngAvgRowC(line + i, raw + i, n - i, bpp);
+}
+
+static inline __m128i absSSE2(__m128i x) {
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static inline __m128i selectSSE2(__m128i mask, __m128i a, __m128i b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+template <int bpp>
+static void pngPaethRowSSE2(Guchar *line, const Guchar *raw, int n,
+			    Guchar *upLeft) {
+  __m128i zero, a, b, c, d, pa, pb, pc, smallest, nearest;
+  Guchar buf[16];
+  int i;
+
+  zero = _mm_setzero_si128();
+  a = c = zero;
+  for (i = 0; i + bpp <= n; i += bpp) {
+    b = _mm_unpacklo_epi8(loadPixelSSE2<bpp>(line + i), zero);
+    // p = a + b - c, so pa = |b - c|, pb = |a - c| and pc = |a + b - 2c|
+    pa = _mm_sub_epi16(b, c);
+    pb = _mm_sub_epi16(a, c);
+    pc = absSSE2(_mm_add_epi16(pa, pb));
+    pa = absSSE2(pa);
+    pb = absSSE2(pb);
+    smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+    nearest = selectSSE2(_mm_cmpeq_epi16(smallest, pc), c, a);
+    nearest = selectSSE2(_mm_cmpeq_epi16(smallest, pb), b, nearest);
+    nearest = selectSSE2(_mm_cmpeq_epi16(smallest, pa), a, nearest);
+    d = _mm_add_epi8(_mm_packus_epi16(nearest, nearest),
+		     loadPixelSSE2<bpp>(raw + i));
+    storePixelSSE2<bpp>(line + i, d);
+    a = _mm_unpacklo_epi8(d, zero);
+    c = b;
+  }
+  if (i < n) {
+    _mm_storeu_si128((__m128i *)buf, _mm_packus_epi16(c, c));
+    memcpy(upLeft, buf, bpp);
+    pngPaethRowC(line + i, raw + i, n - i, bpp, upLeft);
+  }
+}
+
+static inline void unpack1StoreSSE2(Guchar *out, __m128i x, __m128i mask) {
+  x = _mm_cmpeq_epi8(_mm_and_si128(x, mask), mask);
+  _mm_storeu_si128((__m128i *)out, _mm_and_si128(x, _mm_set1_epi8(1)));
+}
+
+// Each byte is replicated 8 times and masked with the bit which belongs
+// to the position.
+static void unpack1SSE2(Guchar *out, const Guchar *in, int nVals) {
+  __m128i mask, x, lo, hi, q[4];
+  int i, j, k;
+
+  mask = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+		      1, 2, 4, 8, 16, 32, 64, (char)128);
+  for (i = 0, j = 0; i + 128 <= nVals; i += 128, j += 16) {
+    x = _mm_loadu_si128((__m128i *)(in + j));
+    lo = _mm_unpacklo_epi8(x, x);
+    hi = _mm_unpackhi_epi8(x, x);
+    // each q holds 4 bytes replicated 4 times
+    q[0] = _mm_unpacklo_epi16(lo, lo);
+    q[1] = _mm_unpackhi_epi16(lo, lo);
+    q[2] = _mm_unpacklo_epi16(hi, hi);
+    q[3] = _mm_unpackhi_epi16(hi, hi);
+    for (k = 0; k < 4; ++k) {
+      unpack1StoreSSE2(out + i + 32 * k, _mm_unpacklo_epi32(q[k], q[k]), mask);
+      unpack1StoreSSE2(out + i + 32 * k + 16, _mm_unpackhi_epi32(q[k], q[k]),
+		       mask);
+    }
+  }
+  unpack1C(out + i, in + j, nVals - i);
+}
+
+static void unpack2SSE2(Guchar *out, const Guchar *in, int nVals) {
+  __m128i mask, x, v0, v1, v2, v3, lo, hi;
+  int i, j;
+
+  mask = _mm_set1_epi8(3);
+  for (i = 0, j = 0; i + 64 <= nVals; i += 64, j += 16) {
+    x = _mm_loadu_si128((__m128i *)(in + j));
+    v0 = _mm_and_si128(_mm_srli_epi16(x, 6), mask);
+    v1 = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+    v2 = _mm_and_si128(_mm_srli_epi16(x, 2), mask);
+    v3 = _mm_and_si128(x, mask);
+    // interleave to v0[0] v1[0] v2[0] v3[0] v0[1] ...
+    lo = _mm_unpacklo_epi8(v0, v1);
+    hi = _mm_unpacklo_epi8(v2, v3);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i *)(out + i + 16), _mm_unpackhi_epi16(lo, hi));
+    lo = _mm_unpackhi_epi8(v0, v1);
+    hi = _mm_unpackhi_epi8(v2, v3);
+    _mm_storeu_si128((__m128i *)(out + i + 32), _mm_unpacklo_epi16(lo, hi));
+    _mm_storeu_si128((__m128i *)(out + i + 48), _mm_unpackhi_epi16(lo, hi));
+  }
+  unpackC(out, in, i, nVals, 2);
+}
+
+static void unpack4SSE2(Guchar *out, const Guchar *in, int nVals) {
+  __m128i mask, x, v0, v1;
+  int i, j;
+
+  mask = _mm_set1_epi8(0x0f);
+  for (i = 0, j = 0; i + 32 <= nVals; i += 32, j += 16) {
+    x = _mm_loadu_si128((__m128i *)(in + j));
+    v0 = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+    v1 = _mm_and_si128(x, mask);
+    _mm_storeu_si128((__m128i *)(out + i), _mm_unpacklo_epi8(v0, v1));
+    _mm_storeu_si128((__m128i *)(out + i + 16), _mm_unpackhi_epi8(v0, v1));
+  }
+  unpackC(out, in, i, nVals, 4);
+}
+
+#endif // STREAM_USE_SSE2
+
+#ifdef STREAM_USE_AVX2
+
+__attribute__((target("avx2")))
+static void pngUpRowAVX2(Guchar *line, const Guchar *raw, int n) {
+  int i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    _mm256_storeu_si256((__m256i *)(line + i),
+			_mm256_add_epi8(_mm256_loadu_si256((__m256i *)(line + i)),
+					_mm256_loadu_si256((__m256i *)(raw + i))));
+  }
+  pngUpRowSSE2(line + i, raw + i, n - i);
+}
+
+static GBool haveAVX2() {
+  static int avx2 = -1;
+
+  if (avx2 < 0) {
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return avx2 ? gTrue : gFalse;
+}
+
+#endif // STREAM_USE_AVX2
+
+static void pngUpRow(Guchar *line, const Guchar *raw, int n) {
+#if defined(STREAM_USE_AVX2)
+  if (haveAVX2()) {
+    pngUpRowAVX2(line, raw, n);
+  } else {
+    pngUpRowSSE2(line, raw, n);
+  }
+#elif defined(STREAM_USE_SSE2)
+  pngUpRowSSE2(line, raw, n);
+#else
+  pngUpRowC(line, raw, n);
+#endif
+}
+
+static void pngSubRow(Guchar *line, const Guchar *raw, int n, int bpp) {
+#ifdef STREAM_USE_SSE2
+  pngSubRowSSE2(line, raw, n, bpp);
+#else
+  pngSubRowC(line, raw, n, bpp);
+#endif
+}
+
+static void pngAvgRow(Guchar *line, const Guchar *raw, int n, int bpp) {
+#ifdef STREAM_USE_SSE2
+  switch (bpp) {
+  case 3: pngAvgRowSSE2<3>(line, raw, n); return;
+  case 4: pngAvgRowSSE2<4>(line, raw, n); return;
+  case 6: pngAvgRowSSE2<6>(line, raw, n); return;
+  case 8: pngAvgRowSSE2<8>(line, raw, n); return;
+  }
+#endif
+  pngAvgRowC(line, raw, n, bpp);
+}
+
+static void pngPaethRow(Guchar *line, const Guchar *raw, int n, int bpp) {
+  Guchar upLeft[gfxColorMaxComps * 2];
+
+  memset(upLeft, 0, bpp);
+#ifdef STREAM_USE_SSE2
+  switch (bpp) {
+  case 3: pngPaethRowSSE2<3>(line, raw, n, upLeft); return;
+  case 4: pngPaethRowSSE2<4>(line, raw, n, upLeft); return;
+  case 6: pngPaethRowSSE2<6>(line, raw, n, upLeft); return;
+  case 8: pngPaethRowSSE2<8>(line, raw, n, upLeft); return;
+  }
+#endif
+  pngPaethRowC(line, raw, n, bpp, upLeft);
+}
+
+static void unpackLine(Guchar *out, const Guchar *in, int nVals, int nBits) {
+#ifdef STREAM_USE_SSE2
+  switch (nBits) {
+  case 1: unpack1SSE2(out, in, nVals); return;
+  case 2: unpack2SSE2(out, in, nVals); return;
+  case 4: unpack4SSE2(out, in, nVals); return;
+  }
+#endif
+  if (nBits == 1) {
+    unpack1C(out, in, nVals);
+  } else {
+    unpackC(out, in, 0, nVals, nBits);
+  }
+}
+
 //------------------------------------------------------------------------
 // ImageStream
 //------------------------------------------------------------------------
@@ -341,10 +798,17 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
   }
   imgLine = (Guchar *)gmallocn(imgLineSize, sizeof(Guchar));
   imgIdx = nVals;
+  if (imgLineSize < 0 || nVals > (INT_MAX - 7) / nBits) {
+    inputLineSize = -1;
+  } else {
+    inputLineSize = (nVals * nBits + 7) >> 3;
+  }
+  inputLine = (Guchar *)gmallocn(inputLineSize, sizeof(Guchar));
 }
 
 ImageStream::~ImageStream() {
   gfree(imgLine);
+  gfree(inputLine);
 }
 
 void ImageStream::reset() {
@@ -367,25 +831,20 @@ GBool ImageStream::getPixel(Guchar *pix) {
 Guchar *ImageStream::getLine() {
   Gulong buf, bitMask;
   int bits;
-  int c;
-  int i;
+  int n, i;
 
-  if (nBits == 1) {
-    for (i = 0; i < nVals; i += 8) {
-      c = str->getChar();
-      imgLine[i+0] = (Guchar)((c >> 7) & 1);
-      imgLine[i+1] = (Guchar)((c >> 6) & 1);
-      imgLine[i+2] = (Guchar)((c >> 5) & 1);
-      imgLine[i+3] = (Guchar)((c >> 4) & 1);
-      imgLine[i+4] = (Guchar)((c >> 3) & 1);
-      imgLine[i+5] = (Guchar)((c >> 2) & 1);
-      imgLine[i+6] = (Guchar)((c >> 1) & 1);
-      imgLine[i+7] = (Guchar)(c & 1);
-    }
-  } else if (nBits == 8) {
-    for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
+  if (nBits == 8) {
+    n = str->getBlock((char *)imgLine, nVals);
+    // missing data are read as EOF, which is 0xff when stored to Guchar
+    if (n < nVals) {
+      memset(imgLine + n, 0xff, nVals - n);
     }
+  } else if (nBits < 8) {
+    n = str->getBlock((char *)inputLine, inputLineSize);
+    if (n < inputLineSize) {
+      memset(inputLine + n, 0xff, inputLineSize - n);
+    }
+    unpackLine(imgLine, inputLine, nVals, nBits);
   } else {
     bitMask = (1 << nBits) - 1;
     buf = 0;
@@ -403,12 +862,7 @@ Guchar *ImageStream::getLine() {
 }
 
 void ImageStream::skipLine() {
-  int n, i;
-
-  n = (nVals * nBits + 7) >> 3;
-  for (i = 0; i < n; ++i) {
-    str->getChar();
-  }
+  str->getBlock((char *)inputLine, inputLineSize);
 }
 
 //------------------------------------------------------------------------
@@ -424,6 +878,7 @@ void StreamPredictor::initContext(int predictorA,
   nComps = nCompsA;
   nBits = nBitsA;
   predLine = NULL;
+  rawLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -438,6 +893,7 @@ void StreamPredictor::initContext(int predictorA,
   }
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  rawLine = (Guchar *)gmalloc(rowBytes);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -457,6 +913,7 @@ StreamPredictor::StreamPredictor(Stream * strA, PredictorContext & context)
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(rawLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -477,14 +934,33 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
-  int i, j, k, kk;
+  int n, i, j, k, kk;
 
   // get PNG optimum predictor number
   if (predictor >= 10) {
@@ -496,56 +972,41 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
+  // read the raw line
+  if ((n = str->getRawBlock((char *)rawLine, rowBytes - pixBytes)) == 0) {
+    return gFalse;
+  }
+  // if n is smaller than the line, the rest of the previous line is kept -
+  // this ought to return false, but some (broken) PDF files contain
+  // truncated image data, and Adobe apparently reads the last partial
+  // line
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+    pngSubRow(predLine + pixBytes, rawLine, n, pixBytes);
+    break;
+  case 12:			// PNG up
+    pngUpRow(predLine + pixBytes, rawLine, n);
+    break;
+  case 13:			// PNG average
+    pngAvgRow(predLine + pixBytes, rawLine, n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+    pngPaethRow(predLine + pixBytes, rawLine, n, pixBytes);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    if (predictor == 2 && nBits == 8) {
+      // 8 bit TIFF predictor is the same as PNG sub
+      pngSubRow(predLine + pixBytes, rawLine, n, nComps);
+      for (i = pixBytes + n; i < rowBytes; ++i) {
+	predLine[i] += predLine[i - nComps];
       }
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
+    } else {
+      memcpy(predLine + pixBytes, rawLine, n);
     }
+    break;
   }
 
   // apply TIFF (component) predictor
@@ -558,9 +1019,7 @@ GBool StreamPredictor::getNextLine() {
 	predLine[i] ^= inBuf >> nComps;
       }
     } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
+      // already applied with PNG predictor
     } else {
       memset(upLeftBuf, 0, nComps + 1);
       bitMask = (1 << nBits) - 1;
@@ -712,6 +1171,46 @@ void FileStream::close() {
   }
 }
 
+int FileStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    // big requests are read directly to the given buffer
+    if (bufPtr >= bufEnd && size - n >= fileStreamBufSize) {
+      bufPos += (Guint)(bufEnd - buf);
+      bufPtr = bufEnd = buf;
+      m = size - n;
+      if (limited) {
+	if (bufPos >= start + length) {
+	  break;
+	}
+	if (bufPos + m > start + length) {
+	  m = start + length - bufPos;
+	}
+      }
+      m = (int)fread(blk + n, 1, m, f);
+      bufPos += m;
+      n += m;
+      if (m == 0) {
+	break;
+      }
+      continue;
+    }
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool FileStream::fillBuf() {
   int n;
 
@@ -849,6 +1348,21 @@ void MemStream::reset() {
 void MemStream::close() {
 }
 
+int MemStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = (int)(bufEnd - bufPtr);
+  if (n > size) {
+    n = size;
+  }
+  if (n <= 0) {
+    return 0;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   Guint i;
 
@@ -975,6 +1489,19 @@ void ASCIIHexStream::reset() {
   eof = gFalse;
 }
 
+int ASCIIHexStream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = ASCIIHexStream::lookChar()) == EOF) {
+      break;
+    }
+    buf = EOF;
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 int ASCIIHexStream::lookChar() {
   int c1, c2, x;
 
@@ -1077,6 +1604,22 @@ void ASCII85Stream::reset() {
   eof = gFalse;
 }
 
+int ASCII85Stream::getBlock(char *blk, int size) {
+  int i;
+
+  i = 0;
+  while (i < size) {
+    // decodes the next group if the current one is consumed
+    if (ASCII85Stream::lookChar() == EOF) {
+      break;
+    }
+    for (; i < size && index < n; ++i) {
+      blk[i] = (char)b[index++];
+    }
+  }
+  return i;
+}
+
 int ASCII85Stream::lookChar() {
   int k;
   Gulong t;
@@ -1404,6 +1947,25 @@ GBool RunLengthStream::isBinary(GBool last)const {
   return str->isBinary(gTrue);
 }
 
+int RunLengthStream::getBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > size - n) {
+      m = size - n;
+    }
+    memcpy(blk + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool RunLengthStream::fillBuf() {
   int c;
   int n, i;
@@ -1416,9 +1978,13 @@ GBool RunLengthStream::fillBuf() {
     return gFalse;
   }
   if (c < 0x80) {
-    n = c + 1;
-    for (i = 0; i < n; ++i)
-      buf[i] = (char)str->getChar();
+    // length of literal run is known so it can be read at once
+    n = str->getBlock(buf, c + 1);
+    if (n < c + 1) {
+      eof = gTrue;
+      if (n == 0)
+	return gFalse;
+    }
   } else {
     n = 0x101 - c;
     c = str->getChar();
@@ -2306,6 +2872,19 @@ void DCTStream::close() {
   FilterStream::close();
 }
 
+int DCTStream::getBlock(char *blk, int size) {
+  int n, c;
+
+  // non virtual calls of getChar
+  for (n = 0; n < size; ++n) {
+    if ((c = DCTStream::getChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 int DCTStream::getChar() {
   int c;
 
@@ -4312,6 +4891,36 @@ int FlateStream::getRawChar() {
   return c;
 }
 
+int FlateStream::getBlock(char *blk, int size) {
+  if (pred) {
+    return pred->getBlock(blk, size);
+  }
+  return getRawBlock(blk, size);
+}
+
+int FlateStream::getRawBlock(char *blk, int size) {
+  int n, m;
+
+  n = 0;
+  while (n < size) {
+    while (remain == 0) {
+      if (endOfBlock && eof)
+	return n;
+      readSome();
+    }
+    // output buffer is circular so copies at most up to its end
+    m = (remain < size - n) ? remain : size - n;
+    if (m > flateWindow - index) {
+      m = flateWindow - index;
+    }
+    memcpy(blk + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 GString *FlateStream::getPSFilter(int psLevel,const char *indent)const {
   GString *s;
 
@@ -4333,7 +4942,6 @@ void FlateStream::readSome() {
   int code1, code2;
   int len, dist;
   int i, j, k;
-  int c;
 
   if (endOfBlock) {
     if (!startBlock())
@@ -4341,44 +4949,61 @@ void FlateStream::readSome() {
   }
 
   if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = gTrue;
-      remain = 0;
-    } else {
+    // decodes as many symbols as fit into the free part of the output
+    // buffer, so that readSome is not called for each literal
+    i = (index + remain) & flateMask;
+    while (remain <= flateWindow - flateMaxMatch) {
+      if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
+	goto err;
+      if (code1 < 256) {
+	buf[i] = (Guchar)code1;
+	i = (i + 1) & flateMask;
+	++remain;
+	continue;
+      }
+      if (code1 == 256) {
+	endOfBlock = gTrue;
+	break;
+      }
       code1 -= 257;
       code2 = lengthDecode[code1].bits;
       if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
 	goto err;
       len = lengthDecode[code1].first + code2;
-      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
+      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF ||
+	  code1 >= flateMaxDistCodes)
 	goto err;
       code2 = distDecode[code1].bits;
       if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
 	goto err;
       dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
-	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
+      j = (i - dist) & flateMask;
+      if (dist >= len && i + len <= flateWindow && j + len <= flateWindow) {
+	// source doesn't overlap the part being written
+	memmove(buf + i, buf + j, len);
+	i += len;
+      } else {
+	for (k = 0; k < len; ++k) {
+	  buf[i] = buf[j];
+	  i = (i + 1) & flateMask;
+	  j = (j + 1) & flateMask;
+	}
       }
-      remain = len;
+      i &= flateMask;
+      remain += len;
     }
 
   } else {
+    // stored block length is known so it is read by blocks (at most
+    // up to the end of the circular buffer)
     len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
-      if ((c = str->getChar()) == EOF) {
-	endOfBlock = eof = gTrue;
-	break;
-      }
-      buf[j] = c & 0xff;
+    i = str->getBlock((char *)buf + index, 
+		    (len < flateWindow - index) ? len : flateWindow - index);
+    if (i == flateWindow - index && i < len) {
+      i += str->getBlock((char *)buf, len - i);
+    }
+    if (i < len) {
+      endOfBlock = eof = gTrue;
     }
     remain = i;
     blockLen -= len;
@@ -4389,9 +5014,9 @@ void FlateStream::readSome() {
   return;
 
 err:
+  // already decoded data are kept
   error(getPos(), "Unexpected end of file in flate stream");
   endOfBlock = eof = gTrue;
-  remain = 0;
 }
 
 GBool FlateStream::startBlock() {
@@ -4571,7 +5196,9 @@ err:
 // Convert an array <lengths> of <n> lengths, in value order, into a
 // Huffman code lookup table.
 void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
-  int tabSize, len, code, code2, skip, val, i, t;
+  int subLen[1 << flateLookupBits];	// max code length for each prefix
+  int subIndex[1 << flateLookupBits];	// second level table index
+  int tabSize, rootBits, rootSize, len, code, code2, skip, val, i, t;
 
   // find max code length
   tab->maxLen = 0;
@@ -4580,9 +5207,39 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
       tab->maxLen = lengths[val];
     }
   }
+  rootBits = (tab->maxLen < flateLookupBits) ? tab->maxLen : flateLookupBits;
+  rootSize = 1 << rootBits;
+
+  // find longest code for each first level prefix - these determine
+  // sizes of the second level tables
+  for (i = 0; i < rootSize; ++i) {
+    subLen[i] = 0;
+  }
+  for (len = 1, code = 0; len <= tab->maxLen; ++len, code <<= 1) {
+    for (val = 0; val < n; ++val) {
+      if (lengths[val] == len) {
+	if (len > rootBits) {
+	  code2 = 0;
+	  t = code >> (len - rootBits);
+	  for (i = 0; i < rootBits; ++i) {
+	    code2 = (code2 << 1) | (t & 1);
+	    t >>= 1;
+	  }
+	  subLen[code2] = len;
+	}
+	++code;
+      }
+    }
+  }
 
   // allocate the table
-  tabSize = 1 << tab->maxLen;
+  tabSize = rootSize;
+  for (i = 0; i < rootSize; ++i) {
+    if (subLen[i]) {
+      subIndex[i] = tabSize;
+      tabSize += 1 << (subLen[i] - rootBits);
+    }
+  }
   tab->codes = (FlateCode *)gmallocn(tabSize, sizeof(FlateCode));
 
   // clear the table
@@ -4591,6 +5248,14 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
     tab->codes[i].val = 0;
   }
 
+  // link the second level tables
+  for (i = 0; i < rootSize; ++i) {
+    if (subLen[i]) {
+      tab->codes[i].len = (Gushort)(flateMaxHuffman + subLen[i] - rootBits);
+      tab->codes[i].val = (Gushort)subIndex[i];
+    }
+  }
+
   // build the table
   for (len = 1, code = 0, skip = 2;
        len <= tab->maxLen;
@@ -4607,9 +5272,19 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
 	}
 
 	// fill in the table entries
-	for (i = code2; i < tabSize; i += skip) {
-	  tab->codes[i].len = (Gushort)len;
-	  tab->codes[i].val = (Gushort)val;
+	if (len <= rootBits) {
+	  for (i = code2; i < rootSize; i += skip) {
+	    tab->codes[i].len = (Gushort)len;
+	    tab->codes[i].val = (Gushort)val;
+	  }
+	} else {
+	  t = code2 & (rootSize - 1);
+	  for (i = code2 >> rootBits;
+	       i < (1 << (subLen[t] - rootBits));
+	       i += skip >> rootBits) {
+	    tab->codes[subIndex[t] + i].len = (Gushort)len;
+	    tab->codes[subIndex[t] + i].val = (Gushort)val;
+	  }
 	}
 
 	++code;
@@ -4620,6 +5295,7 @@ void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
 
 int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
   FlateCode *code;
+  int rootBits;
   int c;
 
   while (codeSize < tab->maxLen) {
@@ -4629,7 +5305,13 @@ int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
     codeBuf |= (c & 0xff) << codeSize;
     codeSize += 8;
   }
-  code = &tab->codes[codeBuf & ((1 << tab->maxLen) - 1)];
+  rootBits = (tab->maxLen < flateLookupBits) ? tab->maxLen : flateLookupBits;
+  code = &tab->codes[codeBuf & ((1 << rootBits) - 1)];
+  if (code->len > flateMaxHuffman) {
+    // long code - second level lookup
+    code = &tab->codes[code->val + ((codeBuf >> rootBits) &
+				    ((1 << (code->len - flateMaxHuffman)) - 1))];
+  }
   if (codeSize == 0 || codeSize < code->len || code->len == 0) {
     return EOF;
   }
@@ -15,6 +15,13 @@
 //              - All filter stream using StremPredictor stores PredictorContext
 //                to enable cloning
 //              - dictionary modificator access methods
+// PDFedit team - getBlock method for reading more characters at once. 
+//                FileStream, MemStream and the most common filters 
+//                implement it without per character virtual calls
+//              - FlateStream uses two level Huffman tables and decodes more
+//                symbols per readSome call
+//              - StreamPredictor and ImageStream work on whole lines (with
+//                SSE2/AVX2 kernels where available), getRawBlock method
 //
 //========================================================================
 
@@ -100,10 +107,18 @@ public:
   // Peek at next char in stream.
   virtual int lookChar() = 0;
 
+  // Get next <size> chars from stream into <blk>.  Returns the number
+  // of chars read, which is less than <size> only at the end of stream.
+  virtual int getBlock(char *blk, int size);
+
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Get next <size> chars from stream without using the predictor.
+  // This is only used by StreamPredictor.
+  virtual int getRawBlock(char *blk, int size);
+
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
@@ -258,6 +273,8 @@ private:
   int nVals;			// components per line
   Guchar *imgLine;		// line buffer
   int imgIdx;			// current index in imgLine
+  Guchar *inputLine;		// packed line buffer
+  int inputLineSize;		// bytes per packed line
 };
 
 //------------------------------------------------------------------------
@@ -290,6 +307,7 @@ public:
 
   int lookChar();
   int getChar();
+  int getBlock(char *blk, int size);
 
 private:
 
@@ -304,6 +322,7 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *rawLine;		// raw (not predicted) line buffer
   int predIdx;			// current index in predLine
   GBool ok;
 
@@ -336,6 +355,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos()const { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart()const { return start; }
@@ -376,6 +396,7 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos()const { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart()const { return start; }
@@ -440,6 +461,7 @@ public:
   virtual int getChar()
     { int c = lookChar(); buf = EOF; return c; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -464,6 +486,7 @@ public:
   virtual int getChar()
     { int ch = lookChar(); ++index; return ch; }
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -537,6 +560,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
@@ -643,6 +667,7 @@ public:
   virtual void close();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
   Stream *getRawStream() { return str; }
@@ -717,13 +742,20 @@ private:
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
 #define flateMaxDistCodes       30    // max # distance codes
+#define flateMaxMatch          258    // max length of repeated string
+#define flateLookupBits          9    // bits of the first level lookup
 
 // Huffman code table entry
 struct FlateCode {
-  Gushort len;			// code length, in bits
-  Gushort val;			// value represented by this code
+  Gushort len;			// code length, in bits (or flateMaxHuffman +
+				//   second level bits for links)
+  Gushort val;			// value represented by this code (or index
+				//   of the second level table for links)
 };
 
+// Codes up to flateLookupBits long are looked up directly, longer codes
+// go through the second level table linked from the first level entry
+// with the same prefix.
 struct FlateHuffmanTab {
   FlateCode *codes;
   int maxLen;
@@ -747,6 +779,8 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getBlock(char *blk, int size);
+  virtual int getRawBlock(char *blk, int size);
   virtual GString *getPSFilter(int psLevel, const char *indent)const;
   virtual GBool isBinary(GBool last = gTrue)const;
 
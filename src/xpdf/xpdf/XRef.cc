@@ -216,7 +216,18 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
 //------------------------------------------------------------------------
 
 static const char * PDFHEADER="%PDF-";
-XRef::XRef(BaseStream *strA):entries(NULL), streamEnds(NULL), objStr(NULL) {
+
+// Initializes trailer with a deep copy of the src dictionary which fetches
+// indirect objects through xrefA.
+static void initTrailerDict(Object *trailer, const Object *src, XRef *xrefA) {
+  Dict *dict = src->getDict()->clone();
+  dict->setXRef(xrefA);
+  trailer->initDict(dict);
+}
+
+XRef::XRef(BaseStream *strA, XRefLoading loadingA)
+  :entries(NULL), streamEnds(NULL), objStr(NULL), 
+   lazy(loadingA != xrefLoadAll), pendingXRef(gFalse), pendingXRefPos(0) {
   // inits stream and initializes internals
   str = strA;
 
@@ -238,7 +249,7 @@ XRef::XRef(BaseStream *strA):entries(NULL), streamEnds(NULL), objStr(NULL) {
 
   // gets position of last xref section
   Guint pos = getStartXref();
-  if(isOk())
+  if(isOk() && loadingA != xrefLoadDeferred)
     initInternals(pos);
 }
 
@@ -248,15 +259,12 @@ void XRef::setErrCode(int err)const
   ok = (errCode == errNone)?gTrue:gFalse;
 }
 
-/** Initializes all XRef internal structures.
- * @param pos Position of xref table.
+/** Sets default values to internal structures.
  *
- * Assumes that str field is already initialized.
+ * Assumes that internals are not allocated (see destroyInternals).
  */
-void XRef::initInternals(Guint pos)
+void XRef::resetInternals()
 {
-  Object obj;
-
   ok = gTrue;
   setErrCode(errNone);
   size = 0;
@@ -265,13 +273,29 @@ void XRef::initInternals(Guint pos)
   streamEndsLen = 0;
   objStr = NULL;
   maxObj = 0;
+  pendingXRef = gFalse;
+  pendingXRefPos = 0;
 
   useEncrypt = gFalse;
   permFlags = defPermFlags;
   ownerPasswordOk = gFalse;
 
-  // read the trailer
   start = str->getStart();
+}
+
+/** Initializes all XRef internal structures.
+ * @param pos Position of xref table.
+ *
+ * Assumes that str field is already initialized.
+ * <br>
+ * Reads only the xref section at the given position in the lazy mode. 
+ * Older sections are read by readPendingXRef when needed.
+ */
+void XRef::initInternals(Guint pos)
+{
+  Object obj;
+
+  resetInternals();
 
   // if there was a problem with the 'startxref' position, try to
   // reconstruct the xref table
@@ -283,7 +307,14 @@ void XRef::initInternals(Guint pos)
 
   // read the xref table
   } else {
-    while (readXRef(&pos)) ;
+    if (lazy) {
+      if (readXRef(&pos)) {
+        pendingXRef = gTrue;
+        pendingXRefPos = pos;
+      }
+    } else {
+      while (readXRef(&pos)) ;
+    }
 
     // if there was a problem with the xref table,
     // try to reconstruct it
@@ -311,6 +342,77 @@ void XRef::initInternals(Guint pos)
   d->setXRef(this);
 }
 
+/** Initializes all XRef internal structures from already parsed data.
+ * @param pos Position of the most recent xref section.
+ * @param entriesA Xref entries (copied).
+ * @param sizeA Number of entries.
+ * @param maxObjA Maximum present indirect object number.
+ * @param trailerA The most recent trailer dictionary (copied).
+ * @return true if xref is initialized, false if given data are not usable.
+ * In such a case, internals are not initialized and initInternals should
+ * be used.
+ *
+ * Assumes that str field is already initialized and internals are not
+ * allocated.
+ */
+GBool XRef::initFromEntries(Guint pos, const XRefEntry *entriesA, int sizeA,
+		Guint maxObjA, Object *trailerA)
+{
+  Object obj;
+
+  if (sizeA <= 0 || (int)maxObjA >= sizeA || !trailerA->isDict())
+    return gFalse;
+  trailerA->dictLookupNF("Root", &obj);
+  if (!obj.isRef()) {
+    obj.free();
+    return gFalse;
+  }
+  obj.free();
+
+  resetInternals();
+  entries = (XRefEntry *)gmallocn(sizeA, sizeof(XRefEntry));
+  memcpy(entries, entriesA, sizeA * sizeof(XRefEntry));
+  size = sizeA;
+  maxObj = maxObjA;
+  lastXRefPos = pos;
+  initTrailerDict(&trailerDict, trailerA, this);
+  return gTrue;
+}
+
+/** Reads the next unread xref section in the lazy mode.
+ * @return true if a section has been read, false if there is nothing
+ * more to read.
+ *
+ * Falls back to xref reconstruction if the section is damaged same as
+ * initInternals does.
+ */
+GBool XRef::readPendingXRef()const
+{
+  if (!pendingXRef)
+    return gFalse;
+
+  // reading of sections only fills not yet described entries and 
+  // doesn't change the visible state otherwise
+  XRef *self = const_cast<XRef *>(this);
+  Guint pos = pendingXRefPos;
+  setErrCode(errNone);
+  pendingXRef = self->readXRef(&pos);
+  pendingXRefPos = pos;
+  if (!ok) {
+    pendingXRef = gFalse;
+    if (!(ok = self->constructXRef())) {
+      setErrCode(errDamaged);
+      return gFalse;
+    }
+    Object constructed;
+    self->trailerDict.copy(&constructed);
+    self->trailerDict.free();
+    initTrailerDict(&self->trailerDict, &constructed, self);
+    constructed.free();
+  }
+  return gTrue;
+}
+
 void XRef::destroyInternals()
 {
   if(entries)
@@ -958,7 +1060,13 @@ Object *XRef::fetch(int num, int gen, Object *obj)const {
   GBool failed = gFalse;
 
   // check for bogus ref - this can happen in corrupted PDF files
-  if (num < 0 || num >= size) {
+  if (num < 0) {
+    goto err_no_obj;
+  }
+  // older xref sections are read until the entry is described
+  while ((num >= size || entries[num].offset == 0xffffffff) && 
+      readPendingXRef()) ;
+  if (num >= size) {
     goto err_no_obj;
   }
 
@@ -1112,8 +1220,14 @@ int XRef::getRootGen()const
 
 RefState XRef::knowsRef(const Ref &ref)const
 {
+   if(ref.num<0)
+      return UNUSED_REF;
+   // older xref sections are read until the entry is described
+   while((ref.num>=size || entries[ref.num].offset==0xffffffff) && 
+         readPendingXRef()) ;
+
    // boundary checking
-   if(ref.num<0 || ref.num>size)
+   if(ref.num>=size)
       return UNUSED_REF;
 
    switch(entries[ref.num].type)
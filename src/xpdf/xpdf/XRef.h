@@ -20,6 +20,11 @@
 //              - maxObj field added which contains the maximum present 
 //                indirect object number
 //              - pdfVersion and getPDFVersion added
+// PDFedit team - lazy loading mode - only the most recent xref section is
+//                read when the file is opened and older ones are read 
+//                when an entry which is not described yet is required
+//              - initFromEntries to initialize xref from already parsed
+//                entries (e.g. persistent xref index)
 //
 //========================================================================
 
@@ -56,6 +61,22 @@ struct XRefEntry {
   XRefEntryType type;
 };
 
+/** Xref sections loading mode.
+ */
+enum XRefLoading {
+  /** All xref sections are read by constructor. */
+  xrefLoadAll,
+  /** Only the most recent xref section is read by constructor and older
+   * ones are read on demand. 
+   */
+  xrefLoadLazy,
+  /** Constructor reads only the header and startxref position. Descendant
+   * has to call initInternals (which works in the lazy mode then) or 
+   * initFromEntries.
+   */
+  xrefLoadDeferred
+};
+
 /** State of reference type.
  *
  * Describes state of reference. Use *_REF defined values.
@@ -75,7 +96,7 @@ class XRef {
 public:
 
   // Constructor.  Read xref table from stream.
-  XRef(BaseStream *strA);
+  XRef(BaseStream *strA, XRefLoading loadingA = xrefLoadAll);
 
   // Destructor.
   virtual ~XRef();
@@ -117,6 +138,7 @@ public:
   // Return the number of objects in the xref table.
   virtual int getNumObjects()const
   { 
+     readAllXRef();
      int count=0;
      for(int i=0; i<size; i++)
         // counts just not free entries
@@ -132,6 +154,9 @@ public:
    */
   virtual RefState knowsRef(const Ref &ref)const;
 
+  // Are all xref sections read (always true if not in lazy mode)?
+  virtual GBool isComplete()const { return !pendingXRef; }
+
   // Return the offset of the last xref table.
   virtual Guint getLastXRefPos()const { return lastXRefPos; }
 
@@ -144,8 +169,8 @@ public:
   virtual GBool getStreamEnd(Guint streamStart, Guint *streamEnd)const;
 
   // Direct access.
-  virtual int getSize()const { return size; }
-  virtual XRefEntry *getEntry(int i)const { return &entries[i]; }
+  virtual int getSize()const { readAllXRef(); return size; }
+  virtual XRefEntry *getEntry(int i)const { readAllXRef(); return &entries[i]; }
   virtual const Object *getTrailerDict()const { return &trailerDict; }
 
   virtual const char *getPDFVersion()const {return pdfVersion.getCString(); }
@@ -182,9 +207,24 @@ protected:
   int keyLength;		// length of key, in bytes
   int encVersion;		// encryption version
   CryptAlgorithm encAlgorithm;	// encryption algorithm
+  GBool lazy;			// true if older xref sections are read
+  				//   on demand
+  mutable GBool pendingXRef;	// true if there are unread xref sections
+  mutable Guint pendingXRefPos;	// position of the next unread section
 
   // inits all internal structures which may change
   void initInternals(Guint pos);
+  // inits all internal structures from already parsed entries and trailer
+  // (trailer is copied) - returns false if given data are not usable
+  GBool initFromEntries(Guint pos, const XRefEntry *entriesA, int sizeA,
+		  Guint maxObjA, Object *trailerA);
+  // sets default values to internal structures
+  void resetInternals();
+  // reads the next unread xref section (lazy mode) - returns false if
+  // there is nothing more to read
+  GBool readPendingXRef()const;
+  // reads all unread xref sections
+  void readAllXRef()const { while (readPendingXRef()) ; }
   // destroy all internal structures which may be reinitialized
   void destroyInternals();
 